@@ -180,6 +180,7 @@ struct temp_disk_io final : lt::disk_interface
 			{ handler(lt::disk_buffer_holder(*this, const_cast<char*>(b.data()), int(b.size())), error); });
 	}
 
+	using lt::disk_interface::async_write;
 	bool async_write(lt::storage_index_t storage, lt::peer_request const& r
 		, char const* buf, std::shared_ptr<lt::disk_observer>
 		, std::function<void(lt::storage_error const&)> handler
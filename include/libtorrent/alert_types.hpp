@@ -99,7 +99,7 @@ namespace libtorrent {
 	constexpr int user_alert_id = 10000;
 
 	// this constant represents "max_alert_index" + 1
-	constexpr int num_alert_types = 105;
+	constexpr int num_alert_types = 107;
 
 	// internal
 	constexpr int abi_alert_count = 128;
@@ -3112,6 +3112,53 @@ TORRENT_VERSION_NAMESPACE_3_END
 		std::vector<announce_entry> trackers;
 	};
 
+	// This alert is only posted when requested by the user, by calling
+	// session::post_torrent_deltas() on the session. It's a compact alternative
+	// to state_update_alert. For each torrent whose status changed since the
+	// last time it was posted, it holds only the fields that changed.
+	struct TORRENT_EXPORT state_delta_alert final : alert
+	{
+		// internal
+		TORRENT_UNEXPORT state_delta_alert(aux::stack_allocator& alloc
+			, std::vector<torrent_status_delta> d);
+
+		TORRENT_DEFINE_ALERT_PRIO(state_delta_alert, 105, alert_priority::high)
+
+		static constexpr alert_category_t static_category = alert_category::status;
+		std::string message() const override;
+
+		// one entry per torrent with changes. Torrents whose changes don't
+		// affect any of the requested fields are left out.
+		std::vector<torrent_status_delta> deltas;
+	};
+
+	// This alert is posted once session::apply_to_torrents() has applied its
+	// operation to all of the torrents it was given. It's always posted,
+	// regardless of the alert mask.
+	struct TORRENT_EXPORT batch_complete_alert final : alert
+	{
+		// internal
+		TORRENT_UNEXPORT batch_complete_alert(aux::stack_allocator& alloc
+			, std::uint64_t id, int num
+			, std::vector<std::pair<torrent_handle, error_code>> e);
+
+		TORRENT_DEFINE_ALERT_PRIO(batch_complete_alert, 106, alert_priority::critical)
+
+		static constexpr alert_category_t static_category = {};
+		std::string message() const override;
+
+		// the ``batch_id`` passed to apply_to_torrents()
+		std::uint64_t batch_id;
+
+		// the number of torrents the operation was applied to successfully
+		int num_applied;
+
+		// the handles the operation failed for, either because the torrent
+		// had been removed or because the operation threw an exception, along
+		// with the error for each of them
+		std::vector<std::pair<torrent_handle, error_code>> errors;
+	};
+
 	// internal
 	TORRENT_EXTRA_EXPORT char const* performance_warning_str(performance_alert::performance_warning_t i);
 
@@ -131,10 +131,15 @@ namespace aux {
 
 		void maybe_notify(alert* a);
 
-		// this mutex protects everything. Since it's held while executing user
-		// callbacks (the notify function and extension on_alert()) it must be
-		// recursive to support recursively post new alerts.
+		// this mutex protects everything except the buffers that aren't being
+		// written to. Since it's held while executing user callbacks (the notify
+		// function and extension on_alert()) it must be recursive to support
+		// recursively post new alerts.
 		mutable std::recursive_mutex m_mutex;
+
+		// this serializes calls to get_all(), which releases the alerts from
+		// the previous call without holding m_mutex
+		std::mutex m_get_all_mutex;
 		std::condition_variable_any m_condition;
 		std::atomic<alert_category_t> m_alert_mask;
 		int m_queue_size_limit;
@@ -153,22 +158,26 @@ namespace aux {
 		// posted to the queue
 		std::function<void()> m_notify;
 
-		// this is either 0 or 1, it indicates which m_alerts and m_allocations
-		// the alert_manager is allowed to use right now. This is swapped when
-		// the client calls get_all(), at which point all of the alert objects
-		// passed to the client will be owned by libtorrent again, and reset.
+		// this is 0, 1 or 2, it indicates which m_alerts and m_allocations
+		// the alert_manager is allowed to use right now. It's rotated when the
+		// client calls get_all(). The buffer before it holds the alerts passed
+		// to the client and the one after it is empty, ready to be written to
+		// next.
 		int m_generation = 0;
 
-		// this is where all alerts are queued up. There are two heterogeneous
-		// queues to double buffer the thread access. The std::mutex in the alert
-		// manager gives exclusive access to m_alerts[m_generation] and
-		// m_allocations[m_generation] whereas the other copy is exclusively
-		// used by the client thread.
-		aux::array<heterogeneous_queue<alert>, 2> m_alerts;
+		// this is where all alerts are queued up. There are three heterogeneous
+		// queues to triple buffer the thread access. m_mutex gives exclusive
+		// access to m_alerts[m_generation] and m_allocations[m_generation]. The
+		// other two are exclusively used by the client thread, in get_all().
+		// The alerts passed to the client by one call to get_all() are
+		// destructed by the next one, after it has released m_mutex. This
+		// keeps the time the posting thread may have to wait for the lock
+		// independent of the number of alerts.
+		aux::array<heterogeneous_queue<alert>, 3> m_alerts;
 
 		// this is a stack where alerts can allocate variable length content,
 		// such as strings, to go with the alerts.
-		aux::array<stack_allocator, 2> m_allocations;
+		aux::array<stack_allocator, 3> m_allocations;
 
 #ifndef TORRENT_DISABLE_EXTENSIONS
 		std::list<std::shared_ptr<plugin>> m_ses_extensions;
@@ -34,7 +34,11 @@ POSSIBILITY OF SUCH DAMAGE.
 #ifndef TORRENT_BANDWIDTH_MANAGER_HPP_INCLUDED
 #define TORRENT_BANDWIDTH_MANAGER_HPP_INCLUDED
 
+#include <cstdint>
+#include <deque>
+#include <map>
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include "libtorrent/aux_/invariant_check.hpp"
@@ -76,8 +80,74 @@ struct TORRENT_EXTRA_EXPORT bandwidth_manager
 
 private:
 
-	// these are the consumers that want bandwidth
-	std::vector<bw_request> m_queue;
+	// requests with the same bandwidth channels and the same priority are
+	// always assigned the same number of bytes in a round. They are grouped
+	// in a bucket, which keeps track of the total number of bytes assigned
+	// to each of its requests. A round only has to visit the buckets and
+	// the requests that are dispatched, not every queued request
+	struct bucket_key
+	{
+		int priority;
+		aux::array<bandwidth_channel*, bw_request::max_bandwidth_channels> channel;
+		bool operator<(bucket_key const& rhs) const;
+	};
+
+	// refers to a request in m_requests. Entries are removed lazily, the
+	// serial number tells whether the slot still holds the same request
+	struct queue_entry
+	{
+		std::int64_t key;
+		std::int64_t serial;
+		int slot;
+	};
+
+	struct bucket
+	{
+		// the number of bytes that have been assigned to a request that
+		// has been in this bucket since it was created
+		std::int64_t credit = 0;
+
+		// the number of requests in this bucket
+		int num_requests = 0;
+
+		// min-heap of the requests, keyed by the credit at which they
+		// have been assigned all the bytes they asked for
+		std::vector<queue_entry> satisfied_at;
+
+		// the requests in the order they were queued. This is also the
+		// order of their deadlines
+		std::deque<queue_entry> expire_queue;
+	};
+
+	// orders the satisfied_at heap with the lowest key at the front
+	static bool heap_order(queue_entry const& lhs, queue_entry const& rhs);
+
+	using dispatch_list = std::vector<std::pair<std::shared_ptr<bandwidth_socket>, int>>;
+
+	bool is_live(queue_entry const& e) const;
+
+	// removes the request in the specified slot from the queue and adds it,
+	// and the number of bytes assigned to it, to the list of peers to call
+	// back
+	void dispatch(bucket& b, int slot, int assigned, dispatch_list& out);
+
+	void compact(bucket& b);
+
+	// these are the consumers that want bandwidth. Unused slots have a
+	// nullptr peer and are also in m_free_slots
+	std::vector<bw_request> m_requests;
+	std::vector<int> m_free_slots;
+
+	std::map<bucket_key, bucket> m_buckets;
+
+	// the number of times update_quotas() has distributed bandwidth
+	std::int64_t m_round = 0;
+
+	std::int64_t m_next_serial = 0;
+
+	// the next slot in m_requests to check for disconnecting peers
+	int m_reap_cursor = 0;
+
 	// the number of bytes all the requests in queue are for
 	std::int64_t m_queued_bytes;
 
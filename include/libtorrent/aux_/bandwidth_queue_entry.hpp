@@ -35,6 +35,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #define TORRENT_BANDWIDTH_QUEUE_ENTRY_HPP_INCLUDED
 
 #include <memory>
+#include <cstdint>
+#include <algorithm>
 
 #include "libtorrent/aux_/bandwidth_limit.hpp"
 #include "libtorrent/aux_/bandwidth_socket.hpp"
@@ -51,20 +53,29 @@ struct TORRENT_EXTRA_EXPORT bw_request
 	std::shared_ptr<bandwidth_socket> peer;
 	// 1 is normal prio
 	int priority;
-	// the number of bytes assigned to this request so far
-	int assigned;
-	// once assigned reaches this, we dispatch the request function
+	// once this many bytes have been assigned, we dispatch the request function
 	int request_size;
 
-	// the max number of rounds for this request to survive
-	// this ensures that requests gets responses at very low
-	// rate limits, when the requested size would take a long
-	// time to satisfy
-	int ttl;
-
-	// loops over the bandwidth channels and assigns bandwidth
-	// from the most limiting one
-	int assign_bandwidth();
+	// the credit of the bucket this request is queued in, at the time it
+	// was queued. The number of bytes assigned to this request is how much
+	// the bucket's credit has grown since then
+	std::int64_t credit_base = 0;
+
+	// the round in which this request is dispatched with whatever it has
+	// been assigned so far. This ensures that requests gets responses at
+	// very low rate limits, when the requested size would take a long time
+	// to satisfy
+	std::int64_t deadline = 0;
+
+	// uniquely identifies this request within the bandwidth manager
+	std::int64_t serial = 0;
+
+	// the number of bytes assigned to this request, given the current credit
+	// of its bucket
+	int assigned(std::int64_t const credit) const
+	{
+		return int(std::min(std::int64_t(request_size), credit - credit_base));
+	}
 
 	static constexpr int max_bandwidth_channels = 10;
 	// we don't actually support more than 10 channels per peer
@@ -37,7 +37,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/config.hpp"
 #include "libtorrent/debug.hpp"
 #include "libtorrent/aux_/buffer.hpp"
+#include "libtorrent/disk_buffer_holder.hpp"
 
+#include <cstdint>
 #include <deque>
 #include <vector>
 
@@ -84,6 +86,8 @@ namespace aux {
 				buf = rhs.buf;
 				size = rhs.size;
 				used_size = rhs.used_size;
+				fd = rhs.fd;
+				file_offset = rhs.file_offset;
 				move_holder(&holder, &rhs.holder);
 			}
 			buffer_t& operator=(buffer_t&& rhs) & noexcept
@@ -94,6 +98,8 @@ namespace aux {
 				buf = rhs.buf;
 				size = rhs.size;
 				used_size = rhs.used_size;
+				fd = rhs.fd;
+				file_offset = rhs.file_offset;
 				move_holder(&holder, &rhs.holder);
 				return *this;
 			}
@@ -117,6 +123,11 @@ namespace aux {
 			char* buf = nullptr; // the first byte of the buffer
 			int size = 0; // the total size of the buffer
 			int used_size = 0; // this is the number of bytes to send/receive
+
+			// if the buffer is a view of a file, this is the file descriptor
+			// and the offset of buf into the file. Otherwise fd is -1
+			int fd = -1;
+			std::int64_t file_offset = 0;
 		};
 
 	public:
@@ -163,6 +174,16 @@ namespace aux {
 
 		span<boost::asio::const_buffer const> build_iovec(int to_send);
 
+		// if the first buffer in the chain is a view of a file, returns its
+		// file descriptor and sets ``offset`` to the position in the file of
+		// the first byte to send and ``len`` to the number of bytes left in
+		// the buffer. Otherwise returns -1
+		int front_file(std::int64_t& offset, int& len) const;
+
+		// returns the number of bytes in the chain before the first buffer
+		// that is a view of a file, or size() if there is none
+		int bytes_until_file() const;
+
 		void clear();
 
 		void build_mutable_iovec(int bytes, std::vector<span<char>>& vec);
@@ -197,6 +218,7 @@ namespace aux {
 #pragma warning(pop)
 #endif
 
+			set_file(b, buf);
 			new (&b.holder) Holder(std::move(buf));
 
 			m_bytes += used_size;
@@ -205,6 +227,15 @@ namespace aux {
 			TORRENT_ASSERT(m_bytes <= m_capacity);
 		}
 
+		template <typename Holder>
+		static void set_file(buffer_t&, Holder const&) {}
+
+		static void set_file(buffer_t& b, disk_buffer_holder const& h)
+		{
+			b.fd = h.file_descriptor();
+			b.file_offset = h.file_offset();
+		}
+
 		template <typename Buffer>
 		void build_vec(int bytes, std::vector<Buffer>& vec);
 
@@ -0,0 +1,97 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_DH_KEY_POOL_HPP_INCLUDED
+#define TORRENT_DH_KEY_POOL_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+
+#if !defined TORRENT_DISABLE_ENCRYPTION
+
+#include "libtorrent/pe_crypto.hpp"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace libtorrent {
+namespace aux {
+
+	// generating the local key pair for the encrypted handshake is an
+	// expensive modular exponentiation. This keeps a number of key pairs
+	// generated ahead of time, by a background thread, for peer connections
+	// to pick up. When many connections are made at once, the network thread
+	// only has to compute the shared secrets.
+	struct TORRENT_EXTRA_EXPORT dh_key_pool
+	{
+		dh_key_pool() = default;
+		~dh_key_pool();
+		dh_key_pool(dh_key_pool const&) = delete;
+		dh_key_pool& operator=(dh_key_pool const&) = delete;
+
+		// sets the number of key pairs to keep ready. 0 disables the pool
+		// and stops the background thread
+		void set_size(int size);
+
+		// returns a key exchange object with a local key pair. It's taken
+		// from the pool if there is one, otherwise it's generated on the
+		// spot. Returns nullptr if out of memory
+		std::unique_ptr<dh_key_exchange> get();
+
+	private:
+
+		void thread_fun();
+		void stop();
+
+		std::mutex m_mutex;
+		std::condition_variable m_cond;
+
+		// the key pairs ready to be used
+		std::vector<std::unique_ptr<dh_key_exchange>> m_keys;
+
+		// the number of key pairs to keep in m_keys
+		int m_size = 0;
+
+		bool m_abort = false;
+
+		// the thread generating keys. It's only started when the pool is
+		// enabled
+		std::thread m_thread;
+	};
+}
+}
+
+#endif // TORRENT_DISABLE_ENCRYPTION
+
+#endif
@@ -42,6 +42,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #endif
 #include <vector>
 #include <mutex>
+#include <atomic>
+#include <array>
 #include <functional>
 #include <memory>
 
@@ -56,6 +58,11 @@ namespace libtorrent {
 
 namespace aux {
 
+	// disk buffers are carved out of large slabs of memory, backed by huge
+	// pages where supported. Free buffers are kept in a number of caches,
+	// each used by a subset of the threads. The pool-wide mutex is only taken
+	// when a cache runs empty or grows too large, to move a batch of buffers
+	// to or from the pool's free list.
 	struct TORRENT_EXTRA_EXPORT disk_buffer_pool final
 		: buffer_allocator_interface
 	{
@@ -73,27 +80,63 @@ namespace aux {
 
 		int in_use() const
 		{
-			std::unique_lock<std::mutex> l(m_pool_mutex);
-			return m_in_use;
+			return m_in_use.load(std::memory_order_relaxed);
 		}
 
 		void set_settings(settings_interface const& sett);
 
+		// the number of slabs currently allocated
+		int num_slabs() const;
+
 	private:
 
-		void free_buffer_impl(char* buf, std::unique_lock<std::mutex>& l);
-		char* allocate_buffer_impl(std::unique_lock<std::mutex>& l, char const* category);
+		struct cache_t
+		{
+			std::mutex mutex;
+			std::vector<char*> blocks;
+			// keep the mutexes of neighboring caches on separate cache lines
+			char padding[64];
+		};
+
+		// the cache to be used by the calling thread
+		cache_t& local_cache();
+
+		void free_buffer_impl(char* buf, cache_t& c);
+		char* allocate_buffer_impl(char const* category);
+
+		// move a batch of blocks from the pool's free list into the cache,
+		// allocating another slab if necessary. Returns false if we're out of
+		// memory
+		bool refill(cache_t& c);
+
+		// allocate another slab and add its blocks to m_free_list
+		bool add_slab(std::unique_lock<std::mutex>& l);
+
+		struct slab_t
+		{
+			char* base;
+			// the number of blocks of this slab in m_free_list
+			int num_free;
+		};
+
+		// returns the slab ``buf`` was carved out of. Must be called with
+		// m_pool_mutex held
+		slab_t& slab_for(char const* buf);
+
+		// frees the slab, once all of its blocks are in m_free_list. Must be
+		// called with m_pool_mutex held
+		void release_slab(std::vector<slab_t>::iterator s);
 
 		// number of disk buffers currently allocated
-		int m_in_use;
+		std::atomic<int> m_in_use{0};
 
 		// cache size limit
-		int m_max_use;
+		std::atomic<int> m_max_use;
 
 		// if we have exceeded the limit, we won't start
 		// allowing allocations again until we drop below
 		// this low watermark
-		int m_low_watermark;
+		std::atomic<int> m_low_watermark;
 
 		// if we exceed the max number of buffers, we start
 		// adding up callbacks to this queue. Once the number
@@ -102,22 +145,37 @@ namespace aux {
 		std::vector<std::weak_ptr<disk_observer>> m_observers;
 
 		// set to true to throttle more allocations
-		bool m_exceeded_max_size;
+		std::atomic<bool> m_exceeded_max_size{false};
 
 		// this is the main thread io_context. Callbacks are
 		// posted on this in order to have them execute in
 		// the main thread.
 		io_context& m_ios;
 
-		void check_buffer_level(std::unique_lock<std::mutex>& l);
+		void set_exceeded_max_size();
+		void check_buffer_level();
+		void add_buffer_in_use(char* buf);
 		void remove_buffer_in_use(char* buf);
 
+		// protects m_observers, m_slabs and m_free_list
 		mutable std::mutex m_pool_mutex;
 
+		// all slabs allocated by this pool, sorted by address. A slab is
+		// freed once all of its blocks have been returned to m_free_list, as
+		// long as there are enough other free blocks left
+		std::vector<slab_t> m_slabs;
+
+		// blocks that are not in use and not in any of the caches
+		std::vector<char*> m_free_list;
+
+		static constexpr std::size_t num_caches = 16;
+		std::array<cache_t, num_caches> m_caches;
+
 		// this is specifically exempt from release_asserts
 		// since it's a quite costly check. Only for debug
 		// builds.
 #if TORRENT_USE_INVARIANT_CHECKS
+		std::mutex m_in_use_mutex;
 		std::set<char*> m_buffers_in_use;
 #endif
 #if TORRENT_USE_ASSERTS
@@ -0,0 +1,237 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_DISK_JOB_DISPATCHER_HPP
+#define TORRENT_DISK_JOB_DISPATCHER_HPP
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/tailqueue.hpp"
+#include "libtorrent/span.hpp"
+#include "libtorrent/io_context.hpp"
+#include "libtorrent/aux_/disk_job.hpp"
+#include "libtorrent/aux_/mmap_disk_job.hpp"
+#include "libtorrent/aux_/posix_disk_job.hpp"
+#include "libtorrent/aux_/disk_job_pool.hpp"
+#include "libtorrent/aux_/disk_io_thread_pool.hpp"
+
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+
+namespace libtorrent {
+
+	struct counters;
+
+namespace aux {
+
+	struct store_buffer;
+
+	// the disk I/O back-end specific part of executing jobs. The functions are
+	// called by basic_disk_job_dispatcher
+	template <typename Job>
+	struct disk_job_executor
+	{
+		virtual ~disk_job_executor() {}
+
+		// performs the job and returns its status. Errors are reported in
+		// j->error. Exceptions are caught by the caller
+		virtual status_t do_job(Job* j) = 0;
+
+		// called by every disk thread as it starts
+		virtual void thread_started() {}
+
+		// called with the job mutex held, after ``jobs`` (holding a single
+		// job) has been popped off ``queue``. More jobs may be moved from
+		// ``queue`` to ``jobs``, to be executed in the same batch
+		virtual void pop_jobs(tailqueue<Job>&, std::vector<Job*>&) {}
+
+		// called without the job mutex held, before the jobs returned by
+		// pop_jobs() are executed one at a time. This lets the executor do the
+		// work of several of them at once
+		virtual void prepare_jobs(span<Job*>) {}
+
+		// called by the first generic disk thread before executing a job, for
+		// periodic maintenance
+		virtual void maintenance() {}
+
+		// called once everything has been aborted and the disk threads have
+		// stopped, or by abort() if there are no disk threads
+		virtual void abort_jobs() {}
+	};
+
+	// the job queues, disk thread pools, storage fences and completion
+	// handling shared by the disk I/O back-ends that execute their jobs on a
+	// pool of disk threads. Most jobs are executed by the generic disk
+	// threads, but hash jobs issued with sequential_access (i.e. full checks)
+	// are executed by a separate pool of hashing_threads, if configured. With
+	// no disk threads, jobs are executed immediately in the calling thread.
+	// Completion handlers are posted back to the network thread in batches.
+	// ``Job`` is the disk I/O back-end's job type. It is instantiated for
+	// mmap_disk_job and posix_disk_job
+	template <typename Job>
+	struct TORRENT_EXTRA_EXPORT basic_disk_job_dispatcher
+	{
+		using jobqueue_t = tailqueue<Job>;
+		using storage_ptr = decltype(Job::storage);
+
+		basic_disk_job_dispatcher(io_context& ios, counters& cnt
+			, store_buffer& sb, basic_disk_job_pool<Job>& job_pool
+			, disk_job_executor<Job>& executor);
+#if TORRENT_USE_ASSERTS
+		~basic_disk_job_dispatcher();
+#endif
+
+		void set_max_threads(int generic_threads, int hash_threads);
+
+		void abort(bool wait);
+		bool aborted() const { return m_abort; }
+
+		// queues up the job. If there are no disk threads, and this is called
+		// by the user (rather than internally), the job is executed right away
+		void add_job(Job* j, bool user_add = true);
+		void add_fence_job(Job* j, bool user_add = true);
+
+		// aborts the queued up full-check hash jobs against ``st``
+		void abort_hash_jobs(storage_ptr const& st);
+
+		// wakes up the disk threads to run the queued up jobs
+		void submit_jobs();
+
+		int num_queued_jobs() const;
+
+	private:
+
+		struct job_queue : pool_thread_interface
+		{
+			explicit job_queue(basic_disk_job_dispatcher& owner) : m_owner(owner) {}
+
+			void notify_all() override
+			{
+				m_job_cond.notify_all();
+			}
+
+			void thread_fun(disk_io_thread_pool& pool, executor_work_guard<io_context::executor_type> work) override;
+
+			basic_disk_job_dispatcher& m_owner;
+
+			// used to wake up the disk IO thread when there are new
+			// jobs on the job queue (m_queued_jobs)
+			std::condition_variable m_job_cond;
+
+			// jobs queued for servicing
+			jobqueue_t m_queued_jobs;
+		};
+
+		void thread_fun(job_queue& queue, disk_io_thread_pool& pool);
+
+		// returns true if the thread should exit
+		static bool wait_for_job(job_queue& jobq, disk_io_thread_pool& threads
+			, std::unique_lock<std::mutex>& l);
+
+		// called when a job cannot be queued. Immediate failure/abort
+		void job_fail_add(Job* j);
+
+		void execute_job(Job* j);
+		void execute_jobs(span<Job*> jobs);
+		void immediate_execute();
+		void perform_job(Job* j, jobqueue_t& completed_jobs);
+
+		void add_completed_jobs(jobqueue_t jobs);
+		void add_completed_jobs_impl(jobqueue_t jobs, jobqueue_t& completed);
+
+		// This is run in the network thread
+		void call_job_handlers();
+
+		// returns the maximum number of threads
+		// the actual number of threads may be less
+		int num_threads() const;
+		job_queue& queue_for_job(Job* j);
+		disk_io_thread_pool& pool_for_job(Job* j);
+
+		// set to true once we start shutting down
+		std::atomic<bool> m_abort{false};
+
+		// this is a counter of how many threads are currently running.
+		// it's used to identify the last thread still running while
+		// shutting down. This last thread is responsible for cleanup
+		// must hold the job mutex to access
+		int m_num_running_threads = 0;
+
+		// std::mutex to protect the m_generic_io_jobs and m_hash_io_jobs lists
+		mutable std::mutex m_job_mutex;
+
+		// callbacks are posted on this
+		io_context& m_ios;
+
+		counters& m_stats_counters;
+
+		// write jobs that fail to execute are removed from here
+		store_buffer& m_store_buffer;
+
+		basic_disk_job_pool<Job>& m_job_pool;
+
+		disk_job_executor<Job>& m_executor;
+
+		// jobs that are completed are put on this queue
+		// whenever the queue size grows from 0 to 1
+		// a message is posted to the network thread, which
+		// will then drain the queue and execute the jobs'
+		// handler functions
+		std::mutex m_completed_jobs_mutex;
+		jobqueue_t m_completed_jobs;
+
+		// this is protected by the completed_jobs_mutex. It's true whenever
+		// there's a call_job_handlers message in-flight to the network thread. We
+		// only ever keep one such message in flight at a time, and coalesce
+		// completion callbacks in m_completed jobs
+		bool m_job_completions_in_flight = false;
+
+		std::atomic_flag m_jobs_aborted = ATOMIC_FLAG_INIT;
+
+		// most jobs are posted to m_generic_io_jobs
+		// but hash jobs are posted to m_hash_io_jobs if m_hash_threads
+		// has a non-zero maximum thread count
+		job_queue m_generic_io_jobs;
+		disk_io_thread_pool m_generic_threads;
+		job_queue m_hash_io_jobs;
+		disk_io_thread_pool m_hash_threads;
+	};
+
+#if TORRENT_HAVE_MMAP || TORRENT_HAVE_MAP_VIEW_OF_FILE
+	extern template struct basic_disk_job_dispatcher<mmap_disk_job>;
+#endif
+	extern template struct basic_disk_job_dispatcher<posix_disk_job>;
+}
+}
+
+#endif // TORRENT_DISK_JOB_DISPATCHER_HPP
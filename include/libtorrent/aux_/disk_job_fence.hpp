@@ -47,6 +47,7 @@ struct counters;
 namespace aux {
 
 	struct mmap_disk_job;
+	struct posix_disk_job;
 
 	// implements the disk I/O job fence used by the default_storage
 	// to provide to the disk thread. Whenever a disk job needs
@@ -54,13 +55,16 @@ namespace aux {
 	// the fence, blocking all new jobs, until there are no longer
 	// any outstanding jobs on the torrent, then the fence is lowered
 	// and it can be performed, along with the backlog of jobs that
-	// accrued while the fence was up
-	struct TORRENT_EXTRA_EXPORT disk_job_fence
+	// accrued while the fence was up.
+	// ``Job`` is the disk I/O back-end's job type. It is instantiated for
+	// mmap_disk_job and posix_disk_job
+	template <typename Job>
+	struct TORRENT_EXTRA_EXPORT basic_disk_job_fence
 	{
-		disk_job_fence() = default;
+		basic_disk_job_fence() = default;
 
 #if TORRENT_USE_ASSERTS
-		~disk_job_fence()
+		~basic_disk_job_fence()
 		{
 			TORRENT_ASSERT(int(m_outstanding_jobs) == 0);
 			TORRENT_ASSERT(m_blocked_jobs.size() == 0);
@@ -72,19 +76,19 @@ namespace aux {
 		// storage, fence_post_fence is returned.
 		// fence_post_none if the fence job was queued.
 		enum { fence_post_fence = 0, fence_post_none = 1 };
-		int raise_fence(mmap_disk_job*, counters&);
+		int raise_fence(Job*, counters&);
 		bool has_fence() const;
 
 		// called whenever a job completes and is posted back to the
 		// main network thread. the tailqueue of jobs will have the
 		// backed-up jobs prepended to it in case this resulted in the
 		// fence being lowered.
-		int job_complete(mmap_disk_job*, tailqueue<mmap_disk_job>&);
+		int job_complete(Job*, tailqueue<Job>&);
 		int num_outstanding_jobs() const { return m_outstanding_jobs; }
 
 		// if there is a fence up, returns true and adds the job
 		// to the queue of blocked jobs
-		bool is_blocked(mmap_disk_job*);
+		bool is_blocked(Job*);
 
 		// the number of blocked jobs
 		int num_blocked() const;
@@ -98,9 +102,9 @@ namespace aux {
 
 		// when there's a fence up, jobs are queued up in here
 		// until the fence is lowered
-		tailqueue<mmap_disk_job> m_blocked_jobs;
+		tailqueue<Job> m_blocked_jobs;
 
-		// the number of mmap_disk_job objects there are, belonging
+		// the number of Job objects there are, belonging
 		// to this torrent, currently pending, hanging off of
 		// cached_piece_entry objects. This is used to determine
 		// when the fence can be lowered
@@ -111,6 +115,10 @@ namespace aux {
 		mutable std::mutex m_mutex;
 	};
 
+	extern template struct basic_disk_job_fence<mmap_disk_job>;
+	extern template struct basic_disk_job_fence<posix_disk_job>;
+
+	using disk_job_fence = basic_disk_job_fence<mmap_disk_job>;
 
 }}
 
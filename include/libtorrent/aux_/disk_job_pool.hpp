@@ -35,7 +35,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #define TORRENT_DISK_JOB_POOL
 
 #include "libtorrent/config.hpp"
-#include "libtorrent/aux_/mmap_disk_job.hpp" // for job_action_t
+#include "libtorrent/aux_/disk_job.hpp" // for job_action_t
 #include "libtorrent/aux_/pool.hpp"
 #include <mutex>
 
@@ -43,15 +43,19 @@ namespace libtorrent {
 namespace aux {
 
 	struct mmap_disk_job;
+	struct posix_disk_job;
 
-	struct TORRENT_EXTRA_EXPORT disk_job_pool
+	// ``Job`` is the disk I/O back-end's job type. It is instantiated for
+	// mmap_disk_job and posix_disk_job
+	template <typename Job>
+	struct TORRENT_EXTRA_EXPORT basic_disk_job_pool
 	{
-		disk_job_pool();
-		~disk_job_pool();
+		basic_disk_job_pool();
+		~basic_disk_job_pool();
 
-		mmap_disk_job* allocate_job(job_action_t type);
-		void free_job(mmap_disk_job* j);
-		void free_jobs(mmap_disk_job** j, int num);
+		Job* allocate_job(job_action_t type);
+		void free_job(Job* j);
+		void free_jobs(Job** j, int num);
 
 		int jobs_in_use() const { return m_jobs_in_use; }
 		int read_jobs_in_use() const { return m_read_jobs; }
@@ -67,8 +71,13 @@ namespace aux {
 		int m_write_jobs;
 
 		std::mutex m_job_mutex;
-		aux::object_pool<mmap_disk_job> m_job_pool;
+		aux::object_pool<Job> m_job_pool;
 	};
+
+	extern template struct basic_disk_job_pool<mmap_disk_job>;
+	extern template struct basic_disk_job_pool<posix_disk_job>;
+
+	using disk_job_pool = basic_disk_job_pool<mmap_disk_job>;
 }
 }
 
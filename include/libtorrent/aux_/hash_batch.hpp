@@ -0,0 +1,102 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_HASH_BATCH_HPP_INCLUDED
+#define TORRENT_HASH_BATCH_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/sha1_hash.hpp"
+#include "libtorrent/span.hpp"
+
+#include <cstdint>
+#include <cstddef>
+
+// the SHA-NI and AVX2 kernels are compiled with per-function target
+// attributes (or, on msvc, without any special flags), and selected at
+// run-time based on aux::sha_ni_support and aux::avx2_support
+#if TORRENT_HAS_SSE && (defined __GNUC__ || (defined _MSC_VER && _MSC_VER >= 1900))
+#define TORRENT_HAS_SHA_X86 1
+#else
+#define TORRENT_HAS_SHA_X86 0
+#endif
+
+namespace libtorrent {
+namespace aux {
+
+	// computes the SHA-1 digest of each of the buffers in ``in``,
+	// independently of each other, and stores it in the corresponding element
+	// of ``out``. Depending on the CPU, buffers of the same size are hashed in
+	// parallel, several at a time. ``out`` must be at least as large as
+	// ``in``.
+	TORRENT_EXTRA_EXPORT void sha1_batch(span<span<char const> const> in
+		, span<sha1_hash> out);
+
+	// the number of buffers sha1_batch() hashes in parallel on this CPU. If
+	// it's 1, there's nothing to gain from batching buffers
+	TORRENT_EXTRA_EXPORT int sha1_batch_lanes();
+
+	// the SHA-256 counterpart of sha1_batch(). This is meant for v2 block
+	// hashes (the leaves of the merkle trees), which all have the same size
+	//
+	// Both functions write ``out[i]`` only once all of ``in[0]`` .. ``in[i]``
+	// have been read. This means the output may overlap the input buffers,
+	// as long as ``out[i]`` only overlaps inputs with an index <= ``i``.
+	// merkle_hash_layer() relies on this to compute a layer of a tree
+	// in-place.
+	TORRENT_EXTRA_EXPORT void sha256_batch(span<span<char const> const> in
+		, span<sha256_hash> out);
+
+#if TORRENT_HAS_SHA_X86
+	// the compression functions of SHA-1 and SHA-256, implemented with the
+	// SHA extensions. ``state`` is updated with ``blocks`` 64 byte blocks,
+	// read from ``data``. These may only be called if aux::sha_ni_support is
+	// set
+	TORRENT_EXTRA_EXPORT void sha1_ni_blocks(std::uint32_t* state
+		, std::uint8_t const* data, std::size_t blocks);
+	TORRENT_EXTRA_EXPORT void sha256_ni_blocks(std::uint32_t* state
+		, std::uint8_t const* data, std::size_t blocks);
+
+	// the compression functions of SHA-1 and SHA-256 for 8 independent
+	// messages at a time, implemented with AVX2. ``state`` holds the state
+	// of the 8 messages interleaved, i.e. word ``i`` of message ``lane`` is
+	// ``state[i * 8 + lane]``. ``blocks`` 64 byte blocks are read from each
+	// of the 8 pointers in ``data``. These may only be called if
+	// aux::avx2_support is set
+	TORRENT_EXTRA_EXPORT void sha1_avx2_x8(std::uint32_t* state
+		, std::uint8_t const* const* data, std::size_t blocks);
+	TORRENT_EXTRA_EXPORT void sha256_avx2_x8(std::uint32_t* state
+		, std::uint8_t const* const* data, std::size_t blocks);
+#endif
+}
+}
+
+#endif // TORRENT_HASH_BATCH_HPP_INCLUDED
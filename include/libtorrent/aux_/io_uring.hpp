@@ -0,0 +1,150 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_IO_URING_HPP_INCLUDED
+#define TORRENT_IO_URING_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+
+#if TORRENT_HAVE_IO_URING
+
+#include "libtorrent/error_code.hpp"
+
+#include <cstdint>
+
+#include "libtorrent/aux_/disable_warnings_push.hpp"
+#include <linux/io_uring.h>
+#include "libtorrent/aux_/disable_warnings_pop.hpp"
+
+namespace libtorrent {
+namespace aux {
+
+	// a minimal wrapper around a linux io_uring instance, using the raw system
+	// calls (i.e. without depending on liburing). The submission queue and the
+	// completion queue are used from different threads. The submission side
+	// (sqe(), submit()) must be serialized by the caller, and so must the
+	// completion side (wait() and reap())
+	struct TORRENT_EXTRA_EXPORT io_uring
+	{
+		// ``entries`` is the requested size of the submission queue. The kernel
+		// rounds it up to a power of two. If the kernel does not support
+		// io_uring (or it has been disabled), ``ec`` is set and the object is
+		// left invalid
+		io_uring(std::uint32_t entries, error_code& ec);
+		~io_uring();
+
+		io_uring(io_uring const&) = delete;
+		io_uring& operator=(io_uring const&) = delete;
+
+		bool valid() const { return m_fd >= 0; }
+
+		std::uint32_t sq_entries() const { return m_sq_entries; }
+		std::uint32_t cq_entries() const { return m_cq_entries; }
+
+		// returns the next free submission queue entry, cleared, or nullptr
+		// if the submission queue is full. The entry is not visible to the
+		// kernel until submit() is called
+		io_uring_sqe* sqe();
+
+		// the number of entries returned by sqe() that have not been submitted
+		// yet
+		std::uint32_t pending() const { return m_sqe_tail - m_sqe_head; }
+
+		// the number of entries sqe() can return before the submission queue
+		// is full
+		std::uint32_t sq_space_left() const
+		{ return m_sq_entries - (m_sqe_tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE)); }
+
+		// pass all pending submission queue entries to the kernel. Returns the
+		// number of entries consumed by the kernel, or -1 and sets ``ec``
+		int submit(error_code& ec);
+
+		// block until at least one completion is available
+		void wait(error_code& ec);
+
+		// call ``f`` with each available completion, and retire them. Returns
+		// the number of completions passed to ``f``
+		template <typename Fun>
+		int reap(Fun f)
+		{
+			std::uint32_t head = *m_cq_head;
+			std::uint32_t const tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+			int ret = 0;
+			while (head != tail)
+			{
+				io_uring_cqe const& cqe = m_cqes[head & *m_cq_mask];
+				f(cqe.user_data, cqe.res);
+				++head;
+				++ret;
+			}
+			__atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+			return ret;
+		}
+
+	private:
+
+		void close();
+
+		int m_fd = -1;
+
+		std::uint32_t m_sq_entries = 0;
+		std::uint32_t m_cq_entries = 0;
+
+		// the memory mapped rings shared with the kernel
+		void* m_sq_ring = nullptr;
+		std::size_t m_sq_ring_size = 0;
+		void* m_cq_ring = nullptr;
+		std::size_t m_cq_ring_size = 0;
+		io_uring_sqe* m_sqes = nullptr;
+
+		std::uint32_t* m_sq_head = nullptr;
+		std::uint32_t* m_sq_tail = nullptr;
+		std::uint32_t* m_sq_mask = nullptr;
+		std::uint32_t* m_sq_array = nullptr;
+
+		std::uint32_t* m_cq_head = nullptr;
+		std::uint32_t* m_cq_tail = nullptr;
+		std::uint32_t* m_cq_mask = nullptr;
+		io_uring_cqe* m_cqes = nullptr;
+
+		// the range of entries handed out by sqe() but not yet published to
+		// the kernel
+		std::uint32_t m_sqe_head = 0;
+		std::uint32_t m_sqe_tail = 0;
+	};
+
+} // aux
+} // libtorrent
+
+#endif // TORRENT_HAVE_IO_URING
+
+#endif
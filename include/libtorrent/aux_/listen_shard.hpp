@@ -0,0 +1,105 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_LISTEN_SHARD_HPP_INCLUDED
+#define TORRENT_LISTEN_SHARD_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/socket.hpp"
+
+#if TORRENT_HAS_REUSEPORT
+
+#include "libtorrent/io_context.hpp"
+#include "libtorrent/error_code.hpp"
+#include "libtorrent/deadline_timer.hpp"
+
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace libtorrent {
+namespace aux {
+
+	// an additional acceptor for a listen socket, bound to the same endpoint
+	// with SO_REUSEPORT. The kernel spreads the incoming connections over all
+	// the acceptors bound to the endpoint. A shard accepts connections on its
+	// own thread and io_context, and hands the accepted sockets off to the
+	// network thread, where they're handled like any other incoming
+	// connection. This takes the accept() calls off the network thread when
+	// many peers connect at once.
+	struct TORRENT_EXTRA_EXPORT listen_shard
+	{
+		// called on the network thread with each accepted socket, or with
+		// the error accepting a connection failed with
+		using accept_handler = std::function<void(error_code const&, true_tcp_socket)>;
+
+		// ``ios`` is the network thread's io_context. The accepted sockets
+		// belong to it, and ``handler`` is posted to it
+		listen_shard(io_context& ios, accept_handler handler);
+		~listen_shard();
+		listen_shard(listen_shard const&) = delete;
+		listen_shard& operator=(listen_shard const&) = delete;
+
+		// opens the acceptor, binds it to ``ep`` and starts the thread
+		// accepting connections. The listen socket already bound to ``ep``
+		// must have SO_REUSEPORT set
+		void open(tcp::endpoint const& ep, std::string const& device
+			, int backlog, error_code& ec);
+
+		// stops accepting connections and joins the thread. Connections
+		// already handed off to the network thread are not affected
+		void close();
+
+	private:
+
+		void async_accept();
+
+		io_context& m_ios;
+		accept_handler m_handler;
+
+		// everything below is only used by m_thread, once it's started
+		io_context m_shard_ios;
+		tcp::acceptor m_acceptor;
+		deadline_timer m_retry_timer;
+
+		// the socket the next connection is accepted into. It belongs to the
+		// network thread's io_context
+		true_tcp_socket m_peer;
+
+		std::thread m_thread;
+	};
+}
+}
+
+#endif // TORRENT_HAS_REUSEPORT
+
+#endif
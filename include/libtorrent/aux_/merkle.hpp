@@ -78,6 +78,22 @@ namespace libtorrent {
 	TORRENT_EXTRA_EXPORT void merkle_fill_tree(span<sha256_hash> tree, int num_leafs, int level_start);
 	TORRENT_EXTRA_EXPORT void merkle_fill_tree(span<sha256_hash> tree, int num_leafs);
 
+	// the same as merkle_fill_tree(), for a whole tree, but the subtrees
+	// below the top few layers are filled in parallel, by up to
+	// ``num_threads`` threads (including the calling thread). Small trees are
+	// filled by the calling thread alone.
+	TORRENT_EXTRA_EXPORT void merkle_fill_tree_parallel(span<sha256_hash> tree
+		, int num_leafs, int num_threads);
+
+	// computes the parent of each pair of nodes in ``children``, and stores
+	// them in ``parents``, which must be half the size. This is the building
+	// block of the functions computing whole trees. The hashes are computed
+	// in batches, which allows them to be computed in parallel on CPUs that
+	// support it. ``parents`` may alias the beginning of ``children``, to
+	// step up one layer in-place.
+	TORRENT_EXTRA_EXPORT void merkle_hash_layer(span<sha256_hash const> children
+		, span<sha256_hash> parents);
+
 	// fills in nodes that can be computed from a tree with arbitrary nodes set
 	// all "orphan" hashes, i.e ones that do not contribute towards computing
 	// the root, will be cleared.
@@ -98,6 +114,13 @@ namespace libtorrent {
 	sha256_hash merkle_root_scratch(span<sha256_hash const> leaves, int num_leafs
 		, sha256_hash pad, std::vector<sha256_hash>& scratch_space);
 
+	// the same as above, but the caller provides the scratch space, which
+	// must hold at least (leaves.size() + 1) / 2 hashes. This allows it to
+	// live on the stack
+	TORRENT_EXTRA_EXPORT
+	sha256_hash merkle_root_scratch(span<sha256_hash const> leaves, int num_leafs
+		, sha256_hash pad, span<sha256_hash> scratch_space);
+
 	// given a flat index, return which layer the node is in
 	TORRENT_EXTRA_EXPORT int merkle_get_layer(int idx);
 	// given a flat index, return the offset in the layer
@@ -121,6 +121,14 @@ namespace aux {
 		// flushed to disk
 		void page_out(span<byte const> range);
 
+		// hint the kernel that we're about to read this part of the file, to
+		// start reading it into the page cache
+		void will_need(span<byte const> range);
+
+		// returns 1 if all pages in the range are in the page cache, 0 if some
+		// aren't and -1 if it can't be determined on this platform
+		int resident(span<byte const> range) const;
+
 	private:
 
 		void close();
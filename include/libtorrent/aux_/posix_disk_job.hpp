@@ -0,0 +1,61 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_POSIX_DISK_JOB_HPP
+#define TORRENT_POSIX_DISK_JOB_HPP
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/tailqueue.hpp"
+#include "libtorrent/aux_/disk_job.hpp"
+
+#include <memory>
+
+namespace libtorrent {
+namespace aux {
+
+	struct posix_storage;
+
+	// the job type used by posix_disk_io. Like mmap_disk_job, these are
+	// allocated from a pool, owned by the network thread and passed by pointer
+	// to the disk threads, chained in intrusive lists
+	struct TORRENT_EXTRA_EXPORT posix_disk_job
+		: tailqueue_node<posix_disk_job>
+		, disk_job
+	{
+		// the disk storage this job applies to (if applicable)
+		std::shared_ptr<posix_storage> storage;
+	};
+
+}
+}
+
+#endif // TORRENT_POSIX_DISK_JOB_HPP
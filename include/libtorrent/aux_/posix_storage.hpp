@@ -43,7 +43,10 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/open_mode.hpp" // for aux::open_mode_t
 #include "libtorrent/aux_/file_pointer.hpp"
 #include "libtorrent/aux_/posix_part_file.hpp"
+#include "libtorrent/aux_/disk_job_fence.hpp"
+#include "libtorrent/sha1_hash.hpp"
 #include <memory>
+#include <mutex>
 #include <string>
 
 namespace libtorrent {
@@ -51,7 +54,22 @@ namespace aux {
 
 	struct session_settings;
 
+#ifndef TORRENT_WINDOWS
+	// an open file descriptor, closed once the last reference to it is
+	// released
+	struct TORRENT_EXTRA_EXPORT native_fd
+	{
+		explicit native_fd(int f) : fd(f) {}
+		~native_fd();
+		native_fd(native_fd const&) = delete;
+		native_fd& operator=(native_fd const&) = delete;
+		int const fd;
+	};
+#endif
+
 	struct TORRENT_EXTRA_EXPORT posix_storage
+		: std::enable_shared_from_this<posix_storage>
+		, aux::basic_disk_job_fence<aux::posix_disk_job>
 	{
 		explicit posix_storage(storage_params const& p);
 		file_storage const& files() const;
@@ -67,6 +85,27 @@ namespace aux {
 			, piece_index_t const piece, int const offset
 			, storage_error& error);
 
+		// computes the SHA-1 hash of ``piece`` (if ``v1`` is set) and the
+		// SHA-256 hashes of its v2 blocks (if ``block_hashes`` is non-empty).
+		// ``scratch`` is used as the read buffer and must be at least one block.
+		// Returns the number of blocks hashed.
+		int hash(settings_interface const& sett
+			, piece_index_t const piece, bool v1
+			, span<sha256_hash> block_hashes, span<char> scratch
+			, sha1_hash& piece_hash, storage_error& error);
+
+		// computes the SHA-256 hash of the v2 block at ``offset`` in ``piece``
+		sha256_hash hash2(settings_interface const& sett
+			, piece_index_t const piece, int const offset
+			, span<char> scratch, storage_error& error);
+
+		// initializes the storage and validates ``resume_data`` (which may be
+		// nullptr) against the files on disk.
+		status_t check_files(settings_interface const& sett
+			, add_torrent_params const* resume_data
+			, aux::vector<std::string, file_index_t> links
+			, storage_error& error);
+
 		bool has_any_file(storage_error& error);
 		void set_file_priority(settings_interface const&
 			, aux::vector<download_priority_t, file_index_t>& prio
@@ -86,6 +125,27 @@ namespace aux {
 
 		status_t initialize(settings_interface const&, storage_error& ec);
 
+		void set_owner(std::shared_ptr<void> const& tor) { m_torrent = tor; }
+
+		storage_index_t storage_index() const { return m_storage_index; }
+		void set_storage_index(storage_index_t st) { m_storage_index = st; }
+
+#ifndef TORRENT_WINDOWS
+		// opens the file at ``idx`` for disk back-ends that issue their own
+		// I/O against it. Returns nullptr if the file is a pad file or if its
+		// data is stored in the part file, in which case read() and write()
+		// must be used instead. Returns nullptr and sets ``ec`` if opening
+		// the file fails. The file is closed once the last reference to it is
+		// released. Caching the descriptors is up to the caller. This
+		// function may block, and is thread safe
+		std::shared_ptr<native_fd const> open_native_file(file_index_t idx
+			, open_mode_t mode, storage_error& ec);
+
+		// to be called by back-ends writing to a file through a descriptor
+		// returned by open_native_file(), since its size may have changed
+		void native_file_written(file_index_t idx);
+#endif
+
 	private:
 
 		file_pointer open_file(file_index_t idx, open_mode_t mode, std::int64_t offset
@@ -97,6 +157,16 @@ namespace aux {
 
 		file_storage const& m_files;
 		std::unique_ptr<file_storage> m_mapped_files;
+
+		// the reason for this to be a void pointer
+		// is to avoid creating a dependency on the
+		// torrent. This shared_ptr is here only
+		// to keep the torrent object alive until
+		// the storage destructs. This is because
+		// the file_storage object is owned by the torrent.
+		std::shared_ptr<void> m_torrent;
+
+		storage_index_t m_storage_index{0};
 		std::string m_save_path;
 		stat_cache m_stat_cache;
 
@@ -115,6 +185,12 @@ namespace aux {
 
 		std::string m_part_file_name;
 		std::unique_ptr<posix_part_file> m_part_file;
+
+		// reads and writes may be issued from multiple disk threads
+		// concurrently. posix_part_file is not thread safe, so accesses to it
+		// from read() and write() are serialized by this mutex. All other uses
+		// of the part file happen in fence jobs
+		std::mutex m_part_file_mutex;
 	};
 }
 }
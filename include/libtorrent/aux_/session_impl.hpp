@@ -70,6 +70,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/add_torrent_params.hpp"
 #include "libtorrent/stat.hpp"
 #include "libtorrent/aux_/bandwidth_manager.hpp"
+#include "libtorrent/aux_/timer_wheel.hpp"
 #include "libtorrent/udp_socket.hpp"
 #include "libtorrent/assert.hpp"
 #include "libtorrent/aux_/alert_manager.hpp" // for alert_manager
@@ -88,6 +89,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/extensions.hpp"
 #include "libtorrent/aux_/portmap.hpp"
 #include "libtorrent/aux_/lsd.hpp"
+#include "libtorrent/aux_/dh_key_pool.hpp"
+#include "libtorrent/aux_/listen_shard.hpp"
 #include "libtorrent/io_context.hpp"
 #include "libtorrent/flags.hpp"
 #include "libtorrent/span.hpp"
@@ -267,6 +270,12 @@ namespace aux {
 		std::shared_ptr<tcp::acceptor> sock;
 		std::shared_ptr<aux::session_udp_socket> udp_sock;
 
+#if TORRENT_HAS_REUSEPORT
+		// additional acceptors bound to the same endpoint as ``sock``, each
+		// running on its own thread. See settings_pack::listen_shards
+		std::vector<std::unique_ptr<aux::listen_shard>> shards;
+#endif
+
 		// since udp packets are expected to be dispatched frequently, this saves
 		// time on handler allocation every time we read again.
 		aux::handler_storage<aux::udp_handler_max_size, aux::udp_handler> udp_handler_storage;
@@ -333,6 +342,19 @@ namespace aux {
 		TORRENT_EXTRA_EXPORT void expand_devices(span<ip_interface const>
 			, std::vector<listen_endpoint_t>& eps);
 
+		// a batch of torrents prepared by session_handle::async_add_torrents()
+		struct add_torrent_batch
+		{
+			std::vector<add_torrent_params> params;
+
+			// the error preparing each of the torrents in params, if any. e.g.
+			// failing to parse its resume data
+			std::vector<error_code> errors;
+
+			// the time it took to prepare the batch
+			time_duration prepare_time;
+		};
+
 		// this is the link between the main thread and the
 		// thread started to run the main downloader loop
 		struct TORRENT_EXTRA_EXPORT session_impl final
@@ -437,6 +459,16 @@ namespace aux {
 			void async_accept(std::shared_ptr<tcp::acceptor> const&, transport);
 			void on_accept_connection(true_tcp_socket s, error_code const&
 				, std::weak_ptr<tcp::acceptor>, transport);
+#if TORRENT_HAS_REUSEPORT
+			// called for connections accepted by the listen shards of
+			// ``listener``
+			void on_shard_accept(true_tcp_socket s, error_code const&
+				, std::weak_ptr<tcp::acceptor> listener, transport);
+			void open_listen_shards(listen_socket_t& ls, std::string const& device);
+#endif
+			// sets up an accepted connection on ``listener``
+			void accept_incoming(true_tcp_socket s
+				, std::shared_ptr<tcp::acceptor> const& listener, transport);
 
 			void incoming_connection(socket_type);
 
@@ -546,6 +578,9 @@ namespace aux {
 #if !defined TORRENT_DISABLE_ENCRYPTION
 			torrent const* find_encrypted_torrent(
 				sha1_hash const& info_hash, sha1_hash const& xor_mask) override;
+
+			std::unique_ptr<dh_key_exchange> new_dh_key_exchange() override
+			{ return m_dh_key_pool.get(); }
 #endif
 
 			void on_lsd_announce(error_code const& e);
@@ -612,6 +647,7 @@ namespace aux {
 			std::tuple<std::shared_ptr<torrent>, info_hash_t, bool>
 			add_torrent_impl(add_torrent_params const& p, error_code& ec) = delete;
 			void async_add_torrent(add_torrent_params* params);
+			void async_add_torrents(add_torrent_batch* batch);
 
 			void remove_torrent(torrent_handle const& h, remove_flags_t options) override;
 			void remove_torrent_impl(std::shared_ptr<torrent> tptr, remove_flags_t options) override;
@@ -622,6 +658,10 @@ namespace aux {
 			void refresh_torrent_status(std::vector<torrent_status>* ret
 				, status_flags_t flags) const;
 			void post_torrent_updates(status_flags_t flags);
+			void post_torrent_deltas(delta_fields_t fields);
+			void apply_to_torrents(std::vector<torrent_handle> const& handles
+				, std::function<void(torrent_handle const&)> const& op
+				, std::uint64_t batch_id);
 			void post_session_stats();
 			void post_dht_stats();
 
@@ -652,6 +692,9 @@ namespace aux {
 
 			aux::bandwidth_manager* get_bandwidth_manager(int channel) override;
 
+			timer_wheel<std::weak_ptr<peer_connection>>& peer_ticks() override
+			{ return m_peer_ticks; }
+
 			int upload_rate_limit(peer_class_t c) const;
 			int download_rate_limit(peer_class_t c) const;
 			void set_upload_rate_limit(peer_class_t c, int limit);
@@ -839,6 +882,7 @@ namespace aux {
 			void update_unchoke_limit();
 			void update_connection_speed();
 			void update_alert_queue_size();
+			void update_dh_key_pool_size();
 			void update_disk_threads();
 			void update_report_web_seed_downloads();
 			void update_outgoing_interfaces();
@@ -854,6 +898,7 @@ namespace aux {
 			void update_lsd();
 			void update_dht();
 			void update_count_slow();
+			void update_status_snapshots();
 			void update_dht_bootstrap_nodes();
 
 			void update_socket_buffer_size();
@@ -875,6 +920,14 @@ namespace aux {
 			aux::array<aux::vector<torrent*>, num_torrent_lists, torrent_list_index_t>
 				m_torrent_lists;
 
+			// the torrents in the state update list before this index have
+			// already been posted. Their entries are stale, and may point to
+			// torrents that have been removed since. Only the entries from here
+			// on are in the list. This lets a state update with
+			// max_state_updates set take torrents off the front of the list
+			// without moving the ones left behind
+			int m_state_update_head = 0;
+
 			peer_class_pool m_classes;
 
 			void init();
@@ -921,6 +974,11 @@ namespace aux {
 			// handles delayed alerts
 			mutable alert_manager m_alerts;
 
+#if !defined TORRENT_DISABLE_ENCRYPTION
+			// key pairs for encrypted handshakes, generated ahead of time
+			dh_key_pool m_dh_key_pool;
+#endif
+
 #if TORRENT_ABI_VERSION == 1
 			// the alert pointers stored in m_alerts
 			mutable aux::vector<alert*> m_alert_pointers;
@@ -949,6 +1007,11 @@ namespace aux {
 			bandwidth_manager m_download_rate;
 			bandwidth_manager m_upload_rate;
 
+			// the peer connections, scheduled by when they want to be ticked
+			// next. Idle connections are only ticked when one of their
+			// timeouts is due
+			timer_wheel<std::weak_ptr<peer_connection>> m_peer_ticks;
+
 			// the peer class that all peers belong to by default
 			peer_class_t m_global_class{0};
 
@@ -1117,6 +1180,16 @@ namespace aux {
 			void recalculate_unchoke_slots();
 			void recalculate_optimistic_unchoke_slots();
 
+			// the number of torrents, from the front of the state update list,
+			// to include in the next state update, according to
+			// max_state_updates
+			int num_state_updates() const;
+
+			// removes the first ``n`` torrents from the state update list, by
+			// advancing m_state_update_head. The remaining ones are posted
+			// first in the next update
+			void pop_state_updates(int n);
+
 			time_point m_created;
 			std::uint16_t session_time() const override
 			{
@@ -1225,6 +1298,9 @@ namespace aux {
 				send_udp_packet(sock.get_ptr(), ep, p, ec, flags);
 			}
 
+			void on_udp_sent(std::shared_ptr<session_udp_socket> const& s
+				, error_code const& ec);
+			void flush_udp_socket(std::weak_ptr<session_udp_socket> s);
 			void on_udp_writeable(std::weak_ptr<session_udp_socket> s, error_code const& ec);
 
 			void on_udp_packet(std::weak_ptr<session_udp_socket> s
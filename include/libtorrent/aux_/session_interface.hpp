@@ -71,6 +71,9 @@ namespace libtorrent {
 	struct external_ip;
 	struct torrent_peer_allocator_interface;
 	struct counters;
+#if !defined TORRENT_DISABLE_ENCRYPTION
+	class dh_key_exchange;
+#endif
 
 namespace aux {
 	struct utp_socket_manager;
@@ -78,6 +81,7 @@ namespace aux {
 	struct bandwidth_manager;
 	struct resolver_interface;
 	struct alert_manager;
+	template <typename T> struct timer_wheel;
 }
 
 	// hidden
@@ -238,6 +242,10 @@ namespace aux {
 
 		virtual bandwidth_manager* get_bandwidth_manager(int channel) = 0;
 
+		// peer connections schedule their next call to second_tick() in this
+		// wheel. It advances one tick per second
+		virtual timer_wheel<std::weak_ptr<peer_connection>>& peer_ticks() = 0;
+
 		virtual void sent_bytes(int bytes_payload, int bytes_protocol) = 0;
 		virtual void received_bytes(int bytes_payload, int bytes_protocol) = 0;
 		virtual void trancieve_ip_packet(int bytes, bool ipv6) = 0;
@@ -270,7 +278,11 @@ namespace aux {
 		static constexpr torrent_list_index_t torrent_seeding_auto_managed{6};
 		static constexpr torrent_list_index_t torrent_checking_auto_managed{7};
 
-		static constexpr std::size_t num_torrent_lists = 8;
+		// torrents whose status changed since their status snapshot was
+		// last published (only used when status_snapshots is enabled)
+		static constexpr torrent_list_index_t torrent_status_snapshots{8};
+
+		static constexpr std::size_t num_torrent_lists = 9;
 
 		virtual aux::vector<torrent*>& torrent_list(torrent_list_index_t i) = 0;
 
@@ -290,6 +302,10 @@ namespace aux {
 #if !defined TORRENT_DISABLE_ENCRYPTION
 		virtual torrent const* find_encrypted_torrent(
 			sha1_hash const& info_hash, sha1_hash const& xor_mask) = 0;
+
+		// returns a key exchange object, with a local key pair, for an
+		// encrypted handshake. Returns nullptr if out of memory
+		virtual std::unique_ptr<dh_key_exchange> new_dh_key_exchange() = 0;
 #endif
 
 #ifndef TORRENT_DISABLE_DHT
@@ -71,6 +71,10 @@ namespace aux {
 		// writeable again. Once it is, we'll set it to false and notify the utp
 		// socket manager
 		bool write_blocked = false;
+
+		// this is true when a call to flush the packets queued on the udp
+		// socket has been posted to the io_context
+		bool flush_pending = false;
 	};
 
 } }
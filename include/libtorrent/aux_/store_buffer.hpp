@@ -35,6 +35,9 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include <unordered_map>
 #include <mutex>
+#include <array>
+#include <algorithm>
+#include <cstdint>
 
 #include "libtorrent/storage_defs.hpp"
 
@@ -88,14 +91,21 @@ struct hash<libtorrent::aux::torrent_location>
 namespace libtorrent {
 namespace aux {
 
+// the store buffer is accessed by the network thread on every read and by all
+// disk threads on every write. To avoid contention on a single mutex, the
+// locations are spread across a number of shards, each with its own mutex
+// and hash table. The callbacks passed to get() and get2() are invoked with
+// the shards holding the buffers locked, since they may be freed as soon as
+// they are erased.
 struct store_buffer
 {
 	template <typename Fun>
 	bool get(torrent_location const loc, Fun f) const
 	{
-		std::unique_lock<std::mutex> l(m_mutex);
-		auto const it = m_store_buffer.find(loc);
-		if (it != m_store_buffer.end())
+		shard const& s = m_shards[shard_index(loc)];
+		std::unique_lock<std::mutex> l(s.mutex);
+		auto const it = s.buffers.find(loc);
+		if (it != s.buffers.end())
 		{
 			f(it->second);
 			return true;
@@ -106,11 +116,22 @@ struct store_buffer
 	template <typename Fun>
 	int get2(torrent_location const loc1, torrent_location const loc2, Fun f) const
 	{
-		std::unique_lock<std::mutex> l(m_mutex);
-		auto const it1 = m_store_buffer.find(loc1);
-		auto const it2 = m_store_buffer.find(loc2);
-		char const* buf1 = (it1 == m_store_buffer.end()) ? nullptr : it1->second;
-		char const* buf2 = (it2 == m_store_buffer.end()) ? nullptr : it2->second;
+		std::size_t const idx1 = shard_index(loc1);
+		std::size_t const idx2 = shard_index(loc2);
+		shard const& s1 = m_shards[idx1];
+		shard const& s2 = m_shards[idx2];
+
+		// always lock the lower shard first, to not deadlock against
+		// another thread locking the same two shards
+		std::unique_lock<std::mutex> l1(m_shards[std::min(idx1, idx2)].mutex);
+		std::unique_lock<std::mutex> l2;
+		if (idx1 != idx2)
+			l2 = std::unique_lock<std::mutex>(m_shards[std::max(idx1, idx2)].mutex);
+
+		auto const it1 = s1.buffers.find(loc1);
+		auto const it2 = s2.buffers.find(loc2);
+		char const* buf1 = (it1 == s1.buffers.end()) ? nullptr : it1->second;
+		char const* buf2 = (it2 == s2.buffers.end()) ? nullptr : it2->second;
 
 		if (buf1 == nullptr && buf2 == nullptr)
 			return 0;
@@ -120,27 +141,56 @@ struct store_buffer
 
 	void insert(torrent_location const loc, char const* buf)
 	{
-		std::lock_guard<std::mutex> l(m_mutex);
-		m_store_buffer.insert({loc, buf});
+		shard& s = m_shards[shard_index(loc)];
+		std::lock_guard<std::mutex> l(s.mutex);
+		s.buffers.insert({loc, buf});
 	}
 
 	void erase(torrent_location const loc)
 	{
-		std::lock_guard<std::mutex> l(m_mutex);
-		auto it = m_store_buffer.find(loc);
-		TORRENT_ASSERT(it != m_store_buffer.end());
-		m_store_buffer.erase(it);
+		shard& s = m_shards[shard_index(loc)];
+		std::lock_guard<std::mutex> l(s.mutex);
+		auto it = s.buffers.find(loc);
+		TORRENT_ASSERT(it != s.buffers.end());
+		s.buffers.erase(it);
 	}
 
 	std::size_t size() const
 	{
-		return m_store_buffer.size();
+		std::size_t ret = 0;
+		for (auto const& s : m_shards)
+		{
+			std::lock_guard<std::mutex> l(s.mutex);
+			ret += s.buffers.size();
+		}
+		return ret;
 	}
 
 private:
 
-	mutable std::mutex m_mutex;
-	std::unordered_map<torrent_location, char const*> m_store_buffer;
+	// must be a power of 2
+	static constexpr std::size_t num_shards = 64;
+
+	static std::size_t shard_index(torrent_location const& loc)
+	{
+		// offsets are multiples of the block size (16 kiB), so the low bits
+		// don't carry any information. Adjacent blocks are meant to end up in
+		// different shards, since they are typically written concurrently
+		std::uint32_t h = std::uint32_t(static_cast<int>(loc.torrent)) * 0x9e3779b1U;
+		h ^= std::uint32_t(static_cast<int>(loc.piece)) * 0x85ebca6bU;
+		h ^= std::uint32_t(loc.offset) >> 14;
+		h ^= h >> 16;
+		return h & (num_shards - 1);
+	}
+
+	struct shard
+	{
+		// keep the mutexes of neighboring shards on separate cache lines
+		alignas(64) mutable std::mutex mutex;
+		std::unordered_map<torrent_location, char const*> buffers;
+	};
+
+	std::array<shard, num_shards> m_shards;
 };
 
 }
@@ -0,0 +1,130 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef TORRENT_TIMER_WHEEL_HPP_INCLUDED
+#define TORRENT_TIMER_WHEEL_HPP_INCLUDED
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "libtorrent/assert.hpp"
+
+namespace libtorrent {
+namespace aux {
+
+	// a hashed timer wheel, with a resolution of one tick. Items are scheduled
+	// to expire at an absolute tick, and are handed back by advance() once
+	// that tick is reached. Scheduling an item is O(1) and advancing the wheel
+	// only touches the items in the slot of the new tick. Items that are
+	// scheduled more than one turn of the wheel ahead stay in their slot
+	// until their turn comes up.
+	//
+	// Items can't be cancelled. It's up to the owner of the items to ignore
+	// the ones that are stale, for instance by passing the tick they were
+	// scheduled for along with them
+	template <typename T>
+	struct timer_wheel
+	{
+		// the number of slots must be a power of two
+		explicit timer_wheel(int const slots = 64)
+			: m_slots(std::size_t(slots))
+		{
+			TORRENT_ASSERT(slots > 0);
+			TORRENT_ASSERT((slots & (slots - 1)) == 0);
+		}
+
+		// the current tick. All items scheduled for this tick, or earlier, have
+		// been handed back
+		std::int64_t now() const { return m_now; }
+
+		// the number of items in the wheel, including stale ones
+		int size() const { return m_size; }
+
+		// schedules the item to expire at the tick ``when``. Items scheduled
+		// for the current tick, or earlier, expire at the next tick
+		void schedule(T item, std::int64_t when)
+		{
+			if (when <= m_now) when = m_now + 1;
+			m_slots[slot(when)].push_back({std::move(item), when});
+			++m_size;
+		}
+
+		// moves the wheel forward one tick and calls ``f(item, when)`` for every
+		// item that expires. ``f`` may schedule new items
+		template <typename F>
+		void advance(F&& f)
+		{
+			++m_now;
+			std::vector<entry>& s = m_slots[slot(m_now)];
+			if (s.empty()) return;
+
+			// new items may be added to this slot by the callback, so the ones to
+			// expire are moved out first
+			m_expiring.swap(s);
+			for (auto& e : m_expiring)
+			{
+				if (e.when > m_now)
+				{
+					s.push_back(std::move(e));
+					continue;
+				}
+				--m_size;
+				f(e.item, e.when);
+			}
+			m_expiring.clear();
+		}
+
+	private:
+
+		struct entry
+		{
+			T item;
+			std::int64_t when;
+		};
+
+		std::size_t slot(std::int64_t const when) const
+		{ return std::size_t(when) & (m_slots.size() - 1); }
+
+		std::vector<std::vector<entry>> m_slots;
+
+		// the items of the slot that's currently being expired
+		std::vector<entry> m_expiring;
+
+		std::int64_t m_now = 0;
+		int m_size = 0;
+	};
+}
+}
+
+#endif
@@ -172,14 +172,37 @@ namespace libtorrent {
 		// count the number of bits in the bitfield that are set to 1.
 		int count() const noexcept;
 
+		// count the number of bits in the range [``first``, ``last``) that are
+		// set to 1.
+		int count(int first, int last) const noexcept;
+
 		// returns the index of the first set bit in the bitfield, i.e. 1 bit.
 		int find_first_set() const noexcept;
 
+		// returns the index of the first set bit at or after ``index``, or -1
+		// if there is none. This can be used to iterate over the set bits
+		// without testing every bit in between.
+		int find_next_set(int index) const noexcept;
+
 		// returns the index to the last cleared bit in the bitfield, i.e. 0 bit.
 		int find_last_clear() const noexcept;
 
 		bool operator==(lt::bitfield const& rhs) const;
 
+		// the following operate on whole words at a time. ``rhs`` may have a
+		// different size, the bits past its end are treated as 0.
+
+		// clears all bits that are not set in ``rhs`` (bitwise and).
+		bitfield& operator&=(bitfield const& rhs) & noexcept;
+
+		// clears all bits that are set in ``rhs`` (bitwise and-not).
+		void clear_bits(bitfield const& rhs) noexcept;
+
+		// returns true if any bit is set in this bitfield but not in ``rhs``.
+		// This is the same as (*this & ~rhs).none_set() being false, without
+		// allocating a temporary.
+		bool any_and_not(bitfield const& rhs) const noexcept;
+
 		// internal
 		struct const_iterator
 		{
@@ -328,6 +351,17 @@ namespace libtorrent {
 		void set_bit(IndexType const index)
 		{ this->bitfield::set_bit(static_cast<int>(index)); }
 
+		int count(IndexType const first, IndexType const last) const noexcept
+		{ return this->bitfield::count(static_cast<int>(first), static_cast<int>(last)); }
+		int count() const noexcept { return this->bitfield::count(); }
+
+		// returns end_index() if there is no set bit at or after ``index``
+		IndexType find_next_set(IndexType const index) const noexcept
+		{
+			int const ret = this->bitfield::find_next_set(static_cast<int>(index));
+			return ret < 0 ? end_index() : IndexType(ret);
+		}
+
 		IndexType end_index() const noexcept { return IndexType(this->size()); }
 	};
 }
@@ -191,6 +191,7 @@ namespace libtorrent {
 
 		void get_specific_peer_info(peer_info& p) const override;
 		bool in_handshake() const override;
+		bool sends_raw_payload() const override;
 		bool packet_finished() const { return m_recv_buffer.packet_finished(); }
 
 		bool supports_holepunch() const { return m_holepunch_id != 0; }
@@ -219,6 +220,7 @@ namespace libtorrent {
 		void on_bitfield(int received);
 		void on_request(int received);
 		void on_piece(int received);
+		void on_piece_direct(int received);
 		void on_cancel(int received);
 		void on_hash_request(int received);
 		void on_hashes(int received);
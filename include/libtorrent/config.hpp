@@ -249,6 +249,35 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #define TORRENT_USE_SYNC_FILE_RANGE 1
 
+// recvmmsg() was added in glibc 2.12. The simulator's sockets don't have
+// a file descriptor to call it on
+#if !defined TORRENT_USE_RECVMMSG && defined __GLIBC__ \
+	&& !defined TORRENT_BUILD_SIMULATOR \
+	&& (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 12))
+#define TORRENT_USE_RECVMMSG 1
+#endif
+
+// sendmmsg() was added in glibc 2.14
+#if !defined TORRENT_USE_SENDMMSG && defined __GLIBC__ \
+	&& !defined TORRENT_BUILD_SIMULATOR \
+	&& (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 14))
+#define TORRENT_USE_SENDMMSG 1
+#endif
+
+// sendfile() to a socket is supported since linux 2.6.33. As with
+// recvmmsg(), the simulator's sockets don't have a file descriptor
+#if !defined TORRENT_USE_SENDFILE && !defined TORRENT_BUILD_SIMULATOR
+#define TORRENT_USE_SENDFILE 1
+#endif
+
+// io_uring was introduced in linux 5.1. It's only enabled if the kernel
+// headers have it
+#if !defined TORRENT_HAVE_IO_URING && defined __has_include
+#if __has_include(<linux/io_uring.h>)
+#define TORRENT_HAVE_IO_URING 1
+#endif
+#endif
+
 #endif // ANDROID
 
 #if defined __GLIBC__ && ( defined __x86_64__ || defined __i386 \
@@ -512,6 +541,22 @@ POSSIBILITY OF SUCH DAMAGE.
 #define TORRENT_USE_SYNC_FILE_RANGE 0
 #endif
 
+#ifndef TORRENT_HAVE_IO_URING
+#define TORRENT_HAVE_IO_URING 0
+#endif
+
+#ifndef TORRENT_USE_RECVMMSG
+#define TORRENT_USE_RECVMMSG 0
+#endif
+
+#ifndef TORRENT_USE_SENDMMSG
+#define TORRENT_USE_SENDMMSG 0
+#endif
+
+#ifndef TORRENT_USE_SENDFILE
+#define TORRENT_USE_SENDFILE 0
+#endif
+
 
 #ifndef TORRENT_COMPLETE_TYPES_REQUIRED
 #define TORRENT_COMPLETE_TYPES_REQUIRED 0
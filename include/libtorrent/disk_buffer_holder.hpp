@@ -37,6 +37,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/config.hpp"
 #include "libtorrent/assert.hpp"
 #include <utility>
+#include <cstdint>
 
 namespace libtorrent {
 
@@ -69,6 +70,14 @@ namespace libtorrent {
 		disk_buffer_holder(buffer_allocator_interface& alloc
 			, char* buf, int sz) noexcept;
 
+		// construct a buffer holder for a buffer that is a view of a range of a
+		// file. ``fd`` is a file descriptor the same bytes can be read from,
+		// starting at ``file_offset``. It must stay open for as long as the
+		// buffer is held. This allows the buffer to be sent to a socket with
+		// ``sendfile()``
+		disk_buffer_holder(buffer_allocator_interface& alloc
+			, char* buf, int sz, int fd, std::int64_t file_offset) noexcept;
+
 		// default construct a holder that does not own any buffer
 		disk_buffer_holder() noexcept = default;
 
@@ -89,6 +98,8 @@ namespace libtorrent {
 			swap(h.m_allocator, m_allocator);
 			swap(h.m_buf, m_buf);
 			swap(h.m_size, m_size);
+			swap(h.m_fd, m_fd);
+			swap(h.m_file_offset, m_file_offset);
 		}
 
 		// if this returns true, the buffer may not be modified in place
@@ -100,11 +111,21 @@ namespace libtorrent {
 
 		std::ptrdiff_t size() const { return m_size; }
 
+		// if the held buffer is a view of a file, returns the file descriptor
+		// of that file. Otherwise returns -1
+		int file_descriptor() const noexcept { return m_fd; }
+
+		// the offset into the file returned by file_descriptor(), of the first
+		// byte in the buffer
+		std::int64_t file_offset() const noexcept { return m_file_offset; }
+
 	private:
 
 		buffer_allocator_interface* m_allocator = nullptr;
 		char* m_buf = nullptr;
 		int m_size = 0;
+		int m_fd = -1;
+		std::int64_t m_file_offset = 0;
 	};
 
 }
@@ -140,7 +140,7 @@ namespace file_open_mode {
 		time_point last_use;
 	};
 
-	using disk_job_flags_t = flags::bitfield_flag<std::uint8_t, struct disk_job_flags_tag>;
+	using disk_job_flags_t = flags::bitfield_flag<std::uint16_t, struct disk_job_flags_tag>;
 
 	// The disk_interface is the customization point for disk I/O in libtorrent.
 	// implement this interface and provide a factory function to the session constructor
@@ -180,6 +180,21 @@ namespace file_open_mode {
 		// it should be flushed to disk
 		static constexpr disk_job_flags_t flush_piece = 7_bit;
 
+		// for async_read(), this allows the disk_buffer_holder passed to the
+		// handler to refer directly to the file's memory mapping (and keep it
+		// alive) rather than to a copy of the block. The buffer must not be
+		// modified. Disk I/O implementations that don't support this ignore
+		// the flag and return a copy.
+		static constexpr disk_job_flags_t zero_copy = 8_bit;
+
+		// for async_read(), this is a hint that the remainder of the piece is
+		// likely to be read soon, and may be read ahead into the page cache
+		static constexpr disk_job_flags_t read_ahead = 9_bit;
+
+		// for async_read(), along with read_ahead, this is a hint that the
+		// next piece is also likely to be read soon
+		static constexpr disk_job_flags_t read_ahead_next_piece = 10_bit;
+
 		// this is called when a new torrent is added. The shared_ptr can be
 		// used to hold the internal torrent object alive as long as there are
 		// outstanding disk operations on the storage.
@@ -218,6 +233,27 @@ namespace file_open_mode {
 			, std::function<void(storage_error const&)> handler
 			, disk_job_flags_t flags = {}) = 0;
 
+		// allocate a block sized buffer that a peer can receive the payload of
+		// a piece message into, to then pass it to the ``async_write()``
+		// overload taking a disk_buffer_holder, saving a copy. If the buffer
+		// pool is above its watermark, ``exceeded`` is set to true and the
+		// disk_observer is notified once it drops below it again, just like
+		// for ``async_write()``. The default implementation returns an empty
+		// holder, which makes peers fall back to the ``char const*`` overload
+		// of ``async_write()``.
+		virtual disk_buffer_holder allocate_disk_buffer(bool& exceeded
+			, std::shared_ptr<disk_observer> o);
+
+		// like the ``async_write()`` above, but takes ownership of ``buf``,
+		// which must have been returned by allocate_disk_buffer() on this
+		// object, rather than copying the block. The return value has the
+		// same meaning. The default implementation forwards to the
+		// ``char const*`` overload.
+		virtual bool async_write(storage_index_t storage, peer_request const& r
+			, disk_buffer_holder buf, std::shared_ptr<disk_observer> o
+			, std::function<void(storage_error const&)> handler
+			, disk_job_flags_t flags = {});
+
 		// Compute hash(es) for the specified piece. Unless the v1_hash flag is
 		// set (in ``flags``), the SHA-1 hash of the whole piece does not need
 		// to be computed.
@@ -333,6 +333,10 @@ TORRENT_VERSION_NAMESPACE_3_END
 
 		// This hook is called approximately once per second. It is a way of making it
 		// easy for plugins to do timed events, for sending messages or whatever.
+		// Torrents that have no peers, web seeds to connect or transfers, and
+		// whose inactive state is settled, are not ticked. Such idle
+		// torrents start ticking again when they get a connection, transfer
+		// data or change state.
 		virtual void tick() {}
 
 		// These hooks are called when the torrent is paused and resumed respectively.
@@ -499,7 +503,9 @@ TORRENT_VERSION_NAMESPACE_3_END
 		virtual void on_piece_pass(piece_index_t) {}
 		virtual void on_piece_failed(piece_index_t) {}
 
-		// called approximately once every second
+		// called approximately once every second while the connection is
+		// transferring data. Idle connections are ticked at least once every
+		// 10 seconds
 		virtual void tick() {}
 
 		// called each time a request message is to be sent. If true
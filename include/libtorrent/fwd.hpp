@@ -115,6 +115,8 @@ struct torrent_need_cert_alert;
 struct incoming_connection_alert;
 struct add_torrent_alert;
 struct state_update_alert;
+struct state_delta_alert;
+struct batch_complete_alert;
 struct session_stats_alert;
 struct dht_error_alert;
 struct dht_immutable_item_alert;
@@ -283,6 +285,7 @@ TORRENT_VERSION_NAMESPACE_3_END
 TORRENT_VERSION_NAMESPACE_3
 struct torrent_status;
 TORRENT_VERSION_NAMESPACE_3_END
+struct torrent_status_delta;
 
 #if TORRENT_ABI_VERSION <= 2
 
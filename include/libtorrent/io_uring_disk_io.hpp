@@ -0,0 +1,61 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_IO_URING_DISK_IO
+#define TORRENT_IO_URING_DISK_IO
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/io_context.hpp"
+
+#include <memory>
+
+namespace libtorrent {
+
+	struct counters;
+	struct disk_interface;
+	struct settings_interface;
+
+	// constructs a disk I/O object that issues block reads and writes through
+	// a linux io_uring instance. Jobs issued by the network thread are
+	// submitted to the kernel in a single batch on submit_jobs(), and
+	// completions are reaped by a separate thread, which posts the handlers
+	// back to the network thread. It uses the same on-disk layout and part
+	// files as posix_disk_io.
+	//
+	// If io_uring is not available (either because libtorrent was built
+	// without support for it, or because the running kernel lacks it or has
+	// it disabled) this falls back to returning a posix_disk_io object.
+	TORRENT_EXPORT std::unique_ptr<disk_interface> io_uring_disk_io_constructor(
+		io_context& ios, settings_interface const&, counters& cnt);
+}
+
+#endif
@@ -41,6 +41,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #if TORRENT_HAVE_MMAP || TORRENT_HAVE_MAP_VIEW_OF_FILE
 
 #include <mutex>
+#include <array>
 #include <atomic>
 #include <memory>
 
@@ -54,6 +55,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/vector.hpp"
 #include "libtorrent/aux_/open_mode.hpp" // for aux::open_mode_t
 #include "libtorrent/disk_interface.hpp" // for disk_job_flags_t
+#include "libtorrent/disk_buffer_holder.hpp"
 #include "libtorrent/aux_/mmap.hpp"
 
 #include "libtorrent/aux_/disable_warnings_push.hpp"
@@ -115,6 +117,33 @@ namespace aux {
 			, piece_index_t piece, int offset, aux::open_mode_t mode
 			, disk_job_flags_t flags
 			, storage_error&);
+		// if the ``len`` bytes at ``offset`` into ``piece`` are stored in a
+		// single memory mapped file, returns a buffer referring directly to
+		// the mapping, holding a reference to keep it alive. The pages are
+		// faulted in before returning. If the range can't be mapped (e.g. it
+		// spans files, or is stored in the part file), an empty buffer is
+		// returned and read() should be used instead.
+		disk_buffer_holder read_view(settings_interface const&
+			, piece_index_t piece, int offset, int len, aux::open_mode_t mode
+			, storage_error&);
+
+		// hint the kernel to start reading the ``len`` bytes at ``offset``
+		// into ``piece`` into the page cache. Only the parts stored in memory
+		// mapped files are affected. This is best-effort, errors are ignored.
+		void prefetch(settings_interface const&, piece_index_t piece
+			, int offset, int len, aux::open_mode_t mode);
+
+		// returns 1 if the ``len`` bytes at ``offset`` into ``piece`` are in
+		// the page cache, 0 if they aren't and -1 if it can't be determined,
+		// e.g. because the range isn't memory mapped
+		int resident(settings_interface const&, piece_index_t piece
+			, int offset, int len, aux::open_mode_t mode);
+
+		// remember that a read-ahead hint was issued for ``piece``, and query
+		// whether one was issued recently. Only reads of such pieces are worth
+		// checking for residency, to tell whether the hints pay off
+		void read_ahead_issued(piece_index_t piece);
+		bool read_ahead_pending(piece_index_t piece) const;
 		int hash(settings_interface const&, hasher& ph, std::ptrdiff_t len
 			, piece_index_t piece, int offset, aux::open_mode_t mode
 			, disk_job_flags_t flags, storage_error&);
@@ -122,6 +151,28 @@ namespace aux {
 			, piece_index_t piece, int offset, aux::open_mode_t mode
 			, disk_job_flags_t flags, storage_error&);
 
+		// computes the SHA-256 hashes of all v2 blocks in ``piece`` at once,
+		// straight out of the memory mapped file, and stores them in
+		// ``block_hashes``. The blocks are hashed in parallel when the CPU
+		// supports it. Returns the number of bytes hashed, -1 on error and 0
+		// if the piece can't be hashed this way (because it's not memory
+		// mapped or it's stored in the part file). In the latter case, the
+		// caller is expected to fall back to hash2()
+		int hash2_blocks(settings_interface const&, piece_index_t piece
+			, span<sha256_hash> block_hashes, aux::open_mode_t mode
+			, disk_job_flags_t flags, storage_error&);
+
+		// computes the SHA-1 hashes of the v1 ``pieces`` at once, straight out
+		// of the memory mapped files, and stores them in ``hashes``. The pieces
+		// are hashed in parallel when the CPU supports it. Only pieces stored
+		// in a single memory mapped file can be hashed this way. Bit ``i`` of
+		// ``hashed`` is set for each piece that was. The caller is expected to
+		// fall back to hash() for the others, which also reports any errors.
+		// Returns the number of pieces hashed
+		int hash_pieces(settings_interface const&, span<piece_index_t const> pieces
+			, span<sha1_hash> hashes, bitfield& hashed, aux::open_mode_t mode
+			, disk_job_flags_t flags);
+
 		// if the files in this storage are mapped, returns the mapped
 		// file_storage, otherwise returns the original file_storage object.
 		file_storage const& files() const { return m_mapped_files ? *m_mapped_files : m_files; }
@@ -223,6 +274,12 @@ namespace aux {
 #endif
 
 		bool m_allocate_files;
+
+		// the last few pieces a read-ahead hint was issued for, used as a
+		// ring buffer. Reads of other pieces don't check residency
+		mutable std::mutex m_read_ahead_mutex;
+		std::array<piece_index_t, 4> m_read_ahead_pieces;
+		int m_read_ahead_cursor = 0;
 	};
 
 }
@@ -62,6 +62,10 @@ namespace libtorrent {
 
 	TORRENT_EXTRA_EXPORT std::array<char, 96> export_key(key_t const& k);
 
+	// returns (base ^ exp) % P, where P is the prime of the encrypted
+	// handshake key exchange
+	TORRENT_EXTRA_EXPORT key_t dh_pow_mod(key_t const& base, key_t const& exp);
+
 	// RC4 state from libtomcrypt
 	struct rc4 {
 		int x;
@@ -487,6 +487,11 @@ namespace aux {
 		// is called once every second by the main loop
 		void second_tick(int tick_interval_ms);
 
+		// is called by the session's peer timer wheel when this connection's
+		// tick is due. Ticks that have been superseded by an earlier one are
+		// ignored
+		void on_tick_due(std::int64_t tick, int tick_interval_ms);
+
 		aux::socket_type const& get_socket() const { return m_socket; }
 		aux::socket_type& get_socket() { return m_socket; }
 		tcp::endpoint const& remote() const override { return m_remote; }
@@ -589,6 +594,7 @@ namespace aux {
 		void incoming_bitfield(typed_bitfield<piece_index_t> const& bits);
 		void incoming_request(peer_request const& r);
 		void incoming_piece(peer_request const& p, char const* data);
+		void incoming_piece(peer_request const& p, disk_buffer_holder data);
 		void incoming_piece_fragment(int bytes);
 		void start_receive_piece(peer_request const& r);
 		void incoming_cancel(peer_request const& r);
@@ -656,6 +662,12 @@ namespace aux {
 		// speaks our protocol (be it bittorrent or http).
 		virtual bool in_handshake() const = 0;
 
+		// returns true if payload appended to the send buffer is written to
+		// the socket as-is. i.e. it's not encrypted, nor copied by an SSL or
+		// uTP stream. Such buffers may refer directly to the files' memory
+		// mappings
+		virtual bool sends_raw_payload() const { return false; }
+
 		// returns the block currently being
 		// downloaded. And the progress of that
 		// block. If the peer isn't downloading
@@ -775,6 +787,29 @@ namespace aux {
 
 		int get_send_barrier() const { return m_send_barrier; }
 
+		// switch to receiving the remainder of the payload of the piece
+		// message ``r`` straight into a disk buffer, rather than into the
+		// receive buffer. ``received`` is the part of the payload that's
+		// already been received. Returns false if the payload should be
+		// received the normal way. While receiving directly, on_receive() is
+		// only called for payload bytes
+		bool start_direct_receive(peer_request const& r, span<char const> received);
+		bool receiving_direct() const { return bool(m_recv_disk_buffer); }
+
+		// while receiving directly, sets ``r`` to the request being received
+		// and returns the number of payload bytes received so far
+		int direct_receive_progress(peer_request& r) const
+		{
+			TORRENT_ASSERT(m_recv_disk_buffer);
+			r = m_recv_disk_request;
+			return m_recv_disk_pos;
+		}
+
+		// once the whole payload has been received directly, returns the disk
+		// buffer holding it and sets ``r`` to the request it's for, ending
+		// direct receive. Until then, returns an empty holder
+		disk_buffer_holder finish_direct_receive(peer_request& r);
+
 		virtual int timeout() const;
 
 		io_context& get_context() { return m_ios; }
@@ -787,7 +822,21 @@ namespace aux {
 		void on_receive_data(error_code const& error
 			, std::size_t bytes_transferred);
 
+#if TORRENT_USE_SENDFILE
+		// sends the file backed buffer at the front of the send buffer with
+		// sendfile(). If the socket isn't writable, it waits for it to become
+		// writable first
+		void async_sendfile(tcp::socket& s);
+		void wait_sendfile(tcp::socket& s);
+		void on_sendfile_ready(error_code const& error);
+
+		// calls sendfile() once, limited by the upload quota. Sets ``ec`` to
+		// would_block if the socket isn't writable
+		std::size_t sendfile_front(tcp::socket& s, error_code& ec);
+#endif
+
 		void account_received_bytes(int bytes_transferred);
+		void account_direct_received_bytes(int bytes_transferred);
 
 		void do_update_interest();
 		void fill_send_buffer();
@@ -807,6 +856,18 @@ namespace aux {
 		int request_timeout() const;
 		void check_graceful_pause();
 
+		// schedules the next call to on_tick_due() ``delay`` ticks from now,
+		// unless one is already scheduled sooner
+		void schedule_tick(int delay);
+
+		// the number of ticks until this connection needs to be ticked again.
+		// Connections with anything in flight are ticked every second, idle
+		// ones only when their next timeout is due
+		int next_tick_delay() const;
+
+		void incoming_piece_impl(peer_request const& p, char const* data
+			, disk_buffer_holder buffer);
+
 		int wanted_transfer(int channel);
 		int request_bandwidth(int channel, int bytes = 0);
 
@@ -843,6 +904,20 @@ namespace aux {
 	protected:
 		aux::receive_buffer m_recv_buffer;
 
+	private:
+		// when receiving the payload of a piece message straight into a disk
+		// buffer, this is the buffer, the request it's for and the number of
+		// payload bytes received into it so far
+		disk_buffer_holder m_recv_disk_buffer;
+		peer_request m_recv_disk_request;
+		int m_recv_disk_pos = 0;
+
+		// set if the buffer pool was above its watermark when m_recv_disk_buffer
+		// was allocated
+		bool m_recv_disk_exceeded = false;
+
+	protected:
+
 		// number of bytes this peer can send and receive
 		int m_quota[2];
 
@@ -1074,6 +1149,15 @@ namespace aux {
 		// thread that hasn't yet been completely written.
 		int m_outstanding_writing_bytes = 0;
 
+		// the peer timer wheel tick this connection is scheduled for, or -1
+		// if it isn't scheduled
+		std::int64_t m_next_tick = -1;
+
+		// set when this connection is idle and scheduled to be ticked more
+		// than one tick from now. Any socket activity reschedules it for the
+		// next tick
+		bool m_parked = false;
+
 		// max transfer rates seen on this peer
 		int m_download_rate_peak = 0;
 		int m_upload_rate_peak = 0;
@@ -196,12 +196,20 @@ namespace libtorrent {
 			num_have_pieces,
 			num_total_pieces_added,
 
+			add_torrent_prepare_time,
+			add_torrent_time,
+
 			num_blocks_written,
 			num_blocks_read,
 			num_blocks_hashed,
 			num_write_ops,
 			num_read_ops,
 			num_read_back,
+			num_zero_copy_reads,
+			num_read_ahead_ops,
+			num_read_ahead_hits,
+			num_read_ahead_misses,
+			num_coalesced_writes,
 
 			disk_read_time,
 			disk_write_time,
@@ -223,6 +231,8 @@ namespace libtorrent {
 			recv_bytes,
 			recv_ip_overhead_bytes,
 			recv_tracker_bytes,
+			sent_sendfile_bytes,
+			recv_direct_bytes,
 
 			recv_failed_bytes,
 			recv_redundant_bytes,
@@ -270,6 +280,12 @@ namespace libtorrent {
 			utp_invalid_pkts_in,
 			utp_redundant_pkts_in,
 
+			// UDP socket receive and send counters
+			udp_recv_syscalls,
+			udp_recv_packets,
+			udp_send_syscalls,
+			udp_send_packets,
+
 			// the buffer sizes accepted by
 			// socket send calls. The larger
 			// the more efficient. The size is
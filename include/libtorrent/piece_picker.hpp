@@ -43,6 +43,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/config.hpp"
 
 #include <algorithm>
+#include <array>
 #include <vector>
 #include <utility>
 #include <cstdint>
@@ -62,13 +63,12 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/flags.hpp"
 #include "libtorrent/units.hpp"
 #include "libtorrent/index_range.hpp"
+#include "libtorrent/bitfield.hpp"
 
 namespace libtorrent {
 
 	struct torrent;
 	struct peer_connection;
-	template <typename Index>
-	struct typed_bitfield;
 	struct counters;
 	struct torrent_peer;
 
@@ -284,6 +284,12 @@ namespace libtorrent {
 		// has passed the hash check
 		bool have_piece(piece_index_t) const;
 
+		// returns true if ``have`` has any piece that we don't have (or that
+		// hasn't passed the hash check) and that isn't filtered. i.e. whether
+		// a peer with this bitfield is interesting
+		bool has_wanted_piece(typed_bitfield<piece_index_t> const& have) const
+		{ return have.any_and_not(m_have_or_filtered); }
+
 		// returns true if the piece has been completely downloaded and
 		// successfully flushed to disk (i.e. "finished").
 		bool is_piece_flushed(piece_index_t) const;
@@ -773,6 +779,16 @@ namespace libtorrent {
 
 		void break_one_seed();
 
+		// adds one to the pending counter of every piece set in ``bits``
+		void add_pending_refcount(std::array<bitfield, 8>& planes
+			, typed_bitfield<piece_index_t> const& bits);
+
+		// applies the pending availability changes to m_piece_map
+		void apply_pending_refcounts() const;
+
+		// returns the pending change in availability of a single piece
+		int pending_refcount(piece_index_t index) const;
+
 		void update_pieces() const;
 
 		prio_index_t priority_begin(int prio) const;
@@ -823,6 +839,11 @@ namespace libtorrent {
 		// TODO: should this be allocated lazily?
 		mutable aux::vector<piece_pos, piece_index_t> m_piece_map;
 
+		// one bit per piece, set for the pieces that either have_piece() returns
+		// true for, or that are filtered. This lets us determine whether a
+		// peer's bitfield has anything we want a word at a time
+		typed_bitfield<piece_index_t> m_have_or_filtered;
+
 		// tracks the number of bytes in a specific piece that are part of a pad
 		// file. The padding is assumed to be at the end of the piece, and the
 		// blocks covered by the pad bytes are not picked by the piece picker
@@ -848,8 +869,25 @@ namespace libtorrent {
 		std::int64_t m_have_filtered_pad_bytes = 0;
 
 		// the number of seeds. These are not added to
-		// the availability counters of the pieces
-		int m_seeds = 0;
+		// the availability counters of the pieces. It's mutable because
+		// applying pending decrements may have to break up seeds
+		mutable int m_seeds = 0;
+
+		// availability changes from peer bitfields that touch more than a
+		// few pieces make the piece list dirty anyway. Rather than updating
+		// the counter of every piece for every peer that connects or
+		// disconnects, they are accumulated here and applied in one pass when
+		// the counts are needed (typically the next time we pick pieces).
+		// The pending increments (and decrements) of a piece form a binary
+		// number, bit k is in m_pending_inc[k]. A peer's bitfield is added
+		// to all pieces a 32 bit word at a time.
+		mutable std::array<bitfield, 8> m_pending_inc;
+		mutable std::array<bitfield, 8> m_pending_dec;
+
+		// the number of bitfields accumulated in m_pending_inc and
+		// m_pending_dec. They're applied before this exceeds what the
+		// counters can hold
+		mutable int m_num_pending = 0;
 
 		// this vector contains all piece indices that are pickable
 		// sorted by priority. Pieces are in random random order
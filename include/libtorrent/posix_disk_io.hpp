@@ -46,7 +46,9 @@ namespace libtorrent {
 
 	// this is a simple posix disk I/O back-end, used for systems that don't
 	// have a 64 bit virtual address space or don't support memory mapped files.
-	// It's implemented using portable C file functions and is single-threaded.
+	// It's implemented using portable C file functions. Disk jobs are
+	// executed by a pool of disk threads, sized by the aio_threads and
+	// hashing_threads settings.
 	TORRENT_EXPORT std::unique_ptr<disk_interface> posix_disk_io_constructor(
 		io_context& ios, settings_interface const&, counters& cnt);
 }
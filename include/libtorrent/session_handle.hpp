@@ -223,6 +223,33 @@ namespace libtorrent {
 		// see status_flags_t in torrent_handle.
 		void post_torrent_updates(status_flags_t flags = status_flags_t::all());
 
+		// This function instructs the session to post the state_delta_alert,
+		// containing the fields selected by ``fields`` that changed for each
+		// torrent whose state changed since the last time this function was
+		// called. It's an alternative to post_torrent_updates(), which is
+		// cheaper when there are a large number of torrents. Both functions
+		// draw from the same set of changed torrents, so a client should only
+		// use one of them. See torrent_status_delta for the available fields.
+		void post_torrent_deltas(delta_fields_t fields = delta_fields_t::all());
+
+		// Calls ``op`` once for each handle in ``handles``, all within a single
+		// job on the session's network thread. It's meant for applying the
+		// same operation to a large number of torrents, such as pausing them,
+		// setting limits or forcing a reannounce, without posting one job per
+		// torrent. Since ``op`` is called on the network thread, the
+		// torrent_handle functions it calls take effect immediately, rather
+		// than being posted. ``op`` must not block and must not call any
+		// session function.
+		//
+		// Once all torrents have been visited, a batch_complete_alert is
+		// posted with ``batch_id``, the number of torrents the operation
+		// succeeded for and the errors for the ones it failed for. Removed
+		// torrents fail with ``errors::invalid_torrent_handle``. If ``op``
+		// throws something other than system_error, the error is left empty.
+		void apply_to_torrents(std::vector<torrent_handle> handles
+			, std::function<void(torrent_handle const&)> op
+			, std::uint64_t batch_id = 0);
+
 		// This function will post a session_stats_alert object, containing a
 		// snapshot of the performance counters from the internals of libtorrent.
 		// To interpret these counters, query the session via
@@ -295,6 +322,30 @@ namespace libtorrent {
 		void async_add_torrent(add_torrent_params&& params);
 		void async_add_torrent(add_torrent_params const& params);
 
+		// ``async_add_torrents()`` adds a large number of torrents at once,
+		// such as when restoring a session at startup. The work that
+		// async_add_torrent() does on the calling thread is spread across one
+		// thread per CPU core, and the torrents are posted to the network
+		// thread in batches, in the order they were passed in. The network
+		// thread starts adding the first batch as soon as it's ready, while
+		// the rest are still being prepared. The call returns once all
+		// torrents have been posted. Just like async_add_torrent(), an
+		// add_torrent_alert is posted for each torrent.
+		//
+		// The overload taking resume data buffers, as produced by
+		// write_resume_data_buf(), also parses them on the worker threads.
+		// Torrents whose resume data doesn't specify a save path are saved
+		// in ``default_save_path``. If parsing fails, the add_torrent_alert
+		// for it carries the error.
+		//
+		// The time spent preparing and adding the torrents are reported by
+		// the ``ses.add_torrent_prepare_time`` and ``ses.add_torrent_time``
+		// performance counters.
+		void async_add_torrents(std::vector<add_torrent_params> params);
+		void async_add_torrents(std::vector<std::vector<char>> resume_data
+			, std::string const& default_save_path
+			, load_torrent_limits const& cfg = {});
+
 #ifndef BOOST_NO_EXCEPTIONS
 #if TORRENT_ABI_VERSION == 1
 		// deprecated in 0.14
@@ -1110,6 +1161,9 @@ namespace libtorrent {
 
 	private:
 
+		void add_torrents_impl(int num
+			, std::function<void(int, add_torrent_params&, error_code&)> const& prepare);
+
 		template <typename Fun, typename... Args>
 		void async_call(Fun f, Args&&... a) const;
 
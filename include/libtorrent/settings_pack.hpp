@@ -1028,6 +1028,56 @@ namespace aux {
 			// protocol may not be valid from the proxy's point of view.
 			socks5_udp_send_local_ep,
 
+			// when enabled, blocks uploaded to plaintext TCP peers (i.e. not
+			// encrypted, not SSL and not uTP) are sent to the socket directly
+			// from the memory mapped file, instead of being copied into a disk
+			// buffer first. This saves one copy of every byte uploaded. It's only
+			// supported by the mmap disk I/O back-end, on systems other than
+			// windows. Files are kept mapped for as long as a block is waiting
+			// in a peer's send buffer.
+			zero_copy_upload,
+
+			// when enabled, blocks uploaded to plaintext TCP peers are sent with
+			// ``sendfile()``, straight from the file to the socket, without being
+			// copied into user space at all. The piece message header is still
+			// sent from the send buffer, held back by the kernel to go out
+			// together with the block. This implies zero_copy_upload, and has
+			// the same restrictions. It's only supported on linux.
+			sendfile_upload,
+
+			// when enabled, a disk thread that picks up a write job also picks
+			// up all other queued write jobs to the same piece, and performs
+			// them in order of their offset. This turns the blocks of a piece,
+			// received from many peers in random order, into sequential writes.
+			// It's only supported by the mmap disk I/O back-end and mostly
+			// benefits spinning disks.
+			coalesce_piece_writes,
+
+			// when enabled, reading the first block of a piece on behalf of a
+			// peer hints the operating system to read the remainder of the
+			// piece into the page cache, since the peer is likely to request
+			// it. If the peer also has requests queued for the next piece, that
+			// piece is read ahead as well. It's only supported by the mmap disk
+			// I/O back-end.
+			piece_read_ahead,
+
+			// when enabled, once the header of a piece message from a plaintext
+			// peer has been received, the rest of the block is received
+			// directly into a disk buffer, which is then handed to the disk
+			// I/O subsystem as-is. This saves copying every downloaded block
+			// out of the peer's receive buffer. Connections using the
+			// bittorrent protocol encryption always copy. It requires support
+			// from the disk I/O back-end, which all built-in ones have.
+			direct_piece_receive,
+
+			// when enabled, the network thread publishes a snapshot of the
+			// status of every torrent whose state changed, once per tick.
+			// torrent_handle::status_snapshot() returns it without waiting
+			// for the network thread. It's disabled by default, since it
+			// costs a status query per changed torrent every tick, whether
+			// the snapshots are read or not. See status_snapshot_flags.
+			status_snapshots,
+
 			max_bool_setting_internal
 		};
 
@@ -2105,6 +2155,47 @@ namespace aux {
 			//    instead of the actual local listening port.
 			announce_port,
 
+			// ``dh_key_pool_size`` is the number of Diffie-Hellman key pairs,
+			// for encrypted handshakes, to generate ahead of time on a
+			// background thread. Connections take their key pair from this
+			// pool, which takes the most expensive part of the key exchange
+			// off of the network thread, when many connections are made at
+			// once. When the pool is empty (or this is 0) the key pair is
+			// generated when the connection needs it. It defaults to 0, which
+			// doesn't start the background thread. In simulator builds the
+			// pool is always disabled, since the random number generator is
+			// shared and not thread safe there.
+			dh_key_pool_size,
+
+			// ``listen_shards`` is the number of additional threads accepting
+			// incoming TCP connections for each listen socket. Each thread
+			// binds its own socket to the listen socket's endpoint, with
+			// SO_REUSEPORT, and the kernel spreads incoming connections across
+			// them. Accepted connections are handed off to the network thread.
+			// This is only supported on platforms that have SO_REUSEPORT. Note
+			// that it lets other sockets of the same user bind to the listen
+			// port too. 0 (the default) accepts all connections on the network
+			// thread. It will not take effect until the ``listen_interfaces``
+			// settings is updated.
+			listen_shards,
+
+			// ``max_state_updates`` is the max number of torrents included in
+			// a single state_update_alert or state_delta_alert. Torrents that
+			// don't fit remain queued, and are posted first by the next call
+			// to post_torrent_updates() or post_torrent_deltas(). This keeps
+			// the cost of each call bounded when a large number of torrents
+			// change at once. 0 means there is no limit.
+			max_state_updates,
+
+			// the fields filled in by the snapshots published when
+			// ``status_snapshots`` is enabled. This is a bitmask of the
+			// status_flags_t flags defined in torrent_handle, like the
+			// ``flags`` argument to torrent_handle::status(). The default
+			// leaves out the piece bitfields, the distributed copies and the
+			// torrent file, since they are expensive to copy or compute for
+			// every changed torrent, every tick.
+			status_snapshot_flags,
+
 			max_int_setting_internal
 		};
 
@@ -171,6 +171,28 @@ struct udp : boost::asio::ip::udp {
 	};
 #endif
 
+	// SO_REUSEPORT lets several sockets bind to the same endpoint. For TCP
+	// listen sockets, the kernel spreads incoming connections across them.
+	// This isn't used in simulations, which run on a single thread
+#if defined SO_REUSEPORT && !defined TORRENT_BUILD_SIMULATOR
+#define TORRENT_HAS_REUSEPORT 1
+	struct reuse_port
+	{
+		explicit reuse_port(int enable): m_value(enable) {}
+		template<class Protocol>
+		int level(Protocol const&) const { return SOL_SOCKET; }
+		template<class Protocol>
+		int name(Protocol const&) const { return SO_REUSEPORT; }
+		template<class Protocol>
+		int const* data(Protocol const&) const { return &m_value; }
+		template<class Protocol>
+		size_t size(Protocol const&) const { return sizeof(m_value); }
+		int m_value;
+	};
+#else
+#define TORRENT_HAS_REUSEPORT 0
+#endif
+
 	struct type_of_service
 	{
 #ifdef _WIN32
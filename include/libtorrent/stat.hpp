@@ -171,6 +171,15 @@ namespace libtorrent {
 				m_stat[i].second_tick(tick_interval_ms);
 		}
 
+		// true if nothing has been transferred since the last tick and all
+		// rates have decayed to zero
+		bool is_idle() const
+		{
+			for (int i = 0; i < num_channels; ++i)
+				if (m_stat[i].counter() != 0 || m_stat[i].rate() != 0) return false;
+			return true;
+		}
+
 		int low_pass_upload_rate() const
 		{
 			return m_stat[upload_payload].low_pass_rate()
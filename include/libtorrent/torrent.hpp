@@ -51,6 +51,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <deque>
 #include <limits> // for numeric_limits
 #include <memory> // for unique_ptr
+#include <mutex>
 
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 #include <boost/logic/tribool.hpp>
@@ -654,6 +655,23 @@ namespace libtorrent {
 		// it, add it to the m_state_updates list in session_impl
 		void state_updated();
 
+		// this torrent changed state, if status snapshots are enabled, add it
+		// to the list of torrents whose snapshot is published on the next tick
+		void snapshot_updated();
+
+		// called by the session on the network thread. Publishes the current
+		// status as the new snapshot and removes the torrent from the list
+		void publish_status_snapshot();
+		void clear_status_snapshot();
+
+		// returns the last published status snapshot, or nullptr if none has
+		// been published. This is the only torrent member function that may
+		// be called from outside the network thread
+		std::shared_ptr<torrent_status const> status_snapshot() const;
+
+		// builds a snapshot of the current status, without publishing it
+		std::shared_ptr<torrent_status const> make_status_snapshot();
+
 		void file_progress(aux::vector<std::int64_t, file_index_t>& fp, file_progress_flags_t flags);
 		void post_file_progress(file_progress_flags_t flags);
 
@@ -737,6 +755,11 @@ namespace libtorrent {
 
 		bool want_tick() const;
 		void update_want_tick();
+
+		// makes sure the torrent is ticked, if it isn't already. This is
+		// cheap enough to be called for every transfer accounted to it
+		void wake_tick();
+
 		void update_state_list();
 
 		bool want_peers() const;
@@ -1124,6 +1147,10 @@ namespace libtorrent {
 		int time_since_complete() const { return int(aux::posix_time() - m_last_seen_complete); }
 		time_t last_seen_complete() const { return m_last_seen_complete; }
 
+		// called by peer connections to report the last time they saw a seed
+		void peer_seen_complete(time_t const t)
+		{ m_swarm_last_seen_complete = std::max(m_swarm_last_seen_complete, t); }
+
 		template <typename Fun, typename... Args>
 		void wrap(Fun f, Args&&... a);
 
@@ -1209,6 +1236,13 @@ namespace libtorrent {
 		void predicted_have_piece(piece_index_t index, int milliseconds);
 #endif
 
+		// fills in the fields of ``d`` selected by ``fields`` that changed
+		// since they were last posted. Returns false if there weren't any.
+		// Only the selected fields are computed. ``st`` is scratch space for
+		// the byte counters, it's passed in to be reused across torrents
+		bool status_delta(torrent_status_delta* d, delta_fields_t fields
+			, torrent_status& st);
+
 		void clear_in_state_update()
 		{
 			TORRENT_ASSERT(m_links[aux::session_interface::torrent_state_updates].in_list());
@@ -1487,6 +1521,18 @@ namespace libtorrent {
 
 	private:
 
+		// the values last posted for this torrent in a state_delta_alert. Its
+		// ``fields`` member indicates which of them have been posted at all
+		torrent_status_delta m_posted_status;
+
+		// the status last published by publish_status_snapshot(). It's
+		// written by the network thread and read by any thread calling
+		// torrent_handle::status_snapshot(), always with
+		// m_status_snapshot_mutex held. Readers keep the snapshot they loaded
+		// alive by holding on to the shared_ptr
+		mutable std::mutex m_status_snapshot_mutex;
+		std::shared_ptr<torrent_status const> m_status_snapshot;
+
 		// m_num_verified = m_verified.count()
 		std::uint32_t m_num_verified = 0;
 
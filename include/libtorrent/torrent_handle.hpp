@@ -86,6 +86,7 @@ namespace aux {
 #endif
 
 	using status_flags_t = flags::bitfield_flag<std::uint32_t, struct status_flags_tag>;
+	using delta_fields_t = flags::bitfield_flag<std::uint32_t, struct delta_fields_tag>;
 	using add_piece_flags_t = flags::bitfield_flag<std::uint8_t, struct add_piece_flags_tag>;
 	using pause_flags_t = flags::bitfield_flag<std::uint8_t, struct pause_flags_tag>;
 	using deadline_flags_t = flags::bitfield_flag<std::uint8_t, struct deadline_flags_tag>;
@@ -385,6 +386,20 @@ namespace aux {
 		torrent_status status(status_flags_t flags = status_flags_t::all()) const;
 		void post_status(status_flags_t flags = status_flags_t::all()) const;
 
+		// ``status_snapshot()`` returns the status of this torrent as last
+		// published by the network thread, without blocking on it. Snapshots
+		// are only published when settings_pack::status_snapshots is enabled,
+		// at most once per second and only for torrents whose status changed.
+		// The snapshot may therefore be up to a second old. The fields filled
+		// in are the ones selected by settings_pack::status_snapshot_flags.
+		// If no snapshot has been published yet, this falls back to a
+		// blocking call to build one. If the torrent_handle is invalid, it
+		// will throw system_error exception.
+		//
+		// The returned object is immutable and may be shared with other
+		// callers. It's safe to hold on to it for as long as needed.
+		std::shared_ptr<torrent_status const> status_snapshot() const;
+
 		// ``post_download_queue()`` triggers a download_queue_alert to be
 		// posted.
 		// ``get_download_queue()`` is a synchronous call and returns a vector
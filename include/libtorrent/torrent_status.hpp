@@ -603,6 +603,65 @@ TORRENT_VERSION_NAMESPACE_3
 	};
 
 TORRENT_VERSION_NAMESPACE_3_END
+
+	// holds the subset of the fields of a torrent_status that changed since
+	// the last time they were posted in a state_delta_alert. It's a flat
+	// record, without any heap allocated members, to make it cheap to post
+	// for a large number of torrents.
+	struct TORRENT_EXPORT torrent_status_delta
+	{
+		// ``state``
+		static constexpr delta_fields_t state_field = 0_bit;
+
+		// ``flags``
+		static constexpr delta_fields_t flags_field = 1_bit;
+
+		// ``progress_ppm``
+		static constexpr delta_fields_t progress_field = 2_bit;
+
+		// ``download_payload_rate`` and ``upload_payload_rate``
+		static constexpr delta_fields_t rate_fields = 3_bit;
+
+		// ``num_peers`` and ``num_seeds``
+		static constexpr delta_fields_t peer_fields = 4_bit;
+
+		// ``total_done`` and ``total_wanted_done``
+		static constexpr delta_fields_t done_fields = 5_bit;
+
+		// ``all_time_upload`` and ``all_time_download``
+		static constexpr delta_fields_t all_time_fields = 6_bit;
+
+		// ``queue_position``
+		static constexpr delta_fields_t queue_position_field = 7_bit;
+
+		// ``errc``
+		static constexpr delta_fields_t error_field = 8_bit;
+
+		// the torrent this record refers to
+		torrent_handle handle;
+
+		// the fields of this record that are set. The others are left at
+		// their default values, and the client should keep using the value it
+		// received last. The first time a field is posted for a torrent, it's
+		// always included.
+		delta_fields_t fields{};
+
+		// these have the same meaning as the fields with the same names in
+		// torrent_status
+		torrent_status::state_t state = torrent_status::checking_resume_data;
+		torrent_flags_t flags{};
+		int progress_ppm = 0;
+		int download_payload_rate = 0;
+		int upload_payload_rate = 0;
+		int num_peers = 0;
+		int num_seeds = 0;
+		std::int64_t total_done = 0;
+		std::int64_t total_wanted_done = 0;
+		std::int64_t all_time_upload = 0;
+		std::int64_t all_time_download = 0;
+		queue_position_t queue_position{};
+		error_code errc;
+	};
 } // namespace libtorrent
 
 namespace std {
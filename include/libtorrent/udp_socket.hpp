@@ -47,6 +47,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include <array>
 #include <memory>
+#include <vector>
 
 namespace libtorrent {
 
@@ -92,14 +93,53 @@ namespace aux { struct alert_manager; }
 			error_code error;
 		};
 
+		// the max number of packets returned by a single call to read(). Each
+		// packet refers to its own receive buffer, owned by the udp_socket
+		static constexpr std::size_t read_batch_size = 50;
+
+		// receive as many packets as are available on the socket, up to
+		// ``pkts.size()`` (or read_batch_size, whichever is smaller). The
+		// payload of the returned packets remain valid until the next call to
+		// read(). On linux, the socket is drained with recvmmsg(), filling
+		// multiple packets per system call
 		int read(span<packet> pkts, error_code& ec);
 
+		// the number of system calls made by the last call to read()
+		int read_syscalls() const { return m_read_syscalls; }
+
 		// this is only valid when using a socks5 proxy
 		void send_hostname(char const* hostname, int port, span<char const> p
 			, error_code& ec, udp_send_flags_t flags = {});
 
+		// on linux, packets that aren't sent via a proxy and don't have the
+		// dont_fragment flag set are queued, to be sent in a batch by flush().
+		// If the send queue is blocked on the socket becoming writeable,
+		// ``ec`` is set to would_block
 		void send(udp::endpoint const& ep, span<char const> p
 			, error_code& ec, udp_send_flags_t flags = {});
+
+		// send all queued packets, with as few system calls as possible.
+		// Consecutive packets of the same size to the same endpoint are sent
+		// as a single UDP_SEGMENT (GSO) buffer, when the kernel supports it.
+		// If the socket's send buffer fills up, the remaining packets are kept
+		// and ``ec`` is set to would_block. Errors for individual packets are
+		// ignored, the same as if they were lost in the network
+		void flush(error_code& ec);
+
+		// returns true if there are packets waiting for flush()
+		bool has_queued_packets() const
+		{
+#if TORRENT_USE_SENDMMSG
+			return !m_send_queue.empty();
+#else
+			return false;
+#endif
+		}
+
+		// the number of system calls made by the last call to send(),
+		// send_hostname() or flush()
+		int send_syscalls() const { return m_send_syscalls; }
+
 		void open(udp const& protocol, error_code& ec);
 		void bind(udp::endpoint const& ep, error_code& ec);
 		void close();
@@ -153,16 +193,55 @@ namespace aux { struct alert_manager; }
 		void wrap(char const* hostname, int port, span<char const> p, error_code& ec, udp_send_flags_t flags);
 		bool unwrap(udp_socket::packet& pack);
 
+		using receive_buffer = std::array<char, 1500>;
+
+		// receive datagrams into ``pkts``, one per buffer in ``bufs``. Returns
+		// the number of packets received, or 0 and sets ``ec``
+		int receive(span<packet> pkts, span<receive_buffer> bufs, error_code& ec);
+
+		// applies the SOCKS5 and proxy filtering to an incoming packet.
+		// Returns false if the packet should be dropped
+		bool accept(packet& p);
+
+#if TORRENT_USE_SENDMMSG
+		void queue_packet(udp::endpoint const& ep, span<char const> p, error_code& ec);
+#endif
+
 		udp::socket m_socket;
 
 		io_context& m_ioc;
 
-		using receive_buffer = std::array<char, 1500>;
-		std::unique_ptr<receive_buffer> m_buf;
+		// the pool of read_batch_size receive buffers
+		std::unique_ptr<receive_buffer[]> m_buf;
 		aux::listen_socket_handle m_listen_socket;
 
 		std::uint16_t m_bind_port;
 
+		int m_read_syscalls = 0;
+		int m_send_syscalls = 0;
+
+#if TORRENT_USE_SENDMMSG
+		struct queued_packet
+		{
+			udp::endpoint ep;
+			// the payload is stored at this offset in m_send_buffer
+			int offset;
+			int size;
+		};
+
+		// packets waiting to be sent by flush(), and their payloads
+		std::vector<queued_packet> m_send_queue;
+		std::vector<char> m_send_buffer;
+
+		// set when flush() failed to send all packets because the socket's
+		// send buffer was full. No more packets are queued until the next
+		// flush()
+		bool m_send_blocked = false;
+
+		// true if the kernel supports the UDP_SEGMENT socket option
+		bool m_gso = false;
+#endif
+
 		aux::proxy_settings m_proxy_settings;
 
 		std::shared_ptr<socks5> m_socks5_connection;
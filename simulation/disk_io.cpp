@@ -373,6 +373,7 @@ struct test_disk_io final : lt::disk_interface
 		});
 	}
 
+	using lt::disk_interface::async_write;
 	bool async_write(lt::storage_index_t storage, lt::peer_request const& r
 		, char const* buf, std::shared_ptr<lt::disk_observer> o
 		, std::function<void(lt::storage_error const&)> handler
@@ -1829,6 +1829,42 @@ namespace {
 #endif
 	}
 
+	state_delta_alert::state_delta_alert(aux::stack_allocator&
+		, std::vector<torrent_status_delta> d)
+		: deltas(std::move(d))
+	{}
+
+	std::string state_delta_alert::message() const
+	{
+#ifdef TORRENT_DISABLE_ALERT_MSG
+		return {};
+#else
+		char msg[100];
+		std::snprintf(msg, sizeof(msg), "state deltas for %d torrents", int(deltas.size()));
+		return msg;
+#endif
+	}
+
+	batch_complete_alert::batch_complete_alert(aux::stack_allocator&
+		, std::uint64_t const id, int const num
+		, std::vector<std::pair<torrent_handle, error_code>> e)
+		: batch_id(id)
+		, num_applied(num)
+		, errors(std::move(e))
+	{}
+
+	std::string batch_complete_alert::message() const
+	{
+#ifdef TORRENT_DISABLE_ALERT_MSG
+		return {};
+#else
+		char msg[150];
+		std::snprintf(msg, sizeof(msg), "batch %" PRIu64 " complete, applied: %d failed: %d"
+			, batch_id, num_applied, int(errors.size()));
+		return msg;
+#endif
+	}
+
 #if TORRENT_ABI_VERSION == 1
 	mmap_cache_alert::mmap_cache_alert(aux::stack_allocator&
 		, error_code const& ec): error(ec)
@@ -3025,7 +3061,8 @@ namespace {
 		"block_uploaded", "alerts_dropped", "socks5",
 		"file_prio", "oversized_file", "torrent_conflict",
 		"peer_info", "file_progress", "piece_info",
-		"piece_availability", "tracker_list"
+		"piece_availability", "tracker_list", "state_delta",
+		"batch_complete"
 		}};
 
 		TORRENT_ASSERT(alert_type >= 0);
@@ -3288,6 +3325,8 @@ namespace {
 	constexpr alert_category_t piece_info_alert::static_category;
 	constexpr alert_category_t piece_availability_alert::static_category;
 	constexpr alert_category_t tracker_list_alert::static_category;
+	constexpr alert_category_t state_delta_alert::static_category;
+	constexpr alert_category_t batch_complete_alert::static_category;
 #if TORRENT_ABI_VERSION == 1
 	constexpr alert_category_t anonymous_mode_alert::static_category;
 	constexpr alert_category_t mmap_cache_alert::static_category;
@@ -109,26 +109,37 @@ namespace aux {
 
 	void alert_manager::get_all(std::vector<alert*>& alerts)
 	{
-		std::lock_guard<std::recursive_mutex> lock(m_mutex);
+		std::lock_guard<std::mutex> get_all_lock(m_get_all_mutex);
 
-		if (m_alerts[m_generation].empty())
+		int released;
 		{
-			alerts.clear();
-			return;
-		}
-
-		if (m_dropped.any()) {
-			emplace_alert<alerts_dropped_alert>(m_dropped);
-			m_dropped.reset();
+			std::lock_guard<std::recursive_mutex> lock(m_mutex);
+
+			if (m_alerts[m_generation].empty())
+			{
+				alerts.clear();
+				return;
+			}
+
+			if (m_dropped.any()) {
+				emplace_alert<alerts_dropped_alert>(m_dropped);
+				m_dropped.reset();
+			}
+
+			m_alerts[m_generation].get_pointers(alerts);
+
+			// rotate buffers. The one we start writing to now was cleared by
+			// the previous call
+			m_generation = (m_generation + 1) % 3;
+			TORRENT_ASSERT(m_alerts[m_generation].empty());
+			released = (m_generation + 1) % 3;
 		}
 
-		m_alerts[m_generation].get_pointers(alerts);
-
-		// swap buffers
-		m_generation = (m_generation + 1) & 1;
-		// clear the one we will start writing to now
-		m_alerts[m_generation].clear();
-		m_allocations[m_generation].reset();
+		// the alerts passed to the client by the previous call are no longer
+		// valid. Neither the posting thread nor wait_for_alert() touch this
+		// buffer, so there's no need to hold m_mutex while destructing them
+		m_alerts[released].clear();
+		m_allocations[released].reset();
 	}
 
 	bool alert_manager::pending() const
@@ -34,6 +34,9 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "libtorrent/aux_/bandwidth_manager.hpp"
 
+#include <algorithm>
+#include <functional>
+
 #if TORRENT_USE_ASSERTS
 #include <climits>
 #endif
@@ -41,6 +44,25 @@ POSSIBILITY OF SUCH DAMAGE.
 namespace libtorrent {
 namespace aux {
 
+namespace {
+
+	// the number of rounds a request waits for more bandwidth, once it has
+	// been assigned some
+	constexpr int request_ttl = 20;
+}
+
+	bool bandwidth_manager::heap_order(queue_entry const& lhs, queue_entry const& rhs)
+	{
+		return lhs.key > rhs.key;
+	}
+
+	bool bandwidth_manager::bucket_key::operator<(bucket_key const& rhs) const
+	{
+		if (priority != rhs.priority) return priority < rhs.priority;
+		return std::lexicographical_compare(channel.begin(), channel.end()
+			, rhs.channel.begin(), rhs.channel.end(), std::less<bandwidth_channel*>());
+	}
+
 	bandwidth_manager::bandwidth_manager(int channel)
 		: m_queued_bytes(0)
 		, m_channel(channel)
@@ -52,14 +74,25 @@ namespace aux {
 	{
 		m_abort = true;
 
-		std::vector<bw_request> queue;
-		queue.swap(m_queue);
+		dispatch_list queue;
+		for (auto& b : m_buckets)
+		{
+			for (auto const& e : b.second.expire_queue)
+			{
+				if (!is_live(e)) continue;
+				int const assigned = m_requests[e.slot].assigned(b.second.credit);
+				dispatch(b.second, e.slot, assigned, queue);
+			}
+		}
+		m_buckets.clear();
+		m_requests.clear();
+		m_free_slots.clear();
 		m_queued_bytes = 0;
 
 		while (!queue.empty())
 		{
-			bw_request& bwr = queue.back();
-			bwr.peer->assign_bandwidth(m_channel, bwr.assigned);
+			auto& bwr = queue.back();
+			bwr.first->assign_bandwidth(m_channel, bwr.second);
 			queue.pop_back();
 		}
 	}
@@ -67,7 +100,7 @@ namespace aux {
 #if TORRENT_USE_ASSERTS
 	bool bandwidth_manager::is_queued(bandwidth_socket const* peer) const
 	{
-		for (auto const& r : m_queue)
+		for (auto const& r : m_requests)
 		{
 			if (r.peer.get() == peer) return true;
 		}
@@ -77,7 +110,7 @@ namespace aux {
 
 	int bandwidth_manager::queue_size() const
 	{
-		return int(m_queue.size());
+		return int(m_requests.size() - m_free_slots.size());
 	}
 
 	std::int64_t bandwidth_manager::queued_bytes() const
@@ -120,8 +153,31 @@ namespace aux {
 
 		if (k == 0) return blk;
 
+		bucket& b = m_buckets[bucket_key{priority, bwr.channel}];
+		bwr.credit_base = b.credit;
+		bwr.deadline = m_round + request_ttl;
+		bwr.serial = m_next_serial++;
+
+		int slot;
+		if (m_free_slots.empty())
+		{
+			slot = int(m_requests.size());
+			m_requests.push_back(std::move(bwr));
+		}
+		else
+		{
+			slot = m_free_slots.back();
+			m_free_slots.pop_back();
+			m_requests[slot] = std::move(bwr);
+		}
+
+		bw_request const& r = m_requests[slot];
+		b.satisfied_at.push_back({r.credit_base + blk, r.serial, slot});
+		std::push_heap(b.satisfied_at.begin(), b.satisfied_at.end(), heap_order);
+		b.expire_queue.push_back({r.deadline, r.serial, slot});
+		++b.num_requests;
+
 		m_queued_bytes += blk;
-		m_queue.push_back(std::move(bwr));
 		return 0;
 	}
 
@@ -129,65 +185,128 @@ namespace aux {
 	void bandwidth_manager::check_invariant() const
 	{
 		std::int64_t queued = 0;
-		for (auto const& r : m_queue)
+		int num_requests = 0;
+		for (auto const& r : m_requests)
 		{
-			queued += r.request_size - r.assigned;
+			if (!r.peer) continue;
+			auto const b = m_buckets.find(bucket_key{r.priority, r.channel});
+			TORRENT_ASSERT(b != m_buckets.end());
+			TORRENT_ASSERT(b->second.credit >= r.credit_base);
+			queued += r.request_size - r.assigned(b->second.credit);
+			++num_requests;
 		}
 		TORRENT_ASSERT(queued == m_queued_bytes);
+		TORRENT_ASSERT(num_requests == queue_size());
+
+		int bucket_requests = 0;
+		for (auto const& b : m_buckets)
+		{
+			TORRENT_ASSERT(b.second.num_requests > 0);
+			bucket_requests += b.second.num_requests;
+		}
+		TORRENT_ASSERT(bucket_requests == num_requests);
 	}
 #endif
 
+	bool bandwidth_manager::is_live(queue_entry const& e) const
+	{
+		bw_request const& r = m_requests[e.slot];
+		return r.peer && r.serial == e.serial;
+	}
+
+	void bandwidth_manager::dispatch(bucket& b, int const slot, int assigned
+		, dispatch_list& out)
+	{
+		bw_request& r = m_requests[slot];
+		TORRENT_ASSERT(r.peer);
+		TORRENT_ASSERT(assigned >= 0);
+		TORRENT_ASSERT(assigned <= r.request_size);
+		m_queued_bytes -= r.request_size - assigned;
+
+		if (r.peer->is_disconnecting())
+		{
+			// return all assigned quota to all the
+			// bandwidth channels this peer belongs to
+			for (int j = 0; j < bw_request::max_bandwidth_channels && r.channel[j]; ++j)
+				r.channel[j]->return_quota(assigned);
+			assigned = 0;
+		}
+
+		out.emplace_back(std::move(r.peer), assigned);
+		r.peer.reset();
+		m_free_slots.push_back(slot);
+		--b.num_requests;
+	}
+
+	void bandwidth_manager::compact(bucket& b)
+	{
+		// entries of dispatched requests are removed lazily. Don't let them
+		// accumulate in buckets whose credit isn't growing
+		if (int(b.satisfied_at.size()) > b.num_requests * 2 + 16)
+		{
+			b.satisfied_at.erase(std::remove_if(b.satisfied_at.begin(), b.satisfied_at.end()
+				, [this](queue_entry const& e) { return !is_live(e); }), b.satisfied_at.end());
+			std::make_heap(b.satisfied_at.begin(), b.satisfied_at.end(), heap_order);
+		}
+		if (int(b.expire_queue.size()) > b.num_requests * 2 + 16)
+		{
+			b.expire_queue.erase(std::remove_if(b.expire_queue.begin(), b.expire_queue.end()
+				, [this](queue_entry const& e) { return !is_live(e); }), b.expire_queue.end());
+		}
+	}
+
 	void bandwidth_manager::update_quotas(time_duration const& dt)
 	{
 		if (m_abort) return;
-		if (m_queue.empty()) return;
+		if (m_buckets.empty()) return;
 
 		INVARIANT_CHECK;
 
 		std::int64_t dt_milliseconds = total_milliseconds(dt);
 		if (dt_milliseconds > 3000) dt_milliseconds = 3000;
 
-		// for each bandwidth channel, call update_quota(dt)
-
-		std::vector<bandwidth_channel*> channels;
+		++m_round;
 
-		std::vector<bw_request> queue;
+		// the peers to hand bandwidth to. They are called once the queue is
+		// consistent again, since they may request more bandwidth right away
+		dispatch_list queue;
 
-		for (auto i = m_queue.begin(); i != m_queue.end();)
+		// disconnecting peers give their quota back. Instead of checking
+		// every request every round, a slice of the requests is checked, so
+		// a disconnecting peer is removed within 8 rounds
+		int const num_slots = int(m_requests.size());
+		for (int n = std::min(num_slots, num_slots / 8 + 1); n > 0; --n)
 		{
-			if (i->peer->is_disconnecting())
-			{
-				m_queued_bytes -= i->request_size - i->assigned;
+			if (m_reap_cursor >= num_slots) m_reap_cursor = 0;
+			int const slot = m_reap_cursor++;
+			bw_request const& r = m_requests[slot];
+			if (!r.peer || !r.peer->is_disconnecting()) continue;
+			auto const b = m_buckets.find(bucket_key{r.priority, r.channel});
+			TORRENT_ASSERT(b != m_buckets.end());
+			dispatch(b->second, slot, r.assigned(b->second.credit), queue);
+			if (b->second.num_requests == 0) m_buckets.erase(b);
+		}
 
-				// return all assigned quota to all the
-				// bandwidth channels this peer belongs to
-				for (int j = 0; j < bw_request::max_bandwidth_channels && i->channel[j]; ++j)
-				{
-					bandwidth_channel* bwc = i->channel[j];
-					bwc->return_quota(i->assigned);
-				}
+		// for each bandwidth channel, call update_quota(dt). The channel's
+		// tmp field is the sum of the priorities of the requests queued on it
 
-				i->assigned = 0;
-				queue.push_back(std::move(*i));
-				i = m_queue.erase(i);
-				continue;
-			}
-			for (int j = 0; j < bw_request::max_bandwidth_channels && i->channel[j]; ++j)
-			{
-				bandwidth_channel* bwc = i->channel[j];
-				bwc->tmp = 0;
-			}
-			++i;
+		std::vector<bandwidth_channel*> channels;
+
+		for (auto const& b : m_buckets)
+		{
+			for (int j = 0; j < bw_request::max_bandwidth_channels && b.first.channel[j]; ++j)
+				b.first.channel[j]->tmp = 0;
 		}
 
-		for (auto const& r : m_queue)
+		for (auto const& b : m_buckets)
 		{
-			for (int j = 0; j < bw_request::max_bandwidth_channels && r.channel[j]; ++j)
+			int const weight = b.first.priority * b.second.num_requests;
+			for (int j = 0; j < bw_request::max_bandwidth_channels && b.first.channel[j]; ++j)
 			{
-				bandwidth_channel* bwc = r.channel[j];
+				bandwidth_channel* bwc = b.first.channel[j];
 				if (bwc->tmp == 0) channels.push_back(bwc);
-				TORRENT_ASSERT(INT_MAX - bwc->tmp > r.priority);
-				bwc->tmp += r.priority;
+				TORRENT_ASSERT(INT_MAX - bwc->tmp > weight);
+				bwc->tmp += weight;
 			}
 		}
 
@@ -196,28 +315,90 @@ namespace aux {
 			ch->update_quota(int(dt_milliseconds));
 		}
 
-		for (auto i = m_queue.begin(); i != m_queue.end();)
+		for (auto i = m_buckets.begin(); i != m_buckets.end();)
 		{
-			int a = i->assign_bandwidth();
-			if (i->assigned == i->request_size
-				|| (i->ttl <= 0 && i->assigned > 0))
+			bucket_key const& key = i->first;
+			bucket& b = i->second;
+
+			// every request in the bucket is assigned its share of the most
+			// limiting channel
+			std::int64_t share = -1;
+			for (int j = 0; j < bw_request::max_bandwidth_channels && key.channel[j]; ++j)
 			{
-				a += i->request_size - i->assigned;
-				TORRENT_ASSERT(i->assigned <= i->request_size);
-				queue.push_back(std::move(*i));
-				i = m_queue.erase(i);
+				bandwidth_channel const* bwc = key.channel[j];
+				if (bwc->throttle() == 0) continue;
+				if (bwc->tmp == 0) continue;
+				std::int64_t const s = std::int64_t(bwc->distribute_quota)
+					* key.priority / bwc->tmp;
+				if (share < 0 || s < share) share = s;
 			}
-			else
+
+			if (share < 0)
+			{
+				// none of the channels are rate limited (anymore), all
+				// requests are satisfied
+				for (auto const& e : b.expire_queue)
+				{
+					if (!is_live(e)) continue;
+					bw_request const& r = m_requests[e.slot];
+					m_queued_bytes -= r.request_size - r.assigned(b.credit);
+					dispatch(b, e.slot, r.request_size, queue);
+				}
+				TORRENT_ASSERT(b.num_requests == 0);
+				i = m_buckets.erase(i);
+				continue;
+			}
+
+			b.credit += share;
+			std::int64_t used = share * b.num_requests;
+
+			while (!b.satisfied_at.empty() && b.satisfied_at.front().key <= b.credit)
 			{
-				++i;
+				std::pop_heap(b.satisfied_at.begin(), b.satisfied_at.end(), heap_order);
+				queue_entry const e = b.satisfied_at.back();
+				b.satisfied_at.pop_back();
+				if (!is_live(e)) continue;
+
+				// this request only needed part of its share this round
+				used -= b.credit - e.key;
+				dispatch(b, e.slot, m_requests[e.slot].request_size, queue);
 			}
-			m_queued_bytes -= a;
+
+			TORRENT_ASSERT(used >= 0);
+			TORRENT_ASSERT(used <= INT_MAX);
+			m_queued_bytes -= used;
+			for (int j = 0; j < bw_request::max_bandwidth_channels && key.channel[j]; ++j)
+				key.channel[j]->use_quota(int(used));
+
+			// requests that have waited long enough are dispatched with the
+			// bandwidth they have been assigned so far. The ones queued later
+			// have later deadlines and haven't been assigned more
+			while (!b.expire_queue.empty())
+			{
+				queue_entry const e = b.expire_queue.front();
+				if (is_live(e))
+				{
+					bw_request const& r = m_requests[e.slot];
+					if (r.deadline > m_round) break;
+					if (r.credit_base == b.credit) break;
+					dispatch(b, e.slot, r.assigned(b.credit), queue);
+				}
+				b.expire_queue.pop_front();
+			}
+
+			if (b.num_requests == 0)
+			{
+				i = m_buckets.erase(i);
+				continue;
+			}
+			compact(b);
+			++i;
 		}
 
 		while (!queue.empty())
 		{
-			bw_request& bwr = queue.back();
-			bwr.peer->assign_bandwidth(m_channel, bwr.assigned);
+			auto& bwr = queue.back();
+			bwr.first->assign_bandwidth(m_channel, bwr.second);
 			queue.pop_back();
 		}
 	}
@@ -44,35 +44,11 @@ namespace aux {
 		, int blk, int prio)
 		: peer(std::move(pe))
 		, priority(prio)
-		, assigned(0)
 		, request_size(blk)
-		, ttl(20)
 	{
 		TORRENT_ASSERT(priority > 0);
 	}
 
-	int bw_request::assign_bandwidth()
-	{
-		TORRENT_ASSERT(assigned < request_size);
-		int quota = request_size - assigned;
-		TORRENT_ASSERT(quota >= 0);
-		--ttl;
-		if (quota == 0) return quota;
-
-		for (int j = 0; j < 5 && channel[j]; ++j)
-		{
-			if (channel[j]->throttle() == 0) continue;
-			if (channel[j]->tmp == 0) continue;
-			quota = std::min(int(std::int64_t(channel[j]->distribute_quota)
-				* priority / channel[j]->tmp), quota);
-		}
-		assigned += quota;
-		for (int j = 0; j < 5 && channel[j]; ++j)
-			channel[j]->use_quota(quota);
-		TORRENT_ASSERT(assigned <= request_size);
-		return quota;
-	}
-
 	static_assert(std::is_nothrow_move_constructible<bw_request>::value
 		, "should be nothrow move constructible");
 	static_assert(std::is_nothrow_move_assignable<bw_request>::value
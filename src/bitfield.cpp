@@ -36,12 +36,134 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/numeric_cast.hpp"
 #include "libtorrent/aux_/cpuid.hpp"
 
+#include <algorithm> // for min
+
 #ifdef _MSC_VER
 #include <intrin.h>
 #endif
 
+// the AVX2 kernels are compiled with a per-function target attribute (or, on
+// msvc, without any special flags) and only called if the CPU supports it
+#if TORRENT_HAS_SSE && (defined __GNUC__ || (defined _MSC_VER && _MSC_VER >= 1900))
+#define TORRENT_HAS_AVX2_BITFIELD 1
+#include "libtorrent/aux_/disable_warnings_push.hpp"
+#include <immintrin.h>
+#include "libtorrent/aux_/disable_warnings_pop.hpp"
+#if defined __GNUC__
+#define TORRENT_TARGET(x) __attribute__((target(x)))
+#else
+#define TORRENT_TARGET(x)
+#endif
+#else
+#define TORRENT_HAS_AVX2_BITFIELD 0
+#endif
+
 namespace libtorrent {
 
+namespace {
+
+	int popcount32(std::uint32_t const v) noexcept
+	{
+#if defined __GNUC__ || defined __clang__
+		return __builtin_popcount(v);
+#else
+		// from:
+		// http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
+		std::uint32_t c = v - ((v >> 1) & 0x55555555);
+		c = ((c >> 2) & 0x33333333) + (c & 0x33333333);
+		c = ((c >> 4) + c) & 0x0f0f0f0f;
+		return int((c * 0x01010101) >> 24);
+#endif
+	}
+
+	// the kernels below work on 8 words (256 bits) at a time, it's not
+	// worth setting up the vector registers for fewer
+	int const avx2_min_words = 16;
+
+#if TORRENT_HAS_AVX2_BITFIELD
+	// popcount of each byte via a nibble lookup table, summed up with
+	// vpsadbw into four 64 bit counters
+	TORRENT_TARGET("avx2")
+	int count_words_avx2(std::uint32_t const* b, int const words) noexcept
+	{
+		__m256i const lookup = _mm256_setr_epi8(
+			0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+			0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+		__m256i const low_mask = _mm256_set1_epi8(0x0f);
+		__m256i acc = _mm256_setzero_si256();
+		int i = 0;
+		for (; i + 8 <= words; i += 8)
+		{
+			__m256i const v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(b + i));
+			__m256i const lo = _mm256_and_si256(v, low_mask);
+			__m256i const hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+			__m256i const cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo)
+				, _mm256_shuffle_epi8(lookup, hi));
+			acc = _mm256_add_epi64(acc, _mm256_sad_epu8(cnt, _mm256_setzero_si256()));
+		}
+		alignas(32) std::uint64_t sums[4];
+		_mm256_store_si256(reinterpret_cast<__m256i*>(sums), acc);
+		int ret = int(sums[0] + sums[1] + sums[2] + sums[3]);
+		for (; i < words; ++i) ret += popcount32(b[i]);
+		return ret;
+	}
+
+	TORRENT_TARGET("avx2")
+	void and_words_avx2(std::uint32_t* dst, std::uint32_t const* src, int const words) noexcept
+	{
+		int i = 0;
+		for (; i + 8 <= words; i += 8)
+		{
+			__m256i* d = reinterpret_cast<__m256i*>(dst + i);
+			__m256i const s = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + i));
+			_mm256_storeu_si256(d, _mm256_and_si256(_mm256_loadu_si256(d), s));
+		}
+		for (; i < words; ++i) dst[i] &= src[i];
+	}
+
+	TORRENT_TARGET("avx2")
+	void and_not_words_avx2(std::uint32_t* dst, std::uint32_t const* src, int const words) noexcept
+	{
+		int i = 0;
+		for (; i + 8 <= words; i += 8)
+		{
+			__m256i* d = reinterpret_cast<__m256i*>(dst + i);
+			__m256i const s = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + i));
+			// andnot negates its first operand
+			_mm256_storeu_si256(d, _mm256_andnot_si256(s, _mm256_loadu_si256(d)));
+		}
+		for (; i < words; ++i) dst[i] &= ~src[i];
+	}
+
+	TORRENT_TARGET("avx2")
+	bool any_and_not_words_avx2(std::uint32_t const* a, std::uint32_t const* b, int const words) noexcept
+	{
+		int i = 0;
+		for (; i + 8 <= words; i += 8)
+		{
+			__m256i const va = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(a + i));
+			__m256i const vb = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(b + i));
+			// testc returns 1 if (~vb & va) is all zeros
+			if (!_mm256_testc_si256(vb, va)) return true;
+		}
+		for (; i < words; ++i)
+			if (a[i] & ~b[i]) return true;
+		return false;
+	}
+#endif // TORRENT_HAS_AVX2_BITFIELD
+
+	int count_words(std::uint32_t const* b, int const words) noexcept
+	{
+#if TORRENT_HAS_AVX2_BITFIELD
+		if (aux::avx2_support && words >= avx2_min_words)
+			return count_words_avx2(b, words);
+#endif
+		int ret = 0;
+		for (int i = 0; i < words; ++i) ret += popcount32(b[i]);
+		return ret;
+	}
+}
+
 	bool bitfield::all_set() const noexcept
 	{
 		if(size() == 0) return false;
@@ -74,6 +196,117 @@ namespace libtorrent {
 		return std::memcmp(lb, rb, std::size_t(num_words()) * 4) == 0;
 	}
 
+	int bitfield::count(int const first, int const last) const noexcept
+	{
+		TORRENT_ASSERT(first >= 0);
+		TORRENT_ASSERT(first <= last);
+		TORRENT_ASSERT(last <= size());
+		if (first >= last) return 0;
+
+		std::uint32_t const* b = buf();
+		int const first_word = first / 32;
+		int const last_word = (last - 1) / 32;
+		// masks in host byte order for the partial words at either end
+		std::uint32_t const head = 0xffffffff >> (first & 31);
+		std::uint32_t const tail = 0xffffffff << (31 - ((last - 1) & 31));
+
+		if (first_word == last_word)
+			return popcount32(aux::network_to_host(b[first_word]) & head & tail);
+
+		int const ret = popcount32(aux::network_to_host(b[first_word]) & head)
+			+ count_words(b + first_word + 1, last_word - first_word - 1)
+			+ popcount32(aux::network_to_host(b[last_word]) & tail);
+		TORRENT_ASSERT(ret <= last - first);
+		return ret;
+	}
+
+	bitfield& bitfield::operator&=(bitfield const& rhs) & noexcept
+	{
+		int const words = num_words();
+		if (words == 0) return *this;
+		int const common = std::min(words, rhs.num_words());
+		if (common > 0)
+		{
+#if TORRENT_HAS_AVX2_BITFIELD
+			if (aux::avx2_support && common >= avx2_min_words)
+				and_words_avx2(buf(), rhs.buf(), common);
+			else
+#endif
+			{
+				std::uint32_t* b = buf();
+				std::uint32_t const* r = rhs.buf();
+				for (int i = 0; i < common; ++i) b[i] &= r[i];
+			}
+		}
+		if (common < words)
+			std::memset(buf() + common, 0, std::size_t(words - common) * 4);
+		return *this;
+	}
+
+	void bitfield::clear_bits(bitfield const& rhs) noexcept
+	{
+		int const common = std::min(num_words(), rhs.num_words());
+		if (common == 0) return;
+#if TORRENT_HAS_AVX2_BITFIELD
+		if (aux::avx2_support && common >= avx2_min_words)
+		{
+			and_not_words_avx2(buf(), rhs.buf(), common);
+			return;
+		}
+#endif
+		std::uint32_t* b = buf();
+		std::uint32_t const* r = rhs.buf();
+		for (int i = 0; i < common; ++i) b[i] &= ~r[i];
+	}
+
+	bool bitfield::any_and_not(bitfield const& rhs) const noexcept
+	{
+		int const words = num_words();
+		if (words == 0) return false;
+		int const common = std::min(words, rhs.num_words());
+		std::uint32_t const* b = buf();
+		if (common > 0)
+		{
+			std::uint32_t const* r = rhs.buf();
+#if TORRENT_HAS_AVX2_BITFIELD
+			if (aux::avx2_support && common >= avx2_min_words)
+			{
+				if (any_and_not_words_avx2(b, r, common)) return true;
+			}
+			else
+#endif
+			{
+				for (int i = 0; i < common; ++i)
+					if (b[i] & ~r[i]) return true;
+			}
+		}
+		// the trailing bits are always 0, so any set bit past the end of rhs
+		// is a hit
+		for (int i = common; i < words; ++i)
+			if (b[i] != 0) return true;
+		return false;
+	}
+
+	int bitfield::find_next_set(int const index) const noexcept
+	{
+		TORRENT_ASSERT(index >= 0);
+		int const num = num_words();
+		if (index >= size()) return -1;
+
+		std::uint32_t const* b = buf();
+		int const word = index / 32;
+		std::uint32_t const first = aux::network_to_host(b[word])
+			& (0xffffffff >> (index & 31));
+		if (first != 0)
+		{
+			std::uint32_t const be = aux::host_to_network(first);
+			return word * 32 + aux::count_leading_zeros({&be, 1});
+		}
+		if (word + 1 == num) return -1;
+		int const count = aux::count_leading_zeros({b + word + 1, num - word - 1});
+		return count != (num - word - 1) * 32 ? (word + 1) * 32 + count : -1;
+	}
+
 	int bitfield::count() const noexcept
 	{
 		int ret = 0;
@@ -534,6 +534,14 @@ namespace {
 		return !m_sent_handshake || m_state < state_t::read_packet_size;
 	}
 
+	bool bt_peer_connection::sends_raw_payload() const
+	{
+#if !defined TORRENT_DISABLE_ENCRYPTION
+		if (!m_enc_handler.is_send_plaintext()) return false;
+#endif
+		return !aux::is_ssl(get_socket()) && !aux::is_utp(get_socket());
+	}
+
 #if !defined TORRENT_DISABLE_ENCRYPTION
 
 	void bt_peer_connection::write_pe1_2_dhkey()
@@ -550,7 +558,7 @@ namespace {
 			peer_log(peer_log_alert::info, "ENCRYPTION", "initiating encrypted handshake");
 #endif
 
-		m_dh_key_exchange.reset(new (std::nothrow) dh_key_exchange);
+		m_dh_key_exchange = m_ses.new_dh_key_exchange();
 		if (!m_dh_key_exchange)
 		{
 			disconnect(errors::no_memory, operation_t::encryption);
@@ -821,6 +829,17 @@ namespace {
 		std::shared_ptr<torrent> t = associated_torrent().lock();
 		TORRENT_ASSERT(t);
 
+		if (receiving_direct())
+		{
+			peer_request r;
+			piece_block_progress p;
+			p.bytes_downloaded = direct_receive_progress(r);
+			p.piece_index = r.piece;
+			p.block_index = r.start / t->block_size();
+			p.full_block_bytes = r.length;
+			return p;
+		}
+
 		span<char const> recv_buffer = m_recv_buffer.get();
 		// are we currently receiving a 'piece' message?
 		if (m_state != state_t::read_packet
@@ -1138,6 +1157,22 @@ namespace {
 			// has been received
 			start_receive_piece(p);
 			if (is_disconnecting()) return;
+
+			if (!m_recv_buffer.packet_finished()
+#if !defined TORRENT_DISABLE_ENCRYPTION
+				&& m_enc_handler.is_recv_plaintext()
+#endif
+				&& start_direct_receive(p, recv_buffer.subspan(header_size)))
+			{
+				incoming_piece_fragment(piece_bytes);
+
+				// the rest of the payload goes straight into a disk buffer (see
+				// on_piece_direct()). The receive buffer moves on to the header
+				// of the next message
+				m_state = state_t::read_packet_size;
+				m_recv_buffer.reset(5);
+				return;
+			}
 		}
 
 		incoming_piece_fragment(piece_bytes);
@@ -1147,6 +1182,23 @@ namespace {
 		maybe_send_hash_request();
 	}
 
+	void bt_peer_connection::on_piece_direct(int const received)
+	{
+		INVARIANT_CHECK;
+
+		TORRENT_ASSERT(received > 0);
+		received_bytes(received, 0);
+		incoming_piece_fragment(received);
+
+		peer_request p;
+		disk_buffer_holder buffer = finish_direct_receive(p);
+		if (!buffer) return;
+
+		stats_counters().inc_stats_counter(counters::num_incoming_piece);
+		incoming_piece(p, std::move(buffer));
+		maybe_send_hash_request();
+	}
+
 	// -----------------------------
 	// ---------- CANCEL -----------
 	// -----------------------------
@@ -2701,6 +2753,12 @@ namespace {
 		// packet, or at least back-to-back packets
 		cork c_(*this);
 
+		if (receiving_direct())
+		{
+			on_piece_direct(int(bytes_transferred));
+			return;
+		}
+
 #if !defined TORRENT_DISABLE_ENCRYPTION
 		if (!m_enc_handler.is_recv_plaintext())
 		{
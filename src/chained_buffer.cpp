@@ -50,6 +50,7 @@ namespace aux {
 			if (b.used_size > bytes_to_pop)
 			{
 				b.buf += bytes_to_pop;
+				b.file_offset += bytes_to_pop;
 				b.used_size -= bytes_to_pop;
 				b.size -= bytes_to_pop;
 				m_capacity -= bytes_to_pop;
@@ -123,6 +124,31 @@ namespace aux {
 		return m_tmp_vec;
 	}
 
+	int chained_buffer::front_file(std::int64_t& offset, int& len) const
+	{
+		TORRENT_ASSERT(is_single_thread());
+		TORRENT_ASSERT(!m_destructed);
+		if (m_vec.empty()) return -1;
+		buffer_t const& b = m_vec.front();
+		if (b.fd < 0) return -1;
+		offset = b.file_offset;
+		len = b.used_size;
+		return b.fd;
+	}
+
+	int chained_buffer::bytes_until_file() const
+	{
+		TORRENT_ASSERT(is_single_thread());
+		TORRENT_ASSERT(!m_destructed);
+		int ret = 0;
+		for (auto const& b : m_vec)
+		{
+			if (b.fd >= 0) break;
+			ret += b.used_size;
+		}
+		return ret;
+	}
+
 	void chained_buffer::build_mutable_iovec(int bytes, std::vector<span<char>> &vec)
 	{
 		TORRENT_ASSERT(!m_destructed);
@@ -54,6 +54,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include <functional>
 #include <memory>
+#include <thread> // for hardware_concurrency
 
 using namespace std::placeholders;
 
@@ -607,6 +608,27 @@ namespace {
 			, [](sha1_hash const& h) { return h.is_all_zeros(); });
 	}
 
+	// computes the root of a file's merkle tree from its piece layer. Files
+	// with a large piece layer have the tree filled by multiple threads
+	sha256_hash file_merkle_root(span<sha256_hash const> const piece_layer
+		, sha256_hash const& pad)
+	{
+		// below this number of pieces, building the full tree costs more
+		// than hashing it on a single thread saves
+		int const min_parallel_leafs = 1 << 13;
+
+		int const num_threads = int(std::thread::hardware_concurrency());
+		int const num_leafs = merkle_num_leafs(int(piece_layer.size()));
+		if (num_threads <= 1 || num_leafs < min_parallel_leafs)
+			return merkle_root(piece_layer, pad);
+
+		std::vector<sha256_hash> tree(std::size_t(merkle_num_nodes(num_leafs)), pad);
+		std::copy(piece_layer.begin(), piece_layer.end()
+			, tree.begin() + merkle_first_leaf(num_leafs));
+		merkle_fill_tree_parallel(tree, num_leafs, num_threads);
+		return tree[0];
+	}
+
 	void add_file_attrs(entry& e, file_flags_t const flags, bool const include_symlinks)
 	{
 		if (!(flags & (file_storage::flag_pad_file
@@ -748,7 +770,7 @@ namespace {
 				if (files().file_flags(fi) & file_storage::flag_pad_file) continue;
 				if (files().file_size(fi) == 0) continue;
 
-				m_fileroots[fi] = merkle_root(m_file_piece_hash[fi], pad_hash);
+				m_fileroots[fi] = file_merkle_root(m_file_piece_hash[fi], pad_hash);
 
 				// files that only have one piece store the piece hash as the
 				// root, we don't need a pieces layer entry for such files
@@ -0,0 +1,141 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/aux_/dh_key_pool.hpp"
+
+#if !defined TORRENT_DISABLE_ENCRYPTION
+
+#include <new>
+#include <system_error>
+
+namespace libtorrent {
+namespace aux {
+
+	dh_key_pool::~dh_key_pool()
+	{
+		stop();
+	}
+
+	void dh_key_pool::set_size(int const size)
+	{
+		if (size <= 0)
+		{
+			stop();
+			return;
+		}
+
+		std::unique_lock<std::mutex> l(m_mutex);
+		m_size = size;
+		if (int(m_keys.size()) > m_size)
+			m_keys.resize(std::size_t(m_size));
+		// the key generating thread relies on this not to allocate
+		m_keys.reserve(std::size_t(m_size));
+		m_abort = false;
+		bool const start = !m_thread.joinable();
+		l.unlock();
+
+		if (start)
+		{
+			try
+			{
+				m_thread = std::thread([this] { thread_fun(); });
+			}
+			catch (std::system_error const&)
+			{
+				// without a thread, keys are generated on demand, like
+				// when the pool is disabled
+				l.lock();
+				m_size = 0;
+			}
+		}
+		else
+		{
+			m_cond.notify_one();
+		}
+	}
+
+	std::unique_ptr<dh_key_exchange> dh_key_pool::get()
+	{
+		{
+			std::lock_guard<std::mutex> l(m_mutex);
+			if (!m_keys.empty())
+			{
+				std::unique_ptr<dh_key_exchange> ret = std::move(m_keys.back());
+				m_keys.pop_back();
+				m_cond.notify_one();
+				return ret;
+			}
+		}
+		return std::unique_ptr<dh_key_exchange>(new (std::nothrow) dh_key_exchange);
+	}
+
+	void dh_key_pool::stop()
+	{
+		std::unique_lock<std::mutex> l(m_mutex);
+		m_abort = true;
+		m_size = 0;
+		m_keys.clear();
+		l.unlock();
+		m_cond.notify_one();
+		if (m_thread.joinable()) m_thread.join();
+	}
+
+	void dh_key_pool::thread_fun()
+	{
+		std::unique_lock<std::mutex> l(m_mutex);
+		for (;;)
+		{
+			m_cond.wait(l, [this] { return m_abort || int(m_keys.size()) < m_size; });
+			if (m_abort) break;
+
+			l.unlock();
+			std::unique_ptr<dh_key_exchange> key;
+			try
+			{
+				key.reset(new (std::nothrow) dh_key_exchange);
+			}
+			catch (std::exception const&) {}
+			l.lock();
+
+			// if we fail to allocate memory or to get random bytes, there's
+			// not much we can do but stop. The connections will generate
+			// their own keys
+			if (!key) break;
+			if (m_abort) break;
+			if (int(m_keys.size()) < m_size)
+				m_keys.push_back(std::move(key));
+		}
+	}
+}
+}
+
+#endif // TORRENT_DISABLE_ENCRYPTION
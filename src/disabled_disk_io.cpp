@@ -86,6 +86,7 @@ struct TORRENT_EXTRA_EXPORT disabled_disk_io final
 		});
 	}
 
+	using disk_interface::async_write;
 	bool async_write(storage_index_t
 		, peer_request const& r
 		, char const*, std::shared_ptr<disk_observer>
@@ -40,11 +40,21 @@ namespace libtorrent {
 		: m_allocator(&alloc), m_buf(buf), m_size(sz)
 	{}
 
+	disk_buffer_holder::disk_buffer_holder(buffer_allocator_interface& alloc
+		, char* const buf, int const sz, int const fd
+		, std::int64_t const file_offset) noexcept
+		: m_allocator(&alloc), m_buf(buf), m_size(sz)
+		, m_fd(fd), m_file_offset(file_offset)
+	{}
+
 	disk_buffer_holder::disk_buffer_holder(disk_buffer_holder&& h) noexcept
 		: m_allocator(h.m_allocator), m_buf(h.m_buf), m_size(h.m_size)
+		, m_fd(h.m_fd), m_file_offset(h.m_file_offset)
 	{
 		h.m_buf = nullptr;
 		h.m_size = 0;
+		h.m_fd = -1;
+		h.m_file_offset = 0;
 	}
 
 	disk_buffer_holder& disk_buffer_holder::operator=(disk_buffer_holder&& h) & noexcept
@@ -59,6 +69,8 @@ namespace libtorrent {
 		if (m_buf) m_allocator->free_disk_buffer(m_buf);
 		m_buf = nullptr;
 		m_size = 0;
+		m_fd = -1;
+		m_file_offset = 0;
 	}
 
 	disk_buffer_holder::~disk_buffer_holder() { reset(); }
@@ -40,6 +40,10 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/disk_observer.hpp"
 #include "libtorrent/disk_interface.hpp" // for default_block_size
 
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 
 #ifdef TORRENT_BSD
@@ -50,6 +54,10 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <linux/unistd.h>
 #endif
 
+#if TORRENT_HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
 #ifdef TORRENT_ADDRESS_SANITIZER
 #include <sanitizer/asan_interface.h>
 #endif
@@ -61,6 +69,14 @@ namespace aux {
 
 namespace {
 
+	// slabs are the size of a (transparent) huge page on x86-64
+	constexpr std::size_t slab_size = 2 * 1024 * 1024;
+	constexpr int blocks_per_slab = int(slab_size / default_block_size);
+
+	// the number of blocks moved between a cache and the pool's free list
+	// at a time. A cache holds at most twice this many blocks
+	constexpr int cache_batch = 32;
+
 	// this is posted to the network thread
 	void watermark_callback(std::vector<std::weak_ptr<disk_observer>> const& cbs)
 	{
@@ -71,13 +87,66 @@ namespace {
 		}
 	}
 
+	char* allocate_slab()
+	{
+#if TORRENT_HAVE_MMAP
+		// huge pages need to be aligned to their size. Map twice the size and
+		// unmap the unaligned head and tail
+		void* const m = ::mmap(nullptr, slab_size * 2, PROT_READ | PROT_WRITE
+			, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (m == MAP_FAILED) return nullptr;
+		char* const start = static_cast<char*>(m);
+		std::uintptr_t const addr = reinterpret_cast<std::uintptr_t>(start);
+		std::size_t const head = (slab_size - addr % slab_size) % slab_size;
+		if (head > 0) ::munmap(start, head);
+		::munmap(start + head + slab_size, slab_size - head);
+		char* const ret = start + head;
+#ifdef MADV_HUGEPAGE
+		// this is just a hint. If transparent huge pages are disabled, we
+		// still get normal pages
+		::madvise(ret, slab_size, MADV_HUGEPAGE);
+#endif
+		return ret;
+#else
+		return static_cast<char*>(std::malloc(slab_size));
+#endif
+	}
+
+	void free_slab(char* slab)
+	{
+#if TORRENT_HAVE_MMAP
+		::munmap(slab, slab_size);
+#else
+		std::free(slab);
+#endif
+	}
+
+	void poison_block(char* buf)
+	{
+		TORRENT_UNUSED(buf);
+#ifdef TORRENT_ADDRESS_SANITIZER
+		__asan_poison_memory_region(buf, default_block_size);
+#endif
+	}
+
+	void unpoison_block(char* buf)
+	{
+		TORRENT_UNUSED(buf);
+#ifdef TORRENT_ADDRESS_SANITIZER
+		__asan_unpoison_memory_region(buf, default_block_size);
+#endif
+	}
+
+	// threads are assigned caches round-robin, the first time they use one.
+	// The index is shared by all pools
+	std::atomic<std::size_t> g_next_cache{0};
+	thread_local std::size_t const t_cache_index = g_next_cache++;
+
 } // anonymous namespace
 
 	disk_buffer_pool::disk_buffer_pool(io_context& ios)
-		: m_in_use(0)
-		, m_max_use(64)
+		: m_max_use(64)
 		, m_low_watermark(std::max(m_max_use - 32, 0))
-		, m_exceeded_max_size(false)
 		, m_ios(ios)
 	{}
 
@@ -87,15 +156,37 @@ namespace {
 #if TORRENT_USE_ASSERTS
 		m_magic = 0;
 #endif
+		for (slab_t const& slab : m_slabs)
+		{
+#ifdef TORRENT_ADDRESS_SANITIZER
+			__asan_unpoison_memory_region(slab.base, slab_size);
+#endif
+			free_slab(slab.base);
+		}
+	}
+
+	disk_buffer_pool::cache_t& disk_buffer_pool::local_cache()
+	{
+		return m_caches[t_cache_index % num_caches];
+	}
+
+	void disk_buffer_pool::set_exceeded_max_size()
+	{
+		std::lock_guard<std::mutex> l(m_pool_mutex);
+		m_exceeded_max_size = true;
 	}
 
 	// checks to see if we're no longer exceeding the high watermark,
 	// and if we're in fact below the low watermark. If so, we need to
 	// post the notification messages to the peers that are waiting for
 	// more buffers to received data into
-	void disk_buffer_pool::check_buffer_level(std::unique_lock<std::mutex>& l)
+	void disk_buffer_pool::check_buffer_level()
 	{
-		TORRENT_ASSERT(l.owns_lock());
+		// the common case is to not have exceeded the limit. Don't take the
+		// mutex for that
+		if (!m_exceeded_max_size || m_in_use > m_low_watermark) return;
+
+		std::unique_lock<std::mutex> l(m_pool_mutex);
 		if (!m_exceeded_max_size || m_in_use > m_low_watermark) return;
 
 		m_exceeded_max_size = false;
@@ -108,8 +199,7 @@ namespace {
 
 	char* disk_buffer_pool::allocate_buffer(char const* category)
 	{
-		std::unique_lock<std::mutex> l(m_pool_mutex);
-		return allocate_buffer_impl(l, category);
+		return allocate_buffer_impl(category);
 	}
 
 	// we allow allocating more blocks even after we exceed the max size,
@@ -122,77 +212,168 @@ namespace {
 	char* disk_buffer_pool::allocate_buffer(bool& exceeded
 		, std::shared_ptr<disk_observer> o, char const* category)
 	{
-		std::unique_lock<std::mutex> l(m_pool_mutex);
-		char* ret = allocate_buffer_impl(l, category);
+		char* ret = allocate_buffer_impl(category);
 		if (m_exceeded_max_size)
 		{
-			exceeded = true;
-			if (o) m_observers.push_back(std::move(o));
+			// the observer must be registered under the mutex, for
+			// check_buffer_level() not to miss it
+			std::lock_guard<std::mutex> l(m_pool_mutex);
+			if (m_exceeded_max_size)
+			{
+				exceeded = true;
+				if (o) m_observers.push_back(std::move(o));
+			}
 		}
 		return ret;
 	}
 
-	char* disk_buffer_pool::allocate_buffer_impl(std::unique_lock<std::mutex>& l
-		, char const*)
+	char* disk_buffer_pool::allocate_buffer_impl(char const*)
 	{
 		TORRENT_ASSERT(m_settings_set);
 		TORRENT_ASSERT(m_magic == 0x1337);
-		TORRENT_ASSERT(l.owns_lock());
-		TORRENT_UNUSED(l);
-
-		char* ret = static_cast<char*>(std::malloc(default_block_size));
 
-		if (ret == nullptr)
+		char* ret = nullptr;
 		{
-			m_exceeded_max_size = true;
-			return nullptr;
+			cache_t& c = local_cache();
+			std::lock_guard<std::mutex> l(c.mutex);
+			if (c.blocks.empty() && !refill(c))
+			{
+				set_exceeded_max_size();
+				return nullptr;
+			}
+			ret = c.blocks.back();
+			c.blocks.pop_back();
 		}
+		unpoison_block(ret);
 
-		++m_in_use;
+		int const in_use = ++m_in_use;
 
 #if TORRENT_USE_INVARIANT_CHECKS
 		try
 		{
-			TORRENT_ASSERT(m_buffers_in_use.count(ret) == 0);
-			m_buffers_in_use.insert(ret);
+			add_buffer_in_use(ret);
 		}
 		catch (...)
 		{
-			free_buffer_impl(ret, l);
+			cache_t& c = local_cache();
+			std::lock_guard<std::mutex> l(c.mutex);
+			free_buffer_impl(ret, c);
 			return nullptr;
 		}
 #endif
 
-		if (m_in_use >= m_low_watermark + (m_max_use - m_low_watermark)
+		if (in_use >= m_low_watermark + (m_max_use - m_low_watermark)
 			/ 2 && !m_exceeded_max_size)
 		{
-			m_exceeded_max_size = true;
+			set_exceeded_max_size();
 		}
 
 		return ret;
 	}
 
+	bool disk_buffer_pool::refill(cache_t& c)
+	{
+		TORRENT_ASSERT(c.blocks.empty());
+		std::unique_lock<std::mutex> l(m_pool_mutex);
+		if (m_free_list.empty() && !add_slab(l)) return false;
+
+		int const n = std::min(cache_batch, int(m_free_list.size()));
+		c.blocks.insert(c.blocks.end(), m_free_list.end() - n, m_free_list.end());
+		m_free_list.resize(m_free_list.size() - std::size_t(n));
+		for (auto i = c.blocks.end() - n; i != c.blocks.end(); ++i)
+			--slab_for(*i).num_free;
+		return true;
+	}
+
+	bool disk_buffer_pool::add_slab(std::unique_lock<std::mutex>& l)
+	{
+		TORRENT_ASSERT(l.owns_lock());
+		TORRENT_UNUSED(l);
+
+		char* const slab = allocate_slab();
+		if (slab == nullptr) return false;
+
+		auto const pos = std::lower_bound(m_slabs.begin(), m_slabs.end(), slab
+			, [](slab_t const& lhs, char const* rhs) { return lhs.base < rhs; });
+		try
+		{
+			m_free_list.reserve(m_free_list.size() + std::size_t(blocks_per_slab));
+			m_slabs.insert(pos, slab_t{slab, blocks_per_slab});
+		}
+		catch (...)
+		{
+			free_slab(slab);
+			return false;
+		}
+
+		// push the blocks in reverse order, so they're handed out in address
+		// order
+		for (int i = blocks_per_slab - 1; i >= 0; --i)
+		{
+			char* const b = slab + i * default_block_size;
+			poison_block(b);
+			m_free_list.push_back(b);
+		}
+		return true;
+	}
+
+	disk_buffer_pool::slab_t& disk_buffer_pool::slab_for(char const* buf)
+	{
+		auto i = std::upper_bound(m_slabs.begin(), m_slabs.end(), buf
+			, [](char const* lhs, slab_t const& rhs) { return lhs < rhs.base; });
+		TORRENT_ASSERT(i != m_slabs.begin());
+		--i;
+		TORRENT_ASSERT(buf >= i->base && buf < i->base + slab_size);
+		return *i;
+	}
+
+	void disk_buffer_pool::release_slab(std::vector<slab_t>::iterator const s)
+	{
+		TORRENT_ASSERT(s->num_free == blocks_per_slab);
+		char* const base = s->base;
+		m_free_list.erase(std::remove_if(m_free_list.begin(), m_free_list.end()
+			, [base](char const* b) { return b >= base && b < base + slab_size; })
+			, m_free_list.end());
+		m_slabs.erase(s);
+#ifdef TORRENT_ADDRESS_SANITIZER
+		__asan_unpoison_memory_region(base, slab_size);
+#endif
+		free_slab(base);
+	}
+
+	int disk_buffer_pool::num_slabs() const
+	{
+		std::lock_guard<std::mutex> l(m_pool_mutex);
+		return int(m_slabs.size());
+	}
+
 	void disk_buffer_pool::free_multiple_buffers(span<char*> bufvec)
 	{
 		// sort the pointers in order to maximize cache hits
 		std::sort(bufvec.begin(), bufvec.end());
 
-		std::unique_lock<std::mutex> l(m_pool_mutex);
-		for (char* buf : bufvec)
 		{
-			remove_buffer_in_use(buf);
-			free_buffer_impl(buf, l);
+			cache_t& c = local_cache();
+			std::lock_guard<std::mutex> l(c.mutex);
+			for (char* buf : bufvec)
+			{
+				remove_buffer_in_use(buf);
+				free_buffer_impl(buf, c);
+			}
 		}
 
-		check_buffer_level(l);
+		check_buffer_level();
 	}
 
 	void disk_buffer_pool::free_buffer(char* buf)
 	{
-		std::unique_lock<std::mutex> l(m_pool_mutex);
 		remove_buffer_in_use(buf);
-		free_buffer_impl(buf, l);
-		check_buffer_level(l);
+		{
+			cache_t& c = local_cache();
+			std::lock_guard<std::mutex> l(c.mutex);
+			free_buffer_impl(buf, c);
+		}
+		check_buffer_level();
 	}
 
 	void disk_buffer_pool::set_settings(settings_interface const& sett)
@@ -212,25 +393,58 @@ namespace {
 #endif
 	}
 
+	void disk_buffer_pool::add_buffer_in_use(char* buf)
+	{
+		TORRENT_UNUSED(buf);
+#if TORRENT_USE_INVARIANT_CHECKS
+		std::lock_guard<std::mutex> l(m_in_use_mutex);
+		TORRENT_ASSERT(m_buffers_in_use.count(buf) == 0);
+		m_buffers_in_use.insert(buf);
+#endif
+	}
+
 	void disk_buffer_pool::remove_buffer_in_use(char* buf)
 	{
 		TORRENT_UNUSED(buf);
 #if TORRENT_USE_INVARIANT_CHECKS
+		std::lock_guard<std::mutex> l(m_in_use_mutex);
 		std::set<char*>::iterator i = m_buffers_in_use.find(buf);
 		TORRENT_ASSERT(i != m_buffers_in_use.end());
 		m_buffers_in_use.erase(i);
 #endif
 	}
 
-	void disk_buffer_pool::free_buffer_impl(char* buf, std::unique_lock<std::mutex>& l)
+	void disk_buffer_pool::free_buffer_impl(char* buf, cache_t& c)
 	{
 		TORRENT_ASSERT(buf);
 		TORRENT_ASSERT(m_magic == 0x1337);
 		TORRENT_ASSERT(m_settings_set);
-		TORRENT_ASSERT(l.owns_lock());
-		TORRENT_UNUSED(l);
 
-		std::free(buf);
+		poison_block(buf);
+		c.blocks.push_back(buf);
+
+		// if the cache has grown too large, hand a batch of blocks back to
+		// the pool, for other threads to use
+		if (int(c.blocks.size()) >= cache_batch * 2)
+		{
+			std::lock_guard<std::mutex> l(m_pool_mutex);
+			m_free_list.insert(m_free_list.end(), c.blocks.end() - cache_batch
+				, c.blocks.end());
+			for (auto i = c.blocks.end() - cache_batch; i != c.blocks.end(); ++i)
+			{
+				slab_t& slab = slab_for(*i);
+				++slab.num_free;
+				// once all blocks of a slab are free, give it back to the
+				// operating system. One slab worth of free blocks is kept, to
+				// not allocate and free slabs back and forth
+				if (slab.num_free == blocks_per_slab
+					&& int(m_free_list.size()) >= blocks_per_slab * 2)
+				{
+					release_slab(m_slabs.begin() + (&slab - m_slabs.data()));
+				}
+			}
+			c.blocks.resize(c.blocks.size() - cache_batch);
+		}
 
 		--m_in_use;
 	}
@@ -40,5 +40,25 @@ constexpr disk_job_flags_t disk_interface::sequential_access;
 constexpr disk_job_flags_t disk_interface::volatile_read;
 constexpr disk_job_flags_t disk_interface::v1_hash;
 constexpr disk_job_flags_t disk_interface::flush_piece;
+constexpr disk_job_flags_t disk_interface::zero_copy;
+constexpr disk_job_flags_t disk_interface::read_ahead;
+constexpr disk_job_flags_t disk_interface::read_ahead_next_piece;
+
+disk_buffer_holder disk_interface::allocate_disk_buffer(bool& exceeded
+	, std::shared_ptr<disk_observer>)
+{
+	exceeded = false;
+	return {};
+}
+
+bool disk_interface::async_write(storage_index_t const storage, peer_request const& r
+	, disk_buffer_holder buf, std::shared_ptr<disk_observer> o
+	, std::function<void(storage_error const&)> handler
+	, disk_job_flags_t const flags)
+{
+	TORRENT_ASSERT(buf);
+	return async_write(storage, r, static_cast<char const*>(buf.data())
+		, std::move(o), std::move(handler), flags);
+}
 
 }
@@ -32,7 +32,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 */
 
-#include "libtorrent/aux_/mmap_disk_job.hpp"
+#include "libtorrent/aux_/disk_job.hpp"
 #include "libtorrent/disk_buffer_holder.hpp"
 
 #include "libtorrent/aux_/disable_warnings_push.hpp"
@@ -45,82 +45,82 @@ namespace aux {
 	namespace {
 		struct caller_visitor : boost::static_visitor<>
 		{
-			explicit caller_visitor(mmap_disk_job& j)
+			explicit caller_visitor(disk_job& j)
 				: m_job(j) {}
 
-			void operator()(mmap_disk_job::read_handler& h) const
+			void operator()(disk_job::read_handler& h) const
 			{
 				if (!h) return;
 				h(std::move(boost::get<disk_buffer_holder>(m_job.argument))
 					, m_job.error);
 			}
 
-			void operator()(mmap_disk_job::write_handler& h) const
+			void operator()(disk_job::write_handler& h) const
 			{
 				if (!h) return;
 				h(m_job.error);
 			}
 
-			void operator()(mmap_disk_job::hash_handler& h) const
+			void operator()(disk_job::hash_handler& h) const
 			{
 				if (!h) return;
 				h(m_job.piece, m_job.d.h.piece_hash, m_job.error);
 			}
 
-			void operator()(mmap_disk_job::hash2_handler& h) const
+			void operator()(disk_job::hash2_handler& h) const
 			{
 				if (!h) return;
 				h(m_job.piece, m_job.d.piece_hash2, m_job.error);
 			}
 
-			void operator()(mmap_disk_job::move_handler& h) const
+			void operator()(disk_job::move_handler& h) const
 			{
 				if (!h) return;
 				h(m_job.ret, std::move(boost::get<std::string>(m_job.argument))
 					, m_job.error);
 			}
 
-			void operator()(mmap_disk_job::release_handler& h) const
+			void operator()(disk_job::release_handler& h) const
 			{
 				if (!h) return;
 				h();
 			}
 
-			void operator()(mmap_disk_job::check_handler& h) const
+			void operator()(disk_job::check_handler& h) const
 			{
 				if (!h) return;
 				h(m_job.ret, m_job.error);
 			}
 
-			void operator()(mmap_disk_job::rename_handler& h) const
+			void operator()(disk_job::rename_handler& h) const
 			{
 				if (!h) return;
 				h(std::move(boost::get<std::string>(m_job.argument))
 					, m_job.file_index, m_job.error);
 			}
 
-			void operator()(mmap_disk_job::clear_piece_handler& h) const
+			void operator()(disk_job::clear_piece_handler& h) const
 			{
 				if (!h) return;
 				h(m_job.piece);
 			}
 
-			void operator()(mmap_disk_job::set_file_prio_handler& h) const
+			void operator()(disk_job::set_file_prio_handler& h) const
 			{
 				if (!h) return;
 				h(m_job.error, std::move(boost::get<aux::vector<download_priority_t, file_index_t>>(m_job.argument)));
 			}
 
 		private:
-			mmap_disk_job& m_job;
+			disk_job& m_job;
 		};
 	}
 
-	constexpr disk_job_flags_t mmap_disk_job::fence;
-	constexpr disk_job_flags_t mmap_disk_job::in_progress;
-	constexpr disk_job_flags_t mmap_disk_job::aborted;
+	constexpr disk_job_flags_t disk_job::fence;
+	constexpr disk_job_flags_t disk_job::in_progress;
+	constexpr disk_job_flags_t disk_job::aborted;
 
-	mmap_disk_job::mmap_disk_job()
+	disk_job::disk_job()
 		: argument(remove_flags_t{})
 		, piece(0)
 	{
@@ -128,7 +128,7 @@ namespace aux {
 		d.io.buffer_size = 0;
 	}
 
-	void mmap_disk_job::call_callback()
+	void disk_job::call_callback()
 	{
 		boost::apply_visitor(caller_visitor(*this), callback);
 	}
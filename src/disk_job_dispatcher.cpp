@@ -0,0 +1,622 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/aux_/disk_job_dispatcher.hpp"
+#include "libtorrent/aux_/mmap_disk_job.hpp"
+#include "libtorrent/aux_/posix_disk_job.hpp"
+#include "libtorrent/aux_/posix_storage.hpp"
+#include "libtorrent/aux_/store_buffer.hpp"
+#include "libtorrent/aux_/array.hpp"
+#include "libtorrent/mmap_storage.hpp"
+#include "libtorrent/disk_interface.hpp"
+#include "libtorrent/performance_counters.hpp"
+#include "libtorrent/platform_util.hpp"
+#include "libtorrent/error.hpp"
+#include "libtorrent/debug.hpp"
+
+namespace libtorrent {
+namespace aux {
+
+	template <typename Job>
+	basic_disk_job_dispatcher<Job>::basic_disk_job_dispatcher(io_context& ios
+		, counters& cnt, store_buffer& sb, basic_disk_job_pool<Job>& job_pool
+		, disk_job_executor<Job>& executor)
+		: m_ios(ios)
+		, m_stats_counters(cnt)
+		, m_store_buffer(sb)
+		, m_job_pool(job_pool)
+		, m_executor(executor)
+		, m_generic_io_jobs(*this)
+		, m_generic_threads(m_generic_io_jobs, ios)
+		, m_hash_io_jobs(*this)
+		, m_hash_threads(m_hash_io_jobs, ios)
+	{}
+
+#if TORRENT_USE_ASSERTS
+	template <typename Job>
+	basic_disk_job_dispatcher<Job>::~basic_disk_job_dispatcher()
+	{
+		// abort should have been triggered
+		TORRENT_ASSERT(m_abort);
+
+		TORRENT_ASSERT(m_generic_threads.num_threads() == 0);
+		TORRENT_ASSERT(m_hash_threads.num_threads() == 0);
+		if (!m_generic_io_jobs.m_queued_jobs.empty())
+		{
+			for (auto i = m_generic_io_jobs.m_queued_jobs.iterate(); i.get(); i.next())
+				std::printf("generic job: %d\n", int(i.get()->action));
+		}
+		if (!m_hash_io_jobs.m_queued_jobs.empty())
+		{
+			for (auto i = m_hash_io_jobs.m_queued_jobs.iterate(); i.get(); i.next())
+				std::printf("hash job: %d\n", int(i.get()->action));
+		}
+		TORRENT_ASSERT(m_generic_io_jobs.m_queued_jobs.empty());
+		TORRENT_ASSERT(m_hash_io_jobs.m_queued_jobs.empty());
+	}
+#endif
+
+	template <typename Job>
+	void basic_disk_job_dispatcher<Job>::set_max_threads(int const generic_threads
+		, int const hash_threads)
+	{
+		m_generic_threads.set_max_threads(generic_threads);
+		m_hash_threads.set_max_threads(hash_threads);
+	}
+
+	template <typename Job>
+	void basic_disk_job_dispatcher<Job>::abort(bool const wait)
+	{
+		// first make sure queued jobs have been submitted
+		// otherwise the queue may not get processed
+		submit_jobs();
+
+		// abuse the job mutex to make setting m_abort and checking the thread count atomic
+		// see also the comment in thread_fun
+		std::unique_lock<std::mutex> l(m_job_mutex);
+		if (m_abort.exchange(true)) return;
+		bool const no_threads = m_generic_threads.num_threads() == 0
+			&& m_hash_threads.num_threads() == 0;
+
+		// abort outstanding hash jobs
+		for (auto i = m_hash_io_jobs.m_queued_jobs.iterate(); i.get(); i.next())
+			i.get()->flags |= disk_job::aborted;
+		l.unlock();
+
+		// if there are no disk threads, we can't wait for the jobs here, because
+		// we'd stall indefinitely
+		if (no_threads && !m_jobs_aborted.test_and_set())
+			m_executor.abort_jobs();
+
+		// even if there are no threads it doesn't hurt to abort the pools
+		// it prevents threads from being started after an abort which is a good
+		// defensive programming measure
+		m_generic_threads.abort(wait);
+		m_hash_threads.abort(wait);
+	}
+
+	template <typename Job>
+	void basic_disk_job_dispatcher<Job>::abort_hash_jobs(storage_ptr const& st)
+	{
+		// abort outstanding hash jobs belonging to this torrent
+		std::unique_lock<std::mutex> l(m_job_mutex);
+
+		for (auto i = m_hash_io_jobs.m_queued_jobs.iterate(); i.get(); i.next())
+		{
+			Job* j = i.get();
+			if (j->storage != st) continue;
+			// only cancel volatile-read jobs. This means only full checking
+			// jobs. These jobs are likely to have a pretty deep queue and
+			// really gain from being cancelled. They can also be restarted
+			// easily.
+			if (!(j->flags & disk_interface::volatile_read)) continue;
+			j->flags |= disk_job::aborted;
+		}
+	}
+
+	template <typename Job>
+	int basic_disk_job_dispatcher<Job>::num_queued_jobs() const
+	{
+		std::lock_guard<std::mutex> l(m_job_mutex);
+		return m_generic_io_jobs.m_queued_jobs.size()
+			+ m_hash_io_jobs.m_queued_jobs.size();
+	}
+
+	template <typename Job>
+	void basic_disk_job_dispatcher<Job>::perform_job(Job* j, jobqueue_t& completed_jobs)
+	{
+		TORRENT_ASSERT(j->next == nullptr);
+		TORRENT_ASSERT((j->flags & disk_job::in_progress) || !j->storage);
+
+		// keep the storage alive until the job has completed
+		storage_ptr storage = j->storage;
+
+		m_stats_counters.inc_stats_counter(counters::num_running_disk_jobs, 1);
+
+		// call disk function
+		// TODO: in the future, propagate exceptions back to the handlers
+		status_t ret = status_t::no_error;
+		try
+		{
+			ret = m_executor.do_job(j);
+		}
+		catch (boost::system::system_error const& err)
+		{
+			ret = status_t::fatal_disk_error;
+			j->error.ec = err.code();
+			j->error.operation = operation_t::exception;
+		}
+		catch (std::bad_alloc const&)
+		{
+			ret = status_t::fatal_disk_error;
+			j->error.ec = errors::no_memory;
+			j->error.operation = operation_t::exception;
+		}
+		catch (std::exception const&)
+		{
+			ret = status_t::fatal_disk_error;
+			j->error.ec = boost::asio::error::fault;
+			j->error.operation = operation_t::exception;
+		}
+
+		// note that -2 errors are OK
+		TORRENT_ASSERT(ret != status_t::fatal_disk_error
+			|| (j->error.ec && j->error.operation != operation_t::unknown));
+
+		m_stats_counters.inc_stats_counter(counters::num_running_disk_jobs, -1);
+
+		j->ret = ret;
+
+		completed_jobs.push_back(j);
+	}
+
+	template <typename Job>
+	void basic_disk_job_dispatcher<Job>::job_fail_add(Job* j)
+	{
+		j->ret = status_t::fatal_disk_error;
+		j->error = storage_error(boost::asio::error::operation_aborted);
+		j->flags |= disk_job::aborted;
+#if TORRENT_USE_ASSERTS
+		TORRENT_ASSERT(j->job_posted == false);
+		j->job_posted = true;
+#endif
+		if (j->action == job_action_t::write)
+			m_store_buffer.erase({j->storage->storage_index(), j->piece, j->d.io.offset});
+
+		std::lock_guard<std::mutex> l(m_completed_jobs_mutex);
+		m_completed_jobs.push_back(j);
+
+		if (!m_job_completions_in_flight)
+		{
+			post(m_ios, [this] { this->call_job_handlers(); });
+			m_job_completions_in_flight = true;
+		}
+	}
+
+	template <typename Job>
+	void basic_disk_job_dispatcher<Job>::add_fence_job(Job* j, bool const user_add)
+	{
+		// if this happens, it means we started to shut down
+		// the disk threads too early. We have to post all jobs
+		// before the disk threads are shut down
+		if (m_abort)
+		{
+			job_fail_add(j);
+			return;
+		}
+
+		TORRENT_ASSERT(j->storage);
+		m_stats_counters.inc_stats_counter(counters::num_fenced_read + static_cast<int>(j->action));
+
+		int const ret = j->storage->raise_fence(j, m_stats_counters);
+		if (ret == disk_job_fence::fence_post_fence)
+		{
+			std::unique_lock<std::mutex> l(m_job_mutex);
+			TORRENT_ASSERT((j->flags & disk_job::in_progress) || !j->storage);
+			m_generic_io_jobs.m_queued_jobs.push_back(j);
+		}
+
+		if (num_threads() == 0 && user_add)
+			immediate_execute();
+	}
+
+	template <typename Job>
+	void basic_disk_job_dispatcher<Job>::add_job(Job* j, bool const user_add)
+	{
+		TORRENT_ASSERT(!j->storage || j->storage->files().is_valid());
+		TORRENT_ASSERT(j->next == nullptr);
+		// if this happens, it means we started to shut down
+		// the disk threads too early. We have to post all jobs
+		// before the disk threads are shut down
+		if (m_abort)
+		{
+			job_fail_add(j);
+			return;
+		}
+
+		TORRENT_ASSERT(!(j->flags & disk_job::in_progress));
+
+		// is the fence up for this storage?
+		// jobs that are instantaneous are not affected by the fence, is_blocked()
+		// will take ownership of the job and queue it up, in case the fence is up
+		// if the fence flag is set, this job just raised the fence on the storage
+		// and should be scheduled
+		if (j->storage && j->storage->is_blocked(j))
+		{
+			m_stats_counters.inc_stats_counter(counters::blocked_disk_jobs);
+			return;
+		}
+
+		std::unique_lock<std::mutex> l(m_job_mutex);
+
+		TORRENT_ASSERT((j->flags & disk_job::in_progress) || !j->storage);
+
+		job_queue& q = queue_for_job(j);
+		q.m_queued_jobs.push_back(j);
+		// if we literally have 0 disk threads, we have to execute the jobs
+		// immediately. If add job is called internally by the dispatcher,
+		// we need to defer executing it. We only want the top level to loop
+		// over the job queue (as is done below)
+		if (pool_for_job(j).max_threads() == 0 && user_add)
+		{
+			l.unlock();
+			immediate_execute();
+		}
+	}
+
+	template <typename Job>
+	void basic_disk_job_dispatcher<Job>::immediate_execute()
+	{
+		while (!m_generic_io_jobs.m_queued_jobs.empty())
+		{
+			Job* j = m_generic_io_jobs.m_queued_jobs.pop_front();
+			execute_job(j);
+		}
+	}
+
+	template <typename Job>
+	void basic_disk_job_dispatcher<Job>::submit_jobs()
+	{
+		std::unique_lock<std::mutex> l(m_job_mutex);
+		if (!m_generic_io_jobs.m_queued_jobs.empty())
+		{
+			m_generic_io_jobs.m_job_cond.notify_all();
+			m_generic_threads.job_queued(m_generic_io_jobs.m_queued_jobs.size());
+		}
+		if (!m_hash_io_jobs.m_queued_jobs.empty())
+		{
+			m_hash_io_jobs.m_job_cond.notify_all();
+			m_hash_threads.job_queued(m_hash_io_jobs.m_queued_jobs.size());
+		}
+	}
+
+	template <typename Job>
+	void basic_disk_job_dispatcher<Job>::execute_job(Job* j)
+	{
+		execute_jobs({&j, 1});
+	}
+
+	template <typename Job>
+	void basic_disk_job_dispatcher<Job>::execute_jobs(span<Job*> const jobs)
+	{
+		jobqueue_t completed_jobs;
+		for (Job* j : jobs)
+		{
+			if (j->flags & disk_job::aborted)
+			{
+				j->ret = status_t::fatal_disk_error;
+				j->error = storage_error(boost::asio::error::operation_aborted);
+				completed_jobs.push_back(j);
+				continue;
+			}
+			perform_job(j, completed_jobs);
+		}
+		if (!completed_jobs.empty())
+			add_completed_jobs(std::move(completed_jobs));
+	}
+
+	template <typename Job>
+	bool basic_disk_job_dispatcher<Job>::wait_for_job(job_queue& jobq
+		, disk_io_thread_pool& threads, std::unique_lock<std::mutex>& l)
+	{
+		TORRENT_ASSERT(l.owns_lock());
+
+		// the thread should only go active if it is exiting or there is work to do
+		// if the thread goes active on every wakeup it causes the minimum idle thread
+		// count to be lower than it should be
+		// for performance reasons we also want to avoid going idle and active again
+		// if there is already work to do
+		if (jobq.m_queued_jobs.empty())
+		{
+			threads.thread_idle();
+
+			do
+			{
+				// if the number of wanted threads is decreased,
+				// we may stop this thread
+				// when we're terminating the last thread, make sure
+				// we finish up all queued jobs first
+				if (threads.should_exit()
+					&& (jobq.m_queued_jobs.empty()
+						|| threads.num_threads() > 1)
+					// try_thread_exit must be the last condition
+					&& threads.try_thread_exit(std::this_thread::get_id()))
+				{
+					// time to exit this thread.
+					threads.thread_active();
+					return true;
+				}
+
+				using namespace std::literals::chrono_literals;
+				jobq.m_job_cond.wait_for(l, 1s);
+			} while (jobq.m_queued_jobs.empty());
+
+			threads.thread_active();
+		}
+
+		return false;
+	}
+
+	template <typename Job>
+	void basic_disk_job_dispatcher<Job>::job_queue::thread_fun(disk_io_thread_pool& pool
+		, executor_work_guard<io_context::executor_type> work)
+	{
+		ADD_OUTSTANDING_ASYNC("disk_job_dispatcher::work");
+		m_owner.thread_fun(*this, pool);
+
+		// w's dtor releases the io_context to allow the run() call to return
+		// we do this once we stop posting new callbacks to it.
+		// after the dtor has been called, the disk I/O object may be destructed
+		TORRENT_UNUSED(work);
+		COMPLETE_ASYNC("disk_job_dispatcher::work");
+	}
+
+	template <typename Job>
+	void basic_disk_job_dispatcher<Job>::thread_fun(job_queue& queue
+		, disk_io_thread_pool& pool)
+	{
+		std::thread::id const thread_id = std::this_thread::get_id();
+
+		set_thread_name("libtorrent-disk-thread");
+		m_executor.thread_started();
+
+		std::unique_lock<std::mutex> l(m_job_mutex);
+
+		++m_num_running_threads;
+		m_stats_counters.inc_stats_counter(counters::num_running_threads, 1);
+
+		std::vector<Job*> jobs;
+
+		for (;;)
+		{
+			bool const should_exit = wait_for_job(queue, pool, l);
+			if (should_exit) break;
+			jobs.push_back(queue.m_queued_jobs.pop_front());
+			m_executor.pop_jobs(queue.m_queued_jobs, jobs);
+			l.unlock();
+
+			TORRENT_ASSERT((jobs.front()->flags & disk_job::in_progress) || !jobs.front()->storage);
+
+			if (&pool == &m_generic_threads && thread_id == pool.first_thread_id())
+				m_executor.maintenance();
+
+			if (jobs.size() > 1) m_executor.prepare_jobs(jobs);
+			execute_jobs(jobs);
+			jobs.clear();
+
+			l.lock();
+		}
+
+		// do cleanup in the last running thread
+		// if we're not aborting, that means we just configured the thread pool to
+		// not have any threads (i.e. perform all disk operations in the network
+		// thread). In this case, the cleanup will happen in abort().
+
+		int const threads_left = --m_num_running_threads;
+		if (threads_left > 0 || !m_abort)
+		{
+			m_stats_counters.inc_stats_counter(counters::num_running_threads, -1);
+			return;
+		}
+
+		// it is important to hold the job mutex while calling try_thread_exit()
+		// and continue to hold it until checking m_abort above so that abort()
+		// doesn't inadvertently trigger the code below when it thinks there are no
+		// more disk I/O threads running
+		l.unlock();
+
+		// at this point, there are no queued jobs left. However, main
+		// thread is still running and may still have peer_connections
+		// that haven't fully destructed yet, reclaiming their references
+		// to read blocks in the disk cache. We need to wait until all
+		// references are removed from other threads before we can go
+		// ahead with the cleanup.
+		// This is not supposed to happen because the disk thread is now scheduled
+		// for shut down after all peers have shut down (see
+		// session_impl::abort_stage2()).
+		if (!m_jobs_aborted.test_and_set())
+			m_executor.abort_jobs();
+
+		m_stats_counters.inc_stats_counter(counters::num_running_threads, -1);
+	}
+
+	template <typename Job>
+	int basic_disk_job_dispatcher<Job>::num_threads() const
+	{
+		return m_generic_threads.max_threads() + m_hash_threads.max_threads();
+	}
+
+	template <typename Job>
+	typename basic_disk_job_dispatcher<Job>::job_queue&
+	basic_disk_job_dispatcher<Job>::queue_for_job(Job* j)
+	{
+		if (m_hash_threads.max_threads() > 0
+			&& (j->action == job_action_t::hash || j->action == job_action_t::hash2)
+			&& (j->flags & disk_interface::sequential_access))
+			return m_hash_io_jobs;
+		else
+			return m_generic_io_jobs;
+	}
+
+	template <typename Job>
+	disk_io_thread_pool& basic_disk_job_dispatcher<Job>::pool_for_job(Job* j)
+	{
+		if (m_hash_threads.max_threads() > 0
+			&& (j->action == job_action_t::hash || j->action == job_action_t::hash2)
+			&& (j->flags & disk_interface::sequential_access))
+			return m_hash_threads;
+		else
+			return m_generic_threads;
+	}
+
+	template <typename Job>
+	void basic_disk_job_dispatcher<Job>::add_completed_jobs(jobqueue_t jobs)
+	{
+		jobqueue_t completed = std::move(jobs);
+		jobqueue_t new_jobs;
+		do
+		{
+			// when a job completes, it's possible for it to cause
+			// a fence to be lowered, issuing the jobs queued up
+			// behind the fence
+			add_completed_jobs_impl(std::move(completed), new_jobs);
+			TORRENT_ASSERT(completed.empty());
+			completed = std::move(new_jobs);
+		} while (!completed.empty());
+	}
+
+	template <typename Job>
+	void basic_disk_job_dispatcher<Job>::add_completed_jobs_impl(jobqueue_t jobs
+		, jobqueue_t& completed)
+	{
+		jobqueue_t new_jobs;
+		int ret = 0;
+		for (auto i = jobs.iterate(); i.get(); i.next())
+		{
+			Job* j = i.get();
+			TORRENT_ASSERT((j->flags & disk_job::in_progress) || !j->storage);
+
+			if (j->flags & disk_job::fence)
+			{
+				m_stats_counters.inc_stats_counter(
+					counters::num_fenced_read + static_cast<int>(j->action), -1);
+			}
+
+			TORRENT_ASSERT(j->storage);
+			if (j->storage)
+				ret += j->storage->job_complete(j, new_jobs);
+
+			TORRENT_ASSERT(ret == new_jobs.size());
+			TORRENT_ASSERT(!(j->flags & disk_job::in_progress));
+#if TORRENT_USE_ASSERTS
+			TORRENT_ASSERT(j->job_posted == false);
+			j->job_posted = true;
+#endif
+		}
+
+		m_stats_counters.inc_stats_counter(counters::blocked_disk_jobs, -ret);
+		TORRENT_ASSERT(int(m_stats_counters[counters::blocked_disk_jobs]) >= 0);
+
+		if (m_abort.load())
+		{
+			while (!new_jobs.empty())
+			{
+				Job* j = new_jobs.pop_front();
+				TORRENT_ASSERT((j->flags & disk_job::in_progress) || !j->storage);
+				j->ret = status_t::fatal_disk_error;
+				j->error = storage_error(boost::asio::error::operation_aborted);
+				if (j->action == job_action_t::write)
+					m_store_buffer.erase({j->storage->storage_index(), j->piece, j->d.io.offset});
+				completed.push_back(j);
+			}
+		}
+		else if (!new_jobs.empty())
+		{
+			std::lock_guard<std::mutex> l(m_job_mutex);
+			m_generic_io_jobs.m_queued_jobs.append(std::move(new_jobs));
+			m_generic_io_jobs.m_job_cond.notify_all();
+			m_generic_threads.job_queued(m_generic_io_jobs.m_queued_jobs.size());
+		}
+
+		std::lock_guard<std::mutex> l(m_completed_jobs_mutex);
+		m_completed_jobs.append(std::move(jobs));
+
+		if (!m_job_completions_in_flight)
+		{
+			post(m_ios, [this] { this->call_job_handlers(); });
+			m_job_completions_in_flight = true;
+		}
+	}
+
+	template <typename Job>
+	void basic_disk_job_dispatcher<Job>::call_job_handlers()
+	{
+		m_stats_counters.inc_stats_counter(counters::on_disk_counter);
+		std::unique_lock<std::mutex> l(m_completed_jobs_mutex);
+
+		TORRENT_ASSERT(m_job_completions_in_flight);
+		m_job_completions_in_flight = false;
+
+		Job* j = m_completed_jobs.get_all();
+		l.unlock();
+
+		array<Job*, 64> to_delete;
+		int cnt = 0;
+
+		while (j)
+		{
+			TORRENT_ASSERT(j->job_posted == true);
+			TORRENT_ASSERT(j->callback_called == false);
+			Job* next = j->next;
+
+#if TORRENT_USE_ASSERTS
+			j->callback_called = true;
+#endif
+			j->call_callback();
+			to_delete[cnt++] = j;
+			j = next;
+			if (cnt == int(to_delete.size()))
+			{
+				cnt = 0;
+				m_job_pool.free_jobs(to_delete.data(), int(to_delete.size()));
+			}
+		}
+
+		if (cnt > 0) m_job_pool.free_jobs(to_delete.data(), cnt);
+	}
+
+#if TORRENT_HAVE_MMAP || TORRENT_HAVE_MAP_VIEW_OF_FILE
+	template struct basic_disk_job_dispatcher<mmap_disk_job>;
+#endif
+	template struct basic_disk_job_dispatcher<posix_disk_job>;
+}
+}
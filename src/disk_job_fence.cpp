@@ -35,6 +35,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "libtorrent/aux_/disk_job_fence.hpp"
 #include "libtorrent/aux_/mmap_disk_job.hpp"
+#include "libtorrent/aux_/posix_disk_job.hpp"
 #include "libtorrent/performance_counters.hpp"
 
 #define DEBUG_STORAGE 0
@@ -48,16 +49,17 @@ POSSIBILITY OF SUCH DAMAGE.
 namespace libtorrent {
 namespace aux {
 
-	int disk_job_fence::job_complete(mmap_disk_job* j, tailqueue<mmap_disk_job>& jobs)
+	template <typename Job>
+	int basic_disk_job_fence<Job>::job_complete(Job* j, tailqueue<Job>& jobs)
 	{
 		std::lock_guard<std::mutex> l(m_mutex);
 
-		TORRENT_ASSERT(j->flags & mmap_disk_job::in_progress);
-		j->flags &= ~mmap_disk_job::in_progress;
+		TORRENT_ASSERT(j->flags & disk_job::in_progress);
+		j->flags &= ~disk_job::in_progress;
 
 		TORRENT_ASSERT(m_outstanding_jobs > 0);
 		--m_outstanding_jobs;
-		if (j->flags & mmap_disk_job::fence)
+		if (j->flags & disk_job::fence)
 		{
 			// a fence job just completed. Make sure the fence logic
 			// works by asserting m_outstanding_jobs is in fact 0 now
@@ -72,8 +74,8 @@ namespace aux {
 			int ret = 0;
 			while (!m_blocked_jobs.empty())
 			{
-				mmap_disk_job *bj = m_blocked_jobs.pop_front();
-				if (bj->flags & mmap_disk_job::fence)
+				Job* bj = m_blocked_jobs.pop_front();
+				if (bj->flags & disk_job::fence)
 				{
 					// we encountered another fence. We cannot post anymore
 					// jobs from the blocked jobs queue. We have to go back
@@ -82,8 +84,8 @@ namespace aux {
 					// executing currently, we should add the fence job.
 					if (m_outstanding_jobs == 0 && jobs.empty())
 					{
-						TORRENT_ASSERT(!(bj->flags & mmap_disk_job::in_progress));
-						bj->flags |= mmap_disk_job::in_progress;
+						TORRENT_ASSERT(!(bj->flags & disk_job::in_progress));
+						bj->flags |= disk_job::in_progress;
 						++m_outstanding_jobs;
 						++ret;
 #if TORRENT_USE_ASSERTS
@@ -100,8 +102,8 @@ namespace aux {
 					TORRENT_ASSERT(m_has_fence > 0 || m_blocked_jobs.size() == 0);
 					return ret;
 				}
-				TORRENT_ASSERT(!(bj->flags & mmap_disk_job::in_progress));
-				bj->flags |= mmap_disk_job::in_progress;
+				TORRENT_ASSERT(!(bj->flags & disk_job::in_progress));
+				bj->flags |= disk_job::in_progress;
 
 				++m_outstanding_jobs;
 				++ret;
@@ -124,11 +126,11 @@ namespace aux {
 		TORRENT_ASSERT(m_blocked_jobs.size() > 0);
 
 		// this is the fence job
-		mmap_disk_job *bj = m_blocked_jobs.pop_front();
-		TORRENT_ASSERT(bj->flags & mmap_disk_job::fence);
+		Job* bj = m_blocked_jobs.pop_front();
+		TORRENT_ASSERT(bj->flags & disk_job::fence);
 
-		TORRENT_ASSERT(!(bj->flags & mmap_disk_job::in_progress));
-		bj->flags |= mmap_disk_job::in_progress;
+		TORRENT_ASSERT(!(bj->flags & disk_job::in_progress));
+		bj->flags |= disk_job::in_progress;
 
 		++m_outstanding_jobs;
 #if TORRENT_USE_ASSERTS
@@ -140,7 +142,8 @@ namespace aux {
 		return 1;
 	}
 
-	bool disk_job_fence::is_blocked(mmap_disk_job* j)
+	template <typename Job>
+	bool basic_disk_job_fence<Job>::is_blocked(Job* j)
 	{
 		std::lock_guard<std::mutex> l(m_mutex);
 		DLOG(stderr, "[%p] is_blocked: fence: %d num_outstanding: %d\n"
@@ -151,8 +154,8 @@ namespace aux {
 		// this job still needs to get queued up
 		if (m_has_fence == 0)
 		{
-			TORRENT_ASSERT(!(j->flags & mmap_disk_job::in_progress));
-			j->flags |= mmap_disk_job::in_progress;
+			TORRENT_ASSERT(!(j->flags & disk_job::in_progress));
+			j->flags |= disk_job::in_progress;
 			++m_outstanding_jobs;
 			return false;
 		}
@@ -167,24 +170,27 @@ namespace aux {
 		return true;
 	}
 
-	bool disk_job_fence::has_fence() const
+	template <typename Job>
+	bool basic_disk_job_fence<Job>::has_fence() const
 	{
 		std::lock_guard<std::mutex> l(m_mutex);
 		return m_has_fence != 0;
 	}
 
-	int disk_job_fence::num_blocked() const
+	template <typename Job>
+	int basic_disk_job_fence<Job>::num_blocked() const
 	{
 		std::lock_guard<std::mutex> l(m_mutex);
 		return m_blocked_jobs.size();
 	}
 
 	// j is the fence job. It must have exclusive access to the storage
-	int disk_job_fence::raise_fence(mmap_disk_job* j, counters& cnt)
+	template <typename Job>
+	int basic_disk_job_fence<Job>::raise_fence(Job* j, counters& cnt)
 	{
-		TORRENT_ASSERT(!(j->flags & mmap_disk_job::in_progress));
-		TORRENT_ASSERT(!(j->flags & mmap_disk_job::fence));
-		j->flags |= mmap_disk_job::fence;
+		TORRENT_ASSERT(!(j->flags & disk_job::in_progress));
+		TORRENT_ASSERT(!(j->flags & disk_job::fence));
+		j->flags |= disk_job::fence;
 
 		std::lock_guard<std::mutex> l(m_mutex);
 
@@ -201,7 +207,7 @@ namespace aux {
 			// after this, without being passed through is_blocked()
 			// that's why we're accounting for it here
 
-			j->flags |= mmap_disk_job::in_progress;
+			j->flags |= disk_job::in_progress;
 			++m_outstanding_jobs;
 			return fence_post_fence;
 		}
@@ -217,5 +223,7 @@ namespace aux {
 		return fence_post_none;
 	}
 
+	template struct basic_disk_job_fence<mmap_disk_job>;
+	template struct basic_disk_job_fence<posix_disk_job>;
 }
 }
@@ -33,27 +33,31 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "libtorrent/aux_/disk_job_pool.hpp"
 #include "libtorrent/aux_/mmap_disk_job.hpp"
+#include "libtorrent/aux_/posix_disk_job.hpp"
 
 namespace libtorrent {
 namespace aux {
 
-	disk_job_pool::disk_job_pool()
+	template <typename Job>
+	basic_disk_job_pool<Job>::basic_disk_job_pool()
 		: m_jobs_in_use(0)
 		, m_read_jobs(0)
 		, m_write_jobs(0)
 		, m_job_pool()
 	{}
 
-	disk_job_pool::~disk_job_pool()
+	template <typename Job>
+	basic_disk_job_pool<Job>::~basic_disk_job_pool()
 	{
 // #error this should be fixed!
 //		TORRENT_ASSERT(m_jobs_in_use == 0);
 	}
 
-	mmap_disk_job* disk_job_pool::allocate_job(job_action_t const type)
+	template <typename Job>
+	Job* basic_disk_job_pool<Job>::allocate_job(job_action_t const type)
 	{
 		std::unique_lock<std::mutex> l(m_job_mutex);
-		mmap_disk_job* ptr = m_job_pool.construct();
+		Job* ptr = m_job_pool.construct();
 		m_job_pool.set_next_size(100);
 		++m_jobs_in_use;
 		if (type == job_action_t::read) ++m_read_jobs;
@@ -67,7 +71,8 @@ namespace aux {
 		return ptr;
 	}
 
-	void disk_job_pool::free_job(mmap_disk_job* j)
+	template <typename Job>
+	void basic_disk_job_pool<Job>::free_job(Job* j)
 	{
 		TORRENT_ASSERT(j);
 		if (j == nullptr) return;
@@ -83,7 +88,8 @@ namespace aux {
 		m_job_pool.destroy(j);
 	}
 
-	void disk_job_pool::free_jobs(mmap_disk_job** j, int const num)
+	template <typename Job>
+	void basic_disk_job_pool<Job>::free_jobs(Job** j, int const num)
 	{
 		if (num == 0) return;
 
@@ -103,5 +109,8 @@ namespace aux {
 		for (int i = 0; i < num; ++i)
 			m_job_pool.destroy(j[i]);
 	}
+
+	template struct basic_disk_job_pool<mmap_disk_job>;
+	template struct basic_disk_job_pool<posix_disk_job>;
 }
 }
@@ -0,0 +1,814 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/aux_/hash_batch.hpp"
+#include "libtorrent/aux_/cpuid.hpp"
+#include "libtorrent/hasher.hpp"
+#include "libtorrent/assert.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if TORRENT_HAS_SHA_X86
+#include "libtorrent/aux_/disable_warnings_push.hpp"
+#include <immintrin.h>
+#include "libtorrent/aux_/disable_warnings_pop.hpp"
+
+// gcc and clang only allow the use of intrinsics in functions that are
+// compiled for an instruction set that has them. Rather than requiring the
+// whole library to be built with -msha and -mavx2, only the kernels are
+// compiled for it, and they are only called when the CPU supports it
+#if defined __GNUC__
+#define TORRENT_TARGET(x) __attribute__((target(x)))
+#else
+#define TORRENT_TARGET(x)
+#endif
+#endif
+
+namespace libtorrent {
+namespace aux {
+
+namespace {
+
+	// hasher's constructor doesn't accept empty buffers
+	template <typename Hasher>
+	auto hash_buffer(span<char const> const buf) -> decltype(Hasher().final())
+	{
+		Hasher h;
+		if (!buf.empty()) h.update(buf);
+		return h.final();
+	}
+
+	std::uint32_t const sha1_init[5] = {
+		0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+
+	std::uint32_t const sha256_init[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+		0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+
+#if TORRENT_HAS_SHA_X86
+	alignas(16) std::uint32_t const sha256_k[64] = {
+		0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+		0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+		0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+		0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+		0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+		0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+		0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+		0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2 };
+
+	// writes the padding and the message length to ``out``, following the
+	// last ``len % 64`` bytes of the message, which are copied from ``tail``.
+	// Returns the number of 64 byte blocks this makes up, 1 or 2. This is the
+	// same for SHA-1 and SHA-256
+	std::size_t pad_message(std::uint8_t* out, std::uint8_t const* tail
+		, std::size_t const len)
+	{
+		std::size_t const rem = len % 64;
+		std::size_t const blocks = rem < 56 ? 1 : 2;
+		std::memcpy(out, tail, rem);
+		out[rem] = 0x80;
+		std::memset(out + rem + 1, 0, blocks * 64 - rem - 1 - 8);
+		std::uint64_t const bits = std::uint64_t(len) * 8;
+		for (int i = 0; i < 8; ++i)
+			out[blocks * 64 - 1 - std::size_t(i)] = std::uint8_t(bits >> (i * 8));
+		return blocks;
+	}
+
+	// the digest is the state words, big-endian
+	template <typename Hash>
+	Hash make_digest(std::uint32_t const* state, int const stride)
+	{
+		char digest[Hash::size()];
+		for (int i = 0; i < int(Hash::size()) / 4; ++i)
+		{
+			std::uint32_t const w = state[i * stride];
+			digest[i * 4 + 0] = char(w >> 24);
+			digest[i * 4 + 1] = char(w >> 16);
+			digest[i * 4 + 2] = char(w >> 8);
+			digest[i * 4 + 3] = char(w);
+		}
+		return Hash(digest);
+	}
+
+	using single_blocks_fun = void (*)(std::uint32_t*, std::uint8_t const*, std::size_t);
+	using x8_blocks_fun = void (*)(std::uint32_t*, std::uint8_t const* const*, std::size_t);
+
+	// hashes a single message with the block function ``fun``
+	template <typename Hash, std::size_t Words>
+	Hash hash_single(span<char const> const buf
+		, std::uint32_t const (&init)[Words], single_blocks_fun const fun)
+	{
+		std::uint32_t state[Words];
+		std::copy(std::begin(init), std::end(init), state);
+		auto const* data = reinterpret_cast<std::uint8_t const*>(buf.data());
+		std::size_t const len = std::size_t(buf.size());
+		fun(state, data, len / 64);
+		std::uint8_t tail[128];
+		fun(state, tail, pad_message(tail, data + len - len % 64, len));
+		return make_digest<Hash>(state, 1);
+	}
+
+	// hashes between 2 and 8 messages of the same length in parallel, with
+	// the block function ``fun``. Lanes without a message of their own hash
+	// a copy of the last one
+	template <typename Hash, std::size_t Words>
+	void hash_x8(span<span<char const> const> const in, span<Hash> const out
+		, std::uint32_t const (&init)[Words], x8_blocks_fun const fun)
+	{
+		TORRENT_ASSERT(in.size() > 0 && in.size() <= 8);
+		std::size_t const len = std::size_t(in[0].size());
+
+		alignas(32) std::uint32_t state[Words * 8];
+		for (std::size_t w = 0; w < Words; ++w)
+			std::fill(state + w * 8, state + w * 8 + 8, init[w]);
+
+		std::uint8_t const* data[8];
+		for (std::ptrdiff_t lane = 0; lane < 8; ++lane)
+		{
+			span<char const> const buf = in[std::min(lane, in.size() - 1)];
+			TORRENT_ASSERT(std::size_t(buf.size()) == len);
+			data[lane] = reinterpret_cast<std::uint8_t const*>(buf.data());
+		}
+		fun(state, data, len / 64);
+
+		std::uint8_t tails[8][128];
+		std::size_t blocks = 0;
+		for (int lane = 0; lane < 8; ++lane)
+		{
+			blocks = pad_message(tails[lane], data[lane] + len - len % 64, len);
+			data[lane] = tails[lane];
+		}
+		fun(state, data, blocks);
+
+		for (std::ptrdiff_t lane = 0; lane < in.size(); ++lane)
+			out[lane] = make_digest<Hash>(state + lane, 8);
+	}
+
+	// hashes the buffers in ``in`` 8 at a time, as long as they have the
+	// same length. Buffers that don't are hashed with ``hasher``
+	template <typename Hasher, typename Hash, std::size_t Words>
+	void hash_batch_x8(span<span<char const> const> const in, span<Hash> const out
+		, std::uint32_t const (&init)[Words], x8_blocks_fun const fun)
+	{
+		std::ptrdiff_t i = 0;
+		while (i < in.size())
+		{
+			std::ptrdiff_t n = 1;
+			while (n < 8 && i + n < in.size() && in[i + n].size() == in[i].size())
+				++n;
+			if (n == 1)
+				out[i] = hash_buffer<Hasher>(in[i]);
+			else
+				hash_x8(in.subspan(i, n), out.subspan(i, n), init, fun);
+			i += n;
+		}
+	}
+
+	TORRENT_TARGET("avx2")
+	inline void transpose8(__m256i* r)
+	{
+		__m256i const t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+		__m256i const t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+		__m256i const t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+		__m256i const t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+		__m256i const t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+		__m256i const t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+		__m256i const t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+		__m256i const t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+		__m256i const u0 = _mm256_unpacklo_epi64(t0, t2);
+		__m256i const u1 = _mm256_unpackhi_epi64(t0, t2);
+		__m256i const u2 = _mm256_unpacklo_epi64(t1, t3);
+		__m256i const u3 = _mm256_unpackhi_epi64(t1, t3);
+		__m256i const u4 = _mm256_unpacklo_epi64(t4, t6);
+		__m256i const u5 = _mm256_unpackhi_epi64(t4, t6);
+		__m256i const u6 = _mm256_unpacklo_epi64(t5, t7);
+		__m256i const u7 = _mm256_unpackhi_epi64(t5, t7);
+		r[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+		r[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+		r[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+		r[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+		r[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+		r[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+		r[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+		r[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+	}
+
+	// loads the 16 big-endian message words of a 64 byte block from each of
+	// the 8 lanes, such that w[i] holds word i of all lanes
+	TORRENT_TARGET("avx2")
+	inline void load_block_x8(__m256i* w, std::uint8_t const* const* data
+		, std::size_t const offset)
+	{
+		__m256i const bswap = _mm256_set_epi8(
+			12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+			12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+		for (int half = 0; half < 2; ++half)
+		{
+			__m256i* r = w + half * 8;
+			for (int lane = 0; lane < 8; ++lane)
+				r[lane] = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(
+					data[lane] + offset + std::size_t(half) * 32));
+			transpose8(r);
+			for (int i = 0; i < 8; ++i)
+				r[i] = _mm256_shuffle_epi8(r[i], bswap);
+		}
+	}
+
+	template <int N>
+	TORRENT_TARGET("avx2")
+	inline __m256i rotl(__m256i const x)
+	{
+		return _mm256_or_si256(_mm256_slli_epi32(x, N), _mm256_srli_epi32(x, 32 - N));
+	}
+#endif // TORRENT_HAS_SHA_X86
+
+} // anonymous namespace
+
+#if TORRENT_HAS_SHA_X86
+	TORRENT_TARGET("sha,sse4.1,ssse3")
+	void sha1_ni_blocks(std::uint32_t* state, std::uint8_t const* data
+		, std::size_t blocks)
+	{
+		__m128i const mask = _mm_set_epi64x(0x0001020304050607LL, 0x08090a0b0c0d0e0fLL);
+
+		__m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(
+			reinterpret_cast<__m128i const*>(state)), 0x1b);
+		__m128i e0 = _mm_set_epi32(int(state[4]), 0, 0, 0);
+		__m128i e1;
+
+		for (; blocks > 0; --blocks, data += 64)
+		{
+			__m128i const abcd_save = abcd;
+			__m128i const e_save = e0;
+
+			__m128i msg0 = _mm_shuffle_epi8(_mm_loadu_si128(
+				reinterpret_cast<__m128i const*>(data)), mask);
+			__m128i msg1 = _mm_shuffle_epi8(_mm_loadu_si128(
+				reinterpret_cast<__m128i const*>(data + 16)), mask);
+			__m128i msg2 = _mm_shuffle_epi8(_mm_loadu_si128(
+				reinterpret_cast<__m128i const*>(data + 32)), mask);
+			__m128i msg3 = _mm_shuffle_epi8(_mm_loadu_si128(
+				reinterpret_cast<__m128i const*>(data + 48)), mask);
+
+			// rounds 0-3
+			e0 = _mm_add_epi32(e0, msg0);
+			e1 = abcd;
+			abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+			// rounds 4-7
+			e1 = _mm_sha1nexte_epu32(e1, msg1);
+			e0 = abcd;
+			abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+			msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+
+			// rounds 8-11
+			e0 = _mm_sha1nexte_epu32(e0, msg2);
+			e1 = abcd;
+			abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+			msg0 = _mm_xor_si128(msg0, msg2);
+			msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+
+			// rounds 12-15
+			e1 = _mm_sha1nexte_epu32(e1, msg3);
+			e0 = abcd;
+			abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+			msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+			msg1 = _mm_xor_si128(msg1, msg3);
+			msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+
+			// rounds 16-19
+			e0 = _mm_sha1nexte_epu32(e0, msg0);
+			e1 = abcd;
+			abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+			msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+			msg2 = _mm_xor_si128(msg2, msg0);
+			msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+
+			// rounds 20-23
+			e1 = _mm_sha1nexte_epu32(e1, msg1);
+			e0 = abcd;
+			abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+			msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+			msg3 = _mm_xor_si128(msg3, msg1);
+			msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+
+			// rounds 24-27
+			e0 = _mm_sha1nexte_epu32(e0, msg2);
+			e1 = abcd;
+			abcd = _mm_sha1rnds4_epu32(abcd, e0, 1);
+			msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+			msg0 = _mm_xor_si128(msg0, msg2);
+			msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+
+			// rounds 28-31
+			e1 = _mm_sha1nexte_epu32(e1, msg3);
+			e0 = abcd;
+			abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+			msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+			msg1 = _mm_xor_si128(msg1, msg3);
+			msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+
+			// rounds 32-35
+			e0 = _mm_sha1nexte_epu32(e0, msg0);
+			e1 = abcd;
+			abcd = _mm_sha1rnds4_epu32(abcd, e0, 1);
+			msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+			msg2 = _mm_xor_si128(msg2, msg0);
+			msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+
+			// rounds 36-39
+			e1 = _mm_sha1nexte_epu32(e1, msg1);
+			e0 = abcd;
+			abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+			msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+			msg3 = _mm_xor_si128(msg3, msg1);
+			msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+
+			// rounds 40-43
+			e0 = _mm_sha1nexte_epu32(e0, msg2);
+			e1 = abcd;
+			abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+			msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+			msg0 = _mm_xor_si128(msg0, msg2);
+			msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+
+			// rounds 44-47
+			e1 = _mm_sha1nexte_epu32(e1, msg3);
+			e0 = abcd;
+			abcd = _mm_sha1rnds4_epu32(abcd, e1, 2);
+			msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+			msg1 = _mm_xor_si128(msg1, msg3);
+			msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+
+			// rounds 48-51
+			e0 = _mm_sha1nexte_epu32(e0, msg0);
+			e1 = abcd;
+			abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+			msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+			msg2 = _mm_xor_si128(msg2, msg0);
+			msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+
+			// rounds 52-55
+			e1 = _mm_sha1nexte_epu32(e1, msg1);
+			e0 = abcd;
+			abcd = _mm_sha1rnds4_epu32(abcd, e1, 2);
+			msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+			msg3 = _mm_xor_si128(msg3, msg1);
+			msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+
+			// rounds 56-59
+			e0 = _mm_sha1nexte_epu32(e0, msg2);
+			e1 = abcd;
+			abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+			msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+			msg0 = _mm_xor_si128(msg0, msg2);
+			msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+
+			// rounds 60-63
+			e1 = _mm_sha1nexte_epu32(e1, msg3);
+			e0 = abcd;
+			abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+			msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+			msg1 = _mm_xor_si128(msg1, msg3);
+			msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+
+			// rounds 64-67
+			e0 = _mm_sha1nexte_epu32(e0, msg0);
+			e1 = abcd;
+			abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+			msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+			msg2 = _mm_xor_si128(msg2, msg0);
+			msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+
+			// rounds 68-71
+			e1 = _mm_sha1nexte_epu32(e1, msg1);
+			e0 = abcd;
+			abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+			msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+			msg3 = _mm_xor_si128(msg3, msg1);
+
+			// rounds 72-75
+			e0 = _mm_sha1nexte_epu32(e0, msg2);
+			e1 = abcd;
+			abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+			msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+
+			// rounds 76-79
+			e1 = _mm_sha1nexte_epu32(e1, msg3);
+			e0 = abcd;
+			abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+			e0 = _mm_sha1nexte_epu32(e0, e_save);
+			abcd = _mm_add_epi32(abcd, abcd_save);
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_shuffle_epi32(abcd, 0x1b));
+		state[4] = std::uint32_t(_mm_extract_epi32(e0, 3));
+	}
+
+	TORRENT_TARGET("sha,sse4.1,ssse3")
+	void sha256_ni_blocks(std::uint32_t* state, std::uint8_t const* data
+		, std::size_t blocks)
+	{
+		__m128i const mask = _mm_set_epi64x(0x0c0d0e0f08090a0bLL, 0x0405060700010203LL);
+
+		// the state is kept as ABEF and CDGH
+		__m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(
+			reinterpret_cast<__m128i const*>(state)), 0xb1);
+		__m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(
+			reinterpret_cast<__m128i const*>(state + 4)), 0x1b);
+		__m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+		state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+		__m128i msg;
+
+		for (; blocks > 0; --blocks, data += 64)
+		{
+			__m128i const abef_save = state0;
+			__m128i const cdgh_save = state1;
+
+			__m128i msg0 = _mm_shuffle_epi8(_mm_loadu_si128(
+				reinterpret_cast<__m128i const*>(data)), mask);
+			__m128i msg1 = _mm_shuffle_epi8(_mm_loadu_si128(
+				reinterpret_cast<__m128i const*>(data + 16)), mask);
+			__m128i msg2 = _mm_shuffle_epi8(_mm_loadu_si128(
+				reinterpret_cast<__m128i const*>(data + 32)), mask);
+			__m128i msg3 = _mm_shuffle_epi8(_mm_loadu_si128(
+				reinterpret_cast<__m128i const*>(data + 48)), mask);
+
+			// rounds 0-3
+			msg = _mm_add_epi32(msg0, _mm_loadu_si128(reinterpret_cast<__m128i const*>(&sha256_k[0])));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+			msg = _mm_shuffle_epi32(msg, 0x0e);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+			// rounds 4-7
+			msg = _mm_add_epi32(msg1, _mm_loadu_si128(reinterpret_cast<__m128i const*>(&sha256_k[4])));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+			msg = _mm_shuffle_epi32(msg, 0x0e);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+			msg0 = _mm_sha256msg1_epu32(msg0, msg1);
+
+			// rounds 8-11
+			msg = _mm_add_epi32(msg2, _mm_loadu_si128(reinterpret_cast<__m128i const*>(&sha256_k[8])));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+			msg = _mm_shuffle_epi32(msg, 0x0e);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+			msg1 = _mm_sha256msg1_epu32(msg1, msg2);
+
+			// rounds 12-15
+			msg = _mm_add_epi32(msg3, _mm_loadu_si128(reinterpret_cast<__m128i const*>(&sha256_k[12])));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+			tmp = _mm_alignr_epi8(msg3, msg2, 4);
+			msg0 = _mm_add_epi32(msg0, tmp);
+			msg0 = _mm_sha256msg2_epu32(msg0, msg3);
+			msg = _mm_shuffle_epi32(msg, 0x0e);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+			msg2 = _mm_sha256msg1_epu32(msg2, msg3);
+
+			// rounds 16-19
+			msg = _mm_add_epi32(msg0, _mm_loadu_si128(reinterpret_cast<__m128i const*>(&sha256_k[16])));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+			tmp = _mm_alignr_epi8(msg0, msg3, 4);
+			msg1 = _mm_add_epi32(msg1, tmp);
+			msg1 = _mm_sha256msg2_epu32(msg1, msg0);
+			msg = _mm_shuffle_epi32(msg, 0x0e);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+			msg3 = _mm_sha256msg1_epu32(msg3, msg0);
+
+			// rounds 20-23
+			msg = _mm_add_epi32(msg1, _mm_loadu_si128(reinterpret_cast<__m128i const*>(&sha256_k[20])));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+			tmp = _mm_alignr_epi8(msg1, msg0, 4);
+			msg2 = _mm_add_epi32(msg2, tmp);
+			msg2 = _mm_sha256msg2_epu32(msg2, msg1);
+			msg = _mm_shuffle_epi32(msg, 0x0e);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+			msg0 = _mm_sha256msg1_epu32(msg0, msg1);
+
+			// rounds 24-27
+			msg = _mm_add_epi32(msg2, _mm_loadu_si128(reinterpret_cast<__m128i const*>(&sha256_k[24])));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+			tmp = _mm_alignr_epi8(msg2, msg1, 4);
+			msg3 = _mm_add_epi32(msg3, tmp);
+			msg3 = _mm_sha256msg2_epu32(msg3, msg2);
+			msg = _mm_shuffle_epi32(msg, 0x0e);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+			msg1 = _mm_sha256msg1_epu32(msg1, msg2);
+
+			// rounds 28-31
+			msg = _mm_add_epi32(msg3, _mm_loadu_si128(reinterpret_cast<__m128i const*>(&sha256_k[28])));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+			tmp = _mm_alignr_epi8(msg3, msg2, 4);
+			msg0 = _mm_add_epi32(msg0, tmp);
+			msg0 = _mm_sha256msg2_epu32(msg0, msg3);
+			msg = _mm_shuffle_epi32(msg, 0x0e);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+			msg2 = _mm_sha256msg1_epu32(msg2, msg3);
+
+			// rounds 32-35
+			msg = _mm_add_epi32(msg0, _mm_loadu_si128(reinterpret_cast<__m128i const*>(&sha256_k[32])));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+			tmp = _mm_alignr_epi8(msg0, msg3, 4);
+			msg1 = _mm_add_epi32(msg1, tmp);
+			msg1 = _mm_sha256msg2_epu32(msg1, msg0);
+			msg = _mm_shuffle_epi32(msg, 0x0e);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+			msg3 = _mm_sha256msg1_epu32(msg3, msg0);
+
+			// rounds 36-39
+			msg = _mm_add_epi32(msg1, _mm_loadu_si128(reinterpret_cast<__m128i const*>(&sha256_k[36])));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+			tmp = _mm_alignr_epi8(msg1, msg0, 4);
+			msg2 = _mm_add_epi32(msg2, tmp);
+			msg2 = _mm_sha256msg2_epu32(msg2, msg1);
+			msg = _mm_shuffle_epi32(msg, 0x0e);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+			msg0 = _mm_sha256msg1_epu32(msg0, msg1);
+
+			// rounds 40-43
+			msg = _mm_add_epi32(msg2, _mm_loadu_si128(reinterpret_cast<__m128i const*>(&sha256_k[40])));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+			tmp = _mm_alignr_epi8(msg2, msg1, 4);
+			msg3 = _mm_add_epi32(msg3, tmp);
+			msg3 = _mm_sha256msg2_epu32(msg3, msg2);
+			msg = _mm_shuffle_epi32(msg, 0x0e);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+			msg1 = _mm_sha256msg1_epu32(msg1, msg2);
+
+			// rounds 44-47
+			msg = _mm_add_epi32(msg3, _mm_loadu_si128(reinterpret_cast<__m128i const*>(&sha256_k[44])));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+			tmp = _mm_alignr_epi8(msg3, msg2, 4);
+			msg0 = _mm_add_epi32(msg0, tmp);
+			msg0 = _mm_sha256msg2_epu32(msg0, msg3);
+			msg = _mm_shuffle_epi32(msg, 0x0e);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+			msg2 = _mm_sha256msg1_epu32(msg2, msg3);
+
+			// rounds 48-51
+			msg = _mm_add_epi32(msg0, _mm_loadu_si128(reinterpret_cast<__m128i const*>(&sha256_k[48])));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+			tmp = _mm_alignr_epi8(msg0, msg3, 4);
+			msg1 = _mm_add_epi32(msg1, tmp);
+			msg1 = _mm_sha256msg2_epu32(msg1, msg0);
+			msg = _mm_shuffle_epi32(msg, 0x0e);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+			msg3 = _mm_sha256msg1_epu32(msg3, msg0);
+
+			// rounds 52-55
+			msg = _mm_add_epi32(msg1, _mm_loadu_si128(reinterpret_cast<__m128i const*>(&sha256_k[52])));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+			tmp = _mm_alignr_epi8(msg1, msg0, 4);
+			msg2 = _mm_add_epi32(msg2, tmp);
+			msg2 = _mm_sha256msg2_epu32(msg2, msg1);
+			msg = _mm_shuffle_epi32(msg, 0x0e);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+			// rounds 56-59
+			msg = _mm_add_epi32(msg2, _mm_loadu_si128(reinterpret_cast<__m128i const*>(&sha256_k[56])));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+			tmp = _mm_alignr_epi8(msg2, msg1, 4);
+			msg3 = _mm_add_epi32(msg3, tmp);
+			msg3 = _mm_sha256msg2_epu32(msg3, msg2);
+			msg = _mm_shuffle_epi32(msg, 0x0e);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+			// rounds 60-63
+			msg = _mm_add_epi32(msg3, _mm_loadu_si128(reinterpret_cast<__m128i const*>(&sha256_k[60])));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+			msg = _mm_shuffle_epi32(msg, 0x0e);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+			state0 = _mm_add_epi32(state0, abef_save);
+			state1 = _mm_add_epi32(state1, cdgh_save);
+		}
+
+		tmp = _mm_shuffle_epi32(state0, 0x1b);
+		state1 = _mm_shuffle_epi32(state1, 0xb1);
+		state0 = _mm_blend_epi16(tmp, state1, 0xf0);
+		state1 = _mm_alignr_epi8(state1, tmp, 8);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(state), state0);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), state1);
+	}
+
+	TORRENT_TARGET("avx2")
+	void sha1_avx2_x8(std::uint32_t* state, std::uint8_t const* const* data
+		, std::size_t const blocks)
+	{
+		__m256i s[5];
+		for (int i = 0; i < 5; ++i)
+			s[i] = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(state + i * 8));
+
+		for (std::size_t b = 0; b < blocks; ++b)
+		{
+			__m256i w[16];
+			load_block_x8(w, data, b * 64);
+
+			__m256i a = s[0];
+			__m256i bb = s[1];
+			__m256i c = s[2];
+			__m256i d = s[3];
+			__m256i e = s[4];
+
+			for (int t = 0; t < 80; ++t)
+			{
+				if (t >= 16)
+				{
+					w[t & 15] = rotl<1>(_mm256_xor_si256(
+						_mm256_xor_si256(w[(t - 3) & 15], w[(t - 8) & 15])
+						, _mm256_xor_si256(w[(t - 14) & 15], w[t & 15])));
+				}
+
+				__m256i f;
+				std::uint32_t k;
+				if (t < 20)
+				{
+					// d ^ (b & (c ^ d))
+					f = _mm256_xor_si256(d, _mm256_and_si256(bb, _mm256_xor_si256(c, d)));
+					k = 0x5a827999;
+				}
+				else if (t < 40)
+				{
+					f = _mm256_xor_si256(_mm256_xor_si256(bb, c), d);
+					k = 0x6ed9eba1;
+				}
+				else if (t < 60)
+				{
+					// (b & c) | (d & (b | c))
+					f = _mm256_or_si256(_mm256_and_si256(bb, c)
+						, _mm256_and_si256(d, _mm256_or_si256(bb, c)));
+					k = 0x8f1bbcdc;
+				}
+				else
+				{
+					f = _mm256_xor_si256(_mm256_xor_si256(bb, c), d);
+					k = 0xca62c1d6;
+				}
+
+				__m256i const tmp = _mm256_add_epi32(
+					_mm256_add_epi32(rotl<5>(a), f)
+					, _mm256_add_epi32(_mm256_add_epi32(e, w[t & 15])
+						, _mm256_set1_epi32(int(k))));
+				e = d;
+				d = c;
+				c = rotl<30>(bb);
+				bb = a;
+				a = tmp;
+			}
+
+			s[0] = _mm256_add_epi32(s[0], a);
+			s[1] = _mm256_add_epi32(s[1], bb);
+			s[2] = _mm256_add_epi32(s[2], c);
+			s[3] = _mm256_add_epi32(s[3], d);
+			s[4] = _mm256_add_epi32(s[4], e);
+		}
+
+		for (int i = 0; i < 5; ++i)
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(state + i * 8), s[i]);
+	}
+
+	TORRENT_TARGET("avx2")
+	void sha256_avx2_x8(std::uint32_t* state, std::uint8_t const* const* data
+		, std::size_t const blocks)
+	{
+		__m256i s[8];
+		for (int i = 0; i < 8; ++i)
+			s[i] = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(state + i * 8));
+
+		for (std::size_t b = 0; b < blocks; ++b)
+		{
+			__m256i w[16];
+			load_block_x8(w, data, b * 64);
+
+			__m256i v[8];
+			std::copy(std::begin(s), std::end(s), v);
+
+			for (int t = 0; t < 64; ++t)
+			{
+				if (t >= 16)
+				{
+					__m256i const w15 = w[(t - 15) & 15];
+					__m256i const w2 = w[(t - 2) & 15];
+					__m256i const s0 = _mm256_xor_si256(_mm256_xor_si256(
+						rotl<25>(w15), rotl<14>(w15)), _mm256_srli_epi32(w15, 3));
+					__m256i const s1 = _mm256_xor_si256(_mm256_xor_si256(
+						rotl<15>(w2), rotl<13>(w2)), _mm256_srli_epi32(w2, 10));
+					w[t & 15] = _mm256_add_epi32(_mm256_add_epi32(w[t & 15], s0)
+						, _mm256_add_epi32(w[(t - 7) & 15], s1));
+				}
+
+				__m256i const a = v[(64 - t) & 7];
+				__m256i const bb = v[(65 - t) & 7];
+				__m256i const c = v[(66 - t) & 7];
+				__m256i const e = v[(68 - t) & 7];
+				__m256i const f = v[(69 - t) & 7];
+				__m256i const g = v[(70 - t) & 7];
+
+				// Sigma1(e) + Ch(e, f, g) + h + K[t] + W[t]
+				__m256i const sigma1 = _mm256_xor_si256(_mm256_xor_si256(
+					rotl<26>(e), rotl<21>(e)), rotl<7>(e));
+				__m256i const ch = _mm256_xor_si256(g, _mm256_and_si256(e, _mm256_xor_si256(f, g)));
+				__m256i const t1 = _mm256_add_epi32(
+					_mm256_add_epi32(_mm256_add_epi32(v[(71 - t) & 7], sigma1), ch)
+					, _mm256_add_epi32(_mm256_set1_epi32(int(sha256_k[t])), w[t & 15]));
+
+				// Sigma0(a) + Maj(a, b, c)
+				__m256i const sigma0 = _mm256_xor_si256(_mm256_xor_si256(
+					rotl<30>(a), rotl<19>(a)), rotl<10>(a));
+				__m256i const maj = _mm256_or_si256(_mm256_and_si256(a, bb)
+					, _mm256_and_si256(c, _mm256_or_si256(a, bb)));
+				__m256i const t2 = _mm256_add_epi32(sigma0, maj);
+
+				// rather than moving all the working variables one step, the
+				// window into v[] is rotated. h becomes the new a and d += t1
+				v[(67 - t) & 7] = _mm256_add_epi32(v[(67 - t) & 7], t1);
+				v[(71 - t) & 7] = _mm256_add_epi32(t1, t2);
+			}
+
+			for (int i = 0; i < 8; ++i)
+				s[i] = _mm256_add_epi32(s[i], v[i]);
+		}
+
+		for (int i = 0; i < 8; ++i)
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(state + i * 8), s[i]);
+	}
+#endif // TORRENT_HAS_SHA_X86
+
+	void sha1_batch(span<span<char const> const> const in, span<sha1_hash> const out)
+	{
+		TORRENT_ASSERT(out.size() >= in.size());
+#if TORRENT_HAS_SHA_X86
+		// a single SHA-NI stream is faster than 8 AVX2 lanes
+		if (sha_ni_support)
+		{
+			for (std::ptrdiff_t i = 0; i < in.size(); ++i)
+				out[i] = hash_single<sha1_hash>(in[i], sha1_init, &sha1_ni_blocks);
+			return;
+		}
+		if (avx2_support)
+		{
+			hash_batch_x8<hasher>(in, out, sha1_init, &sha1_avx2_x8);
+			return;
+		}
+#endif
+		for (std::ptrdiff_t i = 0; i < in.size(); ++i)
+			out[i] = hash_buffer<hasher>(in[i]);
+	}
+
+	int sha1_batch_lanes()
+	{
+#if TORRENT_HAS_SHA_X86
+		if (!sha_ni_support && avx2_support) return 8;
+#endif
+		return 1;
+	}
+
+	void sha256_batch(span<span<char const> const> const in, span<sha256_hash> const out)
+	{
+		TORRENT_ASSERT(out.size() >= in.size());
+#if TORRENT_HAS_SHA_X86
+		if (sha_ni_support)
+		{
+			for (std::ptrdiff_t i = 0; i < in.size(); ++i)
+				out[i] = hash_single<sha256_hash>(in[i], sha256_init, &sha256_ni_blocks);
+			return;
+		}
+		if (avx2_support)
+		{
+			hash_batch_x8<hasher256>(in, out, sha256_init, &sha256_avx2_x8);
+			return;
+		}
+#endif
+		for (std::ptrdiff_t i = 0; i < in.size(); ++i)
+			out[i] = hash_buffer<hasher256>(in[i]);
+	}
+}
+}
@@ -0,0 +1,215 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/config.hpp"
+
+#if TORRENT_HAVE_IO_URING
+
+#include "libtorrent/aux_/io_uring.hpp"
+#include "libtorrent/assert.hpp"
+
+#include <cstring> // for memset
+#include <algorithm>
+
+#include "libtorrent/aux_/disable_warnings_push.hpp"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include "libtorrent/aux_/disable_warnings_pop.hpp"
+
+namespace libtorrent {
+namespace aux {
+
+namespace {
+
+	int sys_io_uring_setup(unsigned const entries, io_uring_params* p)
+	{
+		return int(::syscall(__NR_io_uring_setup, entries, p));
+	}
+
+	int sys_io_uring_enter(int const fd, unsigned const to_submit
+		, unsigned const min_complete, unsigned const flags)
+	{
+		return int(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete
+			, flags, nullptr, 0));
+	}
+
+	template <typename T>
+	T* ring_ptr(void* ring, std::uint32_t const offset)
+	{
+		return reinterpret_cast<T*>(static_cast<char*>(ring) + offset);
+	}
+}
+
+	io_uring::io_uring(std::uint32_t const entries, error_code& ec)
+	{
+		io_uring_params p;
+		std::memset(&p, 0, sizeof(p));
+		m_fd = sys_io_uring_setup(entries, &p);
+		if (m_fd < 0)
+		{
+			ec.assign(errno, system_category());
+			return;
+		}
+
+		m_sq_entries = p.sq_entries;
+		m_cq_entries = p.cq_entries;
+
+		m_sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(std::uint32_t);
+		m_cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+
+		// since linux 5.4 both rings can be mapped with a single mmap() call
+		bool const single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (single_mmap)
+			m_sq_ring_size = m_cq_ring_size = std::max(m_sq_ring_size, m_cq_ring_size);
+
+		m_sq_ring = ::mmap(nullptr, m_sq_ring_size, PROT_READ | PROT_WRITE
+			, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+		if (m_sq_ring == MAP_FAILED)
+		{
+			m_sq_ring = nullptr;
+			ec.assign(errno, system_category());
+			close();
+			return;
+		}
+
+		if (single_mmap)
+		{
+			m_cq_ring = m_sq_ring;
+		}
+		else
+		{
+			m_cq_ring = ::mmap(nullptr, m_cq_ring_size, PROT_READ | PROT_WRITE
+				, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+			if (m_cq_ring == MAP_FAILED)
+			{
+				m_cq_ring = nullptr;
+				ec.assign(errno, system_category());
+				close();
+				return;
+			}
+		}
+
+		void* const sqes = ::mmap(nullptr, p.sq_entries * sizeof(io_uring_sqe)
+			, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+		if (sqes == MAP_FAILED)
+		{
+			ec.assign(errno, system_category());
+			close();
+			return;
+		}
+		m_sqes = static_cast<io_uring_sqe*>(sqes);
+
+		m_sq_head = ring_ptr<std::uint32_t>(m_sq_ring, p.sq_off.head);
+		m_sq_tail = ring_ptr<std::uint32_t>(m_sq_ring, p.sq_off.tail);
+		m_sq_mask = ring_ptr<std::uint32_t>(m_sq_ring, p.sq_off.ring_mask);
+		m_sq_array = ring_ptr<std::uint32_t>(m_sq_ring, p.sq_off.array);
+
+		m_cq_head = ring_ptr<std::uint32_t>(m_cq_ring, p.cq_off.head);
+		m_cq_tail = ring_ptr<std::uint32_t>(m_cq_ring, p.cq_off.tail);
+		m_cq_mask = ring_ptr<std::uint32_t>(m_cq_ring, p.cq_off.ring_mask);
+		m_cqes = ring_ptr<io_uring_cqe>(m_cq_ring, p.cq_off.cqes);
+
+		m_sqe_head = m_sqe_tail = *m_sq_tail;
+	}
+
+	io_uring::~io_uring() { close(); }
+
+	void io_uring::close()
+	{
+		if (m_sqes != nullptr)
+			::munmap(m_sqes, m_sq_entries * sizeof(io_uring_sqe));
+		if (m_cq_ring != nullptr && m_cq_ring != m_sq_ring)
+			::munmap(m_cq_ring, m_cq_ring_size);
+		if (m_sq_ring != nullptr)
+			::munmap(m_sq_ring, m_sq_ring_size);
+		if (m_fd >= 0) ::close(m_fd);
+		m_fd = -1;
+		m_sqes = nullptr;
+		m_cq_ring = nullptr;
+		m_sq_ring = nullptr;
+	}
+
+	io_uring_sqe* io_uring::sqe()
+	{
+		TORRENT_ASSERT(valid());
+		std::uint32_t const head = __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+		if (m_sqe_tail - head >= m_sq_entries) return nullptr;
+		io_uring_sqe* ret = &m_sqes[m_sqe_tail & *m_sq_mask];
+		++m_sqe_tail;
+		std::memset(ret, 0, sizeof(*ret));
+		return ret;
+	}
+
+	int io_uring::submit(error_code& ec)
+	{
+		TORRENT_ASSERT(valid());
+		std::uint32_t const to_submit = m_sqe_tail - m_sqe_head;
+		if (to_submit == 0) return 0;
+
+		// publish the new entries to the kernel
+		std::uint32_t tail = *m_sq_tail;
+		std::uint32_t const mask = *m_sq_mask;
+		for (; m_sqe_head != m_sqe_tail; ++m_sqe_head, ++tail)
+			m_sq_array[tail & mask] = m_sqe_head & mask;
+		__atomic_store_n(m_sq_tail, tail, __ATOMIC_RELEASE);
+
+		for (;;)
+		{
+			int const ret = sys_io_uring_enter(m_fd, to_submit, 0, 0);
+			if (ret >= 0) return ret;
+			if (errno == EINTR) continue;
+			ec.assign(errno, system_category());
+			return -1;
+		}
+	}
+
+	void io_uring::wait(error_code& ec)
+	{
+		TORRENT_ASSERT(valid());
+		for (;;)
+		{
+			if (*m_cq_head != __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE))
+				return;
+			int const ret = sys_io_uring_enter(m_fd, 0, 1, IORING_ENTER_GETEVENTS);
+			if (ret >= 0) return;
+			if (errno == EINTR) continue;
+			ec.assign(errno, system_category());
+			return;
+		}
+	}
+
+} // aux
+} // libtorrent
+
+#endif // TORRENT_HAVE_IO_URING
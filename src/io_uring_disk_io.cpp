@@ -0,0 +1,1406 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/io_uring_disk_io.hpp"
+#include "libtorrent/posix_disk_io.hpp"
+#include "libtorrent/disk_interface.hpp"
+
+#if TORRENT_HAVE_IO_URING
+
+#include "libtorrent/aux_/io_uring.hpp"
+#include "libtorrent/aux_/disk_buffer_pool.hpp"
+#include "libtorrent/aux_/posix_storage.hpp"
+#include "libtorrent/aux_/store_buffer.hpp"
+#include "libtorrent/aux_/storage_free_list.hpp"
+#include "libtorrent/aux_/storage_utils.hpp"
+#include "libtorrent/aux_/open_mode.hpp"
+#include "libtorrent/aux_/throw.hpp"
+#include "libtorrent/aux_/numeric_cast.hpp"
+#include "libtorrent/performance_counters.hpp"
+#include "libtorrent/settings_pack.hpp"
+#include "libtorrent/platform_util.hpp"
+#include "libtorrent/file_storage.hpp"
+#include "libtorrent/add_torrent_params.hpp"
+#include "libtorrent/error.hpp"
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstring>
+
+#include "libtorrent/aux_/disable_warnings_push.hpp"
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <boost/multi_index/member.hpp>
+#include "libtorrent/aux_/disable_warnings_pop.hpp"
+
+#endif
+
+namespace libtorrent {
+
+#if TORRENT_HAVE_IO_URING
+
+namespace {
+
+	using aux::posix_storage;
+
+	namespace mi = boost::multi_index;
+
+	// the number of submission queue entries to request from the kernel. The
+	// completion queue is twice as large
+	std::uint32_t const queue_depth = 256;
+
+	// a block spanning more files than this is not worth splitting into
+	// separate file operations, it's read or written by a helper thread
+	// instead
+	std::size_t const max_slices = 16;
+
+	// the user_data of the NOP operation used to terminate the completion
+	// thread
+	std::uint64_t const shutdown_tag = 0;
+
+	struct uring_job;
+
+	// a single read or write operation against one file. A block that spans
+	// more than one file has one slice per file
+	struct io_slice
+	{
+		uring_job* job;
+		file_index_t file_index;
+
+		// keeps the file open until the operation completes, even if the
+		// storage closes or reopens it in the meantime
+		std::shared_ptr<aux::native_fd const> file;
+		std::int64_t file_offset;
+
+		// the part of the buffer that has not been transferred yet
+		iovec buf;
+	};
+
+	struct uring_job
+	{
+		bool write = false;
+
+		// set for write jobs while the buffer is in the store buffer
+		bool in_store_buffer = false;
+
+		// the storage is kept alive until the job's handler has been posted
+		std::shared_ptr<posix_storage> storage;
+		storage_index_t storage_index{0};
+
+		// the key of the storage's files in the native_file_pool
+		std::uint64_t storage_id = 0;
+		piece_index_t piece{0};
+
+		// offset into the piece. For write jobs, this (together with storage
+		// and piece) is the key into the store buffer
+		int offset = 0;
+
+		disk_buffer_holder buffer;
+
+		// the part of buffer to read or write, starting at offset
+		span<char> range;
+
+		std::function<void(disk_buffer_holder, storage_error const&)> read_handler;
+		std::function<void(storage_error const&)> write_handler;
+
+		std::vector<io_slice> slices;
+
+		// the number of slices still in flight
+		std::atomic<int> outstanding{0};
+
+		storage_error error;
+		time_point start_time;
+	};
+
+	// the file descriptors operated on by the ring, shared by all torrents.
+	// At most ``file_pool_size`` of them are held open, the least recently
+	// used one is closed to make room for a new one. Operations in flight hold
+	// their own reference to the descriptor, so closing it here doesn't affect
+	// them. Files are identified by a storage ID rather than the storage index,
+	// since indices are reused once a torrent is removed, while operations on
+	// the removed torrent may still be opening files
+	struct native_file_pool
+	{
+		using file_ptr = std::shared_ptr<aux::native_fd const>;
+
+		// returns the descriptor of the file, or nullptr if it isn't open (or
+		// only open for reading and ``write`` is set)
+		file_ptr get(std::uint64_t const storage, file_index_t const file
+			, bool const write)
+		{
+			std::lock_guard<std::mutex> l(m_mutex);
+			auto& key_view = m_files.get<0>();
+			auto const i = key_view.find(file_id{storage, file});
+			if (i == key_view.end()) return {};
+			if (write && !i->writable) return {};
+			// move it to the back of the LRU list
+			auto& lru_view = m_files.get<1>();
+			lru_view.relocate(lru_view.end(), m_files.project<1>(i));
+			return i->file;
+		}
+
+		// adds a file opened by posix_storage::open_native_file(). A
+		// descriptor open for reading is replaced by one open for writing
+		void insert(std::uint64_t const storage, file_index_t const file
+			, file_ptr f, bool const write)
+		{
+			std::vector<file_ptr> closed;
+			std::unique_lock<std::mutex> l(m_mutex);
+			auto& key_view = m_files.get<0>();
+			auto i = key_view.find(file_id{storage, file});
+			if (i == key_view.end())
+			{
+				i = key_view.insert(file_entry{file_id{storage, file}, std::move(f), write}).first;
+			}
+			else if (write || !i->writable)
+			{
+				key_view.modify(i, [&](file_entry& e)
+				{
+					closed.push_back(std::move(e.file));
+					e.file = std::move(f);
+					e.writable = write;
+				});
+			}
+			auto& lru_view = m_files.get<1>();
+			lru_view.relocate(lru_view.end(), m_files.project<1>(i));
+			while (int(m_files.size()) > m_size)
+			{
+				closed.push_back(lru_view.front().file);
+				lru_view.pop_front();
+			}
+			l.unlock();
+			// the descriptors are closed here, without holding the mutex
+		}
+
+		// closes all files belonging to the storage
+		void release(std::uint64_t const storage)
+		{
+			std::vector<file_ptr> closed;
+			std::unique_lock<std::mutex> l(m_mutex);
+			auto& key_view = m_files.get<0>();
+			auto const begin = key_view.lower_bound(file_id{storage, file_index_t{0}});
+			auto const end = key_view.lower_bound(file_id{storage + 1, file_index_t{0}});
+			for (auto i = begin; i != end; ++i) closed.push_back(i->file);
+			key_view.erase(begin, end);
+			l.unlock();
+		}
+
+		void resize(int const size)
+		{
+			std::vector<file_ptr> closed;
+			std::unique_lock<std::mutex> l(m_mutex);
+			m_size = std::max(1, size);
+			auto& lru_view = m_files.get<1>();
+			while (int(m_files.size()) > m_size)
+			{
+				closed.push_back(lru_view.front().file);
+				lru_view.pop_front();
+			}
+			l.unlock();
+		}
+
+	private:
+
+		using file_id = std::pair<std::uint64_t, file_index_t>;
+
+		struct file_entry
+		{
+			file_id key;
+			file_ptr file;
+			bool writable;
+		};
+
+		using files_container = mi::multi_index_container<
+			file_entry,
+			mi::indexed_by<
+			// look up files by (storage, file) key
+			mi::ordered_unique<mi::member<file_entry, file_id, &file_entry::key>>,
+			// least recently used files are at the front
+			mi::sequenced<>
+			>
+		>;
+
+		std::mutex m_mutex;
+		files_container m_files;
+		int m_size = 40;
+	};
+
+	enum class helper_kind : std::uint8_t
+	{
+		// a read or write that can't be issued to the ring as-is, because
+		// files need to be opened or the part file is involved. It completes
+		// the job itself
+		io,
+
+		// a hash job. While it runs, it's counted as outstanding against its
+		// storage
+		hash,
+
+		// a fence job, run with no other operation in flight against its
+		// storage
+		fence
+	};
+
+	// an operation run on one of the helper threads
+	struct helper_job
+	{
+		std::function<void()> fun;
+		storage_index_t storage;
+		helper_kind kind;
+	};
+
+	// reads, writes and hash jobs are started as soon as they're posted,
+	// unless a fence job is pending against their storage. In that case they
+	// are queued up behind it
+	struct deferred_job
+	{
+		// set for reads and writes
+		std::unique_ptr<uring_job> io;
+
+		// set for hash and fence jobs
+		std::function<void()> fun;
+
+		// the piece of a hash job
+		piece_index_t piece{0};
+		bool fence = false;
+	};
+
+	struct storage_queue
+	{
+		// the number of reads, writes and hash jobs in flight
+		int outstanding = 0;
+
+		// set while a fence job is running on a helper thread
+		bool fence_running = false;
+
+		std::deque<deferred_job> deferred;
+
+		// the number of writes in flight, per piece. A hash job is held back
+		// until the writes to its piece that were posted before it complete.
+		// Other I/O against the storage is not held up by it
+		std::map<piece_index_t, int> piece_writes;
+
+		// hash jobs waiting for writes to their piece
+		std::multimap<piece_index_t, std::function<void()>> waiting_hashes;
+	};
+
+} // anonymous namespace
+
+	struct TORRENT_EXTRA_EXPORT io_uring_disk_io final
+		: disk_interface
+	{
+		io_uring_disk_io(io_context& ios, settings_interface const& sett
+			, counters& cnt, std::unique_ptr<aux::io_uring> ring)
+			: m_settings(sett)
+			, m_buffer_pool(ios)
+			, m_stats_counters(cnt)
+			, m_ios(ios)
+			, m_ring(std::move(ring))
+		{
+			settings_updated();
+			m_completion_thread = std::thread([this] { thread_fun(); });
+
+			// hashing and checking files are the bulk of the work done by the
+			// helper threads
+			int const num_helpers = std::max(1, sett.get_int(settings_pack::hashing_threads));
+			for (int i = 0; i < num_helpers; ++i)
+				m_helper_threads.emplace_back([this] { helper_thread_fun(); });
+		}
+
+		~io_uring_disk_io() override
+		{
+			abort(true);
+			TORRENT_ASSERT(m_store_buffer.size() == 0);
+		}
+
+		void settings_updated() override
+		{
+			m_buffer_pool.set_settings(m_settings);
+			m_file_pool.resize(m_settings.get_int(settings_pack::file_pool_size));
+		}
+
+		storage_holder new_torrent(storage_params const& params
+			, std::shared_ptr<void> const& owner) override
+		{
+			storage_index_t const idx = m_free_slots.new_index(m_torrents.end_index());
+			auto storage = std::make_shared<posix_storage>(params);
+			storage->set_storage_index(idx);
+			storage->set_owner(owner);
+			if (idx == m_torrents.end_index())
+			{
+				m_torrents.emplace_back(std::move(storage));
+				m_storage_ids.emplace_back(++m_last_storage_id);
+				std::lock_guard<std::mutex> l(m_mutex);
+				m_queues.emplace_back(std::make_unique<storage_queue>());
+			}
+			else
+			{
+				m_torrents[idx] = std::move(storage);
+				m_storage_ids[idx] = ++m_last_storage_id;
+			}
+			return storage_holder(idx, *this);
+		}
+
+		// jobs still in flight against the storage hold their own reference
+		// to it, and to the files they operate on, so this doesn't need to
+		// wait for them
+		void remove_torrent(storage_index_t const idx) override
+		{
+			m_file_pool.release(m_storage_ids[idx]);
+			m_torrents[idx].reset();
+			m_free_slots.add(idx);
+		}
+
+		void abort(bool) override
+		{
+			if (m_abort) return;
+			m_abort = true;
+
+			// let all outstanding jobs complete before stopping the helper
+			// threads and the completion thread
+			submit_jobs();
+			{
+				std::unique_lock<std::mutex> l(m_mutex);
+				m_cond.wait(l, [&] { return m_num_jobs == 0; });
+				m_stop_helpers = true;
+			}
+			m_helper_cond.notify_all();
+			for (auto& t : m_helper_threads) t.join();
+
+			{
+				// nothing is in flight, so the submission queue is empty
+				std::lock_guard<std::mutex> l(m_submit_mutex);
+				io_uring_sqe* sqe = m_ring->sqe();
+				TORRENT_ASSERT(sqe != nullptr);
+				sqe->opcode = IORING_OP_NOP;
+				sqe->user_data = shutdown_tag;
+				error_code ec;
+				m_ring->submit(ec);
+				TORRENT_ASSERT(!ec);
+			}
+			m_completion_thread.join();
+		}
+
+		void async_read(storage_index_t const storage, peer_request const& r
+			, std::function<void(disk_buffer_holder block, storage_error const& se)> handler
+			, disk_job_flags_t) override
+		{
+			TORRENT_ASSERT(r.length <= default_block_size);
+			TORRENT_ASSERT(r.length > 0);
+			TORRENT_ASSERT(r.start >= 0);
+
+			storage_error error;
+			if (r.length <= 0 || r.start < 0)
+			{
+				// this is an invalid read request.
+				error.ec = errors::invalid_request;
+				error.operation = operation_t::file_read;
+				handler(disk_buffer_holder{}, error);
+				return;
+			}
+
+			disk_buffer_holder buffer(m_buffer_pool
+				, m_buffer_pool.allocate_buffer("send buffer"), r.length);
+			if (!buffer)
+			{
+				error.ec = errors::no_memory;
+				error.operation = operation_t::alloc_cache_piece;
+				post(m_ios, [this, error, h = std::move(handler)]{ h(disk_buffer_holder(m_buffer_pool, nullptr, 0), error); });
+				return;
+			}
+
+			// the store buffer is indexed by block aligned offsets. block_offset
+			// is the offset of the first block this read touches and
+			// read_offset is where in that block the read starts
+			int const block_offset = r.start - (r.start % default_block_size);
+			int const read_offset = r.start - block_offset;
+
+			// the part of the request that needs to be read from disk
+			int offset = r.start;
+			span<char> buf = {buffer.data(), r.length};
+
+			if (read_offset + r.length > default_block_size)
+			{
+				// This is an unaligned request spanning two blocks. Either, both
+				// or none of them may be in the store buffer
+				std::ptrdiff_t const len1 = default_block_size - read_offset;
+				int const ret = m_store_buffer.get2({storage, r.piece, block_offset}
+					, {storage, r.piece, block_offset + default_block_size}
+					, [&](char const* buf1, char const* buf2)
+				{
+					if (buf1)
+						std::memcpy(buffer.data(), buf1 + read_offset, std::size_t(len1));
+					if (buf2)
+						std::memcpy(buffer.data() + len1, buf2, std::size_t(r.length - len1));
+					return (buf1 ? 2 : 0) | (buf2 ? 1 : 0);
+				});
+
+				if (ret == 3)
+				{
+					handler(std::move(buffer), error);
+					return;
+				}
+				if (ret == 2)
+				{
+					// the first block came from the store buffer
+					offset = block_offset + default_block_size;
+					buf = buf.subspan(len1);
+				}
+				else if (ret == 1)
+				{
+					// the second block came from the store buffer
+					buf = buf.first(len1);
+				}
+			}
+			else if (m_store_buffer.get({storage, r.piece, block_offset}, [&](char const* b)
+				{ std::memcpy(buffer.data(), b + read_offset, std::size_t(r.length)); }))
+			{
+				handler(std::move(buffer), error);
+				return;
+			}
+
+			auto j = std::make_unique<uring_job>();
+			j->storage = m_torrents[storage];
+			j->storage_index = storage;
+			j->storage_id = m_storage_ids[storage];
+			j->piece = r.piece;
+			j->offset = offset;
+			j->range = buf;
+			j->read_handler = std::move(handler);
+			j->buffer = std::move(buffer);
+			j->start_time = clock_type::now();
+			add_io_job(std::move(j));
+		}
+
+		disk_buffer_holder allocate_disk_buffer(bool& exceeded
+			, std::shared_ptr<disk_observer> o) override
+		{
+			exceeded = false;
+			return disk_buffer_holder(m_buffer_pool, m_buffer_pool.allocate_buffer(
+				exceeded, std::move(o), "receive buffer"), default_block_size);
+		}
+
+		bool async_write(storage_index_t const storage, peer_request const& r
+			, char const* buf, std::shared_ptr<disk_observer> o
+			, std::function<void(storage_error const&)> handler
+			, disk_job_flags_t const flags) override
+		{
+			bool exceeded = false;
+			disk_buffer_holder buffer(m_buffer_pool, m_buffer_pool.allocate_buffer(
+				exceeded, o, "receive buffer"), default_block_size);
+			if (!buffer) aux::throw_ex<std::bad_alloc>();
+			std::memcpy(buffer.data(), buf, aux::numeric_cast<std::size_t>(r.length));
+
+			async_write(storage, r, std::move(buffer), std::move(o), std::move(handler), flags);
+			return exceeded;
+		}
+
+		bool async_write(storage_index_t const storage, peer_request const& r
+			, disk_buffer_holder buffer, std::shared_ptr<disk_observer>
+			, std::function<void(storage_error const&)> handler
+			, disk_job_flags_t) override
+		{
+			TORRENT_ASSERT(buffer);
+			TORRENT_ASSERT(r.start % default_block_size == 0);
+			TORRENT_ASSERT(r.length <= default_block_size);
+
+			auto j = std::make_unique<uring_job>();
+			j->write = true;
+			j->storage = m_torrents[storage];
+			j->storage_index = storage;
+			j->storage_id = m_storage_ids[storage];
+			j->piece = r.piece;
+			j->offset = r.start;
+			j->write_handler = std::move(handler);
+			j->buffer = std::move(buffer);
+			j->range = {j->buffer.data(), r.length};
+			j->start_time = clock_type::now();
+
+			// until the write completes, reads of this block are served from
+			// the store buffer
+			m_store_buffer.insert({storage, j->piece, j->offset}, j->buffer.data());
+			j->in_store_buffer = true;
+			add_io_job(std::move(j));
+			return false;
+		}
+
+		void async_hash(storage_index_t const storage, piece_index_t const piece
+			, span<sha256_hash> block_hashes, disk_job_flags_t const flags
+			, std::function<void(piece_index_t, sha1_hash const&, storage_error const&)> handler) override
+		{
+			bool const v1 = bool(flags & disk_interface::v1_hash);
+
+			add_hash_job(storage, piece, [=, st = m_torrents[storage], h = std::move(handler)] () mutable
+			{
+				time_point const start_time = clock_type::now();
+				disk_buffer_holder buffer(m_buffer_pool, m_buffer_pool.allocate_buffer("hash buffer"), default_block_size);
+				storage_error error;
+				sha1_hash hash;
+				if (!buffer)
+				{
+					error.ec = errors::no_memory;
+					error.operation = operation_t::alloc_cache_piece;
+				}
+				else
+				{
+					int const blocks_read = st->hash(m_settings, piece, v1
+						, block_hashes, {buffer.data(), default_block_size}, hash, error);
+
+					if (!error.ec)
+					{
+						std::int64_t const read_time = total_microseconds(clock_type::now() - start_time);
+
+						m_stats_counters.inc_stats_counter(counters::num_read_back, blocks_read);
+						m_stats_counters.inc_stats_counter(counters::num_blocks_read, blocks_read);
+						m_stats_counters.inc_stats_counter(counters::num_read_ops, blocks_read);
+						m_stats_counters.inc_stats_counter(counters::disk_hash_time, read_time);
+						m_stats_counters.inc_stats_counter(counters::disk_job_time, read_time);
+					}
+				}
+
+				post(m_ios, [=, s = std::move(st), h = std::move(h)]{ h(piece, hash, error); });
+			});
+		}
+
+		void async_hash2(storage_index_t const storage, piece_index_t const piece
+			, int const offset, disk_job_flags_t
+			, std::function<void(piece_index_t, sha256_hash const&, storage_error const&)> handler) override
+		{
+			add_hash_job(storage, piece, [=, st = m_torrents[storage], h = std::move(handler)] () mutable
+			{
+				time_point const start_time = clock_type::now();
+				disk_buffer_holder buffer(m_buffer_pool, m_buffer_pool.allocate_buffer("hash buffer"), default_block_size);
+				storage_error error;
+				sha256_hash hash;
+				if (!buffer)
+				{
+					error.ec = errors::no_memory;
+					error.operation = operation_t::alloc_cache_piece;
+				}
+				else
+				{
+					hash = st->hash2(m_settings, piece, offset
+						, {buffer.data(), default_block_size}, error);
+
+					if (!error.ec)
+					{
+						std::int64_t const read_time = total_microseconds(clock_type::now() - start_time);
+
+						m_stats_counters.inc_stats_counter(counters::num_read_back);
+						m_stats_counters.inc_stats_counter(counters::num_blocks_read);
+						m_stats_counters.inc_stats_counter(counters::num_read_ops);
+						m_stats_counters.inc_stats_counter(counters::disk_hash_time, read_time);
+						m_stats_counters.inc_stats_counter(counters::disk_job_time, read_time);
+					}
+				}
+
+				post(m_ios, [=, s = std::move(st), h = std::move(h)]{ h(piece, hash, error); });
+			});
+		}
+
+		void async_move_storage(storage_index_t const storage, std::string p
+			, move_flags_t const flags
+			, std::function<void(status_t, std::string const&, storage_error const&)> handler) override
+		{
+			add_fence_job(storage, [=, st = m_torrents[storage], id = m_storage_ids[storage]
+				, h = std::move(handler)] () mutable
+			{
+				m_file_pool.release(id);
+				storage_error ec;
+				status_t ret;
+				std::string path;
+				std::tie(ret, path) = st->move_storage(p, flags, ec);
+				post(m_ios, [=, s = std::move(st), h = std::move(h)]{ h(ret, path, ec); });
+			});
+		}
+
+		void async_release_files(storage_index_t const storage
+			, std::function<void()> handler) override
+		{
+			add_fence_job(storage, [this, st = m_torrents[storage], id = m_storage_ids[storage]
+				, h = std::move(handler)] () mutable
+			{
+				m_file_pool.release(id);
+				st->release_files();
+				post(m_ios, [s = std::move(st), h = std::move(h)]{ if (h) h(); });
+			});
+		}
+
+		void async_delete_files(storage_index_t const storage, remove_flags_t const options
+			, std::function<void(storage_error const&)> handler) override
+		{
+			add_fence_job(storage, [=, st = m_torrents[storage], id = m_storage_ids[storage]
+				, h = std::move(handler)] () mutable
+			{
+				m_file_pool.release(id);
+				storage_error error;
+				st->delete_files(options, error);
+				post(m_ios, [=, s = std::move(st), h = std::move(h)]{ h(error); });
+			});
+		}
+
+		void async_check_files(storage_index_t const storage
+			, add_torrent_params const* resume_data
+			, aux::vector<std::string, file_index_t> links
+			, std::function<void(status_t, storage_error const&)> handler) override
+		{
+			add_fence_job(storage, [this, resume_data, l = std::move(links)
+				, st = m_torrents[storage], id = m_storage_ids[storage]
+				, h = std::move(handler)] () mutable
+			{
+				m_file_pool.release(id);
+				storage_error error;
+				status_t const ret = st->check_files(m_settings
+					, resume_data, std::move(l), error);
+				post(m_ios, [error, ret, s = std::move(st), h = std::move(h)]{ h(ret, error); });
+			});
+		}
+
+		void async_rename_file(storage_index_t const storage
+			, file_index_t const idx
+			, std::string name
+			, std::function<void(std::string const&, file_index_t, storage_error const&)> handler) override
+		{
+			add_fence_job(storage, [this, idx, n = std::move(name)
+				, st = m_torrents[storage], id = m_storage_ids[storage]
+				, h = std::move(handler)] () mutable
+			{
+				m_file_pool.release(id);
+				storage_error error;
+				st->rename_file(idx, n, error);
+				post(m_ios, [idx, error, s = std::move(st), h = std::move(h), n = std::move(n)] () mutable
+					{ h(std::move(n), idx, error); });
+			});
+		}
+
+		void async_stop_torrent(storage_index_t const storage
+			, std::function<void()> handler) override
+		{
+			async_release_files(storage, std::move(handler));
+		}
+
+		void async_set_file_priority(storage_index_t const storage
+			, aux::vector<download_priority_t, file_index_t> prio
+			, std::function<void(storage_error const&
+				, aux::vector<download_priority_t, file_index_t>)> handler) override
+		{
+			add_fence_job(storage, [this, p = std::move(prio)
+				, st = m_torrents[storage], id = m_storage_ids[storage]
+				, h = std::move(handler)] () mutable
+			{
+				// files may move in or out of the part file
+				m_file_pool.release(id);
+				storage_error error;
+				st->set_file_priority(m_settings, p, error);
+				post(m_ios, [p = std::move(p), s = std::move(st), h = std::move(h), error] () mutable
+					{ h(error, std::move(p)); });
+			});
+		}
+
+		void async_clear_piece(storage_index_t const storage, piece_index_t const index
+			, std::function<void(piece_index_t)> handler) override
+		{
+			add_fence_job(storage, [this, index, h = std::move(handler)] () mutable
+			{
+				post(m_ios, [index, h = std::move(h)]{ h(index); });
+			});
+		}
+
+		void update_stats_counters(counters& c) const override
+		{
+			std::unique_lock<std::mutex> l(m_mutex);
+			c.set_value(counters::queued_disk_jobs, m_num_jobs);
+			l.unlock();
+
+			c.set_value(counters::disk_blocks_in_use, m_buffer_pool.in_use());
+		}
+
+		std::vector<open_file_state> get_status(storage_index_t) const override
+		{ return {}; }
+
+		// this is where the batching happens. All file operations queued up
+		// by async_read() and async_write() since the last call are handed to
+		// the kernel with a single system call
+		void submit_jobs() override
+		{
+			std::lock_guard<std::mutex> l(m_submit_mutex);
+			error_code ec;
+			m_ring->submit(ec);
+			// if the submit failed, the entries are still in the submission
+			// queue, and will be submitted by the next call
+		}
+
+	private:
+
+		// issues the read or write right away, unless a fence job is pending
+		// against its storage
+		void add_io_job(std::unique_ptr<uring_job> j)
+		{
+			std::unique_lock<std::mutex> l(m_mutex);
+			++m_num_jobs;
+			storage_queue& q = *m_queues[j->storage_index];
+			if (q.fence_running || !q.deferred.empty())
+			{
+				q.deferred.push_back({std::move(j), {}, piece_index_t{0}, false});
+				return;
+			}
+			count_io(q, *j);
+			l.unlock();
+			start_io(std::move(j));
+		}
+
+		// runs ``f`` on a helper thread once the writes to ``piece`` posted
+		// before it have completed. Unlike fence jobs, this doesn't hold up
+		// any other operation
+		void add_hash_job(storage_index_t const storage, piece_index_t const piece
+			, std::function<void()> f)
+		{
+			std::vector<std::unique_ptr<uring_job>> ready;
+			{
+				std::lock_guard<std::mutex> l(m_mutex);
+				++m_num_jobs;
+				storage_queue& q = *m_queues[storage];
+				q.deferred.push_back({{}, std::move(f), piece, false});
+				dispatch_deferred(storage, ready);
+			}
+			start_ready(std::move(ready));
+		}
+
+		// runs ``f`` on a helper thread once all jobs posted against
+		// ``storage`` before it have completed. Jobs posted after it are held
+		// back until it returns
+		void add_fence_job(storage_index_t const storage, std::function<void()> f)
+		{
+			std::vector<std::unique_ptr<uring_job>> ready;
+			{
+				std::lock_guard<std::mutex> l(m_mutex);
+				++m_num_jobs;
+				storage_queue& q = *m_queues[storage];
+				q.deferred.push_back({{}, std::move(f), piece_index_t{0}, true});
+				dispatch_deferred(storage, ready);
+			}
+			start_ready(std::move(ready));
+		}
+
+		// m_mutex must be held
+		static void count_io(storage_queue& q, uring_job const& j)
+		{
+			++q.outstanding;
+			if (j.write) ++q.piece_writes[j.piece];
+		}
+
+		// m_mutex must be held
+		void start_hash(storage_queue& q, storage_index_t const storage
+			, piece_index_t const piece, std::function<void()> f)
+		{
+			++q.outstanding;
+			if (q.piece_writes.count(piece) > 0)
+			{
+				q.waiting_hashes.emplace(piece, std::move(f));
+				return;
+			}
+			m_helper_jobs.push_back({std::move(f), storage, helper_kind::hash});
+			m_helper_cond.notify_one();
+		}
+
+		// m_mutex must be held. Starts the queued up jobs of the storage until
+		// reaching a fence job that has to wait for the operations in flight.
+		// The reads and writes to start are returned in ``ready``, to be
+		// started once the mutex is released
+		void dispatch_deferred(storage_index_t const storage
+			, std::vector<std::unique_ptr<uring_job>>& ready)
+		{
+			storage_queue& q = *m_queues[storage];
+			while (!q.deferred.empty() && !q.fence_running)
+			{
+				deferred_job& d = q.deferred.front();
+				if (d.io)
+				{
+					count_io(q, *d.io);
+					ready.push_back(std::move(d.io));
+				}
+				else if (!d.fence)
+				{
+					start_hash(q, storage, d.piece, std::move(d.fun));
+				}
+				else
+				{
+					if (q.outstanding > 0) break;
+					q.fence_running = true;
+					m_helper_jobs.push_back({std::move(d.fun), storage, helper_kind::fence});
+					m_helper_cond.notify_one();
+				}
+				q.deferred.pop_front();
+			}
+		}
+
+		void start_ready(std::vector<std::unique_ptr<uring_job>> ready)
+		{
+			if (ready.empty()) return;
+			for (auto& j : ready) start_io(std::move(j));
+
+			// this isn't called from the network thread, so there won't be a
+			// call to submit_jobs() to flush these
+			submit_jobs();
+		}
+
+		// called once a read, write or hash job has completed and its handler
+		// has been posted
+		void io_done(storage_index_t const storage, piece_index_t const piece
+			, bool const write)
+		{
+			std::vector<std::unique_ptr<uring_job>> ready;
+			{
+				std::lock_guard<std::mutex> l(m_mutex);
+				storage_queue& q = *m_queues[storage];
+				TORRENT_ASSERT(q.outstanding > 0);
+				--q.outstanding;
+				--m_num_jobs;
+				if (write)
+				{
+					auto const i = q.piece_writes.find(piece);
+					TORRENT_ASSERT(i != q.piece_writes.end());
+					if (--i->second == 0)
+					{
+						q.piece_writes.erase(i);
+
+						// the hash jobs of this piece may run now
+						auto const hashes = q.waiting_hashes.equal_range(piece);
+						for (auto h = hashes.first; h != hashes.second; ++h)
+						{
+							m_helper_jobs.push_back({std::move(h->second), storage, helper_kind::hash});
+							m_helper_cond.notify_one();
+						}
+						q.waiting_hashes.erase(hashes.first, hashes.second);
+					}
+				}
+				if (q.outstanding == 0) dispatch_deferred(storage, ready);
+			}
+			m_cond.notify_all();
+			start_ready(std::move(ready));
+		}
+
+		void fence_done(storage_index_t const storage)
+		{
+			std::vector<std::unique_ptr<uring_job>> ready;
+			{
+				std::lock_guard<std::mutex> l(m_mutex);
+				storage_queue& q = *m_queues[storage];
+				TORRENT_ASSERT(q.fence_running);
+				q.fence_running = false;
+				--m_num_jobs;
+				dispatch_deferred(storage, ready);
+			}
+			m_cond.notify_all();
+			start_ready(std::move(ready));
+		}
+
+		enum class slices_t : std::uint8_t
+		{
+			// all slices of the job refer to open files
+			ready,
+
+			// some of the files the job touches need to be opened first
+			need_open,
+
+			// some of the data lives in the part file, or the block spans too
+			// many files. It has to be read or written by read() and write()
+			sync,
+
+			// the job failed, the error is in uring_job::error
+			failed
+		};
+
+		// this may be called on the network thread, so it must not block. Any
+		// operation that might (opening files, or reading and writing the
+		// part file) is handed to a helper thread
+		void start_io(std::unique_ptr<uring_job> j)
+		{
+			switch (prepare_slices(*j, false))
+			{
+				case slices_t::ready: issue(std::move(j)); return;
+				case slices_t::failed: complete_job(j.release()); return;
+				case slices_t::need_open:
+				case slices_t::sync: break;
+			}
+
+			uring_job* const job = j.release();
+			{
+				std::lock_guard<std::mutex> l(m_mutex);
+				m_helper_jobs.push_back({[this, job]
+				{
+					switch (prepare_slices(*job, true))
+					{
+						case slices_t::ready:
+							issue(std::unique_ptr<uring_job>(job));
+							submit_jobs();
+							return;
+						case slices_t::failed:
+							break;
+						case slices_t::need_open:
+						case slices_t::sync:
+							if (job->write)
+								job->storage->write(m_settings, job->range, job->piece, job->offset, job->error);
+							else
+								job->storage->read(m_settings, job->range, job->piece, job->offset, job->error);
+							break;
+					}
+					complete_job(job);
+				}, job->storage_index, helper_kind::io});
+			}
+			m_helper_cond.notify_one();
+		}
+
+		// splits the range of the job into one io_slice per file it touches.
+		// Ranges overlapping pad files are handled immediately. Files that
+		// aren't in the file pool are only opened if ``open`` is set
+		slices_t prepare_slices(uring_job& j, bool const open)
+		{
+			j.slices.clear();
+			posix_storage& st = *j.storage;
+			auto const mode = j.write ? aux::open_mode::write : aux::open_mode::read_only;
+			slices_t ret = slices_t::ready;
+			aux::readwrite(st.files(), j.range, j.piece, j.offset, j.error
+				, [&](file_index_t const file_index, std::int64_t const file_offset
+					, span<char> b, storage_error& ec)
+			{
+				if (st.files().pad_file_at(file_index))
+				{
+					// pad files read as zeroes, and writes to them are dropped
+					if (!j.write) aux::read_zeroes(b);
+					return int(b.size());
+				}
+
+				if (ret != slices_t::ready) return int(b.size());
+				if (j.slices.size() == max_slices)
+				{
+					ret = slices_t::sync;
+					return int(b.size());
+				}
+
+				auto f = m_file_pool.get(j.storage_id, file_index, j.write);
+				if (!f)
+				{
+					if (!open)
+					{
+						ret = slices_t::need_open;
+						return int(b.size());
+					}
+					f = st.open_native_file(file_index, mode, ec);
+					if (ec) return -1;
+					if (!f)
+					{
+						ret = slices_t::sync;
+						return int(b.size());
+					}
+					m_file_pool.insert(j.storage_id, file_index, f, j.write);
+				}
+				if (j.write) st.native_file_written(file_index);
+
+				iovec const v{b.data(), std::size_t(b.size())};
+				j.slices.push_back({&j, file_index, std::move(f), file_offset, v});
+				return int(b.size());
+			});
+
+			if (j.error.ec) ret = slices_t::failed;
+			if (ret != slices_t::ready) j.slices.clear();
+			return ret;
+		}
+
+		// hands the slices of the job to the ring. They are not submitted to
+		// the kernel until the next call to submit_jobs(). If the completion
+		// queue can't hold them, the job is queued until enough operations
+		// complete
+		void issue(std::unique_ptr<uring_job> j)
+		{
+			int const num_slices = int(j->slices.size());
+			if (num_slices == 0)
+			{
+				// the whole range was pad files
+				complete_job(j.release());
+				return;
+			}
+
+			{
+				// the completion queue must never overflow, so make sure we
+				// never have more operations in flight than it can hold
+				std::lock_guard<std::mutex> l(m_mutex);
+				if (!m_ring_backlog.empty()
+					|| m_outstanding_ops + num_slices > int(m_ring->cq_entries()))
+				{
+					m_ring_backlog.push_back(std::move(j));
+					return;
+				}
+				m_outstanding_ops += num_slices;
+			}
+
+			uring_job* const job = j.release();
+			if (issue_slices(job)) return;
+
+			std::lock_guard<std::mutex> l(m_mutex);
+			m_outstanding_ops -= num_slices;
+			m_ring_backlog.emplace_front(job);
+		}
+
+		// from now on, the job is owned by the completion thread. Returns
+		// false if the submission queue doesn't have room for all of the
+		// job's slices, even after flushing it. Then nothing is issued, and
+		// the job should be tried again once some operation completes
+		bool issue_slices(uring_job* const job)
+		{
+			std::lock_guard<std::mutex> l(m_submit_mutex);
+			std::uint32_t const num_slices = std::uint32_t(job->slices.size());
+			if (m_ring->sq_space_left() < num_slices)
+			{
+				error_code ec;
+				m_ring->submit(ec);
+				if (m_ring->sq_space_left() < num_slices) return false;
+			}
+
+			job->outstanding = int(num_slices);
+			for (auto& s : job->slices)
+				prepare_sqe(s);
+			return true;
+		}
+
+		// m_submit_mutex must be held, and there must be room in the
+		// submission queue
+		void prepare_sqe(io_slice& s)
+		{
+			io_uring_sqe* sqe = m_ring->sqe();
+			TORRENT_ASSERT(sqe != nullptr);
+			sqe->opcode = s.job->write ? IORING_OP_WRITEV : IORING_OP_READV;
+			sqe->fd = s.file->fd;
+			sqe->off = std::uint64_t(s.file_offset);
+			sqe->addr = reinterpret_cast<std::uint64_t>(&s.buf);
+			sqe->len = 1;
+			sqe->user_data = reinterpret_cast<std::uint64_t>(&s);
+		}
+
+		// called on the completion thread, with the result of a single file
+		// operation
+		void on_slice_complete(io_slice* s, int const res)
+		{
+			uring_job* j = s->job;
+
+			if (res == -EINTR || res == -EAGAIN)
+			{
+				resubmit(*s);
+				return;
+			}
+			else if (res < 0)
+			{
+				set_error(*j, s->file_index, error_code(-res, generic_category()));
+			}
+			else if (res == 0)
+			{
+				// we hit end-of-file
+				set_error(*j, s->file_index, errors::file_too_short);
+			}
+			else if (std::size_t(res) < s->buf.iov_len)
+			{
+				// short read or write. Issue another operation for the remainder
+				s->buf.iov_base = static_cast<char*>(s->buf.iov_base) + res;
+				s->buf.iov_len -= std::size_t(res);
+				s->file_offset += res;
+				resubmit(*s);
+				return;
+			}
+
+			if (j->outstanding.fetch_sub(1) > 1) return;
+
+			// the job's slots in the completion queue are free now, issue the
+			// jobs that were waiting for room
+			std::vector<uring_job*> backlog;
+			{
+				std::lock_guard<std::mutex> l(m_mutex);
+				m_outstanding_ops -= int(j->slices.size());
+				while (!m_ring_backlog.empty())
+				{
+					int const n = int(m_ring_backlog.front()->slices.size());
+					if (m_outstanding_ops + n > int(m_ring->cq_entries())) break;
+					m_outstanding_ops += n;
+					backlog.push_back(m_ring_backlog.front().release());
+					m_ring_backlog.pop_front();
+				}
+			}
+			for (std::size_t i = 0; i < backlog.size(); ++i)
+			{
+				if (issue_slices(backlog[i])) continue;
+
+				// the submission queue is full. Put the remaining jobs back, in
+				// order
+				std::lock_guard<std::mutex> l(m_mutex);
+				for (std::size_t k = backlog.size(); k > i; --k)
+				{
+					m_outstanding_ops -= int(backlog[k - 1]->slices.size());
+					m_ring_backlog.emplace_front(backlog[k - 1]);
+				}
+				break;
+			}
+			if (!backlog.empty()) submit_jobs();
+
+			complete_job(j);
+		}
+
+		// issues another operation for the rest of the slice. Its slot in the
+		// completion queue is still reserved, but if the submission queue is
+		// full, it has to wait until the completion thread has reaped some
+		// more operations
+		void resubmit(io_slice& s)
+		{
+			std::lock_guard<std::mutex> l(m_submit_mutex);
+			error_code ec;
+			if (m_ring->sq_space_left() == 0) m_ring->submit(ec);
+			if (m_ring->sq_space_left() == 0)
+			{
+				m_slice_backlog.push_back(&s);
+				return;
+			}
+			prepare_sqe(s);
+			m_ring->submit(ec);
+		}
+
+		// called on the completion thread after reaping completions
+		void issue_slice_backlog()
+		{
+			std::lock_guard<std::mutex> l(m_submit_mutex);
+			if (m_slice_backlog.empty()) return;
+			while (!m_slice_backlog.empty() && m_ring->sq_space_left() > 0)
+			{
+				prepare_sqe(*m_slice_backlog.front());
+				m_slice_backlog.pop_front();
+			}
+			error_code ec;
+			m_ring->submit(ec);
+		}
+
+		// slices of the same job may fail on different threads
+		void set_error(uring_job& j, file_index_t const file, error_code const& ec)
+		{
+			std::lock_guard<std::mutex> l(m_mutex);
+			if (j.error.ec) return;
+			j.error.ec = ec;
+			j.error.file(file);
+			j.error.operation = j.write ? operation_t::file_write : operation_t::file_read;
+		}
+
+		// posts the handler of the job back to the network thread, and frees
+		// it. The reference to the storage is released on the network thread
+		// too, since it may be the last one keeping the torrent alive. This
+		// may be called from any thread
+		void complete_job(uring_job* job)
+		{
+			std::unique_ptr<uring_job> j(job);
+			storage_index_t const storage = j->storage_index;
+
+			if (!j->error.ec)
+			{
+				std::int64_t const elapsed = total_microseconds(clock_type::now() - j->start_time);
+				if (j->write)
+				{
+					m_stats_counters.inc_stats_counter(counters::num_blocks_written);
+					m_stats_counters.inc_stats_counter(counters::num_write_ops);
+					m_stats_counters.inc_stats_counter(counters::disk_write_time, elapsed);
+				}
+				else
+				{
+					m_stats_counters.inc_stats_counter(counters::num_blocks_read);
+					m_stats_counters.inc_stats_counter(counters::num_read_ops);
+					m_stats_counters.inc_stats_counter(counters::disk_read_time, elapsed);
+				}
+				m_stats_counters.inc_stats_counter(counters::disk_job_time, elapsed);
+			}
+
+			if (j->write)
+			{
+				if (j->in_store_buffer)
+					m_store_buffer.erase({storage, j->piece, j->offset});
+				post(m_ios, [h = std::move(j->write_handler), error = j->error
+					, s = std::move(j->storage)]
+					{ h(error); });
+			}
+			else
+			{
+				post(m_ios, [h = std::move(j->read_handler), b = std::move(j->buffer)
+					, error = j->error, s = std::move(j->storage)] () mutable
+					{ h(std::move(b), error); });
+			}
+
+			piece_index_t const piece = j->piece;
+			bool const write = j->write;
+			j.reset();
+			io_done(storage, piece, write);
+		}
+
+		void thread_fun()
+		{
+			set_thread_name("libtorrent-uring-thread");
+
+			for (;;)
+			{
+				error_code ec;
+				m_ring->wait(ec);
+				TORRENT_ASSERT(!ec);
+				if (ec) return;
+
+				bool stop = false;
+				m_ring->reap([&](std::uint64_t const user_data, int const res)
+				{
+					if (user_data == shutdown_tag)
+					{
+						stop = true;
+						return;
+					}
+					on_slice_complete(reinterpret_cast<io_slice*>(user_data), res);
+				});
+				if (stop) return;
+				issue_slice_backlog();
+			}
+		}
+
+		void helper_thread_fun()
+		{
+			set_thread_name("libtorrent-uring-helper");
+
+			for (;;)
+			{
+				std::unique_lock<std::mutex> l(m_mutex);
+				m_helper_cond.wait(l, [&] { return m_stop_helpers || !m_helper_jobs.empty(); });
+				if (m_helper_jobs.empty()) return;
+				helper_job j = std::move(m_helper_jobs.front());
+				m_helper_jobs.pop_front();
+				l.unlock();
+
+				j.fun();
+				// release whatever the job captured before letting the next
+				// job against this storage run
+				j.fun = nullptr;
+				if (j.kind == helper_kind::fence) fence_done(j.storage);
+				else if (j.kind == helper_kind::hash) io_done(j.storage, piece_index_t{0}, false);
+			}
+		}
+
+		aux::vector<std::shared_ptr<posix_storage>, storage_index_t> m_torrents;
+
+		// the IDs of the storages in m_torrents, to identify their files in
+		// m_file_pool. Unlike storage indices, these are never reused
+		aux::vector<std::uint64_t, storage_index_t> m_storage_ids;
+		std::uint64_t m_last_storage_id = 0;
+
+		native_file_pool m_file_pool;
+
+		// slots that are unused in the m_torrents vector
+		aux::storage_free_list m_free_slots;
+
+		settings_interface const& m_settings;
+
+		// disk cache
+		aux::disk_buffer_pool m_buffer_pool;
+
+		// every write job is inserted into this map while it is in flight. It
+		// is removed when the write completes. This lets reads of a block
+		// that's being written be satisfied from its buffer
+		aux::store_buffer m_store_buffer;
+
+		counters& m_stats_counters;
+
+		// callbacks are posted on this
+		io_context& m_ios;
+
+		std::unique_ptr<aux::io_uring> m_ring;
+
+		// serializes the submission side of m_ring. The completion side is
+		// only used by m_completion_thread
+		std::mutex m_submit_mutex;
+
+		// protects m_queues, m_num_jobs, m_outstanding_ops, m_ring_backlog,
+		// m_helper_jobs and the error of jobs in flight
+		mutable std::mutex m_mutex;
+
+		// signalled every time a job completes
+		std::condition_variable m_cond;
+
+		// the jobs in flight and the jobs queued up behind fence jobs, per
+		// storage
+		aux::vector<std::unique_ptr<storage_queue>, storage_index_t> m_queues;
+
+		// the total number of jobs posted and not yet completed
+		int m_num_jobs = 0;
+
+		// the total number of file operations in flight
+		int m_outstanding_ops = 0;
+
+		// jobs waiting for room in the completion queue, or in the submission
+		// queue
+		std::deque<std::unique_ptr<uring_job>> m_ring_backlog;
+
+		// slices of jobs in flight waiting for room in the submission queue,
+		// to issue another operation. Protected by m_submit_mutex
+		std::deque<io_slice*> m_slice_backlog;
+
+		// fence jobs, hash jobs and the reads and writes that can't be issued
+		// to the ring directly
+		std::deque<helper_job> m_helper_jobs;
+		std::condition_variable m_helper_cond;
+		bool m_stop_helpers = false;
+
+		std::thread m_completion_thread;
+		std::vector<std::thread> m_helper_threads;
+
+		bool m_abort = false;
+	};
+
+#endif // TORRENT_HAVE_IO_URING
+
+	TORRENT_EXPORT std::unique_ptr<disk_interface> io_uring_disk_io_constructor(
+		io_context& ios, settings_interface const& sett, counters& cnt)
+	{
+#if TORRENT_HAVE_IO_URING
+		error_code ec;
+		auto ring = std::make_unique<aux::io_uring>(queue_depth, ec);
+		if (!ec)
+			return std::make_unique<io_uring_disk_io>(ios, sett, cnt, std::move(ring));
+		// the kernel doesn't support io_uring, or it has been disabled (e.g.
+		// by seccomp or the kernel.io_uring_disabled sysctl)
+#endif
+		return posix_disk_io_constructor(ios, sett, cnt);
+	}
+}
@@ -0,0 +1,145 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/aux_/listen_shard.hpp"
+
+#if TORRENT_HAS_REUSEPORT
+
+#include "libtorrent/assert.hpp"
+#include "libtorrent/aux_/bind_to_device.hpp"
+#include "libtorrent/aux_/ip_helpers.hpp"
+#include "libtorrent/time.hpp"
+
+#include "libtorrent/aux_/disable_warnings_push.hpp"
+#include <boost/asio/ip/v6_only.hpp>
+#include "libtorrent/aux_/disable_warnings_pop.hpp"
+
+namespace libtorrent {
+namespace aux {
+
+	listen_shard::listen_shard(io_context& ios, accept_handler handler)
+		: m_ios(ios)
+		, m_handler(std::move(handler))
+		, m_acceptor(m_shard_ios)
+		, m_retry_timer(m_shard_ios)
+		, m_peer(ios)
+	{}
+
+	listen_shard::~listen_shard()
+	{
+		close();
+	}
+
+	void listen_shard::open(tcp::endpoint const& ep, std::string const& device
+		, int const backlog, error_code& ec)
+	{
+		TORRENT_ASSERT(!m_thread.joinable());
+		m_acceptor.open(ep.protocol(), ec);
+		if (ec) return;
+
+		// these must match the listen socket's options for the bind to succeed
+		m_acceptor.set_option(tcp::acceptor::reuse_address(true), ec);
+		if (ec) return;
+		m_acceptor.set_option(reuse_port(true), ec);
+		if (ec) return;
+		if (is_v6(ep))
+		{
+			m_acceptor.set_option(boost::asio::ip::v6_only(true), ec);
+			if (ec) return;
+		}
+
+#if TORRENT_HAS_BINDTODEVICE
+		if (!device.empty())
+		{
+			bind_device(m_acceptor, device.c_str(), ec);
+			if (ec) return;
+		}
+#else
+		TORRENT_UNUSED(device);
+#endif
+
+		m_acceptor.bind(ep, ec);
+		if (ec) return;
+		m_acceptor.listen(backlog, ec);
+		if (ec) return;
+
+		async_accept();
+		m_thread = std::thread([this] { m_shard_ios.run(); });
+	}
+
+	void listen_shard::close()
+	{
+		if (!m_thread.joinable()) return;
+
+		// the acceptor may only be used by its own thread
+		post(m_shard_ios, [this]
+		{
+			error_code ignore;
+			m_acceptor.close(ignore);
+			m_retry_timer.cancel();
+		});
+		m_thread.join();
+	}
+
+	void listen_shard::async_accept()
+	{
+		m_acceptor.async_accept(m_peer, [this](error_code const& ec)
+		{
+			if (ec == boost::asio::error::operation_aborted
+				|| !m_acceptor.is_open())
+				return;
+
+			post(m_ios, [h = m_handler, ec, s = std::move(m_peer)]() mutable
+				{ h(ec, std::move(s)); });
+			m_peer = true_tcp_socket(m_ios);
+
+			if (!ec)
+			{
+				async_accept();
+				return;
+			}
+
+			// errors like running out of file descriptors would just fail
+			// again right away. Give the network thread a chance to free some
+			// up before trying again
+			m_retry_timer.expires_after(milliseconds(500));
+			m_retry_timer.async_wait([this](error_code const& err)
+			{
+				if (err || !m_acceptor.is_open()) return;
+				async_accept();
+			});
+		});
+	}
+}
+}
+
+#endif // TORRENT_HAS_REUSEPORT
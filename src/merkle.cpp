@@ -34,8 +34,13 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "libtorrent/aux_/merkle.hpp"
 #include "libtorrent/aux_/vector.hpp"
+#include "libtorrent/aux_/hash_batch.hpp"
 #include "libtorrent/bitfield.hpp"
 
+#include <array>
+#include <atomic>
+#include <thread>
+
 namespace libtorrent {
 
 	int merkle_layer_start(int const layer)
@@ -135,20 +140,86 @@ namespace libtorrent {
 		int level_size = num_leafs;
 		while (level_size > 1)
 		{
-			int parent = merkle_get_parent(level_start);
-			for (int i = level_start; i < level_start + level_size; i += 2, ++parent)
-			{
-				hasher256 h;
-				h.update(tree[i]);
-				h.update(tree[i + 1]);
-				tree[parent] = h.final();
-			}
-			level_start = merkle_get_parent(level_start);
+			int const parent = merkle_get_parent(level_start);
+			merkle_hash_layer(tree.subspan(level_start, level_size)
+				, tree.subspan(parent, level_size / 2));
+			level_start = parent;
 			level_size /= 2;
 		}
 		TORRENT_ASSERT(level_size == 1);
 	}
 
+	void merkle_fill_tree_parallel(span<sha256_hash> tree, int const num_leafs
+		, int const num_threads)
+	{
+		TORRENT_ASSERT(num_leafs >= 1);
+		TORRENT_ASSERT(((num_leafs - 1) & num_leafs) == 0);
+
+		// below this size, starting a thread costs more than it saves
+		int const min_subtree_leafs = 1 << 12;
+
+		// split the tree into more subtrees than there are threads, to
+		// balance the load if some threads are slower than others
+		int subtrees = 1;
+		while (subtrees < num_threads * 4 && num_leafs / (subtrees * 2) >= min_subtree_leafs)
+			subtrees *= 2;
+
+		int const first_leaf = merkle_first_leaf(num_leafs);
+		if (num_threads <= 1 || subtrees == 1)
+		{
+			merkle_fill_tree(tree, num_leafs, first_leaf);
+			return;
+		}
+
+		int const subtree_leafs = num_leafs / subtrees;
+		std::atomic<int> next_subtree{0};
+		auto worker = [&]
+		{
+			for (int i = next_subtree++; i < subtrees; i = next_subtree++)
+				merkle_fill_tree(tree, subtree_leafs, first_leaf + i * subtree_leafs);
+		};
+
+		std::vector<std::thread> threads;
+		threads.reserve(std::size_t(num_threads - 1));
+		try
+		{
+			for (int i = 1; i < std::min(num_threads, subtrees); ++i)
+				threads.emplace_back(worker);
+		}
+		catch (std::system_error const&)
+		{
+			// if we fail to start a thread, make do with the ones we have
+		}
+		worker();
+		for (auto& t : threads) t.join();
+
+		// the roots of the subtrees are the leaves of the top of the tree
+		int roots_start = first_leaf;
+		for (int i = subtree_leafs; i > 1; i /= 2)
+			roots_start = merkle_get_parent(roots_start);
+		merkle_fill_tree(tree, subtrees, roots_start);
+	}
+
+	void merkle_hash_layer(span<sha256_hash const> children, span<sha256_hash> parents)
+	{
+		TORRENT_ASSERT(children.size() == parents.size() * 2);
+		static_assert(sizeof(sha256_hash) == sha256_hash::size()
+			, "merkle tree nodes are expected to be contiguous");
+
+		// the two children of a node are adjacent, so a parent is the hash of
+		// a contiguous 64 byte range
+		std::array<span<char const>, 32> pairs;
+		while (!parents.empty())
+		{
+			std::ptrdiff_t const n = std::min(std::ptrdiff_t(pairs.size()), parents.size());
+			for (std::ptrdiff_t i = 0; i < n; ++i)
+				pairs[std::size_t(i)] = { children[i * 2].data(), sha256_hash::size() * 2 };
+			aux::sha256_batch(span<span<char const> const>(pairs).first(n), parents.first(n));
+			children = children.subspan(n * 2);
+			parents = parents.subspan(n);
+		}
+	}
+
 	void merkle_fill_partial_tree(span<sha256_hash> tree)
 	{
 		int const num_nodes = aux::numeric_cast<int>(tree.size());
@@ -240,28 +311,32 @@ namespace libtorrent {
 		, int num_leafs, sha256_hash pad
 		, std::vector<sha256_hash>& scratch_space)
 	{
-		TORRENT_ASSERT(((num_leafs - 1) & num_leafs) == 0);
-
 		scratch_space.resize(std::size_t(leaves.size() + 1) / 2);
+		return merkle_root_scratch(leaves, num_leafs, pad, span<sha256_hash>(scratch_space));
+	}
+
+	sha256_hash merkle_root_scratch(span<sha256_hash const> leaves
+		, int num_leafs, sha256_hash pad
+		, span<sha256_hash> scratch_space)
+	{
+		TORRENT_ASSERT(((num_leafs - 1) & num_leafs) == 0);
+		TORRENT_ASSERT(scratch_space.size() >= (leaves.size() + 1) / 2);
 		TORRENT_ASSERT(num_leafs > 0);
 
 		if (num_leafs == 1) return leaves[0];
 
 		while (num_leafs > 1)
 		{
-			int i = 0;
-			for (; i < int(leaves.size()) / 2; ++i)
-			{
-				scratch_space[std::size_t(i)] = hasher256()
-					.update(leaves[i * 2])
-					.update(leaves[i * 2 + 1])
-					.final();
-			}
+			int i = int(leaves.size()) / 2;
+			// after the first iteration, leaves refers to the scratch space
+			// itself, which is fine, merkle_hash_layer() can step up a layer
+			// in-place
+			merkle_hash_layer(leaves.first(i * 2), scratch_space.first(i));
 			if (leaves.size() & 1)
 			{
 				// if we have an odd number of leaves, compute the boundary hash
 				// here, that spans both a payload-hash and a pad hash
-				scratch_space[std::size_t(i)] = hasher256()
+				scratch_space[i] = hasher256()
 					.update(leaves[i * 2])
 					.update(pad)
 					.final();
@@ -272,7 +347,7 @@ namespace libtorrent {
 			pad = hasher256().update(pad).update(pad).final();
 
 			// step one level up
-			leaves = span<sha256_hash const>(scratch_space.data(), i);
+			leaves = scratch_space.first(i);
 			num_leafs /= 2;
 		}
 
@@ -37,6 +37,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/numeric_cast.hpp"
 #include "libtorrent/aux_/invariant_check.hpp"
 
+#include <array>
+
 namespace libtorrent {
 namespace aux {
 
@@ -689,6 +691,11 @@ namespace {
 				auto const layer = span<sha256_hash const>(m_tree)
 					.subspan(idx, std::min(m_tree.end_index() - idx, layer_size));
 
+				// most nodes that need computing are close to the stored
+				// layer. Don't touch the heap for those
+				std::array<sha256_hash, 32> small_scratch;
+				if ((layer.size() + 1) / 2 <= int(small_scratch.size()))
+					return merkle_root_scratch(layer, layer_size, pad_hash, small_scratch);
 				return merkle_root_scratch(layer, layer_size, pad_hash, scratch_space);
 			}
 		}
@@ -44,6 +44,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/file.hpp" // for file_handle
 
 #include <cstdint>
+#include <array>
+#include <algorithm>
+#include <utility>
 
 #ifdef TORRENT_WINDOWS
 #include "libtorrent/aux_/win_util.hpp"
@@ -52,6 +55,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #if TORRENT_HAVE_MMAP
 #include <sys/mman.h> // for mmap
 #include <sys/stat.h>
+#include <unistd.h> // for sysconf
 #include <fcntl.h> // for open
 
 #include "libtorrent/aux_/disable_warnings_push.hpp"
@@ -327,6 +331,68 @@ void file_mapping::page_out(span<byte const> range)
 #endif // MAP_VIEW_OF_FILE
 }
 
+namespace {
+
+#if TORRENT_HAVE_MMAP
+	std::uintptr_t page_size()
+	{
+		static std::uintptr_t const size = std::uintptr_t(::sysconf(_SC_PAGESIZE));
+		return size;
+	}
+
+	// madvise() and mincore() operate on whole pages
+	std::pair<byte*, std::size_t> page_align(span<byte const> range)
+	{
+		std::uintptr_t const mask = page_size() - 1;
+		std::uintptr_t const start = reinterpret_cast<std::uintptr_t>(range.data());
+		std::uintptr_t const aligned = start & ~mask;
+		return {reinterpret_cast<byte*>(aligned)
+			, static_cast<std::size_t>(range.size()) + (start - aligned)};
+	}
+#endif
+
+}
+
+void file_mapping::will_need(span<byte const> range)
+{
+#if TORRENT_USE_MADVISE && defined MADV_WILLNEED
+	if (range.empty()) return;
+	auto const r = page_align(range);
+	// this is best-effort. ignore errors
+	::madvise(r.first, r.second, MADV_WILLNEED);
+#else
+	TORRENT_UNUSED(range);
+#endif
+}
+
+int file_mapping::resident(span<byte const> range) const
+{
+#if TORRENT_HAVE_MMAP
+	if (range.empty()) return 1;
+	auto const r = page_align(range);
+
+#ifdef TORRENT_LINUX
+	std::array<unsigned char, 64> pages;
+#else
+	std::array<char, 64> pages;
+#endif
+
+	// only look at the first 64 pages. This is used for individual blocks,
+	// which are a lot smaller
+	std::size_t const len = std::min(r.second
+		, static_cast<std::size_t>(pages.size() * page_size()));
+	if (::mincore(r.first, len, pages.data()) != 0) return -1;
+
+	std::size_t const num_pages = (len + page_size() - 1) / page_size();
+	for (std::size_t i = 0; i < num_pages; ++i)
+		if ((pages[i] & 1) == 0) return 0;
+	return 1;
+#else
+	TORRENT_UNUSED(range);
+	return -1;
+#endif
+}
+
 } // aux
 } // libtorrent
 
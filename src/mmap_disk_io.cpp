@@ -53,7 +53,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/hasher.hpp"
 #include "libtorrent/platform_util.hpp"
 #include "libtorrent/aux_/disk_job_pool.hpp"
-#include "libtorrent/aux_/disk_io_thread_pool.hpp"
+#include "libtorrent/aux_/disk_job_dispatcher.hpp"
 #include "libtorrent/aux_/store_buffer.hpp"
 #include "libtorrent/aux_/time.hpp"
 #include "libtorrent/aux_/alloca.hpp"
@@ -64,6 +64,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/file_view_pool.hpp"
 #include "libtorrent/aux_/scope_end.hpp"
 #include "libtorrent/aux_/storage_free_list.hpp"
+#include "libtorrent/aux_/hash_batch.hpp"
+#include "libtorrent/bitfield.hpp"
 
 #ifdef TORRENT_WINDOWS
 #include "signal_error_code.hpp"
@@ -76,7 +78,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #endif
 
 #include <functional>
+#include <algorithm>
 #include <condition_variable>
+#include <limits>
 
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 #include <boost/variant/get.hpp>
@@ -146,6 +150,15 @@ namespace {
 		return ret;
 	}
 
+	// v1 hash jobs can be hashed together with other pieces, with
+	// aux::sha1_batch()
+	bool batchable_hash(aux::mmap_disk_job const* j)
+	{
+		return j->action == aux::job_action_t::hash
+			&& (j->flags & disk_interface::v1_hash)
+			&& j->d.h.block_hashes.empty();
+	}
+
 #if TORRENT_USE_ASSERTS
 	bool valid_flags(disk_job_flags_t const flags)
 	{
@@ -153,7 +166,10 @@ namespace {
 				| disk_interface::sequential_access
 				| disk_interface::volatile_read
 				| disk_interface::v1_hash
-				| disk_interface::flush_piece))
+				| disk_interface::flush_piece
+				| disk_interface::zero_copy
+				| disk_interface::read_ahead
+				| disk_interface::read_ahead_next_piece))
 			== disk_job_flags_t{};
 	}
 #endif
@@ -165,6 +181,7 @@ using jobqueue_t = tailqueue<aux::mmap_disk_job>;
 // of disk io jobs
 struct TORRENT_EXTRA_EXPORT mmap_disk_io final
 	: disk_interface
+	, aux::disk_job_executor<aux::mmap_disk_job>
 {
 	mmap_disk_io(io_context& ios, settings_interface const&, counters& cnt);
 #if TORRENT_USE_ASSERTS
@@ -185,6 +202,12 @@ struct TORRENT_EXTRA_EXPORT mmap_disk_io final
 		, char const* buf, std::shared_ptr<disk_observer> o
 		, std::function<void(storage_error const&)> handler
 		, disk_job_flags_t flags = {}) override;
+	disk_buffer_holder allocate_disk_buffer(bool& exceeded
+		, std::shared_ptr<disk_observer> o) override;
+	bool async_write(storage_index_t storage, peer_request const& r
+		, disk_buffer_holder buf, std::shared_ptr<disk_observer> o
+		, std::function<void(storage_error const&)> handler
+		, disk_job_flags_t flags = {}) override;
 	void async_hash(storage_index_t storage, piece_index_t piece, span<sha256_hash> v2
 		, disk_job_flags_t flags
 		, std::function<void(piece_index_t, sha1_hash const&, storage_error const&)> handler) override;
@@ -221,6 +244,7 @@ struct TORRENT_EXTRA_EXPORT mmap_disk_io final
 
 	status_t do_partial_read(aux::mmap_disk_job* j);
 	status_t do_read(aux::mmap_disk_job* j);
+	void read_ahead(aux::mmap_disk_job* j);
 	status_t do_write(aux::mmap_disk_job* j);
 	status_t do_hash(aux::mmap_disk_job* j);
 	status_t do_hash2(aux::mmap_disk_job* j);
@@ -234,83 +258,27 @@ struct TORRENT_EXTRA_EXPORT mmap_disk_io final
 	status_t do_file_priority(aux::mmap_disk_job* j);
 	status_t do_clear_piece(aux::mmap_disk_job* j);
 
-	void call_job_handlers();
-
 private:
 
-	struct job_queue : aux::pool_thread_interface
-	{
-		explicit job_queue(mmap_disk_io& owner) : m_owner(owner) {}
-
-		void notify_all() override
-		{
-			m_job_cond.notify_all();
-		}
-
-		void thread_fun(aux::disk_io_thread_pool& pool, executor_work_guard<io_context::executor_type> work) override
-		{
-			ADD_OUTSTANDING_ASYNC("mmap_disk_io::work");
-			m_owner.thread_fun(*this, pool);
-
-			// w's dtor releases the io_context to allow the run() call to return
-			// we do this once we stop posting new callbacks to it.
-			// after the dtor has been called, the mmap_disk_io object may be destructed
-			TORRENT_UNUSED(work);
-			COMPLETE_ASYNC("mmap_disk_io::work");
-		}
-
-		mmap_disk_io& m_owner;
-
-		// used to wake up the disk IO thread when there are new
-		// jobs on the job queue (m_queued_jobs)
-		std::condition_variable m_job_cond;
-
-		// jobs queued for servicing
-		jobqueue_t m_queued_jobs;
-	};
-
-	void thread_fun(job_queue& queue, aux::disk_io_thread_pool& pool);
+	status_t do_job(aux::mmap_disk_job* j) override;
+	void thread_started() override;
 
-	// returns true if the thread should exit
-	static bool wait_for_job(job_queue& jobq, aux::disk_io_thread_pool& threads
-		, std::unique_lock<std::mutex>& l);
+	// moves all write jobs to the same piece as the (single) job in ``jobs``
+	// from the queue, up to the first fence job. They are ordered by offset.
+	// v1 hash jobs are batched with other v1 hash jobs of the same storage
+	void pop_jobs(jobqueue_t& queue, std::vector<aux::mmap_disk_job*>& jobs) override;
 
-	void add_completed_jobs(jobqueue_t jobs);
-	void add_completed_jobs_impl(jobqueue_t jobs, jobqueue_t& new_jobs);
+	// hashes the pieces of a batch of v1 hash jobs at once
+	void prepare_jobs(span<aux::mmap_disk_job*> jobs) override;
 
-	void fail_jobs_impl(storage_error const& e, jobqueue_t& src, jobqueue_t& dst);
+	// moves the jobs ``pred`` matches from the front of ``queue`` to
+	// ``jobs``, until there are ``limit`` of them
+	template <typename Pred>
+	void pop_matching_jobs(jobqueue_t& queue, std::vector<aux::mmap_disk_job*>& jobs
+		, std::size_t limit, Pred pred);
 
-	void perform_job(aux::mmap_disk_job* j, jobqueue_t& completed_jobs);
-
-	// this queues up another job to be submitted
-	void add_job(aux::mmap_disk_job* j, bool user_add = true);
-	void add_fence_job(aux::mmap_disk_job* j, bool user_add = true);
-
-	// called when a job cannot be queued. Immediate failure/abort
-	void job_fail_add(aux::mmap_disk_job* j);
-
-	void execute_job(aux::mmap_disk_job* j);
-	void immediate_execute();
-	void abort_jobs();
-	void abort_hash_jobs(storage_index_t storage);
-
-	// returns the maximum number of threads
-	// the actual number of threads may be less
-	int num_threads() const;
-	job_queue& queue_for_job(aux::mmap_disk_job* j);
-	aux::disk_io_thread_pool& pool_for_job(aux::mmap_disk_job* j);
-
-	// set to true once we start shutting down
-	std::atomic<bool> m_abort{false};
-
-	// this is a counter of how many threads are currently running.
-	// it's used to identify the last thread still running while
-	// shutting down. This last thread is responsible for cleanup
-	// must hold the job mutex to access
-	int m_num_running_threads = 0;
-
-	// std::mutex to protect the m_generic_io_jobs and m_hash_io_jobs lists
-	mutable std::mutex m_job_mutex;
+	void maintenance() override;
+	void abort_jobs() override;
 
 	// every write job is inserted into this map while it is in the job queue.
 	// It is removed after the write completes. This will let subsequent reads
@@ -339,39 +307,25 @@ private:
 	// the main thread.
 	io_context& m_ios;
 
-	// jobs that are completed are put on this queue
-	// whenever the queue size grows from 0 to 1
-	// a message is posted to the network thread, which
-	// will then drain the queue and execute the jobs'
-	// handler functions
-	std::mutex m_completed_jobs_mutex;
-	jobqueue_t m_completed_jobs;
-
 	// storages that have had write activity recently and will get ticked
 	// soon, for deferred actions (say, flushing partfile metadata)
 	std::vector<std::pair<time_point, std::weak_ptr<mmap_storage>>> m_need_tick;
 	std::mutex m_need_tick_mutex;
 
-	// this is protected by the completed_jobs_mutex. It's true whenever
-	// there's a call_job_handlers message in-flight to the network thread. We
-	// only ever keep one such message in flight at a time, and coalesce
-	// completion callbacks in m_completed jobs
-	bool m_job_completions_in_flight = false;
-
 	aux::vector<std::shared_ptr<mmap_storage>, storage_index_t> m_torrents;
 
 	// indices into m_torrents to empty slots
 	aux::storage_free_list m_free_slots;
 
-	std::atomic_flag m_jobs_aborted = ATOMIC_FLAG_INIT;
+	// we call close_oldest_file on the file_pool regularly. This is the next
+	// time we should call it. Only used by the first generic disk thread
+	time_point m_next_close_oldest_file = min_time();
 
-	// most jobs are posted to m_generic_io_jobs
-	// but hash jobs are posted to m_hash_io_jobs if m_hash_threads
-	// has a non-zero maximum thread count
-	job_queue m_generic_io_jobs;
-	aux::disk_io_thread_pool m_generic_threads;
-	job_queue m_hash_io_jobs;
-	aux::disk_io_thread_pool m_hash_threads;
+#if TORRENT_HAVE_MAP_VIEW_OF_FILE
+	time_point m_next_flush_file = min_time();
+#endif
+
+	aux::basic_disk_job_dispatcher<aux::mmap_disk_job> m_dispatcher;
 
 #if TORRENT_USE_ASSERTS
 	int m_magic = 0x1337;
@@ -392,10 +346,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		, m_buffer_pool(ios)
 		, m_stats_counters(cnt)
 		, m_ios(ios)
-		, m_generic_io_jobs(*this)
-		, m_generic_threads(m_generic_io_jobs, ios)
-		, m_hash_io_jobs(*this)
-		, m_hash_threads(m_hash_io_jobs, ios)
+		, m_dispatcher(ios, cnt, m_store_buffer, m_job_pool, *this)
 	{
 		settings_updated();
 	}
@@ -435,64 +386,20 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		m_magic = 0xdead;
 
 		// abort should have been triggered
-		TORRENT_ASSERT(m_abort);
+		TORRENT_ASSERT(m_dispatcher.aborted());
 
 		// there are not supposed to be any writes in-flight by now
 		TORRENT_ASSERT(m_store_buffer.size() == 0);
 
 		// all torrents are supposed to have been removed by now
 		TORRENT_ASSERT(m_torrents.size() == m_free_slots.size());
-		TORRENT_ASSERT(m_generic_threads.num_threads() == 0);
-		TORRENT_ASSERT(m_hash_threads.num_threads() == 0);
-		if (!m_generic_io_jobs.m_queued_jobs.empty())
-		{
-			for (auto i = m_generic_io_jobs.m_queued_jobs.iterate(); i.get(); i.next())
-				std::printf("generic job: %d\n", int(i.get()->action));
-		}
-		if (!m_hash_io_jobs.m_queued_jobs.empty())
-		{
-			for (auto i = m_hash_io_jobs.m_queued_jobs.iterate(); i.get(); i.next())
-				std::printf("hash job: %d\n", int(i.get()->action));
-		}
-		TORRENT_ASSERT(m_generic_io_jobs.m_queued_jobs.empty());
-		TORRENT_ASSERT(m_hash_io_jobs.m_queued_jobs.empty());
 	}
 #endif
 
 	void mmap_disk_io::abort(bool const wait)
 	{
 		DLOG("mmap_disk_io::abort: (wait: %d)\n", int(wait));
-
-		// first make sure queued jobs have been submitted
-		// otherwise the queue may not get processed
-		submit_jobs();
-
-		// abuse the job mutex to make setting m_abort and checking the thread count atomic
-		// see also the comment in thread_fun
-		std::unique_lock<std::mutex> l(m_job_mutex);
-		if (m_abort.exchange(true)) return;
-		bool const no_threads = m_generic_threads.num_threads() == 0
-			&& m_hash_threads.num_threads() == 0;
-		// abort outstanding jobs belonging to this torrent
-
-		DLOG("aborting hash jobs\n");
-		for (auto i = m_hash_io_jobs.m_queued_jobs.iterate(); i.get(); i.next())
-			i.get()->flags |= aux::mmap_disk_job::aborted;
-		l.unlock();
-
-		// if there are no disk threads, we can't wait for the jobs here, because
-		// we'd stall indefinitely
-		if (no_threads)
-		{
-			abort_jobs();
-		}
-
-		DLOG("aborting thread pools\n");
-		// even if there are no threads it doesn't hurt to abort the pools
-		// it prevents threads from being started after an abort which is a good
-		// defensive programming measure
-		m_generic_threads.abort(wait);
-		m_hash_threads.abort(wait);
+		m_dispatcher.abort(wait);
 	}
 
 	void mmap_disk_io::settings_updated()
@@ -505,25 +412,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		int const num_hash_threads = m_settings.get_int(settings_pack::hashing_threads);
 		DLOG("set max threads(%d, %d)\n", num_threads, num_hash_threads);
 
-		m_generic_threads.set_max_threads(num_threads);
-		m_hash_threads.set_max_threads(num_hash_threads);
-	}
-
-	void mmap_disk_io::fail_jobs_impl(storage_error const& e, jobqueue_t& src, jobqueue_t& dst)
-	{
-		while (!src.empty())
-		{
-			aux::mmap_disk_job* j = src.pop_front();
-			TORRENT_ASSERT((j->flags & aux::mmap_disk_job::in_progress) || !j->storage);
-
-			if (j->action == aux::job_action_t::write)
-			{
-				m_store_buffer.erase({j->storage->storage_index(), j->piece, j->d.io.offset});
-			}
-			j->ret = status_t::fatal_disk_error;
-			j->error = e;
-			dst.push_back(j);
-		}
+		m_dispatcher.set_max_threads(num_threads, num_hash_threads);
 	}
 
 	namespace {
@@ -550,66 +439,21 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 
 	} // anonymous namespace
 
-	void mmap_disk_io::perform_job(aux::mmap_disk_job* j, jobqueue_t& completed_jobs)
+	status_t mmap_disk_io::do_job(aux::mmap_disk_job* j)
 	{
-		TORRENT_ASSERT(j->next == nullptr);
-		TORRENT_ASSERT((j->flags & aux::mmap_disk_job::in_progress) || !j->storage);
-
 #if DEBUG_DISK_THREAD
-		{
-			std::unique_lock<std::mutex> l(m_job_mutex);
-
-			DLOG("perform_job job: %s ( %s%s) piece: %d offset: %d outstanding: %d\n"
-				, job_action_name[j->action]
-				, (j->flags & mmap_disk_job::fence) ? "fence ": ""
-				, (j->flags & mmap_disk_job::force_copy) ? "force_copy ": ""
-				, static_cast<int>(j->piece), j->d.io.offset
-				, j->storage ? j->storage->num_outstanding_jobs() : -1);
-		}
+		DLOG("perform_job job: %s ( %s%s) piece: %d offset: %d outstanding: %d\n"
+			, job_action_name[j->action]
+			, (j->flags & mmap_disk_job::fence) ? "fence ": ""
+			, (j->flags & mmap_disk_job::force_copy) ? "force_copy ": ""
+			, static_cast<int>(j->piece), j->d.io.offset
+			, j->storage ? j->storage->num_outstanding_jobs() : -1);
 #endif
 
-		std::shared_ptr<mmap_storage> storage = j->storage;
-
 		TORRENT_ASSERT(static_cast<int>(j->action) < int(job_functions.size()));
 
-		m_stats_counters.inc_stats_counter(counters::num_running_disk_jobs, 1);
-
-		// call disk function
-		// TODO: in the future, propagate exceptions back to the handlers
-		status_t ret = status_t::no_error;
-		try
-		{
-			int const idx = static_cast<int>(j->action);
-			ret = (this->*(job_functions[static_cast<std::size_t>(idx)]))(j);
-		}
-		catch (boost::system::system_error const& err)
-		{
-			ret = status_t::fatal_disk_error;
-			j->error.ec = err.code();
-			j->error.operation = operation_t::exception;
-		}
-		catch (std::bad_alloc const&)
-		{
-			ret = status_t::fatal_disk_error;
-			j->error.ec = errors::no_memory;
-			j->error.operation = operation_t::exception;
-		}
-		catch (std::exception const&)
-		{
-			ret = status_t::fatal_disk_error;
-			j->error.ec = boost::asio::error::fault;
-			j->error.operation = operation_t::exception;
-		}
-
-		// note that -2 errors are OK
-		TORRENT_ASSERT(ret != status_t::fatal_disk_error
-			|| (j->error.ec && j->error.operation != operation_t::unknown));
-
-		m_stats_counters.inc_stats_counter(counters::num_running_disk_jobs, -1);
-
-		j->ret = ret;
-
-		completed_jobs.push_back(j);
+		int const idx = static_cast<int>(j->action);
+		return (this->*(job_functions[static_cast<std::size_t>(idx)]))(j);
 	}
 
 	status_t mmap_disk_io::do_partial_read(aux::mmap_disk_job* j)
@@ -642,6 +486,29 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 
 	status_t mmap_disk_io::do_read(aux::mmap_disk_job* j)
 	{
+		if (m_settings.get_bool(settings_pack::piece_read_ahead))
+			read_ahead(j);
+
+		if (j->flags & disk_interface::zero_copy)
+		{
+			time_point const start_time = clock_type::now();
+			disk_buffer_holder view = j->storage->read_view(m_settings, j->piece
+				, j->d.io.offset, j->d.io.buffer_size, file_mode_for_job(j), j->error);
+			if (j->error) return status_t::no_error;
+			if (view)
+			{
+				std::int64_t const read_time = total_microseconds(clock_type::now() - start_time);
+				j->argument = std::move(view);
+
+				m_stats_counters.inc_stats_counter(counters::num_blocks_read);
+				m_stats_counters.inc_stats_counter(counters::num_zero_copy_reads);
+				m_stats_counters.inc_stats_counter(counters::disk_read_time, read_time);
+				m_stats_counters.inc_stats_counter(counters::disk_job_time, read_time);
+				return status_t::no_error;
+			}
+			// this block can't be referenced in place, fall back to copying it
+		}
+
 		j->argument = disk_buffer_holder(m_buffer_pool, m_buffer_pool.allocate_buffer("send buffer"), default_block_size);
 		auto& buffer = boost::get<disk_buffer_holder>(j->argument);
 		if (!buffer)
@@ -674,6 +541,42 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		return status_t::no_error;
 	}
 
+	void mmap_disk_io::read_ahead(aux::mmap_disk_job* j)
+	{
+		// this tells us whether earlier read-ahead hints paid off. Checking
+		// residency means opening the file and calling mincore(), so only do
+		// it for blocks an earlier hint covered
+		if (j->storage->read_ahead_pending(j->piece))
+		{
+			int const resident = j->storage->resident(m_settings, j->piece
+				, j->d.io.offset, j->d.io.buffer_size, file_mode_for_job(j));
+			if (resident == 1)
+				m_stats_counters.inc_stats_counter(counters::num_read_ahead_hits);
+			else if (resident == 0)
+				m_stats_counters.inc_stats_counter(counters::num_read_ahead_misses);
+		}
+
+		if (!(j->flags & disk_interface::read_ahead)) return;
+
+		// this includes the block we're about to read. If it isn't in the page
+		// cache yet, it's read as part of the same request
+		file_storage const& fs = j->storage->files();
+		int const piece_size = fs.piece_size(j->piece);
+		j->storage->prefetch(m_settings, j->piece, j->d.io.offset
+			, piece_size - j->d.io.offset, file_mode_for_job(j));
+
+		piece_index_t const next_piece = next(j->piece);
+		if ((j->flags & disk_interface::read_ahead_next_piece)
+			&& next_piece < fs.end_piece())
+		{
+			j->storage->prefetch(m_settings, next_piece, 0
+				, fs.piece_size(next_piece), file_mode_for_job(j));
+			j->storage->read_ahead_issued(next_piece);
+		}
+		j->storage->read_ahead_issued(j->piece);
+		m_stats_counters.inc_stats_counter(counters::num_read_ahead_ops);
+	}
+
 	status_t mmap_disk_io::do_write(aux::mmap_disk_job* j)
 	{
 		time_point const start_time = clock_type::now();
@@ -798,7 +701,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 				j->d.io.buffer_offset = std::uint16_t((ret == 1) ? 0 : len1);
 				j->flags = flags;
 				j->callback = std::move(handler);
-				add_job(j);
+				m_dispatcher.add_job(j);
 				return;
 			}
 
@@ -832,7 +735,15 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		j->d.io.buffer_size = std::uint16_t(r.length);
 		j->flags = flags;
 		j->callback = std::move(handler);
-		add_job(j);
+		m_dispatcher.add_job(j);
+	}
+
+	disk_buffer_holder mmap_disk_io::allocate_disk_buffer(bool& exceeded
+		, std::shared_ptr<disk_observer> o)
+	{
+		exceeded = false;
+		return disk_buffer_holder(m_buffer_pool, m_buffer_pool.allocate_buffer(
+			exceeded, std::move(o), "receive buffer"), default_block_size);
 	}
 
 	bool mmap_disk_io::async_write(storage_index_t const storage, peer_request const& r
@@ -846,6 +757,16 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		if (!buffer) aux::throw_ex<std::bad_alloc>();
 		std::memcpy(buffer.data(), buf, aux::numeric_cast<std::size_t>(r.length));
 
+		async_write(storage, r, std::move(buffer), std::move(o), std::move(handler), flags);
+		return exceeded;
+	}
+
+	bool mmap_disk_io::async_write(storage_index_t const storage, peer_request const& r
+		, disk_buffer_holder buffer, std::shared_ptr<disk_observer>
+		, std::function<void(storage_error const&)> handler
+		, disk_job_flags_t const flags)
+	{
+		TORRENT_ASSERT(buffer);
 		TORRENT_ASSERT(r.start % default_block_size == 0);
 		TORRENT_ASSERT(r.length <= default_block_size);
 		TORRENT_ASSERT(r.start + r.length <= m_torrents[storage]->files().piece_size(r.piece));
@@ -861,8 +782,9 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 
 		m_store_buffer.insert({j->storage->storage_index(), j->piece, j->d.io.offset}
 			, boost::get<disk_buffer_holder>(j->argument).data());
-		add_job(j);
-		return exceeded;
+		m_dispatcher.add_job(j);
+		// the buffer was accounted for when it was allocated
+		return false;
 	}
 
 	void mmap_disk_io::async_hash(storage_index_t const storage
@@ -876,7 +798,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		j->d.h.block_hashes = v2;
 		j->callback = std::move(handler);
 		j->flags = flags;
-		add_job(j);
+		m_dispatcher.add_job(j);
 	}
 
 	void mmap_disk_io::async_hash2(storage_index_t const storage
@@ -890,7 +812,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		j->d.io.offset = offset;
 		j->callback = std::move(handler);
 		j->flags = flags;
-		add_job(j);
+		m_dispatcher.add_job(j);
 	}
 
 	void mmap_disk_io::async_move_storage(storage_index_t const storage
@@ -903,7 +825,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		j->callback = std::move(handler);
 		j->move_flags = flags;
 
-		add_fence_job(j);
+		m_dispatcher.add_fence_job(j);
 	}
 
 	void mmap_disk_io::async_release_files(storage_index_t const storage
@@ -913,39 +835,19 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		j->storage = m_torrents[storage]->shared_from_this();
 		j->callback = std::move(handler);
 
-		add_fence_job(j);
-	}
-
-	void mmap_disk_io::abort_hash_jobs(storage_index_t const storage)
-	{
-		// abort outstanding hash jobs belonging to this torrent
-		std::unique_lock<std::mutex> l(m_job_mutex);
-
-		auto st = m_torrents[storage]->shared_from_this();
-		// hash jobs
-		for (auto i = m_hash_io_jobs.m_queued_jobs.iterate(); i.get(); i.next())
-		{
-			aux::mmap_disk_job* j = i.get();
-			if (j->storage != st) continue;
-			// only cancel volatile-read jobs. This means only full checking
-			// jobs. These jobs are likely to have a pretty deep queue and
-			// really gain from being cancelled. They can also be restarted
-			// easily.
-			if (!(j->flags & disk_interface::volatile_read)) continue;
-			j->flags |= aux::mmap_disk_job::aborted;
-		}
+		m_dispatcher.add_fence_job(j);
 	}
 
 	void mmap_disk_io::async_delete_files(storage_index_t const storage
 		, remove_flags_t const options
 		, std::function<void(storage_error const&)> handler)
 	{
-		abort_hash_jobs(storage);
+		m_dispatcher.abort_hash_jobs(m_torrents[storage]);
 		aux::mmap_disk_job* j = m_job_pool.allocate_job(aux::job_action_t::delete_files);
 		j->storage = m_torrents[storage]->shared_from_this();
 		j->callback = std::move(handler);
 		j->argument = options;
-		add_fence_job(j);
+		m_dispatcher.add_fence_job(j);
 	}
 
 	void mmap_disk_io::async_check_files(storage_index_t const storage
@@ -962,7 +864,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		if (!links.empty()) links_vector = new aux::vector<std::string, file_index_t>(std::move(links));
 		j->d.links = links_vector;
 
-		add_fence_job(j);
+		m_dispatcher.add_fence_job(j);
 	}
 
 	void mmap_disk_io::async_rename_file(storage_index_t const storage
@@ -974,19 +876,19 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		j->file_index = index;
 		j->argument = std::move(name);
 		j->callback = std::move(handler);
-		add_fence_job(j);
+		m_dispatcher.add_fence_job(j);
 	}
 
 	void mmap_disk_io::async_stop_torrent(storage_index_t const storage
 		, std::function<void()> handler)
 	{
 		auto st = m_torrents[storage]->shared_from_this();
-		abort_hash_jobs(storage);
+		m_dispatcher.abort_hash_jobs(m_torrents[storage]);
 
 		aux::mmap_disk_job* j = m_job_pool.allocate_job(aux::job_action_t::stop_torrent);
 		j->storage = st;
 		j->callback = std::move(handler);
-		add_fence_job(j);
+		m_dispatcher.add_fence_job(j);
 	}
 
 	void mmap_disk_io::async_set_file_priority(storage_index_t const storage
@@ -999,7 +901,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		j->argument = std::move(prios);
 		j->callback = std::move(handler);
 
-		add_fence_job(j);
+		m_dispatcher.add_fence_job(j);
 	}
 
 	void mmap_disk_io::async_clear_piece(storage_index_t const storage
@@ -1022,7 +924,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		// TODO: Perhaps the job queue could be traversed and all jobs for this
 		// piece could be cancelled. If there are no threads currently writing
 		// to this piece, we could skip the fence altogether
-		add_fence_job(j);
+		m_dispatcher.add_fence_job(j);
 	}
 
 	status_t mmap_disk_io::do_hash(aux::mmap_disk_job* j)
@@ -1031,6 +933,9 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		// just read straight from the file
 		TORRENT_ASSERT(m_magic == 0x1337);
 
+		// the piece was hashed by prepare_jobs()
+		if (j->hashed) return status_t::no_error;
+
 		bool const v1 = bool(j->flags & disk_interface::v1_hash);
 		bool const v2 = !j->d.h.block_hashes.empty();
 
@@ -1046,11 +951,45 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		hasher h;
 		int ret = 0;
 		int offset = 0;
-		int const blocks_to_read = std::max(blocks_in_piece, blocks_in_piece2);
 		time_point const start_time = clock_type::now();
+
+		// if none of the v2 blocks are in the store buffer, hash all of them
+		// in one go, straight from the file. This lets the blocks be hashed in
+		// parallel
+		bool v2_done = false;
+		if (v2)
+		{
+			bool in_store_buffer = false;
+			for (int i = 0; i < blocks_in_piece2 && !in_store_buffer; ++i)
+			{
+				in_store_buffer = m_store_buffer.get({ j->storage->storage_index()
+					, j->piece, i * default_block_size }, [](char const*) {});
+			}
+
+			if (!in_store_buffer)
+			{
+				// if we will call hash() in a bit, don't trigger a flush
+				// just yet, let hash() do it
+				auto const flags = v1 ? (j->flags & ~disk_interface::flush_piece) : j->flags;
+				j->error.ec.clear();
+				ret = j->storage->hash2_blocks(m_settings, j->piece
+					, j->d.h.block_hashes, file_mode, flags, j->error);
+				if (ret < 0) return status_t::fatal_disk_error;
+				if (ret > 0)
+				{
+					v2_done = true;
+					m_stats_counters.inc_stats_counter(counters::num_read_back, blocks_in_piece2);
+					m_stats_counters.inc_stats_counter(counters::num_blocks_read, blocks_in_piece2);
+					m_stats_counters.inc_stats_counter(counters::num_read_ops);
+				}
+			}
+		}
+
+		int const blocks_to_read = v2_done ? blocks_in_piece
+			: std::max(blocks_in_piece, blocks_in_piece2);
 		for (int i = 0; i < blocks_to_read; ++i)
 		{
-			bool const v2_block = i < blocks_in_piece2;
+			bool const v2_block = !v2_done && i < blocks_in_piece2;
 
 			DLOG("do_hash: reading (piece: %d block: %d)\n", int(j->piece), i);
 
@@ -1277,15 +1216,10 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 	{
 		// These are atomic_counts, so it's safe to access them from
 		// a different thread
-		std::unique_lock<std::mutex> jl(m_job_mutex);
-
 		c.set_value(counters::num_read_jobs, m_job_pool.read_jobs_in_use());
 		c.set_value(counters::num_write_jobs, m_job_pool.write_jobs_in_use());
 		c.set_value(counters::num_jobs, m_job_pool.jobs_in_use());
-		c.set_value(counters::queued_disk_jobs, m_generic_io_jobs.m_queued_jobs.size()
-			+ m_hash_io_jobs.m_queued_jobs.size());
-
-		jl.unlock();
+		c.set_value(counters::queued_disk_jobs, m_dispatcher.num_queued_jobs());
 
 		// gauges
 		c.set_value(counters::disk_blocks_in_use, m_buffer_pool.in_use());
@@ -1309,203 +1243,133 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		return status_t::no_error;
 	}
 
-	void mmap_disk_io::job_fail_add(aux::mmap_disk_job* j)
+	void mmap_disk_io::submit_jobs()
 	{
-		j->ret = status_t::fatal_disk_error;
-		j->error = storage_error(boost::asio::error::operation_aborted);
-		j->flags |= aux::mmap_disk_job::aborted;
-#if TORRENT_USE_ASSERTS
-		TORRENT_ASSERT(j->job_posted == false);
-		j->job_posted = true;
-#endif
-		std::lock_guard<std::mutex> l(m_completed_jobs_mutex);
-		m_completed_jobs.push_back(j);
-
-		if (!m_job_completions_in_flight)
-		{
-			DLOG("posting job handlers (%d)\n", m_completed_jobs.size());
-
-			post(m_ios, [this] { this->call_job_handlers(); });
-			m_job_completions_in_flight = true;
-		}
+		m_dispatcher.submit_jobs();
 	}
 
-	void mmap_disk_io::add_fence_job(aux::mmap_disk_job* j, bool const user_add)
+	template <typename Pred>
+	void mmap_disk_io::pop_matching_jobs(jobqueue_t& queue
+		, std::vector<aux::mmap_disk_job*>& jobs, std::size_t const limit, Pred pred)
 	{
-		// if this happens, it means we started to shut down
-		// the disk threads too early. We have to post all jobs
-		// before the disk threads are shut down
-		if (m_abort)
-		{
-			job_fail_add(j);
-			return;
-		}
-
-		DLOG("add_fence:job: %s (outstanding: %d)\n"
-			, job_name(j->action)
-			, j->storage->num_outstanding_jobs());
+		// only the front of the queue is scanned, to bound the time spent
+		// holding the job mutex. Jobs behind a fence must not be moved ahead
+		// of it, so the scan also stops at the first fence
+		int const max_scan = 256;
 
-		TORRENT_ASSERT(j->storage);
-		m_stats_counters.inc_stats_counter(counters::num_fenced_read + static_cast<int>(j->action));
-
-		int ret = j->storage->raise_fence(j, m_stats_counters);
-		if (ret == aux::disk_job_fence::fence_post_fence)
+		jobqueue_t skipped;
+		for (int i = 0; i < max_scan && !queue.empty() && jobs.size() < limit; ++i)
 		{
-			std::unique_lock<std::mutex> l(m_job_mutex);
-			TORRENT_ASSERT((j->flags & aux::mmap_disk_job::in_progress) || !j->storage);
-			m_generic_io_jobs.m_queued_jobs.push_back(j);
-			l.unlock();
-
-			if (num_threads() == 0 && user_add)
-				immediate_execute();
-
-			return;
+			aux::mmap_disk_job* k = queue.first();
+			if (k->flags & aux::mmap_disk_job::fence) break;
+			queue.pop_front();
+			if (pred(k))
+				jobs.push_back(k);
+			else
+				skipped.push_back(k);
 		}
-
-		if (num_threads() == 0 && user_add)
-			immediate_execute();
+		queue.prepend(std::move(skipped));
 	}
 
-	void mmap_disk_io::add_job(aux::mmap_disk_job* j, bool const user_add)
+	void mmap_disk_io::pop_jobs(jobqueue_t& queue
+		, std::vector<aux::mmap_disk_job*>& jobs)
 	{
-		TORRENT_ASSERT(m_magic == 0x1337);
+		TORRENT_ASSERT(jobs.size() == 1);
+		aux::mmap_disk_job* const j = jobs.front();
+		if (queue.empty()) return;
 
-		TORRENT_ASSERT(!j->storage || j->storage->files().is_valid());
-		TORRENT_ASSERT(j->next == nullptr);
-		// if this happens, it means we started to shut down
-		// the disk threads too early. We have to post all jobs
-		// before the disk threads are shut down
-		if (m_abort)
+		if (j->action == aux::job_action_t::write)
 		{
-			job_fail_add(j);
-			return;
-		}
+			if (!m_settings.get_bool(settings_pack::coalesce_piece_writes)) return;
 
-		TORRENT_ASSERT(!(j->flags & aux::mmap_disk_job::in_progress));
+			pop_matching_jobs(queue, jobs, std::numeric_limits<std::size_t>::max()
+				, [j](aux::mmap_disk_job const* k)
+				{
+					return k->action == aux::job_action_t::write
+						&& k->storage == j->storage
+						&& k->piece == j->piece;
+				});
 
-		DLOG("add_job: %s (outstanding: %d)\n"
-			, job_name(j->action)
-			, j->storage ? j->storage->num_outstanding_jobs() : 0);
+			m_stats_counters.inc_stats_counter(counters::num_coalesced_writes
+				, std::int64_t(jobs.size()) - 1);
 
-		// is the fence up for this storage?
-		// jobs that are instantaneous are not affected by the fence, is_blocked()
-		// will take ownership of the job and queue it up, in case the fence is up
-		// if the fence flag is set, this job just raised the fence on the storage
-		// and should be scheduled
-		if (j->storage && j->storage->is_blocked(j))
-		{
-			m_stats_counters.inc_stats_counter(counters::blocked_disk_jobs);
-			DLOG("blocked job: %s (torrent: %d total: %d)\n"
-				, job_name(j->action), j->storage ? j->storage->num_blocked() : 0
-				, int(m_stats_counters[counters::blocked_disk_jobs]));
-			return;
+			std::stable_sort(jobs.begin(), jobs.end()
+				, [](aux::mmap_disk_job const* lhs, aux::mmap_disk_job const* rhs)
+				{ return lhs->d.io.offset < rhs->d.io.offset; });
 		}
-
-		std::unique_lock<std::mutex> l(m_job_mutex);
-
-		TORRENT_ASSERT((j->flags & aux::mmap_disk_job::in_progress) || !j->storage);
-
-		job_queue& q = queue_for_job(j);
-		q.m_queued_jobs.push_back(j);
-		// if we literally have 0 disk threads, we have to execute the jobs
-		// immediately. If add job is called internally by the mmap_disk_io,
-		// we need to defer executing it. We only want the top level to loop
-		// over the job queue (as is done below)
-		if (pool_for_job(j).max_threads() == 0 && user_add)
+		else if (batchable_hash(j))
 		{
-			l.unlock();
-			immediate_execute();
+			// with a single lane, there's nothing to gain from batching, and
+			// other disk threads might as well hash the pieces in parallel
+			std::size_t const lanes = std::size_t(aux::sha1_batch_lanes());
+			if (lanes < 2) return;
+
+			disk_job_flags_t const mask = disk_interface::sequential_access
+				| disk_interface::volatile_read | disk_interface::flush_piece;
+			pop_matching_jobs(queue, jobs, lanes
+				, [j, mask](aux::mmap_disk_job const* k)
+				{
+					return batchable_hash(k)
+						&& k->storage == j->storage
+						&& (k->flags & mask) == (j->flags & mask);
+				});
 		}
 	}
 
-	void mmap_disk_io::immediate_execute()
+	void mmap_disk_io::prepare_jobs(span<aux::mmap_disk_job*> const jobs)
 	{
-		while (!m_generic_io_jobs.m_queued_jobs.empty())
-		{
-			aux::mmap_disk_job* j = m_generic_io_jobs.m_queued_jobs.pop_front();
-			execute_job(j);
-		}
-	}
+		aux::mmap_disk_job* const j = jobs.front();
+		if (!batchable_hash(j)) return;
 
-	void mmap_disk_io::submit_jobs()
-	{
-		std::unique_lock<std::mutex> l(m_job_mutex);
-		if (!m_generic_io_jobs.m_queued_jobs.empty())
-		{
-			m_generic_io_jobs.m_job_cond.notify_all();
-			m_generic_threads.job_queued(m_generic_io_jobs.m_queued_jobs.size());
-		}
-		if (!m_hash_io_jobs.m_queued_jobs.empty())
-		{
-			m_hash_io_jobs.m_job_cond.notify_all();
-			m_hash_threads.job_queued(m_hash_io_jobs.m_queued_jobs.size());
-		}
-	}
+		time_point const start_time = clock_type::now();
+		file_storage const& fs = j->storage->files();
 
-	void mmap_disk_io::execute_job(aux::mmap_disk_job* j)
-	{
-		jobqueue_t completed_jobs;
-		if (j->flags & aux::mmap_disk_job::aborted)
+		// pieces with blocks still in the store buffer are left to do_hash()
+		std::vector<aux::mmap_disk_job*> batch;
+		std::vector<piece_index_t> pieces;
+		for (aux::mmap_disk_job* k : jobs)
 		{
-			j->ret = status_t::fatal_disk_error;
-			j->error = storage_error(boost::asio::error::operation_aborted);
-			completed_jobs.push_back(j);
-			add_completed_jobs(std::move(completed_jobs));
-			return;
+			int const blocks_in_piece = (fs.piece_size(k->piece) + default_block_size - 1)
+				/ default_block_size;
+			bool in_store_buffer = false;
+			for (int i = 0; i < blocks_in_piece && !in_store_buffer; ++i)
+			{
+				in_store_buffer = m_store_buffer.get({ k->storage->storage_index()
+					, k->piece, i * default_block_size }, [](char const*) {});
+			}
+			if (in_store_buffer) continue;
+			batch.push_back(k);
+			pieces.push_back(k->piece);
 		}
+		if (pieces.size() < 2) return;
 
-		perform_job(j, completed_jobs);
-		if (!completed_jobs.empty())
-			add_completed_jobs(std::move(completed_jobs));
-	}
+		std::vector<sha1_hash> hashes(pieces.size());
+		bitfield hashed;
+		int const num_hashed = j->storage->hash_pieces(m_settings, pieces, hashes
+			, hashed, file_mode_for_job(j), j->flags);
+		if (num_hashed == 0) return;
 
-	bool mmap_disk_io::wait_for_job(job_queue& jobq, aux::disk_io_thread_pool& threads
-		, std::unique_lock<std::mutex>& l)
-	{
-		TORRENT_ASSERT(l.owns_lock());
-
-		// the thread should only go active if it is exiting or there is work to do
-		// if the thread goes active on every wakeup it causes the minimum idle thread
-		// count to be lower than it should be
-		// for performance reasons we also want to avoid going idle and active again
-		// if there is already work to do
-		if (jobq.m_queued_jobs.empty())
+		int num_blocks = 0;
+		for (int i = 0; i < int(batch.size()); ++i)
 		{
-			threads.thread_idle();
-
-			do
-			{
-				// if the number of wanted threads is decreased,
-				// we may stop this thread
-				// when we're terminating the last thread, make sure
-				// we finish up all queued jobs first
-				if (threads.should_exit()
-					&& (jobq.m_queued_jobs.empty()
-						|| threads.num_threads() > 1)
-					// try_thread_exit must be the last condition
-					&& threads.try_thread_exit(std::this_thread::get_id()))
-				{
-					// time to exit this thread.
-					threads.thread_active();
-					return true;
-				}
-
-				using namespace std::literals::chrono_literals;
-				jobq.m_job_cond.wait_for(l, 1s);
-			} while (jobq.m_queued_jobs.empty());
-
-			threads.thread_active();
+			if (!hashed.get_bit(i)) continue;
+			aux::mmap_disk_job* k = batch[std::size_t(i)];
+			k->d.h.piece_hash = hashes[std::size_t(i)];
+			k->hashed = true;
+			num_blocks += (fs.piece_size(k->piece) + default_block_size - 1)
+				/ default_block_size;
 		}
 
-		return false;
+		std::int64_t const hash_time = total_microseconds(clock_type::now() - start_time);
+		m_stats_counters.inc_stats_counter(counters::num_read_back, num_blocks);
+		m_stats_counters.inc_stats_counter(counters::num_blocks_read, num_blocks);
+		m_stats_counters.inc_stats_counter(counters::num_read_ops, num_hashed);
+		m_stats_counters.inc_stats_counter(counters::disk_hash_time, hash_time);
+		m_stats_counters.inc_stats_counter(counters::disk_job_time, hash_time);
 	}
 
-	void mmap_disk_io::thread_fun(job_queue& queue, aux::disk_io_thread_pool& pool)
+	void mmap_disk_io::thread_started()
 	{
-		std::thread::id const thread_id = std::this_thread::get_id();
-
-		set_thread_name("libtorrent-disk-thread");
-
 #ifdef _WIN32
 		using SetThreadInformation_t = BOOL (WINAPI*)(HANDLE, THREAD_INFORMATION_CLASS, LPVOID, DWORD);
 		auto SetThreadInformation =
@@ -1525,121 +1389,50 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 #endif
 
 		DLOG("started disk thread\n");
+	}
 
-		std::unique_lock<std::mutex> l(m_job_mutex);
-
-		++m_num_running_threads;
-		m_stats_counters.inc_stats_counter(counters::num_running_threads, 1);
-
-		// we call close_oldest_file on the file_pool regularly. This is the next
-		// time we should call it
-		time_point next_close_oldest_file = min_time();
-
-#if TORRENT_HAVE_MAP_VIEW_OF_FILE
-		time_point next_flush_file = min_time();
-#endif
-
-		for (;;)
+	void mmap_disk_io::maintenance()
+	{
+		time_point const now = aux::time_now();
 		{
-			aux::mmap_disk_job* j = nullptr;
-			bool const should_exit = wait_for_job(queue, pool, l);
-			if (should_exit) break;
-			j = queue.m_queued_jobs.pop_front();
-			l.unlock();
-
-			TORRENT_ASSERT((j->flags & aux::mmap_disk_job::in_progress) || !j->storage);
-
-			if (&pool == &m_generic_threads && thread_id == pool.first_thread_id())
+			std::unique_lock<std::mutex> l2(m_need_tick_mutex);
+			while (!m_need_tick.empty() && m_need_tick.front().first < now)
 			{
-				time_point const now = aux::time_now();
-				{
-					std::unique_lock<std::mutex> l2(m_need_tick_mutex);
-					while (!m_need_tick.empty() && m_need_tick.front().first < now)
-					{
-						std::shared_ptr<mmap_storage> st = m_need_tick.front().second.lock();
-						m_need_tick.erase(m_need_tick.begin());
-						if (st)
-						{
-							l2.unlock();
-							st->tick();
-							l2.lock();
-						}
-					}
-				}
-
-				if (now > next_close_oldest_file)
+				std::shared_ptr<mmap_storage> st = m_need_tick.front().second.lock();
+				m_need_tick.erase(m_need_tick.begin());
+				if (st)
 				{
-					seconds const interval(m_settings.get_int(settings_pack::close_file_interval));
-					if (interval <= seconds(0))
-					{
-						// check again in one minute, in case the setting changed
-						next_close_oldest_file = now + minutes(1);
-					}
-					else
-					{
-						next_close_oldest_file = now + interval;
-						m_file_pool.close_oldest();
-					}
+					l2.unlock();
+					st->tick();
+					l2.lock();
 				}
-
-#if TORRENT_HAVE_MAP_VIEW_OF_FILE
-				if (now > next_flush_file)
-				{
-					// on windows we need to explicitly ask the operating system to flush
-					// dirty pages from time to time
-					m_file_pool.flush_next_file();
-					next_flush_file = now + seconds(30);
-				}
-#endif
 			}
-
-			execute_job(j);
-
-			l.lock();
 		}
 
-		// do cleanup in the last running thread
-		// if we're not aborting, that means we just configured the thread pool to
-		// not have any threads (i.e. perform all disk operations in the network
-		// thread). In this case, the cleanup will happen in abort().
-
-		int const threads_left = --m_num_running_threads;
-		if (threads_left > 0 || !m_abort)
+		if (now > m_next_close_oldest_file)
 		{
-			DLOG("exiting disk thread. num_threads: %d aborting: %d\n"
-				, threads_left, int(m_abort));
-			TORRENT_ASSERT(m_magic == 0x1337);
-			m_stats_counters.inc_stats_counter(counters::num_running_threads, -1);
-			return;
+			seconds const interval(m_settings.get_int(settings_pack::close_file_interval));
+			if (interval <= seconds(0))
+			{
+				// check again in one minute, in case the setting changed
+				m_next_close_oldest_file = now + minutes(1);
+			}
+			else
+			{
+				m_next_close_oldest_file = now + interval;
+				m_file_pool.close_oldest();
+			}
 		}
 
-		// it is important to hold the job mutex while calling try_thread_exit()
-		// and continue to hold it until checking m_abort above so that abort()
-		// doesn't inadvertently trigger the code below when it thinks there are no
-		// more disk I/O threads running
-		l.unlock();
-
-		DLOG("last thread alive. (left: %d) cleaning up. (generic-jobs: %d hash-jobs: %d)\n"
-			, threads_left
-			, m_generic_io_jobs.m_queued_jobs.size()
-			, m_hash_io_jobs.m_queued_jobs.size());
-
-		// at this point, there are no queued jobs left. However, main
-		// thread is still running and may still have peer_connections
-		// that haven't fully destructed yet, reclaiming their references
-		// to read blocks in the disk cache. We need to wait until all
-		// references are removed from other threads before we can go
-		// ahead with the cleanup.
-		// This is not supposed to happen because the disk thread is now scheduled
-		// for shut down after all peers have shut down (see
-		// session_impl::abort_stage2()).
-
-		DLOG("the last disk thread alive. cleaning up\n");
-
-		abort_jobs();
-
-		TORRENT_ASSERT(m_magic == 0x1337);
-		m_stats_counters.inc_stats_counter(counters::num_running_threads, -1);
+#if TORRENT_HAVE_MAP_VIEW_OF_FILE
+		if (now > m_next_flush_file)
+		{
+			// on windows we need to explicitly ask the operating system to flush
+			// dirty pages from time to time
+			m_file_pool.flush_next_file();
+			m_next_flush_file = now + seconds(30);
+		}
+#endif
 	}
 
 	void mmap_disk_io::abort_jobs()
@@ -1647,7 +1440,6 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		DLOG("mmap_disk_io::abort_jobs\n");
 
 		TORRENT_ASSERT(m_magic == 0x1337);
-		if (m_jobs_aborted.test_and_set()) return;
 
 		// close all files. This may take a long
 		// time on certain OSes (i.e. Mac OS)
@@ -1657,161 +1449,6 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		m_file_pool.release();
 		TORRENT_ASSERT(m_magic == 0x1337);
 	}
-
-	int mmap_disk_io::num_threads() const
-	{
-		return m_generic_threads.max_threads() + m_hash_threads.max_threads();
-	}
-
-	mmap_disk_io::job_queue& mmap_disk_io::queue_for_job(aux::mmap_disk_job* j)
-	{
-		if (m_hash_threads.max_threads() > 0
-			&& (j->action == aux::job_action_t::hash || j->action == aux::job_action_t::hash2)
-			&& (j->flags & disk_interface::sequential_access))
-			return m_hash_io_jobs;
-		else
-			return m_generic_io_jobs;
-	}
-
-	aux::disk_io_thread_pool& mmap_disk_io::pool_for_job(aux::mmap_disk_job* j)
-	{
-		if (m_hash_threads.max_threads() > 0
-			&& (j->action == aux::job_action_t::hash || j->action == aux::job_action_t::hash2))
-			return m_hash_threads;
-		else
-			return m_generic_threads;
-	}
-
-	void mmap_disk_io::add_completed_jobs(jobqueue_t jobs)
-	{
-		jobqueue_t completed = std::move(jobs);
-		jobqueue_t new_jobs;
-		do
-		{
-			// when a job completes, it's possible for it to cause
-			// a fence to be lowered, issuing the jobs queued up
-			// behind the fence
-			add_completed_jobs_impl(std::move(completed), new_jobs);
-			TORRENT_ASSERT(completed.empty());
-			completed = std::move(new_jobs);
-		} while (!completed.empty());
-	}
-
-	void mmap_disk_io::add_completed_jobs_impl(jobqueue_t jobs, jobqueue_t& completed)
-	{
-		jobqueue_t new_jobs;
-		int ret = 0;
-		for (auto i = jobs.iterate(); i.get(); i.next())
-		{
-			aux::mmap_disk_job* j = i.get();
-			TORRENT_ASSERT((j->flags & aux::mmap_disk_job::in_progress) || !j->storage);
-
-			if (j->flags & aux::mmap_disk_job::fence)
-			{
-				m_stats_counters.inc_stats_counter(
-					counters::num_fenced_read + static_cast<int>(j->action), -1);
-			}
-
-			TORRENT_ASSERT(j->storage);
-			if (j->storage)
-				ret += j->storage->job_complete(j, new_jobs);
-
-			TORRENT_ASSERT(ret == new_jobs.size());
-			TORRENT_ASSERT(!(j->flags & aux::mmap_disk_job::in_progress));
-#if TORRENT_USE_ASSERTS
-			TORRENT_ASSERT(j->job_posted == false);
-			j->job_posted = true;
-#endif
-		}
-
-		if (ret)
-		{
-			DLOG("unblocked %d jobs (%d left)\n", ret
-				, int(m_stats_counters[counters::blocked_disk_jobs]) - ret);
-		}
-
-		m_stats_counters.inc_stats_counter(counters::blocked_disk_jobs, -ret);
-		TORRENT_ASSERT(int(m_stats_counters[counters::blocked_disk_jobs]) >= 0);
-
-		if (m_abort.load())
-		{
-			while (!new_jobs.empty())
-			{
-				aux::mmap_disk_job* j = new_jobs.pop_front();
-				TORRENT_ASSERT((j->flags & aux::mmap_disk_job::in_progress) || !j->storage);
-				j->ret = status_t::fatal_disk_error;
-				j->error = storage_error(boost::asio::error::operation_aborted);
-				completed.push_back(j);
-			}
-		}
-		else
-		{
-			if (!new_jobs.empty())
-			{
-				{
-					std::lock_guard<std::mutex> l(m_job_mutex);
-					m_generic_io_jobs.m_queued_jobs.append(std::move(new_jobs));
-				}
-
-				{
-					std::lock_guard<std::mutex> l(m_job_mutex);
-					m_generic_io_jobs.m_job_cond.notify_all();
-					m_generic_threads.job_queued(m_generic_io_jobs.m_queued_jobs.size());
-				}
-			}
-		}
-
-		std::lock_guard<std::mutex> l(m_completed_jobs_mutex);
-		m_completed_jobs.append(std::move(jobs));
-
-		if (!m_job_completions_in_flight)
-		{
-			DLOG("posting job handlers (%d)\n", m_completed_jobs.size());
-
-			post(m_ios, [this] { this->call_job_handlers(); });
-			m_job_completions_in_flight = true;
-		}
-	}
-
-	// This is run in the network thread
-	void mmap_disk_io::call_job_handlers()
-	{
-		m_stats_counters.inc_stats_counter(counters::on_disk_counter);
-		std::unique_lock<std::mutex> l(m_completed_jobs_mutex);
-
-		DLOG("call_job_handlers (%d)\n", m_completed_jobs.size());
-
-		TORRENT_ASSERT(m_job_completions_in_flight);
-		m_job_completions_in_flight = false;
-
-		aux::mmap_disk_job* j = m_completed_jobs.get_all();
-		l.unlock();
-
-		aux::array<aux::mmap_disk_job*, 64> to_delete;
-		int cnt = 0;
-
-		while (j)
-		{
-			TORRENT_ASSERT(j->job_posted == true);
-			TORRENT_ASSERT(j->callback_called == false);
-//			DLOG("   callback: %s\n", job_name(j->action));
-			aux::mmap_disk_job* next = j->next;
-
-#if TORRENT_USE_ASSERTS
-			j->callback_called = true;
-#endif
-			j->call_callback();
-			to_delete[cnt++] = j;
-			j = next;
-			if (cnt == int(to_delete.size()))
-			{
-				cnt = 0;
-				m_job_pool.free_jobs(to_delete.data(), int(to_delete.size()));
-			}
-		}
-
-		if (cnt > 0) m_job_pool.free_jobs(to_delete.data(), cnt);
-	}
 }
 
 #endif // HAVE_MMAP || HAVE_MAP_VIEW_OF_FILE
@@ -39,6 +39,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/error_code.hpp"
 #include "libtorrent/aux_/storage_utils.hpp"
 #include "libtorrent/hasher.hpp"
+#include "libtorrent/aux_/hash_batch.hpp"
 
 #include "try_signal.hpp"
 
@@ -116,6 +117,7 @@ error_code translate_error(std::error_code const& err, bool const write)
 		, m_pool(pool)
 		, m_allocate_files(params.mode == storage_mode_allocate)
 	{
+		m_read_ahead_pieces.fill(piece_index_t{-1});
 		if (params.mapped_files) m_mapped_files = std::make_unique<file_storage>(*params.mapped_files);
 
 		TORRENT_ASSERT(files().num_files() > 0);
@@ -604,6 +606,156 @@ error_code translate_error(std::error_code const& err, bool const write)
 		});
 	}
 
+namespace {
+
+	// the "allocator" of a buffer returned by read_view(). It holds a
+	// reference to the file mapping the buffer points into, and deletes
+	// itself when the buffer is freed
+	struct mapped_view final : buffer_allocator_interface
+	{
+		explicit mapped_view(std::shared_ptr<aux::file_mapping> m)
+			: m_mapping(std::move(m)) {}
+		void free_disk_buffer(char*) override { delete this; }
+	private:
+		std::shared_ptr<aux::file_mapping> m_mapping;
+	};
+}
+
+	disk_buffer_holder mmap_storage::read_view(settings_interface const& sett
+		, piece_index_t const piece, int const offset, int const len
+		, aux::open_mode_t const mode
+		, storage_error& error)
+	{
+		TORRENT_ASSERT(len > 0);
+#if TORRENT_HAVE_MMAP
+		std::int64_t const start_offset = static_cast<int>(piece)
+			* std::int64_t(files().piece_length()) + offset;
+		file_index_t const file_index = files().file_index_at_offset(start_offset);
+		std::int64_t const file_offset = start_offset - files().file_offset(file_index);
+
+		if (files().pad_file_at(file_index)) return {};
+		if (file_offset + len > files().file_size(file_index)) return {};
+		if (file_index < m_file_priority.end_index()
+			&& m_file_priority[file_index] == dont_download
+			&& use_partfile(file_index))
+			return {};
+
+		auto handle = open_file(sett, file_index, mode, error);
+		if (error) return {};
+		TORRENT_ASSERT(handle);
+		if (!handle->has_memory_map()) return {};
+
+		span<byte> file_range = handle->range();
+		if (file_range.size() < file_offset + len) return {};
+		file_range = file_range.subspan(std::ptrdiff_t(file_offset), len);
+
+		// the buffer will be sent from the network thread. Make sure the pages
+		// are resident, so the network thread won't block on disk I/O. This is
+		// also where an I/O error on the mapping is reported as a read error
+		try
+		{
+			sig::try_signal([&]{
+				char volatile dummy = 0;
+				for (std::ptrdiff_t i = 0; i < file_range.size(); i += 4096)
+					dummy = file_range[i];
+				dummy = file_range[file_range.size() - 1];
+				TORRENT_UNUSED(dummy);
+			});
+		}
+		catch (std::system_error const& err)
+		{
+			error.ec = translate_error(err.code(), false);
+			error.file(file_index);
+			error.operation = operation_t::file_read;
+			return {};
+		}
+
+		// the mapping holds the file open, so the file descriptor stays valid
+		// for as long as the view does
+		int const fd = handle->fd();
+		return disk_buffer_holder(*new mapped_view(std::move(handle))
+			, file_range.data(), len, fd, file_offset);
+#else
+		// on windows, files can't be renamed or deleted while they are mapped.
+		// Don't keep views alive beyond the storage's own use
+		TORRENT_UNUSED(sett);
+		TORRENT_UNUSED(piece);
+		TORRENT_UNUSED(offset);
+		TORRENT_UNUSED(len);
+		TORRENT_UNUSED(mode);
+		TORRENT_UNUSED(error);
+		return {};
+#endif
+	}
+
+	void mmap_storage::prefetch(settings_interface const& sett
+		, piece_index_t const piece, int const offset, int const len
+		, aux::open_mode_t const mode)
+	{
+		if (len <= 0) return;
+		for (auto const& s : files().map_block(piece, offset, len))
+		{
+			if (files().pad_file_at(s.file_index)) continue;
+			if (s.file_index < m_file_priority.end_index()
+				&& m_file_priority[s.file_index] == dont_download
+				&& use_partfile(s.file_index))
+				continue;
+
+			storage_error ec;
+			auto handle = open_file(sett, s.file_index, mode, ec);
+			if (ec || !handle->has_memory_map()) continue;
+
+			span<byte const> range = handle->range();
+			if (range.size() <= s.offset) continue;
+			range = range.subspan(static_cast<std::ptrdiff_t>(s.offset));
+			range = range.first(std::min(range.size(), static_cast<std::ptrdiff_t>(s.size)));
+			handle->will_need(range);
+		}
+	}
+
+	int mmap_storage::resident(settings_interface const& sett
+		, piece_index_t const piece, int const offset, int const len
+		, aux::open_mode_t const mode)
+	{
+		int ret = 1;
+		for (auto const& s : files().map_block(piece, offset, len))
+		{
+			if (files().pad_file_at(s.file_index)) continue;
+			if (s.file_index < m_file_priority.end_index()
+				&& m_file_priority[s.file_index] == dont_download
+				&& use_partfile(s.file_index))
+				return -1;
+
+			storage_error ec;
+			auto handle = open_file(sett, s.file_index, mode, ec);
+			if (ec || !handle->has_memory_map()) return -1;
+
+			span<byte const> range = handle->range();
+			if (range.size() < s.offset + s.size) return -1;
+			int const r = handle->resident(range.subspan(
+				static_cast<std::ptrdiff_t>(s.offset), static_cast<std::ptrdiff_t>(s.size)));
+			if (r < 0) return -1;
+			if (r == 0) ret = 0;
+		}
+		return ret;
+	}
+
+	void mmap_storage::read_ahead_issued(piece_index_t const piece)
+	{
+		std::lock_guard<std::mutex> l(m_read_ahead_mutex);
+		if (std::find(m_read_ahead_pieces.begin(), m_read_ahead_pieces.end(), piece)
+			!= m_read_ahead_pieces.end()) return;
+		m_read_ahead_pieces[std::size_t(m_read_ahead_cursor)] = piece;
+		m_read_ahead_cursor = (m_read_ahead_cursor + 1) % int(m_read_ahead_pieces.size());
+	}
+
+	bool mmap_storage::read_ahead_pending(piece_index_t const piece) const
+	{
+		std::lock_guard<std::mutex> l(m_read_ahead_mutex);
+		return std::find(m_read_ahead_pieces.begin(), m_read_ahead_pieces.end(), piece)
+			!= m_read_ahead_pieces.end();
+	}
+
 	int mmap_storage::write(settings_interface const& sett
 		, span<char> buffer
 		, piece_index_t const piece, int const offset
@@ -836,6 +988,123 @@ error_code translate_error(std::error_code const& err, bool const write)
 		return static_cast<int>(file_range.size());
 	}
 
+	int mmap_storage::hash2_blocks(settings_interface const& sett
+		, piece_index_t const piece, span<sha256_hash> const block_hashes
+		, aux::open_mode_t const mode
+		, disk_job_flags_t const flags
+		, storage_error& error)
+	{
+		// v2 pieces never span files, so the whole piece is a single range of
+		// one file
+		int const piece_size = files().piece_size2(piece);
+		int const num_blocks = files().blocks_in_piece2(piece);
+		TORRENT_ASSERT(int(block_hashes.size()) >= num_blocks);
+
+		std::int64_t const start_offset = static_cast<int>(piece) * std::int64_t(files().piece_length());
+		file_index_t const file_index = files().file_index_at_offset(start_offset);
+		std::int64_t const file_offset = start_offset - files().file_offset(file_index);
+		TORRENT_ASSERT(file_offset >= 0);
+		TORRENT_ASSERT(!files().pad_file_at(file_index));
+
+		if (file_index < m_file_priority.end_index()
+			&& m_file_priority[file_index] == dont_download
+			&& use_partfile(file_index))
+			return 0;
+
+		auto handle = open_file(sett, file_index, mode, error);
+		if (error) return -1;
+
+		if (!handle->has_memory_map()) return 0;
+
+		// if the file is truncated, let hash2() deal with the short read
+		span<byte const> file_range = handle->range();
+		if (std::int64_t(file_range.size()) < file_offset + piece_size) return 0;
+		file_range = file_range.subspan(std::ptrdiff_t(file_offset), piece_size);
+
+		std::vector<span<char const>> leaves(std::size_t(num_blocks), span<char const>{});
+		char const* const ptr = file_range.data();
+		for (int i = 0; i < num_blocks; ++i)
+		{
+			int const offset = i * default_block_size;
+			leaves[std::size_t(i)] = { ptr + offset, std::min(default_block_size, piece_size - offset) };
+		}
+
+		sig::try_signal([&]{
+			aux::sha256_batch(leaves, block_hashes);
+		});
+		if (flags & disk_interface::volatile_read)
+			handle->dont_need(file_range);
+		if (flags & disk_interface::flush_piece)
+			handle->page_out(file_range);
+
+		return piece_size;
+	}
+
+	int mmap_storage::hash_pieces(settings_interface const& sett
+		, span<piece_index_t const> const pieces, span<sha1_hash> const hashes
+		, bitfield& hashed, aux::open_mode_t const mode
+		, disk_job_flags_t const flags)
+	{
+		TORRENT_ASSERT(hashes.size() >= pieces.size());
+		hashed.resize(int(pieces.size()), false);
+		hashed.clear_all();
+
+		// the mappings are held on to until the pieces have been hashed
+		std::vector<std::shared_ptr<aux::file_mapping>> handles;
+		std::vector<span<char const>> ranges;
+		std::vector<int> index;
+		for (int i = 0; i < int(pieces.size()); ++i)
+		{
+			piece_index_t const piece = pieces[i];
+			int const piece_size = files().piece_size(piece);
+			std::int64_t const start_offset = static_cast<int>(piece) * std::int64_t(files().piece_length());
+			file_index_t const file_index = files().file_index_at_offset(start_offset);
+			std::int64_t const file_offset = start_offset - files().file_offset(file_index);
+
+			if (files().pad_file_at(file_index)) continue;
+			if (file_offset + piece_size > files().file_size(file_index)) continue;
+			if (file_index < m_file_priority.end_index()
+				&& m_file_priority[file_index] == dont_download
+				&& use_partfile(file_index))
+				continue;
+
+			storage_error ec;
+			auto handle = open_file(sett, file_index, mode, ec);
+			if (ec || !handle->has_memory_map()) continue;
+
+			span<byte const> file_range = handle->range();
+			if (std::int64_t(file_range.size()) < file_offset + piece_size) continue;
+			ranges.push_back(file_range.subspan(std::ptrdiff_t(file_offset), piece_size));
+			handles.push_back(std::move(handle));
+			index.push_back(i);
+		}
+		if (ranges.empty()) return 0;
+
+		std::vector<sha1_hash> out(ranges.size());
+		try
+		{
+			sig::try_signal([&]{
+				aux::sha1_batch(ranges, out);
+			});
+		}
+		catch (std::system_error const&)
+		{
+			// hash() will hit the same error and report it
+			return 0;
+		}
+
+		for (std::size_t k = 0; k < ranges.size(); ++k)
+		{
+			hashes[index[k]] = out[k];
+			hashed.set_bit(index[k]);
+			if (flags & disk_interface::volatile_read)
+				handles[k]->dont_need(ranges[k]);
+			if (flags & disk_interface::flush_piece)
+				handles[k]->page_out(ranges[k]);
+		}
+		return int(ranges.size());
+	}
+
 	// a wrapper around open_file_impl that, if it fails, makes sure the
 	// directories have been created and retries
 	std::shared_ptr<aux::file_mapping> mmap_storage::open_file(settings_interface const& sett
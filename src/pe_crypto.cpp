@@ -60,6 +60,214 @@ namespace libtorrent {
 		// TODO: it would be nice to get the literal working
 		key_t const dh_prime
 			("0xFFFFFFFFFFFFFFFFC90FDAA22168C234C4C6628B80DC1CD129024E088A67CC74020BBEA63B139B22514A08798E3404DDEF9519B3CD3A431B302B0A6DF25F14374FE1356D6D51C245E485B576625E7EC6F44C42E9A63A36210000000000090563");
+
+		// the modular exponentiation of the key exchange is done on fixed
+		// size numbers, in Montgomery form. This is a lot cheaper than the
+		// general purpose cpp_int powm(), and doesn't branch on the secret
+		// exponent.
+#if defined __SIZEOF_INT128__
+		using limb_t = std::uint64_t;
+		__extension__ typedef unsigned __int128 dlimb_t;
+#else
+		using limb_t = std::uint32_t;
+		using dlimb_t = std::uint64_t;
+#endif
+		int const limb_bits = int(sizeof(limb_t) * 8);
+		int const num_limbs = 768 / limb_bits;
+
+		// little endian limbs
+		using bignum = std::array<limb_t, num_limbs>;
+
+		bignum from_bytes(std::uint8_t const* in)
+		{
+			bignum ret;
+			for (int i = 0; i < num_limbs; ++i)
+			{
+				limb_t l = 0;
+				std::uint8_t const* p = in + (num_limbs - 1 - i) * int(sizeof(limb_t));
+				for (int k = 0; k < int(sizeof(limb_t)); ++k)
+					l = limb_t(l << 8) | p[k];
+				ret[std::size_t(i)] = l;
+			}
+			return ret;
+		}
+
+		void to_bytes(bignum const& n, std::uint8_t* out)
+		{
+			for (int i = 0; i < num_limbs; ++i)
+			{
+				limb_t const l = n[std::size_t(i)];
+				std::uint8_t* p = out + (num_limbs - 1 - i) * int(sizeof(limb_t));
+				for (int k = 0; k < int(sizeof(limb_t)); ++k)
+					p[k] = std::uint8_t(l >> ((int(sizeof(limb_t)) - 1 - k) * 8));
+			}
+		}
+
+		// r = a - b, returns the borrow
+		limb_t sub(bignum& r, bignum const& a, bignum const& b)
+		{
+			limb_t borrow = 0;
+			for (std::size_t i = 0; i < a.size(); ++i)
+			{
+				dlimb_t const d = dlimb_t(a[i]) - b[i] - borrow;
+				r[i] = limb_t(d);
+				borrow = limb_t(d >> limb_bits) & 1;
+			}
+			return borrow;
+		}
+
+		// sets r to a if mask is all ones, leaves it unchanged if it's 0
+		void select(bignum& r, bignum const& a, limb_t const mask)
+		{
+			for (std::size_t i = 0; i < r.size(); ++i)
+				r[i] = (r[i] & ~mask) | (a[i] & mask);
+		}
+
+		struct montgomery
+		{
+			montgomery()
+			{
+				std::array<char, 96> const p = export_key(dh_prime);
+				m_p = from_bytes(reinterpret_cast<std::uint8_t const*>(p.data()));
+
+				// -p^-1 mod 2^limb_bits, by Newton's method. Every iteration
+				// doubles the number of correct bits
+				limb_t inv = 1;
+				for (int i = 0; i < 7; ++i)
+					inv = limb_t(inv * limb_t(2 - m_p[0] * inv));
+				m_n0 = limb_t(0 - inv);
+
+				// R mod p = 2^768 - p, since p > 2^767
+				bignum const zero{};
+				sub(m_one, zero, m_p);
+
+				// R^2 mod p, by doubling R 768 times
+				m_r2 = m_one;
+				for (int i = 0; i < 768; ++i)
+				{
+					limb_t carry = 0;
+					for (auto& l : m_r2)
+					{
+						limb_t const top = l >> (limb_bits - 1);
+						l = limb_t(l << 1) | carry;
+						carry = top;
+					}
+					reduce(m_r2, carry);
+				}
+			}
+
+			// subtract p from a if a >= p, where carry is the bit above the
+			// most significant limb
+			void reduce(bignum& a, limb_t const carry) const
+			{
+				bignum d;
+				limb_t const borrow = sub(d, a, m_p);
+				// if there's a carry out of a, or no borrow, a >= p
+				select(a, d, limb_t(0) - (carry | (borrow ^ 1)));
+			}
+
+			// returns a * b * R^-1 mod p. The multiplication and the
+			// reduction are interleaved, one limb of a at a time
+			bignum mul(bignum const& a, bignum const& b) const
+			{
+				std::array<limb_t, num_limbs + 1> t{};
+				for (int i = 0; i < num_limbs; ++i)
+				{
+					limb_t const ai = a[std::size_t(i)];
+					dlimb_t s = dlimb_t(ai) * b[0] + t[0];
+					limb_t c1 = limb_t(s >> limb_bits);
+					limb_t const m = limb_t(limb_t(s) * m_n0);
+					dlimb_t s2 = dlimb_t(m) * m_p[0] + limb_t(s);
+					limb_t c2 = limb_t(s2 >> limb_bits);
+					for (std::size_t j = 1; j < num_limbs; ++j)
+					{
+						s = dlimb_t(ai) * b[j] + t[j] + c1;
+						c1 = limb_t(s >> limb_bits);
+						s2 = dlimb_t(m) * m_p[j] + limb_t(s) + c2;
+						c2 = limb_t(s2 >> limb_bits);
+						t[j - 1] = limb_t(s2);
+					}
+					s = dlimb_t(t[num_limbs]) + c1 + c2;
+					t[num_limbs - 1] = limb_t(s);
+					t[num_limbs] = limb_t(s >> limb_bits);
+				}
+				bignum ret;
+				std::copy(t.begin(), t.begin() + num_limbs, ret.begin());
+				reduce(ret, t[num_limbs]);
+				return ret;
+			}
+
+			// returns base ^ exp mod p. Both are big-endian 96 byte numbers.
+			// This uses a fixed 4 bit window, and all table entries are
+			// touched for every lookup, to not leak the exponent through
+			// the memory access pattern
+			bignum pow(bignum base, std::uint8_t const* exp) const
+			{
+				// a remote public key may be larger than p
+				reduce(base, 0);
+
+				std::array<bignum, 16> table;
+				table[0] = m_one;
+				table[1] = mul(base, m_r2);
+				for (std::size_t i = 2; i < table.size(); ++i)
+					table[i] = mul(table[i - 1], table[1]);
+
+				bignum acc = m_one;
+				for (int i = 0; i < 96 * 2; ++i)
+				{
+					if (i > 0)
+					{
+						for (int k = 0; k < 4; ++k)
+							acc = mul(acc, acc);
+					}
+					limb_t const nibble = (exp[i / 2] >> ((i & 1) ? 0 : 4)) & 0xf;
+					bignum factor{};
+					for (limb_t k = 0; k < 16; ++k)
+					{
+						// all ones if k == nibble
+						limb_t const mask = limb_t(0) - limb_t(((k ^ nibble) - 1) >> (limb_bits - 1));
+						select(factor, table[std::size_t(k)], mask);
+					}
+					acc = mul(acc, factor);
+				}
+
+				// convert back from Montgomery form
+				bignum one{};
+				one[0] = 1;
+				return mul(acc, one);
+			}
+
+		private:
+			bignum m_p;
+			// R mod p, i.e. 1 in Montgomery form
+			bignum m_one;
+			// R^2 mod p, to convert into Montgomery form
+			bignum m_r2;
+			limb_t m_n0;
+		};
+
+		montgomery const& dh_field()
+		{
+			static montgomery const m;
+			return m;
+		}
+
+		key_t import_key(std::uint8_t const* begin)
+		{
+			key_t ret;
+			mp::import_bits(ret, begin, begin + 96);
+			return ret;
+		}
+	}
+
+	key_t dh_pow_mod(key_t const& base, key_t const& exp)
+	{
+		std::array<char, 96> const b = export_key(base);
+		std::array<char, 96> const e = export_key(exp);
+		std::array<std::uint8_t, 96> ret;
+		to_bytes(dh_field().pow(from_bytes(reinterpret_cast<std::uint8_t const*>(b.data()))
+			, reinterpret_cast<std::uint8_t const*>(e.data())), ret.data());
+		return import_key(ret.data());
 	}
 
 	std::array<char, 96> export_key(key_t const& k)
@@ -97,28 +305,26 @@ namespace libtorrent {
 			, static_cast<std::ptrdiff_t>(random_key.size())});
 
 		// create local key (random)
-		mp::import_bits(m_dh_local_secret, random_key.begin(), random_key.end());
+		m_dh_local_secret = import_key(random_key.data());
 
 		// key = (2 ^ secret) % prime
-		m_dh_local_key = mp::powm(key_t(2), m_dh_local_secret, dh_prime);
+		m_dh_local_key = dh_pow_mod(key_t(2), m_dh_local_secret);
 	}
 
 	// compute shared secret given remote public key
 	void dh_key_exchange::compute_secret(std::uint8_t const* remote_pubkey)
 	{
 		TORRENT_ASSERT(remote_pubkey);
-		key_t key;
-		mp::import_bits(key, remote_pubkey, remote_pubkey + 96);
-		compute_secret(key);
+		compute_secret(import_key(remote_pubkey));
 	}
 
 	void dh_key_exchange::compute_secret(key_t const& remote_pubkey)
 	{
 		// shared_secret = (remote_pubkey ^ local_secret) % prime
-		m_dh_shared_secret = mp::powm(remote_pubkey, m_dh_local_secret, dh_prime);
+		m_dh_shared_secret = dh_pow_mod(remote_pubkey, m_dh_local_secret);
 
-		std::array<char, 96> buffer;
-		mp::export_bits(m_dh_shared_secret, reinterpret_cast<std::uint8_t*>(buffer.data()), 8);
+		// the secret is hashed as a fixed width, 96 byte, number
+		std::array<char, 96> const buffer = export_key(m_dh_shared_secret);
 
 		static char const req3[4] = {'r', 'e', 'q', '3'};
 		// calculate the xor mask for the obfuscated hash
@@ -78,6 +78,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/array.hpp"
 #include "libtorrent/aux_/set_socket_buffer.hpp"
 #include "libtorrent/aux_/set_traffic_class.hpp"
+#include "libtorrent/aux_/timer_wheel.hpp"
 
 #if TORRENT_USE_ASSERTS
 #include <set>
@@ -92,6 +93,13 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "libtorrent/aux_/torrent_impl.hpp"
 
+#if TORRENT_USE_SENDFILE
+#include "libtorrent/aux_/disable_warnings_push.hpp"
+#include <sys/sendfile.h>
+#include <cerrno>
+#include "libtorrent/aux_/disable_warnings_pop.hpp"
+#endif
+
 //#define TORRENT_CORRUPT_DATA
 
 using namespace std::placeholders;
@@ -106,6 +114,11 @@ namespace libtorrent {
 	// the limits of the download queue size
 	constexpr int min_request_queue = 2;
 
+	// idle connections are still ticked at least this often (in ticks), to
+	// run the extensions' tick() and the timeouts that depend on the state of
+	// the session rather than of the connection itself
+	constexpr int max_idle_tick_interval = 10;
+
 	bool pending_block_in_buffer(pending_block const& pb)
 	{
 		return pb.send_buffer_offset != pending_block::not_in_buffer;
@@ -317,6 +330,8 @@ namespace libtorrent {
 		TORRENT_ASSERT(m_peer_info == nullptr || m_peer_info->connection == this);
 		std::shared_ptr<torrent> t = m_torrent.lock();
 
+		schedule_tick(1);
+
 		if (!m_outgoing)
 		{
 			error_code ec;
@@ -537,21 +552,14 @@ namespace libtorrent {
 		{
 			t->need_picker();
 			piece_picker const& p = t->picker();
-			piece_index_t const end_piece(p.num_pieces());
-			for (piece_index_t j(0); j != end_piece; ++j)
-			{
-				if (m_have_piece[j]
-					&& t->piece_priority(j) > dont_download
-					&& !p.have_piece(j))
-				{
-					interested = true;
+			TORRENT_ASSERT(m_have_piece.size() == p.num_pieces());
+			// the peer is interesting if it has any piece we don't have and
+			// haven't filtered. This is checked a word at a time
+			interested = p.has_wanted_piece(m_have_piece);
 #ifndef TORRENT_DISABLE_LOGGING
-					peer_log(peer_log_alert::info, "UPDATE_INTEREST", "interesting, piece: %d"
-						, static_cast<int>(j));
+			if (interested)
+				peer_log(peer_log_alert::info, "UPDATE_INTEREST", "interesting");
 #endif
-					break;
-				}
-			}
 		}
 
 #ifndef TORRENT_DISABLE_LOGGING
@@ -825,15 +833,8 @@ namespace libtorrent {
 		{
 			TORRENT_ASSERT(m_have_piece.size() == t->torrent_file().num_pieces());
 			t->peer_has(m_have_piece, this);
-			bool interesting = false;
-			for (auto const i : m_have_piece.range())
-			{
-				if (!m_have_piece[i]) continue;
-				// if the peer has a piece and we don't, the peer is interesting
-				if (!t->have_piece(i)
-					&& t->picker().piece_priority(i) != dont_download)
-					interesting = true;
-			}
+			// if the peer has a piece and we don't, the peer is interesting
+			bool const interesting = t->picker().has_wanted_piece(m_have_piece);
 			if (interesting) t->peer_is_interesting(*this);
 			else send_not_interested();
 		}
@@ -1391,6 +1392,9 @@ namespace libtorrent {
 		// think it is
 		m_torrent = t;
 
+		// until now, only the handshake timeout applied to this connection
+		schedule_tick(1);
+
 		if (t && t->alerts().should_post<peer_connect_alert>())
 		{
 			t->alerts().emplace_alert<peer_connect_alert>(
@@ -2674,6 +2678,51 @@ namespace libtorrent {
 #endif
 	}
 
+	bool peer_connection::start_direct_receive(peer_request const& r
+		, span<char const> const received)
+	{
+		TORRENT_ASSERT(is_single_thread());
+		TORRENT_ASSERT(!m_recv_disk_buffer);
+		TORRENT_ASSERT(int(received.size()) < r.length);
+
+		if (!m_settings.get_bool(settings_pack::direct_piece_receive)) return false;
+		if (r.length > default_block_size) return false;
+
+		// the rest of the receive buffer must be empty, as it's left behind
+		if (!m_recv_buffer.pos_at_end()) return false;
+
+		std::shared_ptr<torrent> t = m_torrent.lock();
+		if (!t || t->is_deleted()) return false;
+
+		bool exceeded = false;
+		disk_buffer_holder buffer = m_disk_thread.allocate_disk_buffer(exceeded, self());
+		if (!buffer) return false;
+
+		if (!received.empty())
+			std::memcpy(buffer.data(), received.data(), std::size_t(received.size()));
+		m_recv_disk_buffer = std::move(buffer);
+		m_recv_disk_request = r;
+		m_recv_disk_pos = int(received.size());
+		m_recv_disk_exceeded = exceeded;
+
+#ifndef TORRENT_DISABLE_LOGGING
+		peer_log(peer_log_alert::incoming, "DIRECT_RECEIVE", "piece: %d s: %x l: %x"
+			, static_cast<int>(r.piece), r.start, r.length);
+#endif
+		return true;
+	}
+
+	disk_buffer_holder peer_connection::finish_direct_receive(peer_request& r)
+	{
+		TORRENT_ASSERT(m_recv_disk_buffer);
+		TORRENT_ASSERT(m_recv_disk_pos <= m_recv_disk_request.length);
+		if (m_recv_disk_pos < m_recv_disk_request.length) return {};
+
+		r = m_recv_disk_request;
+		m_recv_disk_pos = 0;
+		return std::move(m_recv_disk_buffer);
+	}
+
 	void peer_connection::start_receive_piece(peer_request const& r)
 	{
 		TORRENT_ASSERT(is_single_thread());
@@ -2784,6 +2833,19 @@ namespace libtorrent {
 	// -----------------------------
 
 	void peer_connection::incoming_piece(peer_request const& p, char const* data)
+	{
+		incoming_piece_impl(p, data, disk_buffer_holder());
+	}
+
+	void peer_connection::incoming_piece(peer_request const& p, disk_buffer_holder data)
+	{
+		TORRENT_ASSERT(data);
+		char const* const ptr = data.data();
+		incoming_piece_impl(p, ptr, std::move(data));
+	}
+
+	void peer_connection::incoming_piece_impl(peer_request const& p, char const* data
+		, disk_buffer_holder buffer)
 	{
 		TORRENT_ASSERT(is_single_thread());
 		INVARIANT_CHECK;
@@ -2981,9 +3043,23 @@ namespace libtorrent {
 
 		if (t->is_deleted()) return;
 
-		bool const exceeded = m_disk_thread.async_write(t->storage(), p, data, self()
-			, [conn = self(), p, t] (storage_error const& e)
-			{ conn->wrap(&peer_connection::on_disk_write_complete, e, p, t); });
+		auto write_handler = [conn = self(), p, t] (storage_error const& e)
+			{ conn->wrap(&peer_connection::on_disk_write_complete, e, p, t); };
+		bool exceeded;
+		if (buffer)
+		{
+			// the block was received straight into a disk buffer, hand it over
+			// as-is
+			exceeded = m_disk_thread.async_write(t->storage(), p, std::move(buffer)
+				, self(), std::move(write_handler));
+			exceeded |= m_recv_disk_exceeded;
+			m_recv_disk_exceeded = false;
+		}
+		else
+		{
+			exceeded = m_disk_thread.async_write(t->storage(), p, data, self()
+				, std::move(write_handler));
+		}
 		m_ses.deferred_submit_jobs();
 
 		// every peer is entitled to have two disk blocks allocated at any given
@@ -4326,6 +4402,11 @@ namespace libtorrent {
 			m_send_buffer.clear();
 		}
 
+		// the same goes for a disk buffer we're receiving a block into, unless
+		// a read into it is still outstanding
+		if (!(m_channel_state[download_channel] & peer_info::bw_network))
+			m_recv_disk_buffer.reset();
+
 		// we cannot do this in a constructor
 		TORRENT_ASSERT(m_in_constructor == false);
 		if (error > normal)
@@ -4844,6 +4925,108 @@ namespace libtorrent {
 #endif
 	}
 
+	void peer_connection::schedule_tick(int const delay)
+	{
+		TORRENT_ASSERT(is_single_thread());
+		TORRENT_ASSERT(delay > 0);
+		auto& wheel = m_ses.peer_ticks();
+		std::int64_t const due = wheel.now() + delay;
+		if (m_next_tick >= 0 && m_next_tick <= due) return;
+
+		// if we're already scheduled later, that entry becomes stale and is
+		// ignored by on_tick_due()
+		m_next_tick = due;
+		m_parked = delay > 1;
+		wheel.schedule(self(), due);
+	}
+
+	int peer_connection::next_tick_delay() const
+	{
+		TORRENT_ASSERT(is_single_thread());
+		std::shared_ptr<torrent> t = m_torrent.lock();
+
+		// anything in flight, or anything that may change without any socket
+		// activity, needs a tick every second
+		if (m_connecting
+			|| in_handshake()
+			|| !m_statistics.is_idle()
+			|| !m_download_queue.empty()
+			|| !m_request_queue.empty()
+			|| !m_requests.empty()
+			|| !m_send_buffer.empty()
+			|| m_reading_bytes > 0
+			|| (m_channel_state[download_channel] & (peer_info::bw_limit | peer_info::bw_disk))
+			|| (m_channel_state[upload_channel] & (peer_info::bw_limit | peer_info::bw_disk | peer_info::bw_network))
+			|| (m_interesting && !m_peer_choked)
+			|| !t || !t->valid_metadata())
+			return 1;
+
+#ifndef TORRENT_DISABLE_SUPERSEEDING
+		if (t->super_seeding()) return 1;
+#endif
+
+		// otherwise, sleep until the first timeout that may fire. Only
+		// deadlines in the future count, a timeout that has passed but was
+		// vetoed by can_disconnect() won't be checked again until the cap
+		time_point const now = aux::time_now();
+		time_point next = now + seconds(max_idle_tick_interval);
+		auto const earliest = [&](time_point const deadline)
+		{
+			if (deadline > now && deadline < next) next = deadline;
+		};
+
+		earliest(m_last_sent.get(m_connect) + seconds(timeout() / 2));
+		if (m_channel_state[download_channel] & peer_info::bw_network)
+			earliest(m_last_receive.get(m_connect) + seconds(timeout()));
+		if (!m_choked && m_peer_interested)
+		{
+			earliest(std::max(std::max(m_last_unchoke.get(m_connect)
+				, m_last_incoming_request.get(m_connect))
+				, m_last_sent_payload.get(m_connect)) + seconds(60));
+		}
+		earliest(std::max(m_became_uninterested.get(m_connect)
+			, m_became_uninteresting.get(m_connect))
+			+ seconds(m_settings.get_int(settings_pack::inactivity_timeout)));
+
+		// round up, the deadline must have passed by the time we're ticked
+		return std::max(1, int(total_seconds(next - now)) + 1);
+	}
+
+	void peer_connection::on_tick_due(std::int64_t const tick
+		, int const tick_interval_ms)
+	{
+		TORRENT_ASSERT(is_single_thread());
+
+		// we've been rescheduled to an earlier tick since this one
+		if (tick != m_next_tick) return;
+		m_next_tick = -1;
+		m_parked = false;
+
+		if (m_disconnecting) return;
+
+		if (m_torrent.expired())
+		{
+			// an incoming connection that hasn't been attached to a torrent
+			// yet. The only thing to do is to not let it stall the handshake
+			int timeout = m_settings.get_int(settings_pack::handshake_timeout);
+#if TORRENT_USE_I2P
+			timeout *= is_i2p(m_socket) ? 4 : 1;
+#endif
+			time_duration const d = aux::time_now() - m_connect;
+			if (d > seconds(timeout))
+			{
+				disconnect(errors::timed_out, operation_t::bittorrent);
+				return;
+			}
+			schedule_tick(int(total_seconds(seconds(timeout) - d)) + 1);
+			return;
+		}
+
+		second_tick(tick_interval_ms);
+		if (m_disconnecting) return;
+		schedule_tick(next_tick_delay());
+	}
+
 	void peer_connection::second_tick(int const tick_interval_ms)
 	{
 		TORRENT_ASSERT(is_single_thread());
@@ -4891,6 +5074,8 @@ namespace libtorrent {
 			return;
 		}
 
+		t->peer_seen_complete(m_last_seen_complete);
+
 		if (m_endgame_mode
 			&& m_interesting
 			&& m_download_queue.empty()
@@ -5394,6 +5579,21 @@ namespace libtorrent {
 				auto const read_mode = m_settings.get_int(settings_pack::disk_io_read_mode);
 				if (read_mode == settings_pack::disable_os_cache)
 					flags |= disk_interface::volatile_read;
+				if ((m_settings.get_bool(settings_pack::zero_copy_upload)
+						|| m_settings.get_bool(settings_pack::sendfile_upload))
+					&& sends_raw_payload())
+					flags |= disk_interface::zero_copy;
+				if (r.start == 0
+					&& m_settings.get_bool(settings_pack::piece_read_ahead))
+				{
+					flags |= disk_interface::read_ahead;
+					// if the peer already has requests queued for the next piece
+					// it's downloading sequentially
+					piece_index_t const next_piece = next(r.piece);
+					if (std::any_of(m_requests.begin(), m_requests.end()
+						, [next_piece](peer_request const& pr) { return pr.piece == next_piece; }))
+						flags |= disk_interface::read_ahead_next_piece;
+				}
 
 				m_disk_thread.async_read(t->storage(), r
 					, [conn = self(), r](disk_buffer_holder buf, storage_error const& ec)
@@ -5906,13 +6106,41 @@ namespace libtorrent {
 			return;
 		}
 
-		int const amount_to_send = std::min({
+		int amount_to_send = std::min({
 			m_send_buffer.size()
 			, quota_left
 			, m_send_barrier});
 
 		TORRENT_ASSERT(amount_to_send > 0);
 
+#if TORRENT_USE_SENDFILE
+		// when the bytes in front of a file backed buffer (typically the
+		// piece message header) are written, the kernel is asked to hold on
+		// to them (MSG_MORE), to go out in the same segment as the start of
+		// the following sendfile()
+		bool cork = false;
+		auto* const tcp_sock = boost::get<tcp::socket>(&m_socket);
+		if (tcp_sock != nullptr
+			&& m_settings.get_bool(settings_pack::sendfile_upload)
+			&& sends_raw_payload())
+		{
+			std::int64_t file_offset;
+			int file_len;
+			if (m_send_buffer.front_file(file_offset, file_len) >= 0)
+			{
+				async_sendfile(*tcp_sock);
+				return;
+			}
+			// only write up to the next buffer that can be sent from its file.
+			// That one is sent by the next write
+			int const until_file = m_send_buffer.bytes_until_file();
+			TORRENT_ASSERT(until_file > 0);
+			cork = until_file <= amount_to_send
+				&& until_file < m_send_buffer.size();
+			amount_to_send = std::min(amount_to_send, until_file);
+		}
+#endif
+
 		TORRENT_ASSERT(!(m_channel_state[upload_channel] & peer_info::bw_network));
 #ifndef TORRENT_DISABLE_LOGGING
 		peer_log(peer_log_alert::outgoing, "ASYNC_WRITE", "bytes: %d", amount_to_send);
@@ -5936,12 +6164,126 @@ namespace libtorrent {
 			>;
 		static_assert(sizeof(write_handler_type) == sizeof(std::shared_ptr<peer_connection>)
 			, "write handler does not have the expected size");
+#if TORRENT_USE_SENDFILE
+		if (cork)
+			tcp_sock->async_send(vec, MSG_MORE, write_handler_type(self()));
+		else
+#endif
 		m_socket.async_write_some(vec, write_handler_type(self()));
 
 		m_channel_state[upload_channel] |= peer_info::bw_network;
 		m_last_sent.set(m_connect, aux::time_now());
 	}
 
+#if TORRENT_USE_SENDFILE
+	void peer_connection::async_sendfile(tcp::socket& s)
+	{
+		TORRENT_ASSERT(is_single_thread());
+		TORRENT_ASSERT(!(m_channel_state[upload_channel] & peer_info::bw_network));
+#ifndef TORRENT_DISABLE_LOGGING
+		peer_log(peer_log_alert::outgoing, "ASYNC_SENDFILE", "quota: %d"
+			, m_quota[upload_channel]);
+#endif
+		ADD_OUTSTANDING_ASYNC("peer_connection::on_send_data");
+
+#if TORRENT_USE_ASSERTS
+		TORRENT_ASSERT(!m_socket_is_writing);
+		m_socket_is_writing = true;
+#endif
+
+		m_channel_state[upload_channel] |= peer_info::bw_network;
+		m_last_sent.set(m_connect, aux::time_now());
+
+		// the socket is most likely writable, since we just finished the
+		// previous send. Only wait for it if it isn't
+		error_code ec;
+		std::size_t const sent = sendfile_front(s, ec);
+		if (ec == boost::asio::error::would_block)
+		{
+			wait_sendfile(s);
+			return;
+		}
+
+		// the completion is posted, to not call back into on_send_data()
+		// from within setup_send()
+		std::shared_ptr<peer_connection> conn = self();
+		post(m_ios, [conn, ec, sent]
+			{ conn->wrap(&peer_connection::on_send_data, ec, sent); });
+	}
+
+	void peer_connection::wait_sendfile(tcp::socket& s)
+	{
+		using wait_handler_type = aux::handler<
+			peer_connection
+			, decltype(&peer_connection::on_sendfile_ready)
+			, &peer_connection::on_sendfile_ready
+			, &peer_connection::on_error
+			, &peer_connection::on_exception
+			, decltype(m_write_handler_storage)
+			, &peer_connection::m_write_handler_storage
+			>;
+		s.async_wait(tcp::socket::wait_write, wait_handler_type(self()));
+	}
+
+	void peer_connection::on_sendfile_ready(error_code const& error)
+	{
+		TORRENT_ASSERT(is_single_thread());
+
+		auto* const s = boost::get<tcp::socket>(&m_socket);
+		if (error || m_disconnecting || s == nullptr)
+		{
+			on_send_data(error, 0);
+			return;
+		}
+
+		error_code ec;
+		std::size_t const sent = sendfile_front(*s, ec);
+		if (ec == boost::asio::error::would_block)
+		{
+			// the socket wasn't writable after all. Wait again
+			wait_sendfile(*s);
+			return;
+		}
+		on_send_data(ec, sent);
+	}
+
+	std::size_t peer_connection::sendfile_front(tcp::socket& s, error_code& ec)
+	{
+		std::int64_t file_offset;
+		int len;
+		int const fd = m_send_buffer.front_file(file_offset, len);
+		TORRENT_ASSERT(fd >= 0);
+		len = std::min(len, m_quota[upload_channel]);
+		TORRENT_ASSERT(len > 0);
+
+		if (!s.native_non_blocking())
+		{
+			s.native_non_blocking(true, ec);
+			if (ec) return 0;
+		}
+
+		off_t offset = off_t(file_offset);
+		ssize_t const ret = ::sendfile(s.native_handle(), fd, &offset, std::size_t(len));
+		if (ret < 0)
+		{
+			if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+				ec = boost::asio::error::would_block;
+			else
+				ec.assign(errno, system_category());
+			return 0;
+		}
+		if (ret == 0)
+		{
+			// the file is shorter than the view of it
+			ec = boost::asio::error::eof;
+			return 0;
+		}
+
+		m_counters.inc_stats_counter(counters::sent_sendfile_bytes, ret);
+		return std::size_t(ret);
+	}
+#endif
+
 	void peer_connection::on_disk()
 	{
 		TORRENT_ASSERT(is_single_thread());
@@ -5970,7 +6312,9 @@ namespace libtorrent {
 		}
 
 		// we may want to request more quota at this point
-		int const buffer_size = m_recv_buffer.max_receive();
+		int const buffer_size = m_recv_disk_buffer
+			? m_recv_disk_request.length - m_recv_disk_pos
+			: m_recv_buffer.max_receive();
 		request_bandwidth(download_channel, buffer_size);
 
 		if (m_channel_state[download_channel] & peer_info::bw_network) return;
@@ -6009,7 +6353,9 @@ namespace libtorrent {
 
 		if (max_receive == 0) return;
 
-		span<char> const vec = m_recv_buffer.reserve(max_receive);
+		span<char> const vec = m_recv_disk_buffer
+			? span<char>(m_recv_disk_buffer.data() + m_recv_disk_pos, max_receive)
+			: m_recv_buffer.reserve(max_receive);
 		TORRENT_ASSERT(!(m_channel_state[download_channel] & peer_info::bw_network));
 		m_channel_state[download_channel] |= peer_info::bw_network;
 #ifndef TORRENT_DISABLE_LOGGING
@@ -6093,6 +6439,26 @@ namespace libtorrent {
 #endif
 	}
 
+	void peer_connection::account_direct_received_bytes(int const bytes_transferred)
+	{
+		// the bytes went straight into the disk buffer, not the receive buffer
+		TORRENT_ASSERT(bytes_transferred > 0);
+		TORRENT_ASSERT(m_recv_disk_pos + bytes_transferred <= m_recv_disk_request.length);
+		m_recv_disk_pos += bytes_transferred;
+
+		TORRENT_ASSERT(bytes_transferred <= m_quota[download_channel]);
+		m_quota[download_channel] -= bytes_transferred;
+
+		m_ses.received_buffer(bytes_transferred);
+		trancieve_ip_packet(bytes_transferred, aux::is_v6(m_remote));
+		m_counters.inc_stats_counter(counters::recv_direct_bytes, bytes_transferred);
+
+#ifndef TORRENT_DISABLE_LOGGING
+		peer_log(peer_log_alert::incoming, "READ_DIRECT"
+			, "%d bytes", bytes_transferred);
+#endif
+	}
+
 	void peer_connection::on_receive_data(error_code const& error
 		, std::size_t bytes_transferred)
 	{
@@ -6119,6 +6485,8 @@ namespace libtorrent {
 
 		INVARIANT_CHECK;
 
+		if (m_parked && !m_disconnecting) schedule_tick(1);
+
 		if (error)
 		{
 #ifndef TORRENT_DISABLE_LOGGING
@@ -6150,6 +6518,29 @@ namespace libtorrent {
 		// flush the send buffer at the end of this function
 		cork _c(*this);
 
+		if (m_recv_disk_buffer)
+		{
+			// the payload of a piece message is being received straight into a
+			// disk buffer. There's nothing in the receive buffer to feed to the
+			// upper layer, just tell it how many payload bytes arrived
+			account_direct_received_bytes(int(bytes_transferred));
+			on_receive(error, bytes_transferred);
+			if (m_disconnecting) return;
+
+			// allow reading from the socket again
+			TORRENT_ASSERT(m_channel_state[download_channel] & peer_info::bw_network);
+			m_channel_state[download_channel] &= ~peer_info::bw_network;
+
+			setup_receive();
+
+			if (m_deferred_send_block_requests)
+			{
+				m_deferred_send_block_requests = false;
+				send_block_requests_impl();
+			}
+			return;
+		}
+
 		// if we received exactly as many bytes as we provided a receive buffer
 		// for. There most likely are more bytes to read, and we should grow our
 		// receive buffer.
@@ -6453,6 +6844,8 @@ namespace libtorrent {
 		INVARIANT_CHECK;
 
 		COMPLETE_ASYNC("peer_connection::on_send_data");
+
+		if (m_parked && !m_disconnecting) schedule_tick(1);
 		// keep ourselves alive in until this function exits in
 		// case we disconnect
 		std::shared_ptr<peer_connection> me(self());
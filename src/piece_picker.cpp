@@ -48,6 +48,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/bitfield.hpp"
 #include "libtorrent/random.hpp"
 #include "libtorrent/aux_/alloca.hpp"
+#include "libtorrent/aux_/ffs.hpp"
+#include "libtorrent/aux_/byteswap.hpp"
 #include "libtorrent/aux_/range.hpp"
 #include "libtorrent/performance_counters.hpp" // for counters
 #include "libtorrent/alert_types.hpp" // for picker_log_alert
@@ -118,6 +120,18 @@ namespace libtorrent {
 #endif // TORRENT_PICKER_LOG
 namespace libtorrent {
 
+namespace {
+
+	// the storage of a bitfield, as 32 bit words in network byte order
+	std::uint32_t const* bitfield_words(bitfield const& b)
+	{ return reinterpret_cast<std::uint32_t const*>(b.data()); }
+	std::uint32_t* bitfield_words(bitfield& b)
+	{ return reinterpret_cast<std::uint32_t*>(b.data()); }
+
+	// the largest number of bitfields the pending counters can hold
+	int const max_pending_refcounts = (1 << 8) - 1;
+}
+
 	// TODO: find a better place for this
 	const piece_block piece_block::invalid(
 		std::numeric_limits<piece_index_t>::max()
@@ -184,6 +198,10 @@ namespace libtorrent {
 		// allocate the piece_map to cover all pieces
 		// and make them invalid (as if we don't have a single piece)
 		m_piece_map.resize(num_pieces, piece_pos(0, 0));
+		m_have_or_filtered.resize(num_pieces);
+		m_have_or_filtered.clear_all();
+		for (auto const i : m_piece_map.range())
+			if (m_piece_map[i].filtered()) m_have_or_filtered.set_bit(i);
 		m_reverse_cursor = m_piece_map.end_index();
 		m_cursor = piece_index_t(0);
 
@@ -198,6 +216,9 @@ namespace libtorrent {
 		m_filtered_pad_bytes += m_have_filtered_pad_bytes;
 		m_have_filtered_pad_bytes = 0;
 		m_dirty = true;
+		for (auto& p : m_pending_inc) p.clear();
+		for (auto& p : m_pending_dec) p.clear();
+		m_num_pending = 0;
 		for (auto& m : m_piece_map)
 		{
 			m.peer_count = 0;
@@ -252,7 +273,7 @@ namespace libtorrent {
 	{
 		piece_pos const& pp = m_piece_map[index];
 		piece_stats_t ret = {
-			int(pp.peer_count + m_seeds),
+			int(pp.peer_count + m_seeds) + pending_refcount(index),
 			pp.priority(this),
 			pp.have(),
 			pp.downloading()
@@ -481,6 +502,8 @@ namespace libtorrent {
 		TORRENT_ASSERT(m_num_have_filtered + m_num_filtered <= num_pieces());
 		TORRENT_ASSERT(m_num_filtered >= 0);
 		TORRENT_ASSERT(m_seeds >= 0);
+		TORRENT_ASSERT(m_num_pending == 0 || m_dirty);
+		TORRENT_ASSERT(m_num_pending <= max_pending_refcounts);
 		TORRENT_ASSERT(m_have_pad_bytes <= num_pad_bytes());
 		TORRENT_ASSERT(m_have_pad_bytes >= 0);
 		TORRENT_ASSERT(m_filtered_pad_bytes <= num_pad_bytes());
@@ -664,6 +687,9 @@ namespace libtorrent {
 #ifdef TORRENT_DEBUG_REFCOUNTS
 			TORRENT_ASSERT(int(p.have_peers.size()) == p.peer_count + m_seeds);
 #endif
+			TORRENT_ASSERT(m_have_or_filtered.get_bit(piece)
+				== (p.filtered() || have_piece(piece)));
+
 			if (p.have())
 			{
 				++num_have;
@@ -776,6 +802,7 @@ namespace libtorrent {
 	std::pair<int, int> piece_picker::distributed_copies() const
 	{
 		TORRENT_ASSERT(m_seeds >= 0);
+		apply_pending_refcounts();
 		const int npieces = num_pieces();
 
 		if (npieces == 0) return std::make_pair(1, 0);
@@ -1194,6 +1221,10 @@ namespace libtorrent {
 		INVARIANT_CHECK;
 #endif
 
+		// pending decrements may need to break up the seed we're about to
+		// remove, so they have to be applied first
+		apply_pending_refcounts();
+
 		if (m_seeds > 0)
 		{
 			--m_seeds;
@@ -1283,6 +1314,137 @@ namespace libtorrent {
 		m_dirty = true;
 	}
 
+	void piece_picker::add_pending_refcount(std::array<bitfield, 8>& planes
+		, typed_bitfield<piece_index_t> const& bits)
+	{
+		TORRENT_ASSERT(bits.size() <= int(m_piece_map.size()));
+		if (m_num_pending == max_pending_refcounts) apply_pending_refcounts();
+
+		if (planes[0].size() != int(m_piece_map.size()))
+		{
+			// the pending counters are allocated lazily, the first time
+			// they're needed
+			for (auto& p : m_pending_inc) p.resize(int(m_piece_map.size()), false);
+			for (auto& p : m_pending_dec) p.resize(int(m_piece_map.size()), false);
+		}
+
+		std::array<std::uint32_t*, 8> dst;
+		for (std::size_t k = 0; k < planes.size(); ++k)
+			dst[k] = bitfield_words(planes[k]);
+
+		// this is a ripple-carry add of 1 to every counter whose bit is set,
+		// for 32 counters at a time. It's byte order agnostic, so the words
+		// don't need to be converted
+		std::uint32_t const* src = bitfield_words(bits);
+		int const words = bits.num_words();
+		for (int w = 0; w < words; ++w)
+		{
+			std::uint32_t carry = src[w];
+			for (std::size_t k = 0; carry != 0; ++k)
+			{
+				TORRENT_ASSERT(k < dst.size());
+				std::uint32_t const c = dst[k][w] & carry;
+				dst[k][w] ^= carry;
+				carry = c;
+			}
+		}
+		++m_num_pending;
+		m_dirty = true;
+	}
+
+	void piece_picker::apply_pending_refcounts() const
+	{
+		if (m_num_pending == 0) return;
+		TORRENT_ASSERT(m_dirty);
+
+		int const words = m_pending_inc[0].num_words();
+
+		// no counter can be larger than the number of pending bitfields, so
+		// only the planes up to its highest bit can have any bits set
+		std::size_t planes = 0;
+		while ((m_num_pending >> planes) != 0) ++planes;
+		TORRENT_ASSERT(planes <= m_pending_inc.size());
+
+		std::array<std::uint32_t const*, 8> inc;
+		std::array<std::uint32_t const*, 8> dec;
+		for (std::size_t k = 0; k < planes; ++k)
+		{
+			inc[k] = bitfield_words(m_pending_inc[k]);
+			dec[k] = bitfield_words(m_pending_dec[k]);
+		}
+
+		// calls f(piece, increment, decrement) for every piece with a
+		// pending change
+		auto for_each_pending = [&](auto f)
+		{
+			for (int w = 0; w < words; ++w)
+			{
+				std::uint32_t mask = 0;
+				for (std::size_t k = 0; k < planes; ++k)
+					mask |= inc[k][w] | dec[k][w];
+
+				while (mask != 0)
+				{
+					int const bit = aux::count_leading_zeros({&mask, 1});
+					std::uint32_t const m = aux::host_to_network(0x80000000u >> bit);
+					mask &= ~m;
+					int i = 0;
+					int d = 0;
+					for (std::size_t k = 0; k < planes; ++k)
+					{
+						if (inc[k][w] & m) i |= 1 << k;
+						if (dec[k][w] & m) d |= 1 << k;
+					}
+					f(piece_index_t(w * 32 + bit), i, d);
+				}
+			}
+		};
+
+		// a piece whose counter would go below zero is accounted for by
+		// a seed. Break up as many seeds as needed, the same way
+		// dec_refcount() does one at a time. Without seeds, no counter can go
+		// below zero
+		int deficit = 0;
+		if (m_seeds > 0) for_each_pending([&](piece_index_t const piece, int const i, int const d)
+		{
+			int const count = int(m_piece_map[piece].peer_count) + i;
+			deficit = std::max(deficit, d - count);
+		});
+		if (deficit > 0)
+		{
+			TORRENT_ASSERT(m_seeds >= deficit);
+			m_seeds -= deficit;
+			for (auto& m : m_piece_map)
+				m.peer_count += std::uint32_t(deficit);
+		}
+
+		for_each_pending([&](piece_index_t const piece, int const i, int const d)
+		{
+			piece_pos& p = m_piece_map[piece];
+			TORRENT_ASSERT(int(p.peer_count) + i - d >= 0);
+			p.peer_count = std::uint32_t(int(p.peer_count) + i - d);
+		});
+
+		for (std::size_t k = 0; k < planes; ++k)
+		{
+			m_pending_inc[k].clear_all();
+			m_pending_dec[k].clear_all();
+		}
+		m_num_pending = 0;
+	}
+
+	int piece_picker::pending_refcount(piece_index_t const index) const
+	{
+		if (m_num_pending == 0) return 0;
+		int ret = 0;
+		for (std::size_t k = 0; k < m_pending_inc.size(); ++k)
+		{
+			if (m_pending_inc[k].get_bit(static_cast<int>(index))) ret += 1 << k;
+			if (m_pending_dec[k].get_bit(static_cast<int>(index))) ret -= 1 << k;
+		}
+		return ret;
+	}
+
 	void piece_picker::dec_refcount(piece_index_t const index
 		, const torrent_peer* peer)
 	{
@@ -1296,6 +1458,10 @@ namespace libtorrent {
 
 		piece_pos& p = m_piece_map[index];
 
+		// the counter may only look like it's 0 because of pending
+		// increments
+		if (p.peer_count == 0) apply_pending_refcounts();
+
 		if (p.peer_count == 0)
 		{
 			TORRENT_ASSERT(m_seeds > 0);
@@ -1347,8 +1513,6 @@ namespace libtorrent {
 		// pieces end up changing, instead of making
 		// the piece list dirty, just update those pieces
 		// instead
-		TORRENT_ALLOCA(incremented, piece_index_t, size);
-
 		if (!m_dirty)
 		{
 			// first count how many pieces we're updating. If it's few (less than half)
@@ -1356,24 +1520,14 @@ namespace libtorrent {
 			// and mark the picker as dirty, so we'll rebuild it next time we need it.
 			// this only matters if we're not already dirty, in which case the fasted
 			// thing to do is to just update the counters and be done
-			piece_index_t index = piece_index_t(0);
-			int num_inc = 0;
-			for (auto i = bitmask.begin(), end(bitmask.end()); i != end; ++i, ++index)
-			{
-				if (!*i) continue;
-				if (num_inc < size) incremented[num_inc] = index;
-				++num_inc;
-				if (num_inc >= size) break;
-			}
-
-			if (num_inc < size)
+			if (bitmask.count() < size)
 			{
 				// not that many pieces were updated
 				// just update those individually instead of
 				// rebuilding the whole piece list
-				for (int i = 0; i < num_inc; ++i)
+				for (piece_index_t piece = bitmask.find_next_set(piece_index_t(0));
+					piece != bitmask.end_index(); piece = bitmask.find_next_set(next(piece)))
 				{
-					piece_index_t const piece = incremented[i];
 					piece_pos& p = m_piece_map[piece];
 					int prev_priority = p.priority(this);
 					++p.peer_count;
@@ -1392,28 +1546,21 @@ namespace libtorrent {
 			}
 		}
 
-		piece_index_t index = piece_index_t(0);
-		bool updated = false;
-		for (auto i = bitmask.begin(), end(bitmask.end()); i != end; ++i, ++index)
-		{
-			if (*i)
-			{
 #ifdef TORRENT_DEBUG_REFCOUNTS
-				TORRENT_ASSERT(m_piece_map[index].have_peers.count(peer) == 0);
-				m_piece_map[index].have_peers.insert(peer);
+		for (piece_index_t index = bitmask.find_next_set(piece_index_t(0));
+			index != bitmask.end_index(); index = bitmask.find_next_set(next(index)))
+		{
+			TORRENT_ASSERT(m_piece_map[index].have_peers.count(peer) == 0);
+			m_piece_map[index].have_peers.insert(peer);
+			++m_piece_map[index].peer_count;
+		}
+		m_dirty = true;
 #else
-				TORRENT_UNUSED(peer);
+		TORRENT_UNUSED(peer);
+		// the piece list has to be rebuilt anyway, just record the change.
+		// It's applied the next time the counters are needed
+		add_pending_refcount(m_pending_inc, bitmask);
 #endif
-
-				++m_piece_map[index].peer_count;
-				updated = true;
-			}
-		}
-
-		// if we're already dirty, no point in doing anything more
-		if (m_dirty) return;
-
-		if (updated) m_dirty = true;
 	}
 
 	void piece_picker::dec_refcount(typed_bitfield<piece_index_t> const& bitmask
@@ -1443,8 +1590,6 @@ namespace libtorrent {
 		// pieces end up changing, instead of making
 		// the piece list dirty, just update those pieces
 		// instead
-		TORRENT_ALLOCA(decremented, piece_index_t, size);
-
 		if (!m_dirty)
 		{
 			// first count how many pieces we're updating. If it's few (less than half)
@@ -1452,24 +1597,14 @@ namespace libtorrent {
 			// and mark the picker as dirty, so we'll rebuild it next time we need it.
 			// this only matters if we're not already dirty, in which case the fasted
 			// thing to do is to just update the counters and be done
-			piece_index_t index = piece_index_t(0);
-			int num_dec = 0;
-			for (auto i = bitmask.begin(), end(bitmask.end()); i != end; ++i, ++index)
-			{
-				if (!*i) continue;
-				if (num_dec < size) decremented[num_dec] = index;
-				++num_dec;
-				if (num_dec >= size) break;
-			}
-
-			if (num_dec < size)
+			if (bitmask.count() < size)
 			{
 				// not that many pieces were updated
 				// just update those individually instead of
 				// rebuilding the whole piece list
-				for (int i = 0; i < num_dec; ++i)
+				for (piece_index_t piece = bitmask.find_next_set(piece_index_t(0));
+					piece != bitmask.end_index(); piece = bitmask.find_next_set(next(piece)))
 				{
-					piece_index_t const piece = decremented[i];
 					piece_pos& p = m_piece_map[piece];
 					int prev_priority = p.priority(this);
 
@@ -1497,45 +1632,41 @@ namespace libtorrent {
 			}
 		}
 
-		piece_index_t index = piece_index_t(0);
-		bool updated = false;
-		for (auto i = bitmask.begin(), end(bitmask.end()); i != end; ++i, ++index)
+#ifdef TORRENT_DEBUG_REFCOUNTS
+		for (piece_index_t index = bitmask.find_next_set(piece_index_t(0));
+			index != bitmask.end_index(); index = bitmask.find_next_set(next(index)))
 		{
-			if (*i)
+			piece_pos& p = m_piece_map[index];
+			if (p.peer_count == 0)
 			{
-				piece_pos& p = m_piece_map[index];
-				if (p.peer_count == 0)
-				{
-					TORRENT_ASSERT(m_seeds > 0);
-					// this is the case where we have one or more
-					// seeds, and one of them saying: I don't have this
-					// piece anymore. we need to break up one of the seed
-					// counters into actual peer counters on the pieces
-					break_one_seed();
-				}
-
-#ifdef TORRENT_DEBUG_REFCOUNTS
-				TORRENT_ASSERT(p.have_peers.count(peer) == 1);
-				p.have_peers.erase(peer);
-#else
-				TORRENT_UNUSED(peer);
-#endif
-
-				TORRENT_ASSERT(p.peer_count > 0);
-				--p.peer_count;
-				updated = true;
+				TORRENT_ASSERT(m_seeds > 0);
+				// this is the case where we have one or more
+				// seeds, and one of them saying: I don't have this
+				// piece anymore. we need to break up one of the seed
+				// counters into actual peer counters on the pieces
+				break_one_seed();
 			}
-		}
 
-		// if we're already dirty, no point in doing anything more
-		if (m_dirty) return;
+			TORRENT_ASSERT(p.have_peers.count(peer) == 1);
+			p.have_peers.erase(peer);
 
-		if (updated) m_dirty = true;
+			TORRENT_ASSERT(p.peer_count > 0);
+			--p.peer_count;
+		}
+		m_dirty = true;
+#else
+		TORRENT_UNUSED(peer);
+		// the piece list has to be rebuilt anyway, just record the change.
+		// Pieces whose counter would go below zero break up seeds when it's
+		// applied
+		add_pending_refcount(m_pending_dec, bitmask);
+#endif
 	}
 
 	void piece_picker::update_pieces() const
 	{
 		TORRENT_ASSERT(m_dirty);
+		apply_pending_refcounts();
 		if (m_priority_boundaries.empty()) m_priority_boundaries.resize(1, prio_index_t(0));
 #ifdef TORRENT_PICKER_LOG
 		std::cerr << "[" << this << "] " << "update_pieces" << std::endl;
@@ -1764,6 +1895,9 @@ namespace libtorrent {
 		std::cerr << "[" << this << "] " << "piece_picker::we_have_all()\n";
 #endif
 
+		// the piece list won't be dirty after this
+		apply_pending_refcounts();
+
 		m_priority_boundaries.clear();
 		m_priority_boundaries.resize(1, prio_index_t(0));
 		m_block_info.clear();
@@ -1778,6 +1912,7 @@ namespace libtorrent {
 		m_cursor = m_piece_map.end_index();
 		m_reverse_cursor = piece_index_t{0};
 		m_num_have = num_pieces();
+		m_have_or_filtered.set_all();
 
 		for (auto& queue : m_downloads) queue.clear();
 		for (auto& p : m_piece_map)
@@ -1814,6 +1949,7 @@ namespace libtorrent {
 			&& p.piece_priority != piece_pos::filter_priority)
 		{
 			// the piece just got filtered
+			m_have_or_filtered.set_bit(index);
 			if (p.have())
 			{
 				m_have_filtered_pad_bytes += pad_bytes_in_piece(index);
@@ -1853,6 +1989,7 @@ namespace libtorrent {
 			&& p.piece_priority == piece_pos::filter_priority)
 		{
 			// the piece just got unfiltered
+			if (!have_piece(index)) m_have_or_filtered.clear_bit(index);
 			if (p.have())
 			{
 				TORRENT_ASSERT(m_have_filtered_pad_bytes >= pad_bytes_in_piece(index));
@@ -1986,6 +2123,9 @@ namespace {
 		TORRENT_ASSERT(peer == nullptr || peer->in_use);
 		picker_flags_t ret;
 
+		// the availability counters are used to order partial pieces
+		apply_pending_refcounts();
+
 		// prevent the number of partial pieces to grow indefinitely
 		// make this scale by the number of peers we have. For large
 		// scale clients, we would have more peers, and allow a higher
@@ -3297,6 +3437,7 @@ get_out:
 		TORRENT_ASSERT(m_seeds >= 0);
 		INVARIANT_CHECK;
 
+		apply_pending_refcounts();
 		avail.resize(m_piece_map.size());
 		auto j = avail.begin();
 		for (auto i = m_piece_map.begin(), end(m_piece_map.end()); i != end; ++i, ++j)
@@ -3305,7 +3446,7 @@ get_out:
 
 	int piece_picker::get_availability(piece_index_t const piece) const
 	{
-		return m_piece_map[piece].peer_count + m_seeds;
+		return int(m_piece_map[piece].peer_count) + m_seeds + pending_refcount(piece);
 	}
 
 	bool piece_picker::mark_as_writing(piece_block const block, torrent_peer* peer)
@@ -3926,6 +4067,7 @@ get_out:
 	void piece_picker::account_have(piece_index_t const index)
 	{
 		++m_num_have;
+		m_have_or_filtered.set_bit(index);
 		piece_pos& p = m_piece_map[index];
 		TORRENT_ASSERT(!p.have());
 		int const pad_bytes = pad_bytes_in_piece(index);
@@ -3960,6 +4102,10 @@ get_out:
 			TORRENT_ASSERT(m_num_have_filtered > 0);
 			--m_num_have_filtered;
 		}
+		else
+		{
+			m_have_or_filtered.clear_bit(index);
+		}
 		TORRENT_ASSERT(m_have_pad_bytes >= pad_bytes);
 		m_have_pad_bytes -= pad_bytes;
 	}
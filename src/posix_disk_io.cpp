@@ -32,372 +32,878 @@ POSSIBILITY OF SUCH DAMAGE.
 
 */
 
+
 #include "libtorrent/config.hpp"
 #include "libtorrent/posix_disk_io.hpp"
 #include "libtorrent/disk_interface.hpp"
+#include "libtorrent/disk_buffer_holder.hpp"
 #include "libtorrent/aux_/disk_buffer_pool.hpp"
+#include "libtorrent/aux_/posix_disk_job.hpp"
+#include "libtorrent/aux_/disk_job_pool.hpp"
+#include "libtorrent/aux_/disk_job_dispatcher.hpp"
+#include "libtorrent/aux_/store_buffer.hpp"
+#include "libtorrent/aux_/throw.hpp"
 #include "libtorrent/io_context.hpp"
 #include "libtorrent/performance_counters.hpp"
 #include "libtorrent/aux_/session_settings.hpp"
 #include "libtorrent/aux_/path.hpp"
 #include "libtorrent/aux_/numeric_cast.hpp"
 #include "libtorrent/aux_/posix_storage.hpp"
-#include "libtorrent/stat_cache.hpp"
+#include "libtorrent/platform_util.hpp"
+#include "libtorrent/settings_pack.hpp"
+#include "libtorrent/error.hpp"
+#include "libtorrent/debug.hpp"
 #include "libtorrent/file_storage.hpp"
 #include "libtorrent/hasher.hpp"
 #include "libtorrent/add_torrent_params.hpp"
 #include "libtorrent/aux_/storage_free_list.hpp"
 
 #include <vector>
+#include <functional>
+
+#include "libtorrent/aux_/disable_warnings_push.hpp"
+#include <boost/variant/get.hpp>
+#include "libtorrent/aux_/disable_warnings_pop.hpp"
 
 namespace libtorrent {
 
 namespace {
 
 	using aux::posix_storage;
+	using aux::posix_disk_job;
+
+#if TORRENT_USE_ASSERTS
+	bool valid_flags(disk_job_flags_t const flags)
+	{
+		return (flags & ~(disk_interface::force_copy
+				| disk_interface::sequential_access
+				| disk_interface::volatile_read
+				| disk_interface::v1_hash
+				| disk_interface::flush_piece
+				| disk_interface::zero_copy
+				| disk_interface::read_ahead
+				| disk_interface::read_ahead_next_piece))
+			== disk_job_flags_t{};
+	}
+#endif
 
 } // anonymous namespace
 
+	// the disk jobs are queued up and executed by a pool of threads, the same
+	// way as mmap_disk_io. See basic_disk_job_dispatcher
 	struct TORRENT_EXTRA_EXPORT posix_disk_io final
 		: disk_interface
+		, aux::disk_job_executor<posix_disk_job>
 	{
-		posix_disk_io(io_context& ios, settings_interface const& sett, counters& cnt)
-			: m_settings(sett)
-			, m_buffer_pool(ios)
-			, m_stats_counters(cnt)
-			, m_ios(ios)
-		{
-			settings_updated();
-		}
+		posix_disk_io(io_context& ios, settings_interface const& sett, counters& cnt);
+#if TORRENT_USE_ASSERTS
+		~posix_disk_io() override;
+#endif
+
+		void settings_updated() override;
+		storage_holder new_torrent(storage_params const& params
+			, std::shared_ptr<void> const& owner) override;
+		void remove_torrent(storage_index_t) override;
+
+		void abort(bool wait) override;
+
+		void async_read(storage_index_t storage, peer_request const& r
+			, std::function<void(disk_buffer_holder, storage_error const&)> handler
+			, disk_job_flags_t flags = {}) override;
+		bool async_write(storage_index_t storage, peer_request const& r
+			, char const* buf, std::shared_ptr<disk_observer> o
+			, std::function<void(storage_error const&)> handler
+			, disk_job_flags_t flags = {}) override;
+		disk_buffer_holder allocate_disk_buffer(bool& exceeded
+			, std::shared_ptr<disk_observer> o) override;
+		bool async_write(storage_index_t storage, peer_request const& r
+			, disk_buffer_holder buf, std::shared_ptr<disk_observer> o
+			, std::function<void(storage_error const&)> handler
+			, disk_job_flags_t flags = {}) override;
+		void async_hash(storage_index_t storage, piece_index_t piece, span<sha256_hash> v2
+			, disk_job_flags_t flags
+			, std::function<void(piece_index_t, sha1_hash const&, storage_error const&)> handler) override;
+		void async_hash2(storage_index_t storage, piece_index_t piece, int offset, disk_job_flags_t flags
+			, std::function<void(piece_index_t, sha256_hash const&, storage_error const&)> handler) override;
+		void async_move_storage(storage_index_t storage, std::string p, move_flags_t flags
+			, std::function<void(status_t, std::string const&, storage_error const&)> handler) override;
+		void async_release_files(storage_index_t storage
+			, std::function<void()> handler = std::function<void()>()) override;
+		void async_delete_files(storage_index_t storage, remove_flags_t options
+			, std::function<void(storage_error const&)> handler) override;
+		void async_check_files(storage_index_t storage
+			, add_torrent_params const* resume_data
+			, aux::vector<std::string, file_index_t> links
+			, std::function<void(status_t, storage_error const&)> handler) override;
+		void async_rename_file(storage_index_t storage, file_index_t index, std::string name
+			, std::function<void(std::string const&, file_index_t, storage_error const&)> handler) override;
+		void async_stop_torrent(storage_index_t storage
+			, std::function<void()> handler) override;
+		void async_set_file_priority(storage_index_t storage
+			, aux::vector<download_priority_t, file_index_t> prio
+			, std::function<void(storage_error const&
+				, aux::vector<download_priority_t, file_index_t>)> handler) override;
+
+		void async_clear_piece(storage_index_t storage, piece_index_t index
+			, std::function<void(piece_index_t)> handler) override;
+
+		void update_stats_counters(counters& c) const override;
+
+		std::vector<open_file_state> get_status(storage_index_t) const override
+		{ return {}; }
+
+		// this submits all queued up jobs to the thread
+		void submit_jobs() override;
+
+		status_t do_partial_read(posix_disk_job* j);
+		status_t do_read(posix_disk_job* j);
+		status_t do_write(posix_disk_job* j);
+		status_t do_hash(posix_disk_job* j);
+		status_t do_hash2(posix_disk_job* j);
+
+		status_t do_move_storage(posix_disk_job* j);
+		status_t do_release_files(posix_disk_job* j);
+		status_t do_delete_files(posix_disk_job* j);
+		status_t do_check_fastresume(posix_disk_job* j);
+		status_t do_rename_file(posix_disk_job* j);
+		status_t do_stop_torrent(posix_disk_job* j);
+		status_t do_file_priority(posix_disk_job* j);
+		status_t do_clear_piece(posix_disk_job* j);
+
+	private:
+
+		status_t do_job(posix_disk_job* j) override;
+
+		// reads the block at ``offset`` in the job's piece into ``buf``,
+		// unless it's found in the store buffer, in which case ``f`` is called
+		// with a pointer to it
+		int read_block(posix_disk_job* j, int offset, span<char> buf
+			, std::function<void(char const*)> const& f);
+
+		// every write job is inserted into this map while it is in the job queue.
+		// It is removed after the write completes. This will let subsequent reads
+		// pull the buffers straight out of the queue instead of having to
+		// synchronize with the writing thread(s)
+		aux::store_buffer m_store_buffer;
+
+		settings_interface const& m_settings;
+
+		// disk cache
+		aux::disk_buffer_pool m_buffer_pool;
+
+		aux::basic_disk_job_pool<posix_disk_job> m_job_pool;
+
+		counters& m_stats_counters;
+
+		// callbacks are posted on this
+		io_context& m_ios;
+
+		aux::vector<std::shared_ptr<posix_storage>, storage_index_t> m_torrents;
+
+		// slots that are unused in the m_torrents vector
+		aux::storage_free_list m_free_slots;
+
+		aux::basic_disk_job_dispatcher<posix_disk_job> m_dispatcher;
+
+#if TORRENT_USE_ASSERTS
+		int m_magic = 0x1337;
+#endif
+	};
+
+	TORRENT_EXPORT std::unique_ptr<disk_interface> posix_disk_io_constructor(
+		io_context& ios, settings_interface const& sett, counters& cnt)
+	{
+		return std::make_unique<posix_disk_io>(ios, sett, cnt);
+	}
+
+	posix_disk_io::posix_disk_io(io_context& ios, settings_interface const& sett, counters& cnt)
+		: m_settings(sett)
+		, m_buffer_pool(ios)
+		, m_stats_counters(cnt)
+		, m_ios(ios)
+		, m_dispatcher(ios, cnt, m_store_buffer, m_job_pool, *this)
+	{
+		settings_updated();
+	}
 
-		void settings_updated() override
+#if TORRENT_USE_ASSERTS
+	posix_disk_io::~posix_disk_io()
+	{
+		TORRENT_ASSERT(m_magic == 0x1337);
+		m_magic = 0xdead;
+
+		// abort should have been triggered
+		TORRENT_ASSERT(m_dispatcher.aborted());
+
+		// there are not supposed to be any writes in-flight by now
+		TORRENT_ASSERT(m_store_buffer.size() == 0);
+
+		// all torrents are supposed to have been removed by now
+		TORRENT_ASSERT(m_torrents.size() == m_free_slots.size());
+	}
+#endif
+
+	void posix_disk_io::settings_updated()
+	{
+		TORRENT_ASSERT(m_magic == 0x1337);
+		m_buffer_pool.set_settings(m_settings);
+
+		int const num_threads = m_settings.get_int(settings_pack::aio_threads);
+		int const num_hash_threads = m_settings.get_int(settings_pack::hashing_threads);
+
+		m_dispatcher.set_max_threads(num_threads, num_hash_threads);
+	}
+
+	storage_holder posix_disk_io::new_torrent(storage_params const& params
+		, std::shared_ptr<void> const& owner)
+	{
+		TORRENT_ASSERT(params.files.is_valid());
+
+		// make sure we can remove this torrent without causing a memory
+		// allocation, by causing the allocation now instead
+		storage_index_t const idx = m_free_slots.new_index(m_torrents.end_index());
+		auto storage = std::make_shared<posix_storage>(params);
+		storage->set_storage_index(idx);
+		storage->set_owner(owner);
+		if (idx == m_torrents.end_index()) m_torrents.emplace_back(std::move(storage));
+		else m_torrents[idx] = std::move(storage);
+		return storage_holder(idx, *this);
+	}
+
+	void posix_disk_io::remove_torrent(storage_index_t const idx)
+	{
+		TORRENT_ASSERT(m_torrents[idx] != nullptr);
+		m_torrents[idx].reset();
+		m_free_slots.add(idx);
+	}
+
+	void posix_disk_io::abort(bool const wait)
+	{
+		m_dispatcher.abort(wait);
+	}
+
+	namespace {
+
+	using disk_io_fun_t = status_t (posix_disk_io::*)(posix_disk_job* j);
+
+	// this is a jump-table for disk I/O jobs
+	std::array<disk_io_fun_t, 13> const job_functions =
+	{{
+		&posix_disk_io::do_read,
+		&posix_disk_io::do_write,
+		&posix_disk_io::do_hash,
+		&posix_disk_io::do_hash2,
+		&posix_disk_io::do_move_storage,
+		&posix_disk_io::do_release_files,
+		&posix_disk_io::do_delete_files,
+		&posix_disk_io::do_check_fastresume,
+		&posix_disk_io::do_rename_file,
+		&posix_disk_io::do_stop_torrent,
+		&posix_disk_io::do_file_priority,
+		&posix_disk_io::do_clear_piece,
+		&posix_disk_io::do_partial_read,
+	}};
+
+	} // anonymous namespace
+
+	status_t posix_disk_io::do_job(posix_disk_job* j)
+	{
+		TORRENT_ASSERT(static_cast<int>(j->action) < int(job_functions.size()));
+
+		int const idx = static_cast<int>(j->action);
+		return (this->*(job_functions[static_cast<std::size_t>(idx)]))(j);
+	}
+
+	status_t posix_disk_io::do_partial_read(posix_disk_job* j)
+	{
+		auto& buffer = boost::get<disk_buffer_holder>(j->argument);
+		TORRENT_ASSERT(buffer);
+
+		time_point const start_time = clock_type::now();
+
+		span<char> const b = {buffer.data() + j->d.io.buffer_offset, j->d.io.buffer_size};
+
+		int const ret = j->storage->read(m_settings, b, j->piece, j->d.io.offset, j->error);
+
+		TORRENT_ASSERT(ret >= 0 || j->error.ec);
+		TORRENT_UNUSED(ret);
+
+		if (!j->error.ec)
 		{
-			m_buffer_pool.set_settings(m_settings);
+			std::int64_t const read_time = total_microseconds(clock_type::now() - start_time);
+
+			m_stats_counters.inc_stats_counter(counters::num_blocks_read);
+			m_stats_counters.inc_stats_counter(counters::num_read_ops);
+			m_stats_counters.inc_stats_counter(counters::disk_read_time, read_time);
+			m_stats_counters.inc_stats_counter(counters::disk_job_time, read_time);
 		}
+		return status_t::no_error;
+	}
 
-		storage_holder new_torrent(storage_params const& params
-			, std::shared_ptr<void> const&) override
+	status_t posix_disk_io::do_read(posix_disk_job* j)
+	{
+		j->argument = disk_buffer_holder(m_buffer_pool, m_buffer_pool.allocate_buffer("send buffer"), default_block_size);
+		auto& buffer = boost::get<disk_buffer_holder>(j->argument);
+		if (!buffer)
 		{
-			// make sure we can remove this torrent without causing a memory
-			// allocation, by causing the allocation now instead
-			storage_index_t const idx = m_free_slots.new_index(m_torrents.end_index());
-			auto storage = std::make_unique<posix_storage>(params);
-			if (idx == m_torrents.end_index()) m_torrents.emplace_back(std::move(storage));
-			else m_torrents[idx] = std::move(storage);
-			return storage_holder(idx, *this);
+			j->error.ec = error::no_memory;
+			j->error.operation = operation_t::alloc_cache_piece;
+			return status_t::fatal_disk_error;
 		}
 
-		void remove_torrent(storage_index_t const idx) override
+		time_point const start_time = clock_type::now();
+
+		span<char> const b = {buffer.data(), j->d.io.buffer_size};
+
+		int const ret = j->storage->read(m_settings, b, j->piece, j->d.io.offset, j->error);
+
+		TORRENT_ASSERT(ret >= 0 || j->error.ec);
+		TORRENT_UNUSED(ret);
+
+		if (!j->error.ec)
 		{
-			m_torrents[idx].reset();
-			m_free_slots.add(idx);
+			std::int64_t const read_time = total_microseconds(clock_type::now() - start_time);
+
+			m_stats_counters.inc_stats_counter(counters::num_blocks_read);
+			m_stats_counters.inc_stats_counter(counters::num_read_ops);
+			m_stats_counters.inc_stats_counter(counters::disk_read_time, read_time);
+			m_stats_counters.inc_stats_counter(counters::disk_job_time, read_time);
 		}
+		return status_t::no_error;
+	}
 
-		void abort(bool) override {}
+	status_t posix_disk_io::do_write(posix_disk_job* j)
+	{
+		time_point const start_time = clock_type::now();
+		auto buffer = std::move(boost::get<disk_buffer_holder>(j->argument));
 
-		void async_read(storage_index_t storage, peer_request const& r
-			, std::function<void(disk_buffer_holder block, storage_error const& se)> handler
-			, disk_job_flags_t) override
-		{
-			disk_buffer_holder buffer = disk_buffer_holder(m_buffer_pool, m_buffer_pool.allocate_buffer("send buffer"), default_block_size);
-			storage_error error;
-			if (!buffer)
-			{
-				error.ec = errors::no_memory;
-				error.operation = operation_t::alloc_cache_piece;
-				post(m_ios, [this, error, h = std::move(handler)]{ h(disk_buffer_holder(m_buffer_pool, nullptr, 0), error); });
-				return;
-			}
+		span<char> const b = { buffer.data(), j->d.io.buffer_size};
 
-			time_point const start_time = clock_type::now();
+		m_stats_counters.inc_stats_counter(counters::num_writing_threads, 1);
 
-			span<char> const buf = {buffer.data(), r.length};
+		// the actual write operation
+		int const ret = j->storage->write(m_settings, b, j->piece, j->d.io.offset, j->error);
 
-			m_torrents[storage]->read(m_settings, buf, r.piece, r.start, error);
+		m_stats_counters.inc_stats_counter(counters::num_writing_threads, -1);
 
-			if (!error.ec)
-			{
-				std::int64_t const read_time = total_microseconds(clock_type::now() - start_time);
+		if (!j->error.ec)
+		{
+			std::int64_t const write_time = total_microseconds(clock_type::now() - start_time);
 
-				m_stats_counters.inc_stats_counter(counters::num_blocks_read);
-				m_stats_counters.inc_stats_counter(counters::num_read_ops);
-				m_stats_counters.inc_stats_counter(counters::disk_read_time, read_time);
-				m_stats_counters.inc_stats_counter(counters::disk_job_time, read_time);
-			}
+			m_stats_counters.inc_stats_counter(counters::num_blocks_written);
+			m_stats_counters.inc_stats_counter(counters::num_write_ops);
+			m_stats_counters.inc_stats_counter(counters::disk_write_time, write_time);
+			m_stats_counters.inc_stats_counter(counters::disk_job_time, write_time);
+		}
 
-			post(m_ios, [h = std::move(handler), b = std::move(buffer), error] () mutable
-				{ h(std::move(b), error); });
+		m_store_buffer.erase({j->storage->storage_index(), j->piece, j->d.io.offset});
+
+		return ret != j->d.io.buffer_size
+			? status_t::fatal_disk_error : status_t::no_error;
+	}
+
+	void posix_disk_io::async_read(storage_index_t storage, peer_request const& r
+		, std::function<void(disk_buffer_holder, storage_error const&)> handler
+		, disk_job_flags_t const flags)
+	{
+		TORRENT_ASSERT(valid_flags(flags));
+		TORRENT_ASSERT(r.length <= default_block_size);
+		TORRENT_ASSERT(r.length > 0);
+		TORRENT_ASSERT(r.start >= 0);
+		TORRENT_ASSERT(r.start + r.length <= m_torrents[storage]->files().piece_size(r.piece));
+
+		storage_error ec;
+		if (r.length <= 0 || r.start < 0)
+		{
+			// this is an invalid read request.
+			ec.ec = errors::invalid_request;
+			ec.operation = operation_t::file_read;
+			handler(disk_buffer_holder{}, ec);
+			return;
 		}
 
-		bool async_write(storage_index_t storage, peer_request const& r
-			, char const* buf, std::shared_ptr<disk_observer>
-			, std::function<void(storage_error const&)> handler
-			, disk_job_flags_t) override
+		// in case r.start is not aligned to a block, calculate that offset,
+		// since that's how the store_buffer is indexed. block_offset is the
+		// aligned offset to the first block this read touches. In the case the
+		// request is aligned, it's the same as r.start
+		int const block_offset = r.start - (r.start % default_block_size);
+		// this is the offset into the block that we're reading from
+		int const read_offset = r.start - block_offset;
+
+		disk_buffer_holder buffer;
+
+		if (read_offset + r.length > default_block_size)
 		{
-			span<char> const b = { const_cast<char*>(buf), r.length };
+			// This is an unaligned request spanning two blocks. One of the two
+			// blocks may be in the store buffer, or neither.
+			// If neither is in the store buffer, we can just issue a normal
+			// read job for the unaligned request.
+
+			aux::torrent_location const loc1{storage, r.piece, block_offset};
+			aux::torrent_location const loc2{storage, r.piece, block_offset + default_block_size};
+			std::ptrdiff_t const len1 = default_block_size - read_offset;
+
+			TORRENT_ASSERT(r.length > len1);
 
-			time_point const start_time = clock_type::now();
+			int const ret = m_store_buffer.get2(loc1, loc2, [&](char const* buf1, char const* buf2)
+			{
+				buffer = disk_buffer_holder(m_buffer_pool, m_buffer_pool.allocate_buffer("send buffer"), r.length);
+				if (!buffer)
+				{
+					ec.ec = error::no_memory;
+					ec.operation = operation_t::alloc_cache_piece;
+					return 3;
+				}
 
-			storage_error error;
-			m_torrents[storage]->write(m_settings, b, r.piece, r.start, error);
+				if (buf1)
+					std::memcpy(buffer.data(), buf1 + read_offset, std::size_t(len1));
+				if (buf2)
+					std::memcpy(buffer.data() + len1, buf2, std::size_t(r.length - len1));
+				return (buf1 ? 2 : 0) | (buf2 ? 1 : 0);
+			});
 
-			if (!error.ec)
+			if (ret == 3)
 			{
-				std::int64_t const write_time = total_microseconds(clock_type::now() - start_time);
+				// both sides were found in the store buffer and the read request
+				// was satisfied immediately
+				handler(std::move(buffer), ec);
+				return;
+			}
 
-				m_stats_counters.inc_stats_counter(counters::num_blocks_written);
-				m_stats_counters.inc_stats_counter(counters::num_write_ops);
-				m_stats_counters.inc_stats_counter(counters::disk_write_time, write_time);
-				m_stats_counters.inc_stats_counter(counters::disk_job_time, write_time);
+			if (ret != 0)
+			{
+				TORRENT_ASSERT(ret == 1 || ret == 2);
+				// only one side of the read request was found in the store
+				// buffer, and we need to issue a partial read for the remaining
+				// bytes
+				posix_disk_job* j = m_job_pool.allocate_job(aux::job_action_t::partial_read);
+				j->argument = std::move(buffer);
+				j->storage = m_torrents[storage]->shared_from_this();
+				j->piece = r.piece;
+				j->d.io.offset = (ret == 1) ? r.start : block_offset + default_block_size;
+				j->d.io.buffer_size = std::uint16_t((ret == 1) ? len1 : r.length - len1);
+				j->d.io.buffer_offset = std::uint16_t((ret == 1) ? 0 : len1);
+				j->flags = flags;
+				j->callback = std::move(handler);
+				m_dispatcher.add_job(j);
+				return;
 			}
 
-			post(m_ios, [=, h = std::move(handler)]{ h(error); });
-			return false;
+			// if we couldn't find any block in the store buffer, just post it
+			// as a normal read job
 		}
-
-		void async_hash(storage_index_t storage, piece_index_t const piece
-			, span<sha256_hash> block_hashes, disk_job_flags_t flags
-			, std::function<void(piece_index_t, sha1_hash const&, storage_error const&)> handler) override
+		else
 		{
-			time_point const start_time = clock_type::now();
-
-			bool const v1 = bool(flags & disk_interface::v1_hash);
-			bool const v2 = !block_hashes.empty();
+			if (m_store_buffer.get({ storage, r.piece, block_offset }, [&](char const* buf)
+			{
+				buffer = disk_buffer_holder(m_buffer_pool, m_buffer_pool.allocate_buffer("send buffer"), r.length);
+				if (!buffer)
+				{
+					ec.ec = error::no_memory;
+					ec.operation = operation_t::alloc_cache_piece;
+					return;
+				}
 
-			disk_buffer_holder buffer = disk_buffer_holder(m_buffer_pool, m_buffer_pool.allocate_buffer("hash buffer"), default_block_size);
-			storage_error error;
-			if (!buffer)
+				std::memcpy(buffer.data(), buf + read_offset, std::size_t(r.length));
+			}))
 			{
-				error.ec = errors::no_memory;
-				error.operation = operation_t::alloc_cache_piece;
-				post(m_ios, [=, h = std::move(handler)]{ h(piece, sha1_hash{}, error); });
+				handler(std::move(buffer), ec);
 				return;
 			}
-			hasher ph;
+		}
 
-			posix_storage* st = m_torrents[storage].get();
+		posix_disk_job* j = m_job_pool.allocate_job(aux::job_action_t::read);
+		j->storage = m_torrents[storage]->shared_from_this();
+		j->piece = r.piece;
+		j->d.io.offset = r.start;
+		j->d.io.buffer_size = std::uint16_t(r.length);
+		j->flags = flags;
+		j->callback = std::move(handler);
+		m_dispatcher.add_job(j);
+	}
 
-			int const piece_size = v1 ? st->files().piece_size(piece) : 0;
-			int const piece_size2 = v2 ? st->files().piece_size2(piece) : 0;
-			int const blocks_in_piece = v1 ? (piece_size + default_block_size - 1) / default_block_size : 0;
-			int const blocks_in_piece2 = v2 ? st->files().blocks_in_piece2(piece) : 0;
+	disk_buffer_holder posix_disk_io::allocate_disk_buffer(bool& exceeded
+		, std::shared_ptr<disk_observer> o)
+	{
+		exceeded = false;
+		return disk_buffer_holder(m_buffer_pool, m_buffer_pool.allocate_buffer(
+			exceeded, std::move(o), "receive buffer"), default_block_size);
+	}
 
-			TORRENT_ASSERT(!v2 || int(block_hashes.size()) >= blocks_in_piece2);
+	bool posix_disk_io::async_write(storage_index_t const storage, peer_request const& r
+		, char const* buf, std::shared_ptr<disk_observer> o
+		, std::function<void(storage_error const&)> handler
+		, disk_job_flags_t const flags)
+	{
+		bool exceeded = false;
+		disk_buffer_holder buffer(m_buffer_pool, m_buffer_pool.allocate_buffer(
+			exceeded, o, "receive buffer"), default_block_size);
+		if (!buffer) aux::throw_ex<std::bad_alloc>();
+		std::memcpy(buffer.data(), buf, aux::numeric_cast<std::size_t>(r.length));
+
+		async_write(storage, r, std::move(buffer), std::move(o), std::move(handler), flags);
+		return exceeded;
+	}
 
-			int offset = 0;
-			int const blocks_to_read = std::max(blocks_in_piece, blocks_in_piece2);
-			for (int i = 0; i < blocks_to_read; ++i)
-			{
-				bool const v2_block = i < blocks_in_piece2;
-
-				auto const len = v1 ? std::min(default_block_size, piece_size - offset) : 0;
-				auto const len2 = v2_block ? std::min(default_block_size, piece_size2 - offset) : 0;
-
-				span<char> const b = {buffer.data(), std::max(len, len2)};
-				int const ret = st->read(m_settings, b, piece, offset, error);
-				offset += default_block_size;
-				if (ret <= 0) break;
-				if (v1)
-					ph.update(b.first(std::min(ret, len)));
-				if (v2_block)
-					block_hashes[i] = hasher256(b.first(std::min(ret, len2))).final();
-			}
+	bool posix_disk_io::async_write(storage_index_t const storage, peer_request const& r
+		, disk_buffer_holder buffer, std::shared_ptr<disk_observer>
+		, std::function<void(storage_error const&)> handler
+		, disk_job_flags_t const flags)
+	{
+		TORRENT_ASSERT(buffer);
+		TORRENT_ASSERT(r.start % default_block_size == 0);
+		TORRENT_ASSERT(r.length <= default_block_size);
+		TORRENT_ASSERT(r.start + r.length <= m_torrents[storage]->files().piece_size(r.piece));
+
+		posix_disk_job* j = m_job_pool.allocate_job(aux::job_action_t::write);
+		j->storage = m_torrents[storage]->shared_from_this();
+		j->piece = r.piece;
+		j->d.io.offset = r.start;
+		j->d.io.buffer_size = std::uint16_t(r.length);
+		j->argument = std::move(buffer);
+		j->callback = std::move(handler);
+		j->flags = flags;
+
+		m_store_buffer.insert({j->storage->storage_index(), j->piece, j->d.io.offset}
+			, boost::get<disk_buffer_holder>(j->argument).data());
+		m_dispatcher.add_job(j);
+		// the buffer was accounted for when it was allocated
+		return false;
+	}
 
-			sha1_hash const hash = v1 ? ph.final() : sha1_hash();
+	void posix_disk_io::async_hash(storage_index_t const storage
+		, piece_index_t const piece, span<sha256_hash> const v2, disk_job_flags_t const flags
+		, std::function<void(piece_index_t, sha1_hash const&, storage_error const&)> handler)
+	{
+		TORRENT_ASSERT(valid_flags(flags));
+		posix_disk_job* j = m_job_pool.allocate_job(aux::job_action_t::hash);
+		j->storage = m_torrents[storage]->shared_from_this();
+		j->piece = piece;
+		j->d.h.block_hashes = v2;
+		j->callback = std::move(handler);
+		j->flags = flags;
+		m_dispatcher.add_job(j);
+	}
 
-			if (!error.ec)
-			{
-				std::int64_t const read_time = total_microseconds(clock_type::now() - start_time);
+	void posix_disk_io::async_hash2(storage_index_t const storage
+		, piece_index_t const piece, int const offset, disk_job_flags_t const flags
+		, std::function<void(piece_index_t, sha256_hash const&, storage_error const&)> handler)
+	{
+		TORRENT_ASSERT(valid_flags(flags));
+		posix_disk_job* j = m_job_pool.allocate_job(aux::job_action_t::hash2);
+		j->storage = m_torrents[storage]->shared_from_this();
+		j->piece = piece;
+		j->d.io.offset = offset;
+		j->callback = std::move(handler);
+		j->flags = flags;
+		m_dispatcher.add_job(j);
+	}
 
-				m_stats_counters.inc_stats_counter(counters::num_read_back, blocks_to_read);
-				m_stats_counters.inc_stats_counter(counters::num_blocks_read, blocks_to_read);
-				m_stats_counters.inc_stats_counter(counters::num_read_ops, blocks_to_read);
-				m_stats_counters.inc_stats_counter(counters::disk_hash_time, read_time);
-				m_stats_counters.inc_stats_counter(counters::disk_job_time, read_time);
-			}
+	void posix_disk_io::async_move_storage(storage_index_t const storage
+		, std::string p, move_flags_t const flags
+		, std::function<void(status_t, std::string const&, storage_error const&)> handler)
+	{
+		posix_disk_job* j = m_job_pool.allocate_job(aux::job_action_t::move_storage);
+		j->storage = m_torrents[storage]->shared_from_this();
+		j->argument = std::move(p);
+		j->callback = std::move(handler);
+		j->move_flags = flags;
 
-			post(m_ios, [=, h = std::move(handler)]{ h(piece, hash, error); });
-		}
+		m_dispatcher.add_fence_job(j);
+	}
 
-		void async_hash2(storage_index_t storage, piece_index_t const piece, int offset, disk_job_flags_t
-			, std::function<void(piece_index_t, sha256_hash const&, storage_error const&)> handler) override
-		{
-			time_point const start_time = clock_type::now();
+	void posix_disk_io::async_release_files(storage_index_t const storage
+		, std::function<void()> handler)
+	{
+		posix_disk_job* j = m_job_pool.allocate_job(aux::job_action_t::release_files);
+		j->storage = m_torrents[storage]->shared_from_this();
+		j->callback = std::move(handler);
 
-			disk_buffer_holder buffer = disk_buffer_holder(m_buffer_pool, m_buffer_pool.allocate_buffer("hash buffer"), 0x4000);
-			storage_error error;
-			if (!buffer)
-			{
-				error.ec = errors::no_memory;
-				error.operation = operation_t::alloc_cache_piece;
-				post(m_ios, [=, h = std::move(handler)]{ h(piece, sha256_hash{}, error); });
-				return;
-			}
+		m_dispatcher.add_fence_job(j);
+	}
 
-			posix_storage* st = m_torrents[storage].get();
+	void posix_disk_io::async_delete_files(storage_index_t const storage
+		, remove_flags_t const options
+		, std::function<void(storage_error const&)> handler)
+	{
+		m_dispatcher.abort_hash_jobs(m_torrents[storage]);
+		posix_disk_job* j = m_job_pool.allocate_job(aux::job_action_t::delete_files);
+		j->storage = m_torrents[storage]->shared_from_this();
+		j->callback = std::move(handler);
+		j->argument = options;
+		m_dispatcher.add_fence_job(j);
+	}
 
-			int const piece_size = st->files().piece_size2(piece);
+	void posix_disk_io::async_check_files(storage_index_t const storage
+		, add_torrent_params const* resume_data
+		, aux::vector<std::string, file_index_t> links
+		, std::function<void(status_t, storage_error const&)> handler)
+	{
+		posix_disk_job* j = m_job_pool.allocate_job(aux::job_action_t::check_fastresume);
+		j->storage = m_torrents[storage]->shared_from_this();
+		j->argument = resume_data;
+		j->callback = std::move(handler);
 
-			std::ptrdiff_t const len = std::min(default_block_size, piece_size - offset);
+		aux::vector<std::string, file_index_t>* links_vector = nullptr;
+		if (!links.empty()) links_vector = new aux::vector<std::string, file_index_t>(std::move(links));
+		j->d.links = links_vector;
 
-			hasher256 ph;
-			span<char> const b = {buffer.data(), len};
-			int const ret = st->read(m_settings, b, piece, offset, error);
-			if (ret > 0)
-				ph.update(b.first(ret));
+		m_dispatcher.add_fence_job(j);
+	}
 
-			sha256_hash const hash = ph.final();
+	void posix_disk_io::async_rename_file(storage_index_t const storage
+		, file_index_t const index, std::string name
+		, std::function<void(std::string const&, file_index_t, storage_error const&)> handler)
+	{
+		posix_disk_job* j = m_job_pool.allocate_job(aux::job_action_t::rename_file);
+		j->storage = m_torrents[storage]->shared_from_this();
+		j->file_index = index;
+		j->argument = std::move(name);
+		j->callback = std::move(handler);
+		m_dispatcher.add_fence_job(j);
+	}
 
-			if (!error.ec)
-			{
-				std::int64_t const read_time = total_microseconds(clock_type::now() - start_time);
+	void posix_disk_io::async_stop_torrent(storage_index_t const storage
+		, std::function<void()> handler)
+	{
+		auto st = m_torrents[storage]->shared_from_this();
+		m_dispatcher.abort_hash_jobs(m_torrents[storage]);
 
-				m_stats_counters.inc_stats_counter(counters::num_read_back);
-				m_stats_counters.inc_stats_counter(counters::num_blocks_read);
-				m_stats_counters.inc_stats_counter(counters::num_read_ops);
-				m_stats_counters.inc_stats_counter(counters::disk_hash_time, read_time);
-				m_stats_counters.inc_stats_counter(counters::disk_job_time, read_time);
-			}
+		posix_disk_job* j = m_job_pool.allocate_job(aux::job_action_t::stop_torrent);
+		j->storage = st;
+		j->callback = std::move(handler);
+		m_dispatcher.add_fence_job(j);
+	}
 
-			post(m_ios, [=, h = std::move(handler)]{ h(piece, hash, error); });
-		}
+	void posix_disk_io::async_set_file_priority(storage_index_t const storage
+		, aux::vector<download_priority_t, file_index_t> prios
+		, std::function<void(storage_error const&
+			, aux::vector<download_priority_t, file_index_t>)> handler)
+	{
+		posix_disk_job* j = m_job_pool.allocate_job(aux::job_action_t::file_priority);
+		j->storage = m_torrents[storage]->shared_from_this();
+		j->argument = std::move(prios);
+		j->callback = std::move(handler);
 
+		m_dispatcher.add_fence_job(j);
+	}
 
-		void async_move_storage(storage_index_t const storage, std::string p
-			, move_flags_t const flags
-			, std::function<void(status_t, std::string const&, storage_error const&)> handler) override
-		{
-			posix_storage* st = m_torrents[storage].get();
-			storage_error ec;
-			status_t ret;
-			std::tie(ret, p) = st->move_storage(p, flags, ec);
-			post(m_ios, [=, h = std::move(handler)]{ h(ret, p, ec); });
-		}
+	void posix_disk_io::async_clear_piece(storage_index_t const storage
+		, piece_index_t const index, std::function<void(piece_index_t)> handler)
+	{
+		posix_disk_job* j = m_job_pool.allocate_job(aux::job_action_t::clear_piece);
+		j->storage = m_torrents[storage]->shared_from_this();
+		j->piece = index;
+		j->callback = std::move(handler);
+
+		// regular jobs are not guaranteed to be executed in-order
+		// since clear piece must guarantee that all write jobs that
+		// have been issued finish before the clear piece job completes
+		m_dispatcher.add_fence_job(j);
+	}
 
-		void async_release_files(storage_index_t storage, std::function<void()> handler) override
+	int posix_disk_io::read_block(posix_disk_job* j, int const offset
+		, span<char> const buf, std::function<void(char const*)> const& f)
+	{
+		if (m_store_buffer.get({ j->storage->storage_index(), j->piece, offset }, f))
+			return int(buf.size());
+
+		int const ret = j->storage->read(m_settings, buf, j->piece, offset, j->error);
+		if (!j->error.ec)
 		{
-			posix_storage* st = m_torrents[storage].get();
-			st->release_files();
-			if (!handler) return;
-			post(m_ios, [=]{ handler(); });
+			m_stats_counters.inc_stats_counter(counters::num_read_back);
+			m_stats_counters.inc_stats_counter(counters::num_blocks_read);
+			m_stats_counters.inc_stats_counter(counters::num_read_ops);
 		}
+		if (ret > 0) f(buf.data());
+		return ret;
+	}
+
+	status_t posix_disk_io::do_hash(posix_disk_job* j)
+	{
+		TORRENT_ASSERT(m_magic == 0x1337);
+
+		bool const v1 = bool(j->flags & disk_interface::v1_hash);
+		bool const v2 = !j->d.h.block_hashes.empty();
+
+		int const piece_size = v1 ? j->storage->files().piece_size(j->piece) : 0;
+		int const piece_size2 = v2 ? j->storage->files().piece_size2(j->piece) : 0;
+		int const blocks_in_piece = v1 ? (piece_size + default_block_size - 1) / default_block_size : 0;
+		int const blocks_in_piece2 = v2 ? j->storage->files().blocks_in_piece2(j->piece) : 0;
 
-		void async_delete_files(storage_index_t storage, remove_flags_t const options
-			, std::function<void(storage_error const&)> handler) override
+		TORRENT_ASSERT(!v2 || int(j->d.h.block_hashes.size()) >= blocks_in_piece2);
+		TORRENT_ASSERT(v1 || v2);
+
+		disk_buffer_holder buffer(m_buffer_pool, m_buffer_pool.allocate_buffer("hash buffer"), default_block_size);
+		if (!buffer)
 		{
-			storage_error error;
-			posix_storage* st = m_torrents[storage].get();
-			st->delete_files(options, error);
-			post(m_ios, [=, h = std::move(handler)]{ h(error); });
+			j->error.ec = error::no_memory;
+			j->error.operation = operation_t::alloc_cache_piece;
+			return status_t::fatal_disk_error;
 		}
 
-		void async_check_files(storage_index_t storage
-			, add_torrent_params const* resume_data
-			, aux::vector<std::string, file_index_t> links
-			, std::function<void(status_t, storage_error const&)> handler) override
+		hasher h;
+		int ret = 0;
+		int offset = 0;
+		int const blocks_to_read = std::max(blocks_in_piece, blocks_in_piece2);
+		time_point const start_time = clock_type::now();
+		for (int i = 0; i < blocks_to_read; ++i)
 		{
-			posix_storage* st = m_torrents[storage].get();
+			bool const v2_block = i < blocks_in_piece2;
 
-			add_torrent_params tmp;
-			add_torrent_params const* rd = resume_data ? resume_data : &tmp;
+			int const len = v1 ? std::min(default_block_size, piece_size - offset) : 0;
+			int const len2 = v2_block ? std::min(default_block_size, piece_size2 - offset) : 0;
 
-			storage_error error;
-			status_t const ret = [&]
+			ret = read_block(j, offset, {buffer.data(), std::max(len, len2)}
+				, [&](char const* buf)
 			{
-				auto const ret_flag = st->initialize(m_settings, error);
-				if (error) return status_t::fatal_disk_error | ret_flag;
-
-				bool const verify_success = st->verify_resume_data(*rd
-					, std::move(links), error);
-
-				if (m_settings.get_bool(settings_pack::no_recheck_incomplete_resume))
-					return status_t::no_error | ret_flag;
-
-				if (!aux::contains_resume_data(*rd))
-				{
-					// if we don't have any resume data, we still may need to trigger a
-					// full re-check, if there are *any* files.
-					storage_error ignore;
-					return ((st->has_any_file(ignore))
-						? status_t::need_full_check
-						: status_t::no_error)
-						| ret_flag;
-				}
+				if (v1) h.update({ buf, len });
+				if (v2_block) j->d.h.block_hashes[i] = hasher256(span<char const>(buf, len2)).final();
+			});
 
-				return (verify_success
-					? status_t::no_error
-					: status_t::need_full_check)
-					| ret_flag;
-			}();
+			if (ret <= 0) break;
 
-			post(m_ios, [error, ret, h = std::move(handler)]{ h(ret, error); });
+			offset += default_block_size;
 		}
 
-		void async_rename_file(storage_index_t const storage
-			, file_index_t const idx
-			, std::string name
-			, std::function<void(std::string const&, file_index_t, storage_error const&)> handler) override
+		if (!j->error.ec)
 		{
-			posix_storage* st = m_torrents[storage].get();
-			storage_error error;
-			st->rename_file(idx, name, error);
-			post(m_ios, [idx, error, h = std::move(handler), n = std::move(name)] () mutable
-				{ h(std::move(n), idx, error); });
+			std::int64_t const read_time = total_microseconds(clock_type::now() - start_time);
+			m_stats_counters.inc_stats_counter(counters::disk_hash_time, read_time);
+			m_stats_counters.inc_stats_counter(counters::disk_job_time, read_time);
 		}
 
-		void async_stop_torrent(storage_index_t, std::function<void()> handler) override
-		{
-			if (!handler) return;
-			post(m_ios, std::move(handler));
-		}
+		if (v1)
+			j->d.h.piece_hash = h.final();
+		return ret >= 0 ? status_t::no_error : status_t::fatal_disk_error;
+	}
 
-		void async_set_file_priority(storage_index_t const storage
-			, aux::vector<download_priority_t, file_index_t> prio
-			, std::function<void(storage_error const&
-				, aux::vector<download_priority_t, file_index_t>)> handler) override
+	status_t posix_disk_io::do_hash2(posix_disk_job* j)
+	{
+		TORRENT_ASSERT(m_magic == 0x1337);
+
+		int const piece_size = j->storage->files().piece_size2(j->piece);
+
+		TORRENT_ASSERT(piece_size > j->d.io.offset);
+		int const len = std::min(default_block_size, piece_size - j->d.io.offset);
+
+		disk_buffer_holder buffer(m_buffer_pool, m_buffer_pool.allocate_buffer("hash buffer"), default_block_size);
+		if (!buffer)
 		{
-			posix_storage* st = m_torrents[storage].get();
-			storage_error error;
-			st->set_file_priority(m_settings, prio, error);
-			post(m_ios, [p = std::move(prio), h = std::move(handler), error] () mutable
-				{ h(error, std::move(p)); });
+			j->error.ec = error::no_memory;
+			j->error.operation = operation_t::alloc_cache_piece;
+			return status_t::fatal_disk_error;
 		}
 
-		void async_clear_piece(storage_index_t, piece_index_t index
-			, std::function<void(piece_index_t)> handler) override
+		time_point const start_time = clock_type::now();
+
+		hasher256 h;
+		int const ret = read_block(j, j->d.io.offset, {buffer.data(), len}
+			, [&](char const* buf) { h.update({ buf, len }); });
+		if (ret < 0) return status_t::fatal_disk_error;
+
+		if (!j->error.ec)
 		{
-			post(m_ios, [=, h = std::move(handler)]{ h(index); });
+			std::int64_t const read_time = total_microseconds(clock_type::now() - start_time);
+
+			m_stats_counters.inc_stats_counter(counters::disk_hash_time, read_time);
+			m_stats_counters.inc_stats_counter(counters::disk_job_time, read_time);
 		}
 
-		void update_stats_counters(counters&) const override {}
+		j->d.piece_hash2 = h.final();
+		return status_t::no_error;
+	}
 
-		std::vector<open_file_state> get_status(storage_index_t) const override
-		{ return {}; }
+	status_t posix_disk_io::do_move_storage(posix_disk_job* j)
+	{
+		// if this assert fails, something's wrong with the fence logic
+		TORRENT_ASSERT(j->storage->num_outstanding_jobs() == 1);
 
-		void submit_jobs() override {}
+		status_t ret;
+		std::string p;
+		std::tie(ret, p) = j->storage->move_storage(boost::get<std::string>(j->argument)
+			, j->move_flags, j->error);
 
-	private:
+		boost::get<std::string>(j->argument) = p;
+		return ret;
+	}
 
-		aux::vector<std::unique_ptr<posix_storage>, storage_index_t> m_torrents;
+	status_t posix_disk_io::do_release_files(posix_disk_job* j)
+	{
+		// if this assert fails, something's wrong with the fence logic
+		TORRENT_ASSERT(j->storage->num_outstanding_jobs() == 1);
+		j->storage->release_files();
+		return status_t::no_error;
+	}
 
-		// slots that are unused in the m_torrents vector
-		aux::storage_free_list m_free_slots;
+	status_t posix_disk_io::do_delete_files(posix_disk_job* j)
+	{
+		TORRENT_ASSERT(boost::get<remove_flags_t>(j->argument));
 
-		settings_interface const& m_settings;
+		// if this assert fails, something's wrong with the fence logic
+		TORRENT_ASSERT(j->storage->num_outstanding_jobs() == 1);
+		j->storage->delete_files(boost::get<remove_flags_t>(j->argument), j->error);
+		return j->error ? status_t::fatal_disk_error : status_t::no_error;
+	}
 
-		// disk cache
-		aux::disk_buffer_pool m_buffer_pool;
+	status_t posix_disk_io::do_check_fastresume(posix_disk_job* j)
+	{
+		// if this assert fails, something's wrong with the fence logic
+		TORRENT_ASSERT(j->storage->num_outstanding_jobs() == 1);
+
+		std::unique_ptr<aux::vector<std::string, file_index_t>> links(j->d.links);
+		return j->storage->check_files(m_settings
+			, boost::get<add_torrent_params const*>(j->argument)
+			, links ? std::move(*links) : aux::vector<std::string, file_index_t>()
+			, j->error);
+	}
 
-		counters& m_stats_counters;
+	status_t posix_disk_io::do_rename_file(posix_disk_job* j)
+	{
+		// if this assert fails, something's wrong with the fence logic
+		TORRENT_ASSERT(j->storage->num_outstanding_jobs() == 1);
 
-		// callbacks are posted on this
-		io_context& m_ios;
-	};
+		j->storage->rename_file(j->file_index, boost::get<std::string>(j->argument)
+			, j->error);
+		return j->error ? status_t::fatal_disk_error : status_t::no_error;
+	}
 
-	TORRENT_EXPORT std::unique_ptr<disk_interface> posix_disk_io_constructor(
-		io_context& ios, settings_interface const& sett, counters& cnt)
+	status_t posix_disk_io::do_stop_torrent(posix_disk_job* j)
 	{
-		return std::make_unique<posix_disk_io>(ios, sett, cnt);
+		// if this assert fails, something's wrong with the fence logic
+		TORRENT_ASSERT(j->storage->num_outstanding_jobs() == 1);
+		j->storage->release_files();
+		return status_t::no_error;
+	}
+
+	status_t posix_disk_io::do_file_priority(posix_disk_job* j)
+	{
+		j->storage->set_file_priority(m_settings
+			, boost::get<aux::vector<download_priority_t, file_index_t>>(j->argument)
+			, j->error);
+		return status_t::no_error;
+	}
+
+	status_t posix_disk_io::do_clear_piece(posix_disk_job*)
+	{
+		// there's nothing to do here, by the time this is called the jobs for
+		// this storage has been completed since this is a fence job
+		return status_t::no_error;
 	}
-}
 
+	void posix_disk_io::update_stats_counters(counters& c) const
+	{
+		c.set_value(counters::num_read_jobs, m_job_pool.read_jobs_in_use());
+		c.set_value(counters::num_write_jobs, m_job_pool.write_jobs_in_use());
+		c.set_value(counters::num_jobs, m_job_pool.jobs_in_use());
+		c.set_value(counters::queued_disk_jobs, m_dispatcher.num_queued_jobs());
+
+		// gauges
+		c.set_value(counters::disk_blocks_in_use, m_buffer_pool.in_use());
+	}
+
+	void posix_disk_io::submit_jobs()
+	{
+		m_dispatcher.submit_jobs();
+	}
+}
@@ -39,8 +39,16 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/open_mode.hpp"
 #include "libtorrent/aux_/file_pointer.hpp"
 #include "libtorrent/torrent_status.hpp"
+#include "libtorrent/hasher.hpp"
+#include "libtorrent/add_torrent_params.hpp"
+#include "libtorrent/disk_interface.hpp" // for default_block_size
+
+#include <algorithm>
 #ifdef TORRENT_WINDOWS
 #include "libtorrent/utf8.hpp"
+#else
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 using namespace libtorrent::flags; // for flag operators
@@ -186,6 +194,7 @@ namespace aux {
 
 				error_code e;
 				peer_request map = files().map_file(file_index, file_offset, 0);
+				std::lock_guard<std::mutex> l(m_part_file_mutex);
 				int const ret = m_part_file->read(buf, map.piece, map.start, e);
 
 				if (e)
@@ -250,6 +259,7 @@ namespace aux {
 				error_code e;
 				peer_request map = files().map_file(file_index
 					, file_offset, 0);
+				std::lock_guard<std::mutex> l(m_part_file_mutex);
 				int const ret = m_part_file->write(buf, map.piece, map.start, e);
 
 				if (e)
@@ -285,6 +295,97 @@ namespace aux {
 		});
 	}
 
+	int posix_storage::hash(settings_interface const& sett
+		, piece_index_t const piece, bool const v1
+		, span<sha256_hash> const block_hashes, span<char> const scratch
+		, sha1_hash& piece_hash, storage_error& error)
+	{
+		bool const v2 = !block_hashes.empty();
+
+		hasher ph;
+
+		int const piece_size = v1 ? files().piece_size(piece) : 0;
+		int const piece_size2 = v2 ? files().piece_size2(piece) : 0;
+		int const blocks_in_piece = v1 ? (piece_size + default_block_size - 1) / default_block_size : 0;
+		int const blocks_in_piece2 = v2 ? files().blocks_in_piece2(piece) : 0;
+
+		TORRENT_ASSERT(!v2 || int(block_hashes.size()) >= blocks_in_piece2);
+		TORRENT_ASSERT(scratch.size() >= default_block_size);
+
+		int offset = 0;
+		int const blocks_to_read = std::max(blocks_in_piece, blocks_in_piece2);
+		for (int i = 0; i < blocks_to_read; ++i)
+		{
+			bool const v2_block = i < blocks_in_piece2;
+
+			auto const len = v1 ? std::min(default_block_size, piece_size - offset) : 0;
+			auto const len2 = v2_block ? std::min(default_block_size, piece_size2 - offset) : 0;
+
+			span<char> const b = scratch.first(std::max(len, len2));
+			int const ret = read(sett, b, piece, offset, error);
+			offset += default_block_size;
+			if (ret <= 0) break;
+			if (v1)
+				ph.update(b.first(std::min(ret, len)));
+			if (v2_block)
+				block_hashes[i] = hasher256(b.first(std::min(ret, len2))).final();
+		}
+
+		piece_hash = v1 ? ph.final() : sha1_hash();
+		return blocks_to_read;
+	}
+
+	sha256_hash posix_storage::hash2(settings_interface const& sett
+		, piece_index_t const piece, int const offset
+		, span<char> const scratch, storage_error& error)
+	{
+		int const piece_size = files().piece_size2(piece);
+
+		std::ptrdiff_t const len = std::min(default_block_size, piece_size - offset);
+
+		hasher256 ph;
+		span<char> const b = scratch.first(len);
+		int const ret = read(sett, b, piece, offset, error);
+		if (ret > 0)
+			ph.update(b.first(ret));
+
+		return ph.final();
+	}
+
+	status_t posix_storage::check_files(settings_interface const& sett
+		, add_torrent_params const* resume_data
+		, aux::vector<std::string, file_index_t> links
+		, storage_error& error)
+	{
+		add_torrent_params tmp;
+		add_torrent_params const* rd = resume_data ? resume_data : &tmp;
+
+		auto const ret_flag = initialize(sett, error);
+		if (error) return status_t::fatal_disk_error | ret_flag;
+
+		bool const verify_success = verify_resume_data(*rd
+			, std::move(links), error);
+
+		if (sett.get_bool(settings_pack::no_recheck_incomplete_resume))
+			return status_t::no_error | ret_flag;
+
+		if (!aux::contains_resume_data(*rd))
+		{
+			// if we don't have any resume data, we still may need to trigger a
+			// full re-check, if there are *any* files.
+			storage_error ignore;
+			return ((has_any_file(ignore))
+				? status_t::need_full_check
+				: status_t::no_error)
+				| ret_flag;
+		}
+
+		return (verify_success
+			? status_t::no_error
+			: status_t::need_full_check)
+			| ret_flag;
+	}
+
 	bool posix_storage::has_any_file(storage_error& error)
 	{
 		m_stat_cache.reserve(files().num_files());
@@ -476,11 +577,23 @@ namespace aux {
 				// now that we've created the directories, try again
 				// and make sure we create the file this time ("r+") opens for
 				// reading and writing, but doesn't create the file. "w+" creates
-				// the file and truncates it
+				// the file but truncates it, which would race with other disk
+				// threads creating the same file and writing to it. "a" creates
+				// the file without truncating it, then it's re-opened with "r+"
 #ifdef TORRENT_WINDOWS
-				f = ::_wfopen(convert_to_native_path_string(fn).c_str(), L"wb+");
+				f = ::_wfopen(convert_to_native_path_string(fn).c_str(), L"ab");
+				if (f != nullptr)
+				{
+					std::fclose(f);
+					f = ::_wfopen(convert_to_native_path_string(fn).c_str(), mode_str);
+				}
 #else
-				f = std::fopen(fn.c_str(), "wb+");
+				f = std::fopen(fn.c_str(), "ab");
+				if (f != nullptr)
+				{
+					std::fclose(f);
+					f = std::fopen(fn.c_str(), mode_str);
+				}
 #endif
 				if (f == nullptr)
 				{
@@ -512,6 +625,57 @@ namespace aux {
 		return file_pointer{f};
 	}
 
+#ifndef TORRENT_WINDOWS
+	native_fd::~native_fd() { ::close(fd); }
+
+	std::shared_ptr<native_fd const> posix_storage::open_native_file(
+		file_index_t const idx, open_mode_t const mode, storage_error& ec)
+	{
+		file_storage const& fs = files();
+		if (fs.pad_file_at(idx)) return {};
+
+		if (idx < m_file_priority.end_index()
+			&& m_file_priority[idx] == dont_download
+			&& use_partfile(idx))
+			return {};
+
+		bool const write = bool(mode & open_mode::write);
+		if (write) m_stat_cache.set_dirty(idx);
+
+		std::string const fn = fs.file_path(idx, m_save_path);
+		int const flags = (write ? O_RDWR : O_RDONLY) | O_CLOEXEC;
+		int fd = ::open(fn.c_str(), flags);
+		if (fd < 0 && write && errno == ENOENT)
+		{
+			// just like open_file(), create the directory the file is in, and
+			// create the file
+			create_directories(parent_path(fn), ec.ec);
+			if (ec.ec)
+			{
+				ec.file(idx);
+				ec.operation = operation_t::mkdir;
+				return {};
+			}
+			fd = ::open(fn.c_str(), flags | O_CREAT, 0666);
+		}
+
+		if (fd < 0)
+		{
+			ec.ec.assign(errno, generic_category());
+			ec.file(idx);
+			ec.operation = operation_t::file_open;
+			return {};
+		}
+
+		return std::make_shared<native_fd const>(fd);
+	}
+
+	void posix_storage::native_file_written(file_index_t const idx)
+	{
+		m_stat_cache.set_dirty(idx);
+	}
+#endif
+
 	bool posix_storage::use_partfile(file_index_t const index) const
 	{
 		TORRENT_ASSERT_VAL(index >= file_index_t{}, index);
@@ -65,6 +65,7 @@ namespace aux {
 	constexpr torrent_list_index_t session_interface::torrent_downloading_auto_managed;
 	constexpr torrent_list_index_t session_interface::torrent_seeding_auto_managed;
 	constexpr torrent_list_index_t session_interface::torrent_checking_auto_managed;
+	constexpr torrent_list_index_t session_interface::torrent_status_snapshots;
 }
 
 #ifndef TORRENT_DISABLE_EXTENSIONS
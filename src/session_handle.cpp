@@ -42,12 +42,16 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/peer_class.hpp"
 #include "libtorrent/peer_class_type_filter.hpp"
 #include "libtorrent/aux_/scope_end.hpp"
+#include "libtorrent/read_resume_data.hpp"
 
 #if TORRENT_ABI_VERSION == 1
-#include "libtorrent/read_resume_data.hpp"
 #include "libtorrent/magnet_uri.hpp"
 #endif
 
+#include <atomic>
+#include <mutex>
+#include <thread>
+
 using libtorrent::aux::session_impl;
 
 namespace libtorrent {
@@ -229,6 +233,19 @@ namespace libtorrent {
 		async_call(&session_impl::post_torrent_updates, flags);
 	}
 
+	void session_handle::post_torrent_deltas(delta_fields_t const fields)
+	{
+		async_call(&session_impl::post_torrent_deltas, fields);
+	}
+
+	void session_handle::apply_to_torrents(std::vector<torrent_handle> handles
+		, std::function<void(torrent_handle const&)> op
+		, std::uint64_t const batch_id)
+	{
+		async_call(&session_impl::apply_to_torrents, std::move(handles)
+			, std::move(op), batch_id);
+	}
+
 	void session_handle::post_session_stats()
 	{
 		async_call(&session_impl::post_session_stats);
@@ -469,7 +486,11 @@ namespace {
 		async_add_torrent(add_torrent_params(params));
 	}
 
-	void session_handle::async_add_torrent(add_torrent_params&& params)
+namespace {
+
+	// the work done on the calling thread before a torrent is posted to the
+	// network thread by async_add_torrent() and async_add_torrents()
+	void prepare_async_add_torrent(add_torrent_params& params)
 	{
 		TORRENT_ASSERT_PRECOND(!params.save_path.empty());
 
@@ -483,22 +504,170 @@ namespace {
 		if (params.ti)
 			params.ti = std::make_shared<torrent_info>(*params.ti);
 
+		params.save_path = complete(params.save_path);
+
+#if TORRENT_ABI_VERSION == 1
+		handle_backwards_compatible_resume_data(params);
+#endif
+	}
+
+	// the number of torrents posted to the network thread in one job by
+	// async_add_torrents()
+	int const add_torrent_batch_size = 256;
+}
+
+	void session_handle::async_add_torrent(add_torrent_params&& params)
+	{
 		// we cannot capture a unique_ptr into a lambda in c++11, so we use a raw
 		// pointer for now. async_call uses a lambda expression to post the call
 		// to the main thread
 		// TODO: in C++14, use unique_ptr and move it into the lambda
 		auto* p = new add_torrent_params(std::move(params));
 		auto guard = aux::scope_end([p]{ delete p; });
-		p->save_path = complete(p->save_path);
-
-#if TORRENT_ABI_VERSION == 1
-		handle_backwards_compatible_resume_data(*p);
-#endif
+		prepare_async_add_torrent(*p);
 
 		async_call(&session_impl::async_add_torrent, p);
 		guard.disarm();
 	}
 
+	void session_handle::async_add_torrents(std::vector<add_torrent_params> params)
+	{
+		add_torrents_impl(int(params.size())
+			, [&params](int const i, add_torrent_params& atp, error_code&)
+		{
+			atp = std::move(params[std::size_t(i)]);
+			prepare_async_add_torrent(atp);
+		});
+	}
+
+	void session_handle::async_add_torrents(std::vector<std::vector<char>> resume_data
+		, std::string const& default_save_path, load_torrent_limits const& cfg)
+	{
+		TORRENT_ASSERT_PRECOND(!default_save_path.empty());
+		add_torrents_impl(int(resume_data.size())
+			, [&](int const i, add_torrent_params& atp, error_code& ec)
+		{
+			auto& buf = resume_data[std::size_t(i)];
+			// the torrent_info is parsed here and not shared with the client,
+			// so unlike async_add_torrent(), there's no need to copy it
+			atp = read_resume_data(buf, ec, cfg);
+			// the buffer is no longer needed, free it as we go
+			std::vector<char>().swap(buf);
+			if (ec) return;
+			if (atp.save_path.empty()) atp.save_path = default_save_path;
+			atp.save_path = complete(atp.save_path);
+		});
+	}
+
+	void session_handle::add_torrents_impl(int const num
+		, std::function<void(int, add_torrent_params&, error_code&)> const& prepare)
+	{
+		std::shared_ptr<session_impl> s = m_impl.lock();
+		if (!s) aux::throw_ex<system_error>(errors::invalid_session_handle);
+
+		int const num_batches = (num + add_torrent_batch_size - 1) / add_torrent_batch_size;
+		if (num_batches == 0) return;
+
+		// batches are prepared in parallel, but posted in order, to add the
+		// torrents in the order they were passed in. A batch is posted as soon
+		// as it and all batches before it are ready, so the network thread
+		// can start adding torrents while the rest are still being prepared
+		std::vector<std::unique_ptr<aux::add_torrent_batch>> ready(static_cast<std::size_t>(num_batches));
+		std::mutex ready_mutex;
+		int next_to_post = 0;
+		std::atomic<int> next_batch{0};
+
+		// if posting a batch fails (e.g. because the session is shutting
+		// down) the remaining batches are abandoned and the exception is
+		// rethrown on the calling thread
+		std::exception_ptr post_error;
+
+		auto worker = [&]
+		{
+			for (int b = next_batch++; b < num_batches; b = next_batch++)
+			{
+				time_point const start = clock_type::now();
+				std::unique_ptr<aux::add_torrent_batch> batch(new aux::add_torrent_batch);
+				int const first = b * add_torrent_batch_size;
+				int const last = std::min(num, first + add_torrent_batch_size);
+				batch->params.resize(std::size_t(last - first));
+				batch->errors.resize(std::size_t(last - first));
+				for (int i = first; i < last; ++i)
+				{
+					add_torrent_params& atp = batch->params[std::size_t(i - first)];
+					error_code& ec = batch->errors[std::size_t(i - first)];
+#ifndef BOOST_NO_EXCEPTIONS
+					try {
+#endif
+						prepare(i, atp, ec);
+#ifndef BOOST_NO_EXCEPTIONS
+					} catch (system_error const& e) {
+						ec = e.code();
+					} catch (std::bad_alloc const&) {
+						ec = errors::no_memory;
+					} catch (...) {
+						ec = error_code(boost::system::errc::invalid_argument, generic_category());
+					}
+#endif
+				}
+				batch->prepare_time = clock_type::now() - start;
+
+				std::lock_guard<std::mutex> l(ready_mutex);
+				if (post_error) return;
+				ready[std::size_t(b)] = std::move(batch);
+				while (next_to_post < num_batches && ready[std::size_t(next_to_post)])
+				{
+#ifndef BOOST_NO_EXCEPTIONS
+					try {
+#endif
+						// see async_add_torrent() for why this is a raw pointer
+						async_call(&session_impl::async_add_torrents
+							, ready[std::size_t(next_to_post)].get());
+#ifndef BOOST_NO_EXCEPTIONS
+					} catch (...) {
+						post_error = std::current_exception();
+						next_batch = num_batches;
+						return;
+					}
+#endif
+					ready[std::size_t(next_to_post)].release();
+					++next_to_post;
+				}
+			}
+		};
+
+		int const num_threads = std::min(num_batches
+			, std::max(1, int(std::thread::hardware_concurrency())));
+		std::vector<std::thread> threads;
+		threads.reserve(std::size_t(num_threads - 1));
+
+		// the threads must be joined on every path out of here, including when
+		// the calling thread's own share of the work throws
+		auto join_threads = aux::scope_end([&threads] {
+			for (auto& t : threads) t.join();
+		});
+
+#ifndef BOOST_NO_EXCEPTIONS
+		try
+		{
+#endif
+			for (int i = 1; i < num_threads; ++i)
+				threads.emplace_back(worker);
+#ifndef BOOST_NO_EXCEPTIONS
+		}
+		catch (std::system_error const&)
+		{
+			// if we fail to start a thread, make do with the ones we have
+		}
+#endif
+		worker();
+		join_threads.disarm();
+		for (auto& t : threads) t.join();
+
+		if (post_error) std::rethrow_exception(post_error);
+		TORRENT_ASSERT(next_to_post == num_batches);
+	}
+
 #ifndef BOOST_NO_EXCEPTIONS
 #if TORRENT_ABI_VERSION == 1
 	// if the torrent already exists, this will throw duplicate_torrent
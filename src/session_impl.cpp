@@ -1061,6 +1061,10 @@ bool ssl_server_name_callback(ssl::stream_handle_type stream_handle, std::string
 
 		m_close_file_timer.cancel();
 
+#if !defined TORRENT_DISABLE_ENCRYPTION
+		m_dh_key_pool.set_size(0);
+#endif
+
 		// abort the main thread
 		m_abort = true;
 		error_code ec;
@@ -1138,6 +1142,9 @@ bool ssl_server_name_callback(ssl::stream_handle_type stream_handle, std::string
 				l->sock->close(ec);
 				TORRENT_ASSERT(!ec);
 			}
+#if TORRENT_HAS_REUSEPORT
+			for (auto& s : l->shards) s->close();
+#endif
 
 			// TODO: 3 closing the udp sockets here means that
 			// the uTP connections cannot be closed gracefully
@@ -1687,6 +1694,22 @@ namespace {
 			}
 #endif // TORRENT_WINDOWS
 
+#if TORRENT_HAS_REUSEPORT
+			if (m_settings.get_int(settings_pack::listen_shards) > 0)
+			{
+				// the listen shards bind to the same endpoint
+				error_code err;
+				ret->sock->set_option(reuse_port(true), err);
+#ifndef TORRENT_DISABLE_LOGGING
+				if (err && should_log())
+				{
+					session_log("failed enable reuse-port on listen socket: %s"
+						, err.message().c_str());
+				}
+#endif // TORRENT_DISABLE_LOGGING
+			}
+#endif // TORRENT_HAS_REUSEPORT
+
 			if (is_v6(bind_ep))
 			{
 				error_code err; // ignore errors here
@@ -1828,6 +1851,10 @@ namespace {
 				}
 				return ret;
 			}
+
+#if TORRENT_HAS_REUSEPORT
+			open_listen_shards(*ret, lep.device);
+#endif
 		} // accept incoming
 
 		socket_type_t const udp_sock_type
@@ -2155,6 +2182,9 @@ namespace {
 			}
 #endif
 			if ((*remove_iter)->sock) (*remove_iter)->sock->close(ec);
+#if TORRENT_HAS_REUSEPORT
+			for (auto& s : (*remove_iter)->shards) s->close();
+#endif
 			if ((*remove_iter)->udp_sock) (*remove_iter)->udp_sock->sock.close();
 			if ((*remove_iter)->natpmp_mapper) (*remove_iter)->natpmp_mapper->close();
 			if ((*remove_iter)->upnp_mapper) (*remove_iter)->upnp_mapper->close();
@@ -2482,15 +2512,7 @@ namespace {
 		auto s = std::static_pointer_cast<aux::listen_socket_t>(si)->udp_sock;
 
 		s->sock.send_hostname(hostname, port, p, ec, flags);
-
-		if ((ec == error::would_block || ec == error::try_again)
-			&& !s->write_blocked)
-		{
-			s->write_blocked = true;
-			ADD_OUTSTANDING_ASYNC("session_impl::on_udp_writeable");
-			s->sock.async_write(std::bind(&session_impl::on_udp_writeable
-				, this, s, _1));
-		}
+		on_udp_sent(s, ec);
 	}
 
 	void session_impl::send_udp_packet(std::weak_ptr<utp_socket_interface> sock
@@ -2516,6 +2538,15 @@ namespace {
 			|| s->sock.local_endpoint().protocol() == ep.protocol());
 
 		s->sock.send(ep, p, ec, flags);
+		on_udp_sent(s, ec);
+	}
+
+	void session_impl::on_udp_sent(std::shared_ptr<session_udp_socket> const& s
+		, error_code const& ec)
+	{
+		m_stats_counters.inc_stats_counter(counters::udp_send_syscalls
+			, s->sock.send_syscalls());
+		if (!ec) m_stats_counters.inc_stats_counter(counters::udp_send_packets);
 
 		if ((ec == error::would_block || ec == error::try_again) && !s->write_blocked)
 		{
@@ -2524,6 +2555,38 @@ namespace {
 			s->sock.async_write(std::bind(&session_impl::on_udp_writeable
 				, this, s, _1));
 		}
+
+		// packets queued by the udp socket are sent in a batch once we're done
+		// with the current handler. This collects all packets produced while
+		// handling incoming packets, or while filling a uTP congestion window
+		if (s->sock.has_queued_packets() && !s->flush_pending)
+		{
+			s->flush_pending = true;
+			std::weak_ptr<session_udp_socket> sock = s;
+			post(m_io_context, [this, sock] { wrap(&session_impl::flush_udp_socket, sock); });
+		}
+	}
+
+	void session_impl::flush_udp_socket(std::weak_ptr<session_udp_socket> sock)
+	{
+		auto s = sock.lock();
+		if (!s) return;
+
+		s->flush_pending = false;
+		if (s->write_blocked) return;
+
+		error_code ec;
+		s->sock.flush(ec);
+		m_stats_counters.inc_stats_counter(counters::udp_send_syscalls
+			, s->sock.send_syscalls());
+
+		if (ec == error::would_block || ec == error::try_again)
+		{
+			s->write_blocked = true;
+			ADD_OUTSTANDING_ASYNC("session_impl::on_udp_writeable");
+			s->sock.async_write(std::bind(&session_impl::on_udp_writeable
+				, this, s, _1));
+		}
 	}
 
 	void session_impl::on_udp_writeable(std::weak_ptr<session_udp_socket> sock, error_code const& ec)
@@ -2536,6 +2599,21 @@ namespace {
 
 		s->write_blocked = false;
 
+		// send the packets that were left in the queue when the socket's send
+		// buffer filled up
+		error_code err;
+		s->sock.flush(err);
+		m_stats_counters.inc_stats_counter(counters::udp_send_syscalls
+			, s->sock.send_syscalls());
+		if (err == error::would_block || err == error::try_again)
+		{
+			s->write_blocked = true;
+			ADD_OUTSTANDING_ASYNC("session_impl::on_udp_writeable");
+			s->sock.async_write(std::bind(&session_impl::on_udp_writeable
+				, this, s, _1));
+			return;
+		}
+
 #ifdef TORRENT_SSL_PEERS
 		auto i = std::find_if(
 			m_listen_sockets.begin(), m_listen_sockets.end()
@@ -2595,9 +2673,13 @@ namespace {
 
 		for (;;)
 		{
-			aux::array<udp_socket::packet, 50> p;
+			aux::array<udp_socket::packet, udp_socket::read_batch_size> p;
 			error_code err;
 			int const num_packets = s->sock.read(p, err);
+			m_stats_counters.inc_stats_counter(counters::udp_recv_syscalls
+				, s->sock.read_syscalls());
+			m_stats_counters.inc_stats_counter(counters::udp_recv_packets
+				, num_packets);
 
 			for (udp_socket::packet& packet : span<udp_socket::packet>(p).first(num_packets))
 			{
@@ -2820,7 +2902,82 @@ namespace {
 			return;
 		}
 		async_accept(listener, ssl);
+		accept_incoming(std::move(s), listener, ssl);
+	}
+
+#if TORRENT_HAS_REUSEPORT
+	void session_impl::open_listen_shards(listen_socket_t& ls
+		, std::string const& device)
+	{
+		int const num_shards = m_settings.get_int(settings_pack::listen_shards);
+		std::weak_ptr<tcp::acceptor> const listener(ls.sock);
+		transport const ssl = ls.ssl;
+		for (int i = 0; i < num_shards; ++i)
+		{
+			auto shard = std::make_unique<listen_shard>(m_io_context
+				, [this, listener, ssl](error_code const& e, true_tcp_socket s)
+				{ wrap(&session_impl::on_shard_accept, std::move(s), e, listener, ssl); });
+			error_code ec;
+			shard->open(ls.local_endpoint, device
+				, m_settings.get_int(settings_pack::listen_queue_size), ec);
+			if (ec)
+			{
+				// the listen socket still accepts connections on its own
+#ifndef TORRENT_DISABLE_LOGGING
+				if (should_log())
+				{
+					session_log("failed to open listen shard on %s: %s"
+						, print_endpoint(ls.local_endpoint).c_str(), ec.message().c_str());
+				}
+#endif
+				break;
+			}
+			ls.shards.push_back(std::move(shard));
+		}
+	}
+
+	void session_impl::on_shard_accept(true_tcp_socket s, error_code const& e
+		, std::weak_ptr<tcp::acceptor> listen_socket, transport const ssl)
+	{
+		TORRENT_ASSERT(is_single_thread());
+		m_stats_counters.inc_stats_counter(counters::on_accept_counter);
+
+		std::shared_ptr<tcp::acceptor> listener = listen_socket.lock();
+		if (!listener) return;
+
+		if (m_abort) return;
 
+		if (e)
+		{
+			// the shard tries again by itself
+			error_code ec;
+			tcp::endpoint const ep = listener->local_endpoint(ec);
+#ifndef TORRENT_DISABLE_LOGGING
+			if (should_log())
+			{
+				session_log("error accepting connection on listen shard '%s': %s"
+					, print_endpoint(ep).c_str(), e.message().c_str());
+			}
+#endif
+			if (m_alerts.should_post<listen_failed_alert>())
+			{
+				m_alerts.emplace_alert<listen_failed_alert>(ep.address().to_string()
+					, ep, operation_t::sock_accept, e
+					, ssl == transport::ssl ? socket_type_t::tcp_ssl : socket_type_t::tcp);
+			}
+			return;
+		}
+
+		accept_incoming(std::move(s), listener, ssl);
+	}
+#endif // TORRENT_HAS_REUSEPORT
+
+	void session_impl::accept_incoming(true_tcp_socket s
+		, std::shared_ptr<tcp::acceptor> const& listener, transport const ssl)
+	{
+#ifndef TORRENT_SSL_PEERS
+		TORRENT_UNUSED(ssl);
+#endif
 		// don't accept any connections from our local listen sockets if we're
 		// using a proxy. We should only accept peers via the proxy, never
 		// directly.
@@ -3575,27 +3732,6 @@ namespace {
 			recalculate_auto_managed_torrents();
 		}
 
-		// --------------------------------------------------------------
-		// check for incoming connections that might have timed out
-		// --------------------------------------------------------------
-
-		for (auto i = m_connections.begin(); i != m_connections.end();)
-		{
-			peer_connection* p = (*i).get();
-			++i;
-			// ignore connections that already have a torrent, since they
-			// are ticked through the torrents' second_tick
-			if (!p->associated_torrent().expired()) continue;
-
-			// TODO: have a separate list for these connections, instead of having to loop through all of them
-			int timeout = m_settings.get_int(settings_pack::handshake_timeout);
-#if TORRENT_USE_I2P
-			timeout *= is_i2p(p->get_socket()) ? 4 : 1;
-#endif
-			if (m_last_tick - p->connected_time () > seconds(timeout))
-				p->disconnect(errors::timed_out, operation_t::bittorrent);
-		}
-
 		// --------------------------------------------------------------
 		// second_tick every torrent (that wants it)
 		// --------------------------------------------------------------
@@ -3620,6 +3756,37 @@ namespace {
 			if (!t.want_tick()) --i;
 		}
 
+		// --------------------------------------------------------------
+		// tick the peer connections that are due
+		// --------------------------------------------------------------
+
+		// this includes incoming connections that haven't been attached to a
+		// torrent yet, to time out their handshake
+		m_peer_ticks.advance([tick_interval_ms](std::weak_ptr<peer_connection> const& c
+			, std::int64_t const tick)
+		{
+			std::shared_ptr<peer_connection> p = c.lock();
+			if (p) p->on_tick_due(tick, tick_interval_ms);
+		});
+
+		// --------------------------------------------------------------
+		// publish status snapshots of torrents that changed
+		// --------------------------------------------------------------
+
+		aux::vector<torrent*>& snapshots = m_torrent_lists[torrent_status_snapshots];
+		if (!snapshots.empty())
+		{
+#if TORRENT_USE_ASSERTS
+			m_posting_torrent_updates = true;
+#endif
+			for (torrent* t : snapshots)
+				t->publish_status_snapshot();
+			snapshots.clear();
+#if TORRENT_USE_ASSERTS
+			m_posting_torrent_updates = false;
+#endif
+		}
+
 		// TODO: this should apply to all bandwidth channels
 		if (m_settings.get_bool(settings_pack::rate_limit_ip_overhead))
 		{
@@ -4780,17 +4947,15 @@ namespace {
 		m_posting_torrent_updates = true;
 #endif
 
+		// the torrents that don't fit in this update are posted first in the
+		// next one, since the torrent lists are always pushed back
+		int const num = num_state_updates();
 		std::vector<torrent_status> status;
-		status.reserve(state_updates.size());
+		status.reserve(std::size_t(num));
 
-		// TODO: it might be a nice feature here to limit the number of torrents
-		// to send in a single update. By just posting the first n torrents, they
-		// would nicely be round-robined because the torrent lists are always
-		// pushed back. Perhaps the status_update_alert could even have a fixed
-		// array of n entries rather than a vector, to further improve memory
-		// locality.
-		for (auto& t : state_updates)
+		for (int i = m_state_update_head; i < m_state_update_head + num; ++i)
 		{
+			torrent* t = state_updates[std::size_t(i)];
 			TORRENT_ASSERT(t->m_links[aux::session_impl::torrent_state_updates].in_list());
 			status.emplace_back();
 			// querying accurate download counters may require
@@ -4800,7 +4965,7 @@ namespace {
 			t->status(&status.back(), flags);
 			t->clear_in_state_update();
 		}
-		state_updates.clear();
+		pop_state_updates(num);
 
 #if TORRENT_USE_ASSERTS
 		m_posting_torrent_updates = false;
@@ -4809,6 +4974,111 @@ namespace {
 		m_alerts.emplace_alert<state_update_alert>(std::move(status));
 	}
 
+	void session_impl::post_torrent_deltas(delta_fields_t const fields)
+	{
+		INVARIANT_CHECK;
+
+		TORRENT_ASSERT(is_single_thread());
+
+		std::vector<torrent*>& state_updates
+			= m_torrent_lists[aux::session_impl::torrent_state_updates];
+
+#if TORRENT_USE_ASSERTS
+		m_posting_torrent_updates = true;
+#endif
+
+		int const num = num_state_updates();
+		std::vector<torrent_status_delta> deltas;
+		deltas.reserve(std::size_t(num));
+
+		// scratch space for the byte counters of each torrent
+		torrent_status st;
+		for (int i = m_state_update_head; i < m_state_update_head + num; ++i)
+		{
+			torrent* t = state_updates[std::size_t(i)];
+			TORRENT_ASSERT(t->m_links[aux::session_impl::torrent_state_updates].in_list());
+			deltas.emplace_back();
+			if (!t->status_delta(&deltas.back(), fields, st))
+				deltas.pop_back();
+			t->clear_in_state_update();
+		}
+		pop_state_updates(num);
+
+#if TORRENT_USE_ASSERTS
+		m_posting_torrent_updates = false;
+#endif
+
+		m_alerts.emplace_alert<state_delta_alert>(std::move(deltas));
+	}
+
+	void session_impl::apply_to_torrents(std::vector<torrent_handle> const& handles
+		, std::function<void(torrent_handle const&)> const& op
+		, std::uint64_t const batch_id)
+	{
+		TORRENT_ASSERT(is_single_thread());
+
+		std::vector<std::pair<torrent_handle, error_code>> failed;
+		for (auto const& h : handles)
+		{
+			// a removed torrent may still be kept alive by outstanding jobs
+			std::shared_ptr<torrent> const t = h.native_handle();
+			if (!t || t->is_aborted())
+			{
+				failed.emplace_back(h, errors::invalid_torrent_handle);
+				continue;
+			}
+#ifndef BOOST_NO_EXCEPTIONS
+			try {
+#endif
+				// calls made through the handle are dispatched, and since
+				// we're already on the network thread, they run right away
+				op(h);
+#ifndef BOOST_NO_EXCEPTIONS
+			} catch (system_error const& e) {
+				failed.emplace_back(h, e.code());
+			} catch (...) {
+				failed.emplace_back(h, error_code());
+			}
+#endif
+		}
+
+		int const num_applied = int(handles.size()) - int(failed.size());
+		m_alerts.emplace_alert<batch_complete_alert>(batch_id, num_applied
+			, std::move(failed));
+	}
+
+	int session_impl::num_state_updates() const
+	{
+		int const num = int(m_torrent_lists[torrent_state_updates].size()) - m_state_update_head;
+		int const limit = m_settings.get_int(settings_pack::max_state_updates);
+		return limit > 0 ? std::min(num, limit) : num;
+	}
+
+	void session_impl::pop_state_updates(int const n)
+	{
+		aux::vector<torrent*>& list = m_torrent_lists[torrent_state_updates];
+		TORRENT_ASSERT(n >= 0 && m_state_update_head + n <= int(list.size()));
+		m_state_update_head += n;
+		int const remaining = int(list.size()) - m_state_update_head;
+		if (remaining == 0)
+		{
+			list.clear();
+			m_state_update_head = 0;
+		}
+		else if (m_state_update_head >= remaining)
+		{
+			// torrents may keep being added to the back of the list as fast as
+			// they're posted from the front, and then it never drains. Move
+			// the remaining torrents to the front once they're outnumbered by
+			// stale entries. That costs no more than the posts that made those
+			// entries stale
+			list.erase(list.begin(), list.begin() + m_state_update_head);
+			for (int i = 0; i < remaining; ++i)
+				list[i]->m_links[torrent_state_updates].index = i;
+			m_state_update_head = 0;
+		}
+	}
+
 	void session_impl::post_session_stats()
 	{
 		if (!m_posted_stats_header)
@@ -4886,6 +5156,40 @@ namespace {
 		add_torrent(std::move(*params), ec);
 	}
 
+	void session_impl::async_add_torrents(add_torrent_batch* batch)
+	{
+		std::unique_ptr<add_torrent_batch> holder(batch);
+		TORRENT_ASSERT(batch->params.size() == batch->errors.size());
+
+		time_point const start = clock_type::now();
+		for (std::size_t i = 0; i < batch->params.size(); ++i)
+		{
+			if (batch->errors[i])
+			{
+				m_alerts.emplace_alert<add_torrent_alert>(torrent_handle()
+					, std::move(batch->params[i]), batch->errors[i]);
+				continue;
+			}
+			error_code ec;
+			add_torrent(std::move(batch->params[i]), ec);
+		}
+		time_duration const add_time = clock_type::now() - start;
+
+		m_stats_counters.inc_stats_counter(counters::add_torrent_prepare_time
+			, total_microseconds(batch->prepare_time));
+		m_stats_counters.inc_stats_counter(counters::add_torrent_time
+			, total_microseconds(add_time));
+
+#ifndef TORRENT_DISABLE_LOGGING
+		if (should_log())
+		{
+			session_log("added batch of %d torrents in %d ms (prepared in %d ms)"
+				, int(batch->params.size()), int(total_milliseconds(add_time))
+				, int(total_milliseconds(batch->prepare_time)));
+		}
+#endif
+	}
+
 #ifndef TORRENT_DISABLE_EXTENSIONS
 	void session_impl::add_extensions_to_torrent(
 		std::shared_ptr<torrent> const& torrent_ptr, client_data_t const userdata)
@@ -5101,6 +5405,9 @@ namespace {
 		{
 			l.reserve(num_torrents + 1);
 		}
+		// the state update list may hold as many stale entries as torrents
+		// (see m_state_update_head)
+		m_torrent_lists[torrent_state_updates].reserve(num_torrents * 2 + 1);
 
 		try
 		{
@@ -5512,6 +5819,16 @@ namespace {
 		}
 	}
 
+	void session_impl::update_status_snapshots()
+	{
+		bool const enabled = m_settings.get_bool(settings_pack::status_snapshots);
+		for (auto const& tp : m_torrents)
+		{
+			if (enabled) tp->snapshot_updated();
+			else tp->clear_status_snapshot();
+		}
+	}
+
 	// TODO: 2 this function should be removed and users need to deal with the
 	// more generic case of having multiple listen ports
 	std::uint16_t session_impl::listen_port() const
@@ -6492,6 +6809,21 @@ namespace {
 		m_alerts.set_alert_queue_size_limit(m_settings.get_int(settings_pack::alert_queue_size));
 	}
 
+	void session_impl::update_dh_key_pool_size()
+	{
+#if !defined TORRENT_DISABLE_ENCRYPTION
+		if (m_abort) return;
+#ifdef TORRENT_BUILD_SIMULATOR
+		// the simulator's random engine is a single, non thread-local
+		// instance. Generating keys on another thread would race with the
+		// network thread and make simulations non-deterministic
+		m_dh_key_pool.set_size(0);
+#else
+		m_dh_key_pool.set_size(m_settings.get_int(settings_pack::dh_key_pool_size));
+#endif
+#endif
+	}
+
 	bool session_impl::preemptive_unchoke() const
 	{
 		if (settings().get_int(settings_pack::choking_algorithm) != settings_pack::fixed_slots_choker) return false;
@@ -7156,9 +7488,12 @@ namespace {
 			for (torrent_list_index_t l{}; l != m_torrent_lists.end_index(); ++l)
 			{
 				std::vector<torrent*> const& list = m_torrent_lists[l];
-				for (auto const& i : list)
+				// the entries before the head of the state update list are
+				// stale
+				int const first = l == torrent_state_updates ? m_state_update_head : 0;
+				for (int i = first; i < int(list.size()); ++i)
 				{
-					TORRENT_ASSERT(i->m_links[l].in_list());
+					TORRENT_ASSERT(list[std::size_t(i)]->m_links[l].in_list());
 				}
 
 				queue_position_t idx{};
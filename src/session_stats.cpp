@@ -191,6 +191,14 @@ namespace {
 		METRIC(net, recv_ip_overhead_bytes)
 		METRIC(net, recv_tracker_bytes)
 
+		// the number of bytes sent to peers with sendfile(), directly from
+		// the file. These are included in sent_payload_bytes
+		METRIC(net, sent_sendfile_bytes)
+
+		// the number of payload bytes received from peers directly into disk
+		// buffers. These are included in recv_payload_bytes
+		METRIC(net, recv_direct_bytes)
+
 		// the number of sockets currently waiting for upload and download
 		// bandwidth from the rate limiter.
 		METRIC(net, limiter_up_queue)
@@ -246,6 +254,12 @@ namespace {
 		METRIC(ses, num_have_pieces)
 		METRIC(ses, num_total_pieces_added)
 
+		// cumulative time spent by session::async_add_torrents() preparing
+		// torrents on the calling threads (e.g. parsing resume data), and
+		// adding them on the network thread. Measured in microseconds
+		METRIC(ses, add_torrent_prepare_time)
+		METRIC(ses, add_torrent_time)
+
 		// the number of allowed unchoked peers
 		METRIC(ses, num_unchoke_slots)
 
@@ -372,6 +386,25 @@ namespace {
 		// hash a piece (when verifying against the piece hash)
 		METRIC(disk, num_read_back)
 
+		// the number of blocks read by referencing the file's memory mapping
+		// directly, rather than copying it into a disk buffer. See
+		// settings_pack::zero_copy_upload
+		METRIC(disk, num_zero_copy_reads)
+
+		// the number of times a piece (or the remainder of one) was hinted to
+		// be read ahead, and the number of blocks that were, or weren't, in
+		// the page cache by the time they were read. Only counted when
+		// settings_pack::piece_read_ahead is enabled, and for blocks that are
+		// memory mapped.
+		METRIC(disk, num_read_ahead_ops)
+		METRIC(disk, num_read_ahead_hits)
+		METRIC(disk, num_read_ahead_misses)
+
+		// the number of block writes that were performed together with an
+		// earlier queued write to the same piece. Only counted when
+		// settings_pack::coalesce_piece_writes is enabled
+		METRIC(disk, num_coalesced_writes)
+
 		// cumulative time spent in various disk jobs, as well
 		// as total for all disk jobs. Measured in microseconds
 		METRIC(disk, disk_read_time)
@@ -509,6 +542,19 @@ namespace {
 		// the outgoing ACK is lost.
 		METRIC(utp, utp_redundant_pkts_in)
 
+		// the number of system calls made to receive packets from the UDP
+		// sockets, and the number of packets they returned. On linux,
+		// recvmmsg() is used to receive multiple packets per call, the ratio
+		// of these counters is the average number of packets per system call
+		METRIC(net, udp_recv_syscalls)
+		METRIC(net, udp_recv_packets)
+
+		// the number of system calls made to send packets on the UDP sockets,
+		// and the number of packets sent. On linux, packets are queued and
+		// sent in batches with sendmmsg(), and UDP_SEGMENT where possible
+		METRIC(net, udp_send_syscalls)
+		METRIC(net, udp_send_packets)
+
 		// the number of uTP sockets in each respective state
 		METRIC(utp, num_utp_idle)
 		METRIC(utp, num_utp_syn_sent)
@@ -239,6 +239,12 @@ constexpr int DISK_WRITE_MODE = settings_pack::enable_os_cache;
 		SET(allow_idna, false, nullptr),
 		SET(enable_set_file_valid_data, false, nullptr),
 		SET(socks5_udp_send_local_ep, false, nullptr),
+		SET(zero_copy_upload, false, nullptr),
+		SET(sendfile_upload, false, nullptr),
+		SET(coalesce_piece_writes, false, nullptr),
+		SET(piece_read_ahead, false, nullptr),
+		SET(direct_piece_receive, false, nullptr),
+		SET(status_snapshots, false, &session_impl::update_status_snapshots),
 	}});
 
 	CONSTEXPR_SETTINGS
@@ -366,8 +372,8 @@ constexpr int DISK_WRITE_MODE = settings_pack::enable_os_cache;
 		SET(out_enc_policy, settings_pack::pe_enabled, nullptr),
 		SET(in_enc_policy, settings_pack::pe_enabled, nullptr),
 		SET(allowed_enc_level, settings_pack::pe_both, nullptr),
-		SET(inactive_down_rate, 2048, nullptr),
-		SET(inactive_up_rate, 2048, nullptr),
+		SET(inactive_down_rate, 2048, &session_impl::update_count_slow),
+		SET(inactive_up_rate, 2048, &session_impl::update_count_slow),
 		SET(proxy_type, settings_pack::none, &session_impl::update_proxy),
 		SET(proxy_port, 0, &session_impl::update_proxy),
 		SET(i2p_port, 0, &session_impl::update_i2p_bridge),
@@ -402,7 +408,14 @@ constexpr int DISK_WRITE_MODE = settings_pack::enable_os_cache;
 		SET(i2p_outbound_quantity, 3, nullptr),
 		SET(i2p_inbound_length, 3, nullptr),
 		SET(i2p_outbound_length, 3, nullptr),
-		SET(announce_port, 0, nullptr)
+		SET(announce_port, 0, nullptr),
+		SET(dh_key_pool_size, 0, &session_impl::update_dh_key_pool_size),
+		SET(listen_shards, 0, nullptr),
+		SET(max_state_updates, 0, nullptr),
+		SET(status_snapshot_flags, int(static_cast<std::uint32_t>(torrent_handle::query_accurate_download_counters
+			| torrent_handle::query_last_seen_complete
+			| torrent_handle::query_name
+			| torrent_handle::query_save_path)), &session_impl::update_status_snapshots)
 	}});
 
 #undef SET
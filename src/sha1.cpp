@@ -21,6 +21,9 @@ changelog at the end of the file.
 #include <cstdio>
 #include <cstring>
 
+#include "libtorrent/aux_/hash_batch.hpp"
+#include "libtorrent/aux_/cpuid.hpp"
+
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 #include <boost/predef/other/endian.h>
 #include "libtorrent/aux_/disable_warnings_pop.hpp"
@@ -154,10 +157,22 @@ using u8 = std::uint8_t;
 		if ((j + len) > 63)
 		{
 			memcpy(&context->buffer[j], data, (i = 64-j));
-			SHA1transform<BlkFun>(context->state, context->buffer);
-			for ( ; i + 63 < len; i += 64)
+#if TORRENT_HAS_SHA_X86
+			if (aux::sha_ni_support)
+			{
+				aux::sha1_ni_blocks(context->state, context->buffer, 1);
+				size_t const blocks = (len - i) / 64;
+				aux::sha1_ni_blocks(context->state, &data[i], blocks);
+				i += blocks * 64;
+			}
+			else
+#endif
 			{
-				SHA1transform<BlkFun>(context->state, &data[i]);
+				SHA1transform<BlkFun>(context->state, context->buffer);
+				for ( ; i + 63 < len; i += 64)
+				{
+					SHA1transform<BlkFun>(context->state, &data[i]);
+				}
 			}
 			j = 0;
 		}
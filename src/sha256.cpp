@@ -9,6 +9,9 @@
 
 #include <cstring>
 
+#include "libtorrent/aux_/hash_batch.hpp"
+#include "libtorrent/aux_/cpuid.hpp"
+
 namespace libtorrent { namespace {
 
 	using u32 = std::uint32_t;
@@ -64,6 +67,14 @@ namespace libtorrent { namespace {
 
 	void sha_compress(sha256_ctx& md, const unsigned char* buf)
 	{
+#if TORRENT_HAS_SHA_X86
+		if (aux::sha_ni_support)
+		{
+			aux::sha256_ni_blocks(md.state, buf, 1);
+			return;
+		}
+#endif
+
 		u32 S[8], W[64], t0, t1, t;
 
 		// Copy state into S
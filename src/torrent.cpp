@@ -636,6 +636,7 @@ bool is_downloading_state(int const st)
 		update_want_scrape();
 		update_want_tick();
 		update_state_list();
+		snapshot_updated();
 
 		if (m_torrent_file->is_valid())
 		{
@@ -990,6 +991,7 @@ bool is_downloading_state(int const st)
 
 		set_need_save_resume(torrent_handle::if_state_changed);
 		update_gauge();
+		update_want_tick();
 		state_updated();
 		send_upload_only();
 
@@ -4933,6 +4935,7 @@ namespace {
 			if (!m_links[i].in_list()) continue;
 			m_links[i].unlink(m_ses.torrent_list(i), i);
 		}
+		clear_status_snapshot();
 		// don't re-add this torrent to the state-update list
 		m_state_subscription = false;
 	}
@@ -8124,11 +8127,20 @@ namespace {
 		if (!is_finished() && !m_web_seeds.empty() && m_files_checked)
 			return true;
 
-		if (m_stat.low_pass_upload_rate() > 0 || m_stat.low_pass_download_rate() > 0)
-			return true;
+		// the transfer rates need to fade out to 0
+		if (!m_stat.is_idle()) return true;
 
-		// if we don't get ticks we won't become inactive
-		if (!m_paused && !m_inactive) return true;
+		// leaving upload mode is retried periodically
+		if (m_upload_mode && m_auto_managed && !m_paused) return true;
+
+		// without peers or transfers, the only state left to change is
+		// becoming inactive. Once that change is pending (or if it doesn't
+		// apply), an idle torrent has nothing to do until it's woken up by a
+		// new connection, a state change or an API call
+		if (!m_paused && !m_inactive && !m_pending_active_change
+			&& settings().get_bool(settings_pack::dont_count_slow_torrents)
+			&& is_inactive_internal())
+			return true;
 
 		return false;
 	}
@@ -8138,6 +8150,12 @@ namespace {
 		update_list(aux::session_interface::torrent_want_tick, want_tick());
 	}
 
+	void torrent::wake_tick()
+	{
+		if (m_links[aux::session_interface::torrent_want_tick].in_list()) return;
+		update_want_tick();
+	}
+
 	// this function adjusts which lists this torrent is part of (checking,
 	// seeding or downloading)
 	void torrent::update_state_list()
@@ -8253,6 +8271,7 @@ namespace {
 			TORRENT_LIST_NAME(torrent_downloading_auto_managed);
 			TORRENT_LIST_NAME(torrent_seeding_auto_managed);
 			TORRENT_LIST_NAME(torrent_checking_auto_managed);
+			TORRENT_LIST_NAME(torrent_status_snapshots);
 			default: TORRENT_ASSERT_FAIL_VAL(idx);
 		}
 #undef TORRENT_LIST_NAME
@@ -9317,6 +9336,7 @@ namespace {
 		m_auto_managed = a;
 		update_gauge();
 		update_want_scrape();
+		update_want_tick();
 		update_state_list();
 
 		state_updated();
@@ -10255,18 +10275,11 @@ namespace {
 
 		maybe_connect_web_seeds();
 
-		m_swarm_last_seen_complete = m_last_seen_complete;
-		for (auto p : m_connections)
-		{
-			TORRENT_INCREMENT(m_iterating_connections);
-
-			// look for the peer that saw a seed most recently
-			m_swarm_last_seen_complete = std::max(p->last_seen_complete(), m_swarm_last_seen_complete);
-
-			// updates the peer connection's ul/dl bandwidth
-			// resource requests
-			p->second_tick(tick_interval_ms);
-		}
+		// the peer connections are ticked by the session, when they're due.
+		// They report the last time they saw a seed through
+		// peer_seen_complete()
+		m_swarm_last_seen_complete = std::max(m_swarm_last_seen_complete
+			, m_last_seen_complete);
 #if TORRENT_ABI_VERSION <= 2
 		if (m_ses.alerts().should_post<stats_alert>())
 			m_ses.alerts().emplace_alert<stats_alert>(get_handle(), tick_interval_ms, m_stat);
@@ -10326,6 +10339,9 @@ namespace {
 	{
 		m_pending_active_change = false;
 
+		// whether we want ticks depends on a change being pending
+		update_want_tick();
+
 		if (ec) return;
 
 		bool const is_inactive = is_inactive_internal();
@@ -10522,30 +10538,35 @@ namespace {
 	{
 		m_stat.sent_bytes(bytes_payload, bytes_protocol);
 		m_ses.sent_bytes(bytes_payload, bytes_protocol);
+		wake_tick();
 	}
 
 	void torrent::received_bytes(int const bytes_payload, int const bytes_protocol)
 	{
 		m_stat.received_bytes(bytes_payload, bytes_protocol);
 		m_ses.received_bytes(bytes_payload, bytes_protocol);
+		wake_tick();
 	}
 
 	void torrent::trancieve_ip_packet(int const bytes, bool const ipv6)
 	{
 		m_stat.trancieve_ip_packet(bytes, ipv6);
 		m_ses.trancieve_ip_packet(bytes, ipv6);
+		wake_tick();
 	}
 
 	void torrent::sent_syn(bool const ipv6)
 	{
 		m_stat.sent_syn(ipv6);
 		m_ses.sent_syn(ipv6);
+		wake_tick();
 	}
 
 	void torrent::received_synack(bool const ipv6)
 	{
 		m_stat.received_synack(ipv6);
 		m_ses.received_synack(ipv6);
+		wake_tick();
 	}
 
 #ifndef TORRENT_DISABLE_STREAMING
@@ -11741,6 +11762,8 @@ namespace {
 		// is building the status update alert
 		TORRENT_ASSERT(!m_ses.is_posting_torrent_updates());
 
+		snapshot_updated();
+
 		// we're not subscribing to this torrent, don't add it
 		if (!m_state_subscription) return;
 
@@ -11750,19 +11773,62 @@ namespace {
 		// add it to the list twice
 		if (m_links[aux::session_interface::torrent_state_updates].in_list())
 		{
-#ifdef TORRENT_EXPENSIVE_INVARIANT_CHECKS
-			TORRENT_ASSERT(find(list.begin(), list.end(), this) != list.end());
-#endif
+			TORRENT_ASSERT(list[m_links[aux::session_interface::torrent_state_updates].index] == this);
 			return;
 		}
 
-#ifdef TORRENT_EXPENSIVE_INVARIANT_CHECKS
-		TORRENT_ASSERT(find(list.begin(), list.end(), this) == list.end());
-#endif
+		// the front of the list may still have stale entries for torrents
+		// that have already been posted, including this one
 
 		m_links[aux::session_interface::torrent_state_updates].insert(list, this);
 	}
 
+	void torrent::snapshot_updated()
+	{
+		if (m_abort) return;
+		if (!settings().get_bool(settings_pack::status_snapshots)) return;
+		update_list(aux::session_interface::torrent_status_snapshots, true);
+	}
+
+	std::shared_ptr<torrent_status const> torrent::make_status_snapshot()
+	{
+		status_flags_t const flags(static_cast<std::uint32_t>(
+			settings().get_int(settings_pack::status_snapshot_flags)));
+		auto st = std::make_shared<torrent_status>();
+		status(st.get(), flags);
+		return st;
+	}
+
+	void torrent::publish_status_snapshot()
+	{
+		TORRENT_ASSERT(is_single_thread());
+		TORRENT_ASSERT(m_links[aux::session_interface::torrent_status_snapshots].in_list());
+		std::shared_ptr<torrent_status const> st = make_status_snapshot();
+		{
+			std::lock_guard<std::mutex> l(m_status_snapshot_mutex);
+			m_status_snapshot.swap(st);
+		}
+		// the previous snapshot (now in st) is released outside of the lock
+
+		// the session clears the whole list once all torrents are published
+		m_links[aux::session_interface::torrent_status_snapshots].clear();
+	}
+
+	void torrent::clear_status_snapshot()
+	{
+		TORRENT_ASSERT(is_single_thread());
+		update_list(aux::session_interface::torrent_status_snapshots, false);
+		std::shared_ptr<torrent_status const> st;
+		std::lock_guard<std::mutex> l(m_status_snapshot_mutex);
+		m_status_snapshot.swap(st);
+	}
+
+	std::shared_ptr<torrent_status const> torrent::status_snapshot() const
+	{
+		std::lock_guard<std::mutex> l(m_status_snapshot_mutex);
+		return m_status_snapshot;
+	}
+
 	void torrent::post_status(status_flags_t const flags)
 	{
 		std::vector<torrent_status> s;
@@ -11771,6 +11837,119 @@ namespace {
 		m_ses.alerts().emplace_alert<state_update_alert>(std::move(s));
 	}
 
+	bool torrent::status_delta(torrent_status_delta* d, delta_fields_t const fields
+		, torrent_status& st)
+	{
+		INVARIANT_CHECK;
+
+		d->handle = get_handle();
+		d->fields = {};
+
+		torrent_status_delta& posted = m_posted_status;
+		auto const update = [&](delta_fields_t const f, bool const changed)
+		{
+			if ((posted.fields & f) && !changed) return false;
+			d->fields |= f;
+			posted.fields |= f;
+			return true;
+		};
+
+		// only the fields that were asked for are computed. They are computed
+		// the same way as in status()
+		if (fields & torrent_status_delta::state_field)
+		{
+			auto const state = valid_metadata()
+				? static_cast<torrent_status::state_t>(m_state)
+				: torrent_status::downloading_metadata;
+			if (update(torrent_status_delta::state_field, posted.state != state))
+				d->state = posted.state = state;
+		}
+
+		if (fields & torrent_status_delta::flags_field)
+		{
+			torrent_flags_t const f = this->flags();
+			if (update(torrent_status_delta::flags_field, posted.flags != f))
+				d->flags = posted.flags = f;
+		}
+
+		// the byte counters are the expensive part, only compute them if
+		// they're needed
+		if (fields & (torrent_status_delta::progress_field | torrent_status_delta::done_fields))
+			bytes_done(st, {});
+
+		if (fields & torrent_status_delta::progress_field)
+		{
+			int const progress_ppm
+				= !valid_metadata() || m_state == torrent_status::checking_files
+				? int(m_progress_ppm)
+				: st.total_wanted == 0 ? 1000000
+				: int(st.total_wanted_done * 1000000 / st.total_wanted);
+			if (update(torrent_status_delta::progress_field, posted.progress_ppm != progress_ppm))
+				d->progress_ppm = posted.progress_ppm = progress_ppm;
+		}
+
+		if (fields & torrent_status_delta::rate_fields)
+		{
+			int const down = m_stat.download_payload_rate();
+			int const up = m_stat.upload_payload_rate();
+			if (update(torrent_status_delta::rate_fields
+				, posted.download_payload_rate != down || posted.upload_payload_rate != up))
+			{
+				d->download_payload_rate = posted.download_payload_rate = down;
+				d->upload_payload_rate = posted.upload_payload_rate = up;
+			}
+		}
+
+		if (fields & torrent_status_delta::peer_fields)
+		{
+			int const peers = num_peers() - m_num_connecting;
+			int const seeds = valid_metadata() ? num_seeds() : 0;
+			if (update(torrent_status_delta::peer_fields
+				, posted.num_peers != peers || posted.num_seeds != seeds))
+			{
+				d->num_peers = posted.num_peers = peers;
+				d->num_seeds = posted.num_seeds = seeds;
+			}
+		}
+
+		if (fields & torrent_status_delta::done_fields)
+		{
+			if (update(torrent_status_delta::done_fields
+				, posted.total_done != st.total_done
+				|| posted.total_wanted_done != st.total_wanted_done))
+			{
+				d->total_done = posted.total_done = st.total_done;
+				d->total_wanted_done = posted.total_wanted_done = st.total_wanted_done;
+			}
+		}
+
+		if (fields & torrent_status_delta::all_time_fields)
+		{
+			if (update(torrent_status_delta::all_time_fields
+				, posted.all_time_upload != m_total_uploaded
+				|| posted.all_time_download != m_total_downloaded))
+			{
+				d->all_time_upload = posted.all_time_upload = m_total_uploaded;
+				d->all_time_download = posted.all_time_download = m_total_downloaded;
+			}
+		}
+
+		if (fields & torrent_status_delta::queue_position_field)
+		{
+			queue_position_t const pos = queue_position();
+			if (update(torrent_status_delta::queue_position_field, posted.queue_position != pos))
+				d->queue_position = posted.queue_position = pos;
+		}
+
+		if (fields & torrent_status_delta::error_field)
+		{
+			if (update(torrent_status_delta::error_field, posted.errc != m_error))
+				d->errc = posted.errc = m_error;
+		}
+
+		return bool(d->fields);
+	}
+
 	void torrent::status(torrent_status* st, status_flags_t const flags)
 	{
 		INVARIANT_CHECK;
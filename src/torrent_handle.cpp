@@ -504,6 +504,22 @@ namespace libtorrent {
 		async_call(&torrent::post_status, flags);
 	}
 
+	std::shared_ptr<torrent_status const> torrent_handle::status_snapshot() const
+	{
+		std::shared_ptr<torrent> t = m_torrent.lock();
+#ifndef BOOST_NO_EXCEPTIONS
+		if (!t) throw_invalid_handle();
+#else
+		if (!t) return {};
+#endif
+		// this is published by the network thread, reading it doesn't
+		// require synchronizing with it
+		std::shared_ptr<torrent_status const> st = t->status_snapshot();
+		if (st) return st;
+		return sync_call_ret<std::shared_ptr<torrent_status const>>(nullptr
+			, &torrent::make_status_snapshot);
+	}
+
 	void torrent_handle::post_piece_availability() const
 	{
 		async_call(&torrent::post_piece_availability);
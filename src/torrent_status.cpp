@@ -41,6 +41,16 @@ namespace libtorrent {
 	file_index_t constexpr torrent_status::error_file_partfile;
 	file_index_t constexpr torrent_status::error_file_metadata;
 
+	constexpr delta_fields_t torrent_status_delta::state_field;
+	constexpr delta_fields_t torrent_status_delta::flags_field;
+	constexpr delta_fields_t torrent_status_delta::progress_field;
+	constexpr delta_fields_t torrent_status_delta::rate_fields;
+	constexpr delta_fields_t torrent_status_delta::peer_fields;
+	constexpr delta_fields_t torrent_status_delta::done_fields;
+	constexpr delta_fields_t torrent_status_delta::all_time_fields;
+	constexpr delta_fields_t torrent_status_delta::queue_position_field;
+	constexpr delta_fields_t torrent_status_delta::error_field;
+
 	torrent_status::torrent_status() noexcept {}
 	torrent_status::~torrent_status() = default;
 	torrent_status::torrent_status(torrent_status const&) = default;
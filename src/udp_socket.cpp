@@ -51,7 +51,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/resolver_interface.hpp"
 
 #include <cstdlib>
+#include <cstring> // for memcpy
 #include <functional>
+#include <algorithm>
 
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 #include <boost/asio/ip/v6_only.hpp>
@@ -62,6 +64,22 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <mstcpip.h>
 #endif
 
+#if TORRENT_USE_RECVMMSG || TORRENT_USE_SENDMMSG
+#include <sys/socket.h>
+#include <sys/uio.h> // for iovec
+#endif
+
+#if TORRENT_USE_SENDMMSG
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <cerrno>
+
+// UDP generic segmentation offload was added in linux 4.18
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#endif
+
 namespace libtorrent {
 
 using namespace std::placeholders;
@@ -72,6 +90,23 @@ std::size_t const tmp_buffer_size = 270;
 // used for SOCKS5 UDP wrapper header
 std::size_t const max_header_size = 255;
 
+#if TORRENT_USE_SENDMMSG
+namespace {
+
+	// the max number of packets queued by send(), before they are sent
+	// synchronously
+	std::size_t const max_send_batch = 64;
+
+	// the kernel's limit on the number of segments in a UDP_SEGMENT buffer
+	// (UDP_MAX_SEGMENTS)
+	int const max_gso_segments = 64;
+
+	// the payload of a UDP_SEGMENT buffer must fit in a single (unfragmented)
+	// UDP datagram
+	int const max_gso_size = 65000;
+}
+#endif
+
 // this class hold the state of the SOCKS5 connection to maintain the UDP
 // ASSOCIATE tunnel. It's instantiated on the heap for two reasons:
 //
@@ -188,7 +223,7 @@ struct set_dont_frag
 udp_socket::udp_socket(io_context& ios, aux::listen_socket_handle ls)
 	: m_socket(ios)
 	, m_ioc(ios)
-	, m_buf(new receive_buffer())
+	, m_buf(new receive_buffer[read_batch_size])
 	, m_listen_socket(std::move(ls))
 	, m_bind_port(0)
 	, m_abort(true)
@@ -196,14 +231,18 @@ udp_socket::udp_socket(io_context& ios, aux::listen_socket_handle ls)
 
 int udp_socket::read(span<packet> pkts, error_code& ec)
 {
-	auto const num = int(pkts.size());
+	auto const num = int(std::min(std::size_t(pkts.size()), read_batch_size));
+	span<receive_buffer> bufs(m_buf.get(), int(read_batch_size));
 	int ret = 0;
-	packet p;
+	m_read_syscalls = 0;
 
-	while (ret < num)
+	// every datagram is received into its own buffer, to keep the packets we
+	// return valid until the next call. Packets we drop still use up their
+	// buffer, so we may return fewer than num packets
+	while (ret < num && !bufs.empty())
 	{
-		int const len = int(m_socket.receive_from(boost::asio::buffer(*m_buf)
-			, p.from, 0, ec));
+		auto const batch = std::min(num - ret, int(bufs.size()));
+		int const received = receive(pkts.subspan(ret, batch), bufs.first(batch), ec);
 
 		if (ec == error::would_block
 			|| ec == error::try_again
@@ -225,46 +264,104 @@ int udp_socket::read(span<packet> pkts, error_code& ec)
 			// a proxy we must ignore these
 			if (m_proxy_settings.type != settings_pack::none) continue;
 
+			packet& p = pkts[ret];
+			p = packet();
 			p.error = ec;
-			p.data = span<char>();
+			++ret;
+			return ret;
 		}
-		else
-		{
-			p.data = {m_buf->data(), len};
 
-			// support packets coming from the SOCKS5 proxy
-			if (active_socks5())
-			{
-				// if the source IP doesn't match the proxy's, ignore the packet
-				if (p.from != m_socks5_connection->target()) continue;
-				// if we failed to unwrap, silently ignore the packet
-				if (!unwrap(p)) continue;
-			}
-			else
-			{
-				// if we don't proxy trackers or peers, we may be receiving unwrapped
-				// packets and we must let them through.
-				bool const proxy_only
-					= m_proxy_settings.proxy_peer_connections
-					&& m_proxy_settings.proxy_tracker_connections
-					;
-
-				// if we proxy everything, block all packets that aren't coming from
-				// the proxy
-				if (m_proxy_settings.type != settings_pack::none && proxy_only) continue;
-			}
+		bufs = bufs.subspan(received);
+
+		// compact the packets we accept towards the front
+		int const end = ret + received;
+		for (int i = ret; i < end; ++i)
+		{
+			if (!accept(pkts[i])) continue;
+			if (i != ret) pkts[ret] = pkts[i];
+			++ret;
 		}
+	}
 
-		pkts[ret] = p;
-		++ret;
+	return ret;
+}
 
-		// we only have a single buffer for now, so we can only return a
-		// single packet. In the future though, we could attempt to drain
-		// the socket here, or maybe even use recvmmsg()
-		break;
+int udp_socket::receive(span<packet> pkts, span<receive_buffer> bufs
+	, error_code& ec)
+{
+	TORRENT_ASSERT(pkts.size() == bufs.size());
+	TORRENT_ASSERT(!pkts.empty());
+
+	++m_read_syscalls;
+#if TORRENT_USE_RECVMMSG
+	std::array<::mmsghdr, read_batch_size> msgs;
+	std::array<::iovec, read_batch_size> iovs;
+	std::array<::sockaddr_storage, read_batch_size> addrs;
+
+	auto const num = std::size_t(pkts.size());
+	for (std::size_t i = 0; i < num; ++i)
+	{
+		iovs[i].iov_base = bufs[std::ptrdiff_t(i)].data();
+		iovs[i].iov_len = bufs[std::ptrdiff_t(i)].size();
+		std::memset(&msgs[i], 0, sizeof(msgs[i]));
+		msgs[i].msg_hdr.msg_name = &addrs[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
 	}
 
+	int const ret = ::recvmmsg(m_socket.native_handle(), msgs.data()
+		, static_cast<unsigned int>(num), MSG_DONTWAIT, nullptr);
+	if (ret < 0)
+	{
+		ec.assign(errno, system_category());
+		return 0;
+	}
+
+	for (std::size_t i = 0; i < std::size_t(ret); ++i)
+	{
+		packet& p = pkts[std::ptrdiff_t(i)];
+		p = packet();
+		std::size_t const addr_len = std::min(std::size_t(msgs[i].msg_hdr.msg_namelen)
+			, p.from.capacity());
+		std::memcpy(p.from.data(), &addrs[i], addr_len);
+		p.from.resize(addr_len);
+		p.data = {bufs[std::ptrdiff_t(i)].data(), int(msgs[i].msg_len)};
+	}
+	ec.clear();
 	return ret;
+#else
+	packet& p = pkts[0];
+	p = packet();
+	int const len = int(m_socket.receive_from(boost::asio::buffer(bufs[0])
+		, p.from, 0, ec));
+	if (ec) return 0;
+	p.data = {bufs[0].data(), len};
+	return 1;
+#endif
+}
+
+bool udp_socket::accept(packet& p)
+{
+	// support packets coming from the SOCKS5 proxy
+	if (active_socks5())
+	{
+		// if the source IP doesn't match the proxy's, ignore the packet
+		if (p.from != m_socks5_connection->target()) return false;
+		// if we failed to unwrap, silently ignore the packet
+		return unwrap(p);
+	}
+
+	// if we don't proxy trackers or peers, we may be receiving unwrapped
+	// packets and we must let them through.
+	bool const proxy_only
+		= m_proxy_settings.proxy_peer_connections
+		&& m_proxy_settings.proxy_tracker_connections
+		;
+
+	// if we proxy everything, block all packets that aren't coming from
+	// the proxy
+	return m_proxy_settings.type == settings_pack::none || !proxy_only;
 }
 
 bool udp_socket::active_socks5() const
@@ -276,6 +373,7 @@ void udp_socket::send_hostname(char const* hostname, int const port
 	, span<char const> p, error_code& ec, udp_send_flags_t const flags)
 {
 	TORRENT_ASSERT(is_single_thread());
+	m_send_syscalls = 0;
 
 	// if the sockets are closed, the udp_socket is closing too
 	if (!is_open())
@@ -314,6 +412,7 @@ void udp_socket::send(udp::endpoint const& ep, span<char const> p
 	, error_code& ec, udp_send_flags_t const flags)
 {
 	TORRENT_ASSERT(is_single_thread());
+	m_send_syscalls = 0;
 
 	// if the sockets are closed, the udp_socket is closing too
 	if (!is_open())
@@ -342,13 +441,182 @@ void udp_socket::send(udp::endpoint const& ep, span<char const> p
 		return;
 	}
 
+#if TORRENT_USE_SENDMMSG
+	if (!(flags & dont_fragment))
+	{
+		queue_packet(ep, p, ec);
+		return;
+	}
+
+	// MTU probes are sent right away, since the caller needs to know whether
+	// they failed. Send the queue first, to preserve the order of packets
+	flush(ec);
+	if (ec) return;
+#endif
+
 	// set the DF flag for the socket and clear it again in the destructor
 	set_dont_frag df(m_socket, (flags & dont_fragment)
 		&& aux::is_v4(ep));
 
+	++m_send_syscalls;
 	m_socket.send_to(boost::asio::buffer(p.data(), static_cast<std::size_t>(p.size())), ep, 0, ec);
 }
 
+#if TORRENT_USE_SENDMMSG
+void udp_socket::queue_packet(udp::endpoint const& ep, span<char const> p
+	, error_code& ec)
+{
+	if (m_send_blocked)
+	{
+		ec = boost::asio::error::would_block;
+		return;
+	}
+
+	if (m_send_queue.size() >= max_send_batch)
+	{
+		flush(ec);
+		if (ec) return;
+	}
+
+	int const offset = int(m_send_buffer.size());
+	m_send_buffer.insert(m_send_buffer.end(), p.begin(), p.end());
+	m_send_queue.push_back({ep, offset, int(p.size())});
+}
+#endif
+
+void udp_socket::flush(error_code& ec)
+{
+	TORRENT_ASSERT(is_single_thread());
+	m_send_syscalls = 0;
+#if TORRENT_USE_SENDMMSG
+	m_send_blocked = false;
+	if (m_send_queue.empty()) return;
+
+	std::array<::mmsghdr, max_send_batch> msgs;
+	std::array<::iovec, max_send_batch> iovs;
+
+	// the UDP_SEGMENT control message for each mmsghdr
+	union gso_cmsg
+	{
+		char buf[CMSG_SPACE(sizeof(std::uint16_t))];
+		::cmsghdr align;
+	};
+	std::array<gso_cmsg, max_send_batch> cmsgs;
+
+	// the number of packets in each mmsghdr
+	std::array<int, max_send_batch> segments;
+
+	std::size_t const num_packets = m_send_queue.size();
+	std::size_t sent = 0;
+
+	// packets before this index are not coalesced into UDP_SEGMENT buffers,
+	// because the kernel rejected them as such
+	std::size_t no_gso = 0;
+
+	while (sent < num_packets)
+	{
+		std::size_t num_msgs = 0;
+		std::size_t i = sent;
+		while (i < num_packets && num_msgs < max_send_batch)
+		{
+			queued_packet& qp = m_send_queue[i];
+			::mmsghdr& m = msgs[num_msgs];
+			std::memset(&m, 0, sizeof(m));
+			m.msg_hdr.msg_name = qp.ep.data();
+			m.msg_hdr.msg_namelen = static_cast<socklen_t>(qp.ep.size());
+			m.msg_hdr.msg_iov = &iovs[i - sent];
+
+			// a run of packets to the same endpoint, all of the same size
+			// (except possibly the last one, which may be smaller) can be
+			// sent as a single buffer, and segmented by the kernel
+			std::size_t end = i + 1;
+			if (m_gso && i >= no_gso)
+			{
+				int total = qp.size;
+				while (end < num_packets
+					&& int(end - i) < max_gso_segments
+					&& m_send_queue[end - 1].size == qp.size
+					&& m_send_queue[end].size <= qp.size
+					&& m_send_queue[end].ep == qp.ep
+					&& total + m_send_queue[end].size <= max_gso_size)
+				{
+					total += m_send_queue[end].size;
+					++end;
+				}
+			}
+
+			for (std::size_t k = i; k < end; ++k)
+			{
+				iovs[k - sent].iov_base = m_send_buffer.data() + m_send_queue[k].offset;
+				iovs[k - sent].iov_len = std::size_t(m_send_queue[k].size);
+			}
+			m.msg_hdr.msg_iovlen = end - i;
+
+			if (end - i > 1)
+			{
+				m.msg_hdr.msg_control = cmsgs[num_msgs].buf;
+				m.msg_hdr.msg_controllen = sizeof(cmsgs[num_msgs].buf);
+				::cmsghdr* cm = CMSG_FIRSTHDR(&m.msg_hdr);
+				cm->cmsg_level = SOL_UDP;
+				cm->cmsg_type = UDP_SEGMENT;
+				cm->cmsg_len = CMSG_LEN(sizeof(std::uint16_t));
+				std::uint16_t const gso_size = std::uint16_t(qp.size);
+				std::memcpy(CMSG_DATA(cm), &gso_size, sizeof(gso_size));
+			}
+
+			segments[num_msgs] = int(end - i);
+			++num_msgs;
+			i = end;
+		}
+
+		++m_send_syscalls;
+		int const ret = ::sendmmsg(m_socket.native_handle(), msgs.data()
+			, static_cast<unsigned int>(num_msgs), MSG_DONTWAIT);
+
+		if (ret > 0)
+		{
+			for (int k = 0; k < ret; ++k)
+				sent += std::size_t(segments[std::size_t(k)]);
+			continue;
+		}
+
+		int const err = errno;
+		if (err == EINTR) continue;
+
+		if (err == EAGAIN || err == EWOULDBLOCK)
+		{
+			// keep the packets we could not send, for the next flush()
+			m_send_queue.erase(m_send_queue.begin()
+				, m_send_queue.begin() + std::ptrdiff_t(sent));
+			m_send_blocked = true;
+			ec = boost::asio::error::would_block;
+			return;
+		}
+
+		if (segments[0] > 1)
+		{
+			// the kernel rejected the UDP_SEGMENT buffer. If it doesn't support
+			// the option at all, stop using it. Otherwise (e.g. if the segment
+			// size exceeds the path MTU) send these packets one at a time
+			if (err == ENOPROTOOPT || err == EOPNOTSUPP)
+				m_gso = false;
+			no_gso = sent + std::size_t(segments[0]);
+			continue;
+		}
+
+		// the first packet failed. Since the caller was told it was sent, there
+		// is no one to report the error to. Just skip it, the same as if it was
+		// lost
+		sent += std::size_t(segments[0]);
+	}
+
+	m_send_queue.clear();
+	m_send_buffer.clear();
+#else
+	TORRENT_UNUSED(ec);
+#endif
+}
+
 void udp_socket::wrap(udp::endpoint const& ep, span<char const> p
 	, error_code& ec, udp_send_flags_t const flags)
 {
@@ -370,6 +638,7 @@ void udp_socket::wrap(udp::endpoint const& ep, span<char const> p
 	// set the DF flag for the socket and clear it again in the destructor
 	set_dont_frag df(m_socket, (flags & dont_fragment) && aux::is_v4(ep));
 
+	++m_send_syscalls;
 	m_socket.send_to(iovec, m_socks5_connection->target(), 0, ec);
 }
 
@@ -398,6 +667,7 @@ void udp_socket::wrap(char const* hostname, int const port, span<char const> p
 	set_dont_frag df(m_socket, (flags & dont_fragment)
 		&& aux::is_v4(m_socket.local_endpoint(ec)));
 
+	++m_send_syscalls;
 	m_socket.send_to(iovec, m_socks5_connection->target(), 0, ec);
 }
 
@@ -461,6 +731,11 @@ void udp_socket::close()
 	error_code ec;
 	m_socket.close(ec);
 	TORRENT_ASSERT_VAL(!ec || ec == error::bad_descriptor, ec);
+#if TORRENT_USE_SENDMMSG
+	m_send_queue.clear();
+	m_send_buffer.clear();
+	m_send_blocked = false;
+#endif
 	if (m_socks5_connection)
 	{
 		m_socks5_connection->close();
@@ -480,6 +755,22 @@ void udp_socket::open(udp const& protocol, error_code& ec)
 
 	m_socket.open(protocol, ec);
 	if (ec) return;
+
+#if TORRENT_USE_SENDMMSG
+	m_send_queue.clear();
+	m_send_buffer.clear();
+	m_send_blocked = false;
+
+	// older kernels silently ignore control messages they don't know about,
+	// which would send the whole buffer as a single datagram. Only use
+	// UDP_SEGMENT if the kernel knows about the socket option
+	{
+		int val = 0;
+		socklen_t len = sizeof(val);
+		m_gso = ::getsockopt(m_socket.native_handle(), SOL_UDP, UDP_SEGMENT
+			, &val, &len) == 0;
+	}
+#endif
 	if (protocol == udp::v6())
 	{
 		error_code err;
@@ -1069,5 +1360,6 @@ constexpr udp_send_flags_t udp_socket::peer_connection;
 constexpr udp_send_flags_t udp_socket::tracker_connection;
 constexpr udp_send_flags_t udp_socket::dont_queue;
 constexpr udp_send_flags_t udp_socket::dont_fragment;
+constexpr std::size_t udp_socket::read_batch_size;
 
 }
@@ -295,6 +295,69 @@ TORRENT_TEST(get_all_empty)
 	TEST_CHECK(alerts.empty());
 }
 
+TORRENT_TEST(get_all_rotation)
+{
+	aux::alert_manager mgr(100, alert_category::all);
+	std::vector<alert*> alerts;
+
+	// the alerts returned by get_all() must stay valid until the next call,
+	// while new alerts are posted
+	for (int round = 0; round < 5; ++round)
+	{
+		for (int i = 0; i < 3; ++i)
+			mgr.emplace_alert<piece_finished_alert>(torrent_handle(), piece_index_t(round * 3 + i));
+
+		mgr.get_all(alerts);
+		TEST_EQUAL(alerts.size(), 3);
+
+		mgr.emplace_alert<piece_finished_alert>(torrent_handle(), piece_index_t(100));
+		mgr.emplace_alert<piece_finished_alert>(torrent_handle(), piece_index_t(101));
+
+		for (int i = 0; i < 3; ++i)
+		{
+			auto const* pf = alert_cast<piece_finished_alert>(alerts[std::size_t(i)]);
+			TEST_CHECK(pf != nullptr);
+			if (pf == nullptr) continue;
+			TEST_EQUAL(pf->piece_index, piece_index_t(round * 3 + i));
+		}
+
+		mgr.get_all(alerts);
+		TEST_EQUAL(alerts.size(), 2);
+	}
+}
+
+TORRENT_TEST(get_all_concurrent)
+{
+	int const num_alerts = 20000;
+	aux::alert_manager mgr(num_alerts, alert_category::all);
+
+	std::thread posting_thread([&mgr]
+	{
+		for (int i = 0; i < num_alerts; ++i)
+			mgr.emplace_alert<piece_finished_alert>(torrent_handle(), piece_index_t(i));
+	});
+
+	// every alert is received exactly once, in order
+	std::vector<alert*> alerts;
+	int expected = 0;
+	while (expected < num_alerts)
+	{
+		mgr.get_all(alerts);
+		for (auto const* a : alerts)
+		{
+			auto const* pf = alert_cast<piece_finished_alert>(a);
+			TEST_CHECK(pf != nullptr);
+			if (pf == nullptr) continue;
+			TEST_EQUAL(pf->piece_index, piece_index_t(expected));
+			++expected;
+		}
+	}
+	posting_thread.join();
+
+	mgr.get_all(alerts);
+	TEST_CHECK(alerts.empty());
+}
+
 TORRENT_TEST(dropped_alerts)
 {
 	aux::alert_manager mgr(1, alert_category::all);
@@ -458,6 +458,20 @@ void test_no_starvation(int limit)
 	TEST_CHECK(close_to(p->m_quota / sample_time, float(limit) / 200 / num_peers, 5));
 }
 
+struct test_socket : aux::bandwidth_socket
+{
+	bool is_disconnecting() const override { return disconnecting; }
+	void assign_bandwidth(int /*channel*/, int amount) override
+	{
+		assigned += amount;
+		++calls;
+	}
+
+	bool disconnecting = false;
+	int assigned = 0;
+	int calls = 0;
+};
+
 } // anonymous namespace
 
 TORRENT_TEST(equal_connection)
@@ -517,3 +531,45 @@ TORRENT_TEST(no_starvation)
 {
 	test_no_starvation(40000);
 }
+
+TORRENT_TEST(request_dispatch)
+{
+	aux::bandwidth_manager manager(0);
+	aux::bandwidth_channel limit;
+	limit.throttle(1000);
+	aux::bandwidth_channel* channels[] = { &limit };
+
+	auto small = std::make_shared<test_socket>();
+	auto large = std::make_shared<test_socket>();
+	auto leaving = std::make_shared<test_socket>();
+	TEST_EQUAL(manager.request_bandwidth(small, 100, 1, channels, 1), 0);
+	TEST_EQUAL(manager.request_bandwidth(large, 100000, 1, channels, 1), 0);
+	TEST_EQUAL(manager.request_bandwidth(leaving, 100000, 1, channels, 1), 0);
+	TEST_EQUAL(manager.queue_size(), 3);
+	TEST_EQUAL(manager.queued_bytes(), 200100);
+
+	// the small request is satisfied by its share of the first round
+	manager.update_quotas(seconds(1));
+	TEST_EQUAL(small->calls, 1);
+	TEST_EQUAL(small->assigned, 100);
+	TEST_EQUAL(large->calls, 0);
+	TEST_EQUAL(manager.queue_size(), 2);
+
+	// a disconnecting peer is handed back its request, without any bandwidth
+	leaving->disconnecting = true;
+	for (int i = 0; i < 8; ++i)
+		manager.update_quotas(seconds(1));
+	TEST_EQUAL(leaving->calls, 1);
+	TEST_EQUAL(leaving->assigned, 0);
+	TEST_EQUAL(large->calls, 0);
+	TEST_EQUAL(manager.queue_size(), 1);
+
+	// once the channel isn't rate limited anymore, the remaining request is
+	// satisfied
+	limit.throttle(0);
+	manager.update_quotas(seconds(1));
+	TEST_EQUAL(large->calls, 1);
+	TEST_EQUAL(large->assigned, 100000);
+	TEST_EQUAL(manager.queue_size(), 0);
+	TEST_EQUAL(manager.queued_bytes(), 0);
+}
@@ -36,6 +36,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "test.hpp"
 #include "libtorrent/bitfield.hpp"
 #include "libtorrent/aux_/cpuid.hpp"
+#include "libtorrent/random.hpp"
 #include <cstdlib>
 
 using namespace lt;
@@ -429,3 +430,98 @@ TORRENT_TEST(bitfield_index_range)
 	TEST_EQUAL(sum, 15 * 16 / 2);
 }
 
+
+namespace {
+
+bitfield random_bitfield(int const bits)
+{
+	bitfield ret(bits);
+	for (int i = 0; i < bits; ++i)
+		if (lt::random(3) == 0) ret.set_bit(i);
+	return ret;
+}
+
+}
+
+TORRENT_TEST(bitfield_count_range)
+{
+	// both sides of the AVX2 threshold
+	for (int const bits : {1, 31, 32, 33, 100, 511, 1000, 4097})
+	{
+		bitfield const b = random_bitfield(bits);
+		for (int rep = 0; rep < 50; ++rep)
+		{
+			int const first = int(lt::random(std::uint32_t(bits)));
+			int const last = first + int(lt::random(std::uint32_t(bits - first)));
+			int expected = 0;
+			for (int i = first; i < last; ++i) expected += b.get_bit(i);
+			TEST_EQUAL(b.count(first, last), expected);
+		}
+		TEST_EQUAL(b.count(0, bits), b.count());
+	}
+}
+
+TORRENT_TEST(bitfield_find_next_set)
+{
+	for (int const bits : {1, 31, 32, 33, 100, 1000})
+	{
+		bitfield const b = random_bitfield(bits);
+		int index = 0;
+		for (int i = 0; i < bits; ++i)
+		{
+			if (!b.get_bit(i)) continue;
+			index = b.find_next_set(index);
+			TEST_EQUAL(index, i);
+			++index;
+		}
+		if (index < bits) TEST_EQUAL(b.find_next_set(index), -1);
+	}
+
+	typed_bitfield<int> b(100);
+	TEST_EQUAL(b.find_next_set(0), b.end_index());
+	b.set_bit(99);
+	TEST_EQUAL(b.find_next_set(0), 99);
+	TEST_EQUAL(b.find_next_set(99), 99);
+}
+
+TORRENT_TEST(bitfield_and_and_not)
+{
+	for (int const bits : {1, 33, 100, 1000, 4097})
+	{
+		bitfield const a = random_bitfield(bits);
+		bitfield const b = random_bitfield(bits);
+
+		bitfield and_ = a;
+		and_ &= b;
+		bitfield and_not = a;
+		and_not.clear_bits(b);
+		bool any = false;
+		for (int i = 0; i < bits; ++i)
+		{
+			TEST_EQUAL(and_.get_bit(i), a.get_bit(i) && b.get_bit(i));
+			TEST_EQUAL(and_not.get_bit(i), a.get_bit(i) && !b.get_bit(i));
+			any |= a.get_bit(i) && !b.get_bit(i);
+		}
+		TEST_EQUAL(a.any_and_not(b), any);
+		TEST_CHECK(!and_.any_and_not(b));
+		TEST_CHECK(!a.any_and_not(a));
+
+		// a single bit difference at the very end
+		bitfield c(bits, true);
+		bitfield d(bits, true);
+		TEST_CHECK(!c.any_and_not(d));
+		d.clear_bit(bits - 1);
+		TEST_CHECK(c.any_and_not(d));
+		TEST_CHECK(!d.any_and_not(c));
+	}
+
+	// bits past the end of the right hand side count as 0
+	bitfield a(100, true);
+	bitfield const b(40, true);
+	TEST_CHECK(a.any_and_not(b));
+	a &= b;
+	TEST_EQUAL(a.count(), 40);
+	TEST_CHECK(!a.any_and_not(b));
+	a.clear_bits(b);
+	TEST_CHECK(a.none_set());
+}
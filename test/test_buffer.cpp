@@ -309,3 +309,57 @@ TORRENT_TEST(chained_buffer)
 	}
 	TEST_CHECK(buffer_list.empty());
 }
+
+namespace {
+
+struct test_allocator final : buffer_allocator_interface
+{
+	void free_disk_buffer(char* b) override { free_buffer(b); }
+};
+
+} // anonymous namespace
+
+TORRENT_TEST(chained_buffer_file)
+{
+	char data_test[] = "foobar";
+	test_allocator alloc;
+	{
+		chained_buffer b;
+		std::int64_t offset = 0;
+		int len = 0;
+		TEST_EQUAL(b.front_file(offset, len), -1);
+		TEST_EQUAL(b.bytes_until_file(), 0);
+
+		char* b1 = allocate_buffer(512);
+		std::memcpy(b1, data_test, 6);
+		b.append_buffer(holder(b1, 512), 6);
+
+		// a view of 6 bytes at offset 1000 in file descriptor 42
+		char* b2 = allocate_buffer(6);
+		std::memcpy(b2, data_test, 6);
+		b.append_buffer(disk_buffer_holder(alloc, b2, 6, 42, 1000), 6);
+
+		// the file backed buffer is not at the front
+		TEST_EQUAL(b.front_file(offset, len), -1);
+		TEST_EQUAL(b.bytes_until_file(), 6);
+		TEST_EQUAL(b.space_in_last_buffer(), 0);
+
+		b.pop_front(6);
+		TEST_EQUAL(b.front_file(offset, len), 42);
+		TEST_EQUAL(offset, 1000);
+		TEST_EQUAL(len, 6);
+		TEST_EQUAL(b.bytes_until_file(), 0);
+
+		// partially sending it moves the offset into the file
+		b.pop_front(4);
+		TEST_EQUAL(b.front_file(offset, len), 42);
+		TEST_EQUAL(offset, 1004);
+		TEST_EQUAL(len, 2);
+		TEST_CHECK(compare_chained_buffer(b, "ar", 2));
+
+		b.pop_front(2);
+		TEST_CHECK(b.empty());
+		TEST_EQUAL(b.front_file(offset, len), -1);
+	}
+	TEST_CHECK(buffer_list.empty());
+}
@@ -0,0 +1,182 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "test.hpp"
+#include "libtorrent/aux_/disk_buffer_pool.hpp"
+#include "libtorrent/disk_observer.hpp"
+#include "libtorrent/disk_interface.hpp" // for default_block_size
+#include "libtorrent/settings_pack.hpp"
+#include "libtorrent/io_context.hpp"
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using lt::aux::disk_buffer_pool;
+
+namespace {
+
+struct test_observer final : lt::disk_observer
+{
+	void on_disk() override { ++called; }
+	int called = 0;
+};
+
+void setup_pool(disk_buffer_pool& pool, int const blocks)
+{
+	lt::settings_pack sett;
+	sett.set_int(lt::settings_pack::max_queued_disk_bytes, blocks * lt::default_block_size);
+	pool.set_settings(sett);
+}
+
+} // anonymous namespace
+
+TORRENT_TEST(disk_buffer_pool_watermark)
+{
+	lt::io_context ios;
+	disk_buffer_pool pool(ios);
+	setup_pool(pool, 100);
+
+	auto obs = std::make_shared<test_observer>();
+	std::vector<char*> bufs;
+	bool exceeded = false;
+	while (!exceeded)
+	{
+		char* b = pool.allocate_buffer(exceeded, obs, "test");
+		TEST_CHECK(b != nullptr);
+		// make sure the whole block is usable
+		std::memset(b, 0xcc, lt::default_block_size);
+		bufs.push_back(b);
+		TEST_CHECK(bufs.size() < 1000);
+	}
+
+	// we exceed the limit half way between the low watermark and the max
+	TEST_EQUAL(int(bufs.size()), 75);
+	TEST_EQUAL(pool.in_use(), 75);
+
+	// freeing down to just above the low watermark doesn't notify the
+	// observer
+	while (bufs.size() > 51)
+	{
+		pool.free_buffer(bufs.back());
+		bufs.pop_back();
+	}
+	ios.run();
+	ios.restart();
+	TEST_EQUAL(obs->called, 0);
+
+	pool.free_buffer(bufs.back());
+	bufs.pop_back();
+	ios.run();
+	ios.restart();
+	TEST_EQUAL(obs->called, 1);
+	TEST_EQUAL(pool.in_use(), 50);
+
+	pool.free_multiple_buffers(bufs);
+	TEST_EQUAL(pool.in_use(), 0);
+}
+
+TORRENT_TEST(disk_buffer_pool_release_slabs)
+{
+	lt::io_context ios;
+	disk_buffer_pool pool(ios);
+	setup_pool(pool, 2000);
+
+	// 8 slabs worth of blocks
+	std::vector<char*> bufs;
+	for (int i = 0; i < 1024; ++i)
+	{
+		char* b = pool.allocate_buffer("test");
+		TEST_CHECK(b != nullptr);
+		bufs.push_back(b);
+	}
+	TEST_EQUAL(pool.num_slabs(), 8);
+
+	for (char* b : bufs) pool.free_buffer(b);
+	bufs.clear();
+	TEST_EQUAL(pool.in_use(), 0);
+
+	// one slab is kept as a reserve, and one may be held back by blocks in
+	// the thread's cache. The others are given back
+	TEST_CHECK(pool.num_slabs() <= 2);
+
+	// the remaining blocks are still usable
+	for (int i = 0; i < 300; ++i)
+	{
+		char* b = pool.allocate_buffer("test");
+		TEST_CHECK(b != nullptr);
+		std::memset(b, 0xcc, lt::default_block_size);
+		bufs.push_back(b);
+	}
+	pool.free_multiple_buffers(bufs);
+	TEST_EQUAL(pool.in_use(), 0);
+}
+
+TORRENT_TEST(disk_buffer_pool_threads)
+{
+	lt::io_context ios;
+	disk_buffer_pool pool(ios);
+	setup_pool(pool, 1000);
+
+	// buffers allocated by one thread are freed by another, like receive
+	// buffers passed from the network thread to a disk thread
+	std::vector<std::vector<char*>> bufs(4);
+	for (auto& v : bufs)
+	{
+		for (int i = 0; i < 200; ++i)
+		{
+			char* b = pool.allocate_buffer("test");
+			TEST_CHECK(b != nullptr);
+			v.push_back(b);
+		}
+	}
+	TEST_EQUAL(pool.in_use(), 800);
+
+	std::vector<std::thread> threads;
+	for (auto& v : bufs)
+	{
+		threads.emplace_back([&pool, &v] {
+			for (int round = 0; round < 100; ++round)
+			{
+				for (char*& b : v)
+				{
+					pool.free_buffer(b);
+					b = pool.allocate_buffer("test");
+				}
+			}
+			pool.free_multiple_buffers(v);
+		});
+	}
+	for (auto& t : threads) t.join();
+
+	TEST_EQUAL(pool.in_use(), 0);
+}
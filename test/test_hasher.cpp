@@ -35,10 +35,14 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "libtorrent/hasher.hpp"
 #include "libtorrent/hex.hpp"
+#include "libtorrent/aux_/hash_batch.hpp"
+#include "libtorrent/aux_/cpuid.hpp"
+#include "libtorrent/random.hpp"
 
 #include "test.hpp"
 
 #include <iostream>
+#include <vector>
 
 using namespace lt;
 
@@ -144,3 +148,148 @@ TORRENT_TEST(hasher256)
 	}
 }
 
+
+namespace {
+
+template <typename Hasher>
+auto reference_hash(span<char const> buf) -> decltype(Hasher().final())
+{
+	Hasher h;
+	if (!buf.empty()) h.update(buf);
+	return h.final();
+}
+
+// a mix of lengths around the block- and padding boundaries, with runs of
+// equal lengths to exercise the multi-buffer kernels
+std::vector<std::vector<char>> batch_buffers()
+{
+	std::vector<std::vector<char>> ret;
+	for (int const len : {0, 1, 55, 56, 63, 64, 65, 119, 120, 1000, 1000, 1000})
+		ret.emplace_back(std::size_t(len));
+	for (int i = 0; i < 11; ++i)
+		ret.emplace_back(std::size_t(0x4000));
+	ret.emplace_back(std::size_t(0x4000 - 1));
+	for (auto& b : ret) aux::random_bytes(b);
+	return ret;
+}
+
+std::vector<span<char const>> to_spans(std::vector<std::vector<char>> const& bufs)
+{
+	std::vector<span<char const>> ret;
+	for (auto const& b : bufs) ret.emplace_back(b);
+	return ret;
+}
+
+#if TORRENT_HAS_SHA_X86
+// pads ``buf`` the way SHA-1 and SHA-256 do, to be passed to the block
+// functions directly
+std::vector<std::uint8_t> pad(std::vector<char> const& buf)
+{
+	std::vector<std::uint8_t> ret(buf.begin(), buf.end());
+	ret.push_back(0x80);
+	while (ret.size() % 64 != 56) ret.push_back(0);
+	std::uint64_t const bits = std::uint64_t(buf.size()) * 8;
+	for (int i = 7; i >= 0; --i) ret.push_back(std::uint8_t(bits >> (i * 8)));
+	return ret;
+}
+
+template <typename Hash>
+Hash digest(std::uint32_t const* state, int const stride)
+{
+	char ret[Hash::size()];
+	for (int i = 0; i < int(Hash::size()) / 4; ++i)
+	{
+		std::uint32_t const w = state[i * stride];
+		ret[i * 4] = char(w >> 24);
+		ret[i * 4 + 1] = char(w >> 16);
+		ret[i * 4 + 2] = char(w >> 8);
+		ret[i * 4 + 3] = char(w);
+	}
+	return Hash(ret);
+}
+#endif
+
+}
+
+TORRENT_TEST(sha1_batch)
+{
+	auto const bufs = batch_buffers();
+	auto const in = to_spans(bufs);
+	std::vector<sha1_hash> out(in.size());
+	aux::sha1_batch(in, out);
+	for (std::size_t i = 0; i < in.size(); ++i)
+		TEST_EQUAL(out[i], reference_hash<hasher>(in[i]));
+}
+
+TORRENT_TEST(sha256_batch)
+{
+	auto const bufs = batch_buffers();
+	auto const in = to_spans(bufs);
+	std::vector<sha256_hash> out(in.size());
+	aux::sha256_batch(in, out);
+	for (std::size_t i = 0; i < in.size(); ++i)
+		TEST_EQUAL(out[i], reference_hash<hasher256>(in[i]));
+}
+
+#if TORRENT_HAS_SHA_X86
+TORRENT_TEST(sha_ni_blocks)
+{
+	if (!aux::sha_ni_support) return;
+
+	for (auto const& b : batch_buffers())
+	{
+		auto const padded = pad(b);
+
+		std::uint32_t state1[5] = {
+			0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+		aux::sha1_ni_blocks(state1, padded.data(), padded.size() / 64);
+		TEST_EQUAL(digest<sha1_hash>(state1, 1), reference_hash<hasher>(b));
+
+		std::uint32_t state256[8] = {
+			0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+			0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+		aux::sha256_ni_blocks(state256, padded.data(), padded.size() / 64);
+		TEST_EQUAL(digest<sha256_hash>(state256, 1), reference_hash<hasher256>(b));
+	}
+}
+
+TORRENT_TEST(sha_avx2_x8)
+{
+	if (!aux::avx2_support) return;
+
+	for (int const len : {0, 64, 100, 0x4000})
+	{
+		std::vector<std::vector<char>> bufs(8, std::vector<char>(std::size_t(len)));
+		std::vector<std::vector<std::uint8_t>> padded;
+		std::uint8_t const* data[8];
+		for (int lane = 0; lane < 8; ++lane)
+		{
+			aux::random_bytes(bufs[std::size_t(lane)]);
+			padded.push_back(pad(bufs[std::size_t(lane)]));
+		}
+		for (int lane = 0; lane < 8; ++lane)
+			data[lane] = padded[std::size_t(lane)].data();
+		std::size_t const blocks = padded[0].size() / 64;
+
+		std::uint32_t state1[5 * 8];
+		std::uint32_t const init1[5] = {
+			0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+		for (int i = 0; i < 5 * 8; ++i) state1[i] = init1[i / 8];
+		aux::sha1_avx2_x8(state1, data, blocks);
+
+		std::uint32_t state256[8 * 8];
+		std::uint32_t const init256[8] = {
+			0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+			0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+		for (int i = 0; i < 8 * 8; ++i) state256[i] = init256[i / 8];
+		aux::sha256_avx2_x8(state256, data, blocks);
+
+		for (int lane = 0; lane < 8; ++lane)
+		{
+			auto const& b = bufs[std::size_t(lane)];
+			TEST_EQUAL(digest<sha1_hash>(state1 + lane, 8), reference_hash<hasher>(b));
+			TEST_EQUAL(digest<sha256_hash>(state256 + lane, 8), reference_hash<hasher256>(b));
+		}
+	}
+}
+#endif
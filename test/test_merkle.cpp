@@ -34,6 +34,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "test.hpp"
 #include "libtorrent/aux_/merkle.hpp"
 #include "libtorrent/bitfield.hpp"
+#include <array>
 #include <iostream>
 
 using namespace lt;
@@ -647,6 +648,73 @@ TORRENT_TEST(merkle_root_scratch)
 	TEST_CHECK(merkle_root_scratch(v{a,b,c}, 8, o, buf) == H(H(ab, H(c, o)), H(H(o,o), H(o,o))));
 }
 
+TORRENT_TEST(merkle_root_scratch_span)
+{
+	std::array<sha256_hash, 4> buf;
+
+	TEST_CHECK(merkle_root_scratch(v{a,b,c,d,e,f,g,h}, 8, o, buf) == ah);
+	TEST_CHECK(merkle_root_scratch(v{a,b,c,d,e,f}, 8, o, buf) == H(ad, H(ef, H(o, o))));
+	TEST_CHECK(merkle_root_scratch(v{a,b,c}, 8, o, buf) == H(H(ab, H(c, o)), H(H(o,o), H(o,o))));
+}
+
+TORRENT_TEST(merkle_hash_layer)
+{
+	v parents(4);
+	merkle_hash_layer(v{a,b,c,d,e,f,g,h}, parents);
+	TEST_CHECK((parents == v{ab, cd, ef, gh}));
+
+	// in-place
+	v layer{a,b,c,d,e,f,g,h};
+	merkle_hash_layer(layer, span<sha256_hash>(layer).first(4));
+	TEST_CHECK((span<sha256_hash const>(layer).first(4) == span<sha256_hash const>(parents)));
+
+	// more nodes than fit in a single batch
+	v leaves(300);
+	for (int i = 0; i < int(leaves.size()); ++i)
+		leaves[std::size_t(i)] = hasher256(reinterpret_cast<char const*>(&i), sizeof(i)).final();
+	v large(150);
+	merkle_hash_layer(leaves, large);
+	for (int i = 0; i < int(large.size()); ++i)
+		TEST_CHECK(large[std::size_t(i)] == H(leaves[std::size_t(i * 2)], leaves[std::size_t(i * 2 + 1)]));
+}
+
+TORRENT_TEST(merkle_fill_tree_parallel)
+{
+	for (int const num_leafs : {1, 8, 1 << 15})
+	{
+		v tree(std::size_t(merkle_num_nodes(num_leafs)));
+		int const first_leaf = merkle_first_leaf(num_leafs);
+		for (int i = 0; i < num_leafs; ++i)
+			tree[std::size_t(first_leaf + i)] = hasher256(reinterpret_cast<char const*>(&i), sizeof(i)).final();
+
+		v expected = tree;
+		merkle_fill_tree(expected, num_leafs);
+
+		for (int const threads : {1, 3, 4})
+		{
+			v parallel = tree;
+			merkle_fill_tree_parallel(parallel, num_leafs, threads);
+			TEST_CHECK(parallel == expected);
+		}
+	}
+}
+
+// this is how create_torrent computes the roots of large files
+TORRENT_TEST(merkle_fill_tree_parallel_pad)
+{
+	int const num_pieces = (1 << 14) + 5;
+	v pieces(static_cast<std::size_t>(num_pieces));
+	for (int i = 0; i < num_pieces; ++i)
+		pieces[std::size_t(i)] = hasher256(reinterpret_cast<char const*>(&i), sizeof(i)).final();
+	sha256_hash const pad = merkle_pad(16, 1);
+
+	int const num_leafs = merkle_num_leafs(num_pieces);
+	v tree(std::size_t(merkle_num_nodes(num_leafs)), pad);
+	std::copy(pieces.begin(), pieces.end(), tree.begin() + merkle_first_leaf(num_leafs));
+	merkle_fill_tree_parallel(tree, num_leafs, 4);
+	TEST_CHECK(tree[0] == merkle_root(pieces, pad));
+}
+
 namespace {
 void print_tree(span<sha256_hash const> tree)
 {
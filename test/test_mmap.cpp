@@ -114,6 +114,40 @@ TORRENT_TEST(mmap_write)
 	}
 }
 
+TORRENT_TEST(mmap_resident)
+{
+	std::vector<char> buf = filled_buffer(1024 * 1024);
+
+	{
+		std::ofstream file("test_file3", std::ios::binary);
+		file.write(buf.data(), std::streamsize(buf.size()));
+	}
+
+	auto m = std::make_shared<file_mapping>(aux::file_handle("test_file3"
+		, std::int64_t(buf.size()), open_mode::read_only)
+		, open_mode::read_only, buf.size()
+#if TORRENT_HAVE_MAP_VIEW_OF_FILE
+		, std::make_shared<std::mutex>()
+#endif
+		);
+
+	// an unaligned range in the middle of the file
+	auto const range = m->range().subspan(100000, 0x4000);
+	m->will_need(range);
+
+	// touch the pages, to make sure they are in the page cache
+	int sum = 0;
+	for (auto const b : range) sum += int(b);
+	TEST_CHECK(sum != 0);
+
+#if TORRENT_HAVE_MMAP
+	TEST_EQUAL(m->resident(range), 1);
+	TEST_EQUAL(m->resident(range.first(0)), 1);
+#else
+	TEST_EQUAL(m->resident(range), -1);
+#endif
+}
+
 #else
 
 TORRENT_TEST(dummy) {}
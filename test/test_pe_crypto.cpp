@@ -40,6 +40,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/pe_crypto.hpp"
 #include "libtorrent/random.hpp"
 #include "libtorrent/span.hpp"
+#include "libtorrent/aux_/dh_key_pool.hpp"
+
+#include <boost/multiprecision/cpp_int.hpp>
 
 #include "test.hpp"
 
@@ -138,6 +141,64 @@ TORRENT_TEST(diffie_hellman)
 	}
 }
 
+TORRENT_TEST(dh_pow_mod)
+{
+	using namespace lt;
+	namespace mp = boost::multiprecision;
+
+	lt::key_t const prime("0xFFFFFFFFFFFFFFFFC90FDAA22168C234C4C6628B80DC1CD1"
+		"29024E088A67CC74020BBEA63B139B22514A08798E3404DDEF9519B3CD3A431B"
+		"302B0A6DF25F14374FE1356D6D51C245E485B576625E7EC6F44C42E9A63A3621"
+		"0000000000090563");
+
+	TEST_EQUAL(dh_pow_mod(lt::key_t(2), lt::key_t(0)), lt::key_t(1));
+	TEST_EQUAL(dh_pow_mod(lt::key_t(2), lt::key_t(10)), lt::key_t(1024));
+	TEST_EQUAL(dh_pow_mod(prime - 1, lt::key_t(2)), lt::key_t(1));
+
+	for (int rep = 0; rep < 64; ++rep)
+	{
+		std::array<char, 96> buf;
+		aux::random_bytes(buf);
+		lt::key_t base;
+		mp::import_bits(base, buf.begin(), buf.end());
+		base %= prime;
+		aux::random_bytes(buf);
+		lt::key_t exp;
+		mp::import_bits(exp, buf.begin(), buf.end());
+
+		TEST_EQUAL(dh_pow_mod(base, exp), lt::key_t(mp::powm(base, exp, prime)));
+	}
+}
+
+TORRENT_TEST(dh_key_pool)
+{
+	using namespace lt;
+
+	aux::dh_key_pool pool;
+
+	// with the pool disabled, keys are generated on demand
+	std::unique_ptr<dh_key_exchange> k1 = pool.get();
+	TEST_CHECK(k1);
+
+	pool.set_size(4);
+	std::unique_ptr<dh_key_exchange> k2 = pool.get();
+	std::unique_ptr<dh_key_exchange> k3 = pool.get();
+	TEST_CHECK(k2);
+	TEST_CHECK(k3);
+	TEST_CHECK(k2->get_local_key() != k3->get_local_key());
+
+	k2->compute_secret(k3->get_local_key());
+	k3->compute_secret(k2->get_local_key());
+	TEST_EQUAL(k2->get_secret(), k3->get_secret());
+
+	pool.set_size(0);
+	std::unique_ptr<dh_key_exchange> k4 = pool.get();
+	TEST_CHECK(k4);
+	k4->compute_secret(k1->get_local_key());
+	k1->compute_secret(k4->get_local_key());
+	TEST_EQUAL(k1->get_secret(), k4->get_secret());
+}
+
 TORRENT_TEST(rc4)
 {
 	using namespace lt;
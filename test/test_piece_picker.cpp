@@ -622,6 +622,151 @@ TORRENT_TEST(we_dont_have)
 	TEST_CHECK(picked.front().piece_index == 1_piece);
 }
 
+TORRENT_TEST(has_wanted_piece)
+{
+	// pieces 1 and 3 we have, piece 4 is filtered
+	auto p = setup_picker("1111111", " * *   ", "1111011", "");
+	TEST_CHECK(!p->has_wanted_piece(string2vec("       ")));
+	TEST_CHECK(!p->has_wanted_piece(string2vec(" * **  ")));
+	TEST_CHECK(p->has_wanted_piece(string2vec("*      ")));
+	TEST_CHECK(p->has_wanted_piece(string2vec("      *")));
+
+	p->set_piece_priority(4_piece, default_priority);
+	TEST_CHECK(p->has_wanted_piece(string2vec(" * **  ")));
+	p->set_piece_priority(1_piece, dont_download);
+	p->set_piece_priority(1_piece, default_priority);
+	TEST_CHECK(!p->has_wanted_piece(string2vec(" *     ")));
+
+	p->we_dont_have(3_piece);
+	TEST_CHECK(p->has_wanted_piece(string2vec("   *   ")));
+
+	// a piece that passed the hash check, but isn't flushed yet, isn't
+	// wanted
+	p->mark_as_downloading({6_piece, 0}, nullptr);
+	p->piece_passed(6_piece);
+	TEST_CHECK(!p->has_wanted_piece(string2vec("      *")));
+
+	p->we_have_all();
+	TEST_CHECK(!p->has_wanted_piece(string2vec("*******")));
+}
+
+// the batching is disabled when debugging refcounts, and this test doesn't
+// keep track of which peer has which piece
+#ifndef TORRENT_DEBUG_REFCOUNTS
+TORRENT_TEST(batched_refcounts)
+{
+	// availability changes from whole bitfields are applied lazily. Make
+	// sure the counters end up the same as if they were applied one at a
+	// time, interleaved with picking and with seeds being broken up
+	int const num_pieces = 300;
+	auto p = std::make_shared<piece_picker>(num_pieces * default_piece_size
+		, default_piece_size);
+
+	aux::vector<int, piece_index_t> expected(static_cast<std::size_t>(num_pieces), 0);
+	std::vector<typed_bitfield<piece_index_t>> peers;
+	int seeds = 0;
+
+	for (int round = 0; round < 1000; ++round)
+	{
+		int const action = int(random(9));
+		if (action == 0)
+		{
+			p->inc_refcount_all(nullptr);
+			++seeds;
+		}
+		else if (action == 1 && seeds > 0)
+		{
+			p->dec_refcount_all(nullptr);
+			--seeds;
+		}
+		else if (action == 2 && seeds > 0)
+		{
+			// a seed sending a dont-have message
+			piece_index_t const piece(int(random(num_pieces - 1)));
+			p->dec_refcount(piece, nullptr);
+			--seeds;
+			typed_bitfield<piece_index_t> b(num_pieces, true);
+			b.clear_bit(piece);
+			for (auto const i : b.range()) if (b[i]) ++expected[i];
+			peers.push_back(std::move(b));
+		}
+		else if (action < 6 || peers.empty())
+		{
+			typed_bitfield<piece_index_t> b(num_pieces);
+			for (auto const i : b.range())
+				if (random(1)) b.set_bit(i);
+			p->inc_refcount(b, nullptr);
+			for (auto const i : b.range()) if (b[i]) ++expected[i];
+			peers.push_back(std::move(b));
+		}
+		else
+		{
+			std::size_t const idx = random(std::uint32_t(peers.size() - 1));
+			p->dec_refcount(peers[idx], nullptr);
+			for (auto const i : peers[idx].range()) if (peers[idx][i]) --expected[i];
+			peers.erase(peers.begin() + std::ptrdiff_t(idx));
+		}
+
+		if ((round % 97) == 0)
+		{
+			// picking pieces applies the pending changes
+			std::string const all(std::size_t(num_pieces), '*');
+			pick_pieces(p, all.c_str(), 1, 0, nullptr, options, empty_vector);
+		}
+
+		TEST_EQUAL(p->get_availability(piece_index_t(round % num_pieces))
+			, expected[piece_index_t(round % num_pieces)] + seeds);
+	}
+
+	aux::vector<int, piece_index_t> avail;
+	p->get_availability(avail);
+	for (auto const i : avail.range())
+		TEST_EQUAL(avail[i], expected[i] + seeds);
+}
+
+TORRENT_TEST(batched_refcounts_overflow)
+{
+	// queue more bitfields than the pending counters can hold, without
+	// anything applying them in between. The pending counters have to be
+	// applied when they're full, rather than overflow
+	int const num_pieces = 100;
+	int const num_peers = 600;
+	auto p = std::make_shared<piece_picker>(num_pieces * default_piece_size
+		, default_piece_size);
+
+	aux::vector<int, piece_index_t> expected(static_cast<std::size_t>(num_pieces), 0);
+	std::vector<typed_bitfield<piece_index_t>> peers;
+	for (int k = 0; k < num_peers; ++k)
+	{
+		typed_bitfield<piece_index_t> b(num_pieces);
+		// every peer has piece 0, to make sure at least one counter
+		// exceeds what fits in the pending counters
+		b.set_bit(piece_index_t(0));
+		for (auto const i : b.range())
+			if (random(1)) b.set_bit(i);
+		p->inc_refcount(b, nullptr);
+		for (auto const i : b.range()) if (b[i]) ++expected[i];
+		peers.push_back(std::move(b));
+
+		TEST_EQUAL(p->get_availability(piece_index_t(k % num_pieces))
+			, expected[piece_index_t(k % num_pieces)]);
+	}
+	TEST_EQUAL(p->get_availability(piece_index_t(0)), num_peers);
+
+	aux::vector<int, piece_index_t> avail;
+	p->get_availability(avail);
+	for (auto const i : avail.range())
+		TEST_EQUAL(avail[i], expected[i]);
+
+	for (auto const& b : peers)
+		p->dec_refcount(b, nullptr);
+
+	p->get_availability(avail);
+	for (auto const i : avail.range())
+		TEST_EQUAL(avail[i], 0);
+}
+#endif
+
 TORRENT_TEST(dec_refcount_split_seed)
 {
 	// make sure we can split m_seed when removing a refcount
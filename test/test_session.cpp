@@ -34,6 +34,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "libtorrent/session.hpp"
 #include "libtorrent/session_params.hpp"
+#include "libtorrent/socket.hpp"
 #include <functional>
 #include <thread>
 
@@ -45,6 +46,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/bdecode.hpp"
 #include "libtorrent/bencode.hpp"
 #include "libtorrent/torrent_info.hpp"
+#include "libtorrent/write_resume_data.hpp"
 #include "settings.hpp"
 
 #include <functional>
@@ -213,6 +215,238 @@ TORRENT_TEST(async_add_torrent_duplicate_back_to_back)
 	TEST_CHECK(!(st.flags & torrent_flags::auto_managed));
 }
 
+TORRENT_TEST(apply_to_torrents)
+{
+	lt::session ses(settings());
+
+	std::vector<torrent_handle> handles;
+	for (int i = 0; i < 3; ++i)
+	{
+		add_torrent_params atp;
+		atp.info_hashes.v1[0] = std::uint8_t(i + 1);
+		atp.flags &= ~(torrent_flags::paused | torrent_flags::auto_managed);
+		atp.save_path = ".";
+		handles.push_back(ses.add_torrent(atp));
+	}
+
+	// this torrent is removed before the batch is applied
+	ses.remove_torrent(handles.back());
+
+	ses.apply_to_torrents(handles, [](torrent_handle const& h)
+		{ h.pause(); }, 1337);
+
+	auto* a = alert_cast<batch_complete_alert>(wait_for_alert(ses
+		, batch_complete_alert::alert_type, "ses"));
+	TEST_CHECK(a);
+	if (a == nullptr) return;
+	TEST_EQUAL(a->batch_id, 1337);
+	TEST_EQUAL(a->num_applied, 2);
+	TEST_EQUAL(a->errors.size(), 1);
+	if (a->errors.size() != 1) return;
+	TEST_CHECK(a->errors.front().first == handles.back());
+	TEST_CHECK(a->errors.front().second == error_code(errors::invalid_torrent_handle));
+
+	TEST_CHECK(handles[0].flags() & torrent_flags::paused);
+	TEST_CHECK(handles[1].flags() & torrent_flags::paused);
+}
+
+namespace {
+std::vector<torrent_status_delta> wait_for_deltas(lt::session& ses)
+{
+	auto* a = alert_cast<state_delta_alert>(wait_for_alert(ses
+		, state_delta_alert::alert_type, "ses"));
+	TEST_CHECK(a);
+	if (a == nullptr) return {};
+	return a->deltas;
+}
+}
+
+TORRENT_TEST(post_torrent_deltas)
+{
+	lt::settings_pack pack = settings();
+	pack.set_int(settings_pack::max_state_updates, 2);
+	lt::session ses(pack);
+
+	std::vector<torrent_handle> handles;
+	for (int i = 0; i < 5; ++i)
+	{
+		add_torrent_params atp;
+		atp.info_hashes.v1[0] = std::uint8_t(i + 1);
+		atp.flags |= torrent_flags::paused;
+		atp.flags &= ~torrent_flags::auto_managed;
+		atp.save_path = ".";
+		handles.push_back(ses.add_torrent(atp));
+	}
+
+	// all five torrents are new, but only two fit in one update. The first
+	// time a torrent is posted, all fields are included
+	ses.post_torrent_deltas();
+	std::vector<torrent_status_delta> d = wait_for_deltas(ses);
+	TEST_EQUAL(d.size(), 2);
+	for (auto const& delta : d)
+	{
+		TEST_CHECK(delta.handle == handles[0] || delta.handle == handles[1]);
+		TEST_CHECK(delta.fields == (torrent_status_delta::state_field
+			| torrent_status_delta::flags_field
+			| torrent_status_delta::progress_field
+			| torrent_status_delta::rate_fields
+			| torrent_status_delta::peer_fields
+			| torrent_status_delta::done_fields
+			| torrent_status_delta::all_time_fields
+			| torrent_status_delta::queue_position_field
+			| torrent_status_delta::error_field));
+		TEST_CHECK(delta.flags & torrent_flags::paused);
+	}
+
+	// a torrent that changes again is queued behind the ones that didn't fit
+	handles[0].set_flags(torrent_flags::sequential_download);
+	ses.post_torrent_deltas();
+	d = wait_for_deltas(ses);
+	TEST_EQUAL(d.size(), 2);
+	if (d.size() == 2)
+	{
+		TEST_CHECK(d[0].handle == handles[2]);
+		TEST_CHECK(d[1].handle == handles[3]);
+	}
+
+	ses.post_torrent_deltas();
+	d = wait_for_deltas(ses);
+	TEST_EQUAL(d.size(), 2);
+	if (d.size() == 2)
+	{
+		TEST_CHECK(d[0].handle == handles[4]);
+		TEST_CHECK(d[1].handle == handles[0]);
+		TEST_CHECK(d[1].fields == torrent_status_delta::flags_field);
+	}
+
+	// nothing changed
+	ses.post_torrent_deltas();
+	d = wait_for_deltas(ses);
+	TEST_EQUAL(d.size(), 0);
+
+	// only the field that changed is included
+	handles[1].set_flags(torrent_flags::sequential_download);
+	ses.post_torrent_deltas();
+	d = wait_for_deltas(ses);
+	TEST_EQUAL(d.size(), 1);
+	if (d.size() != 1) return;
+	TEST_CHECK(d[0].handle == handles[1]);
+	TEST_CHECK(d[0].fields == torrent_status_delta::flags_field);
+	TEST_CHECK(d[0].flags & torrent_flags::sequential_download);
+
+	// fields that weren't asked for are left out
+	handles[2].set_flags(torrent_flags::sequential_download);
+	ses.post_torrent_deltas(torrent_status_delta::state_field);
+	d = wait_for_deltas(ses);
+	TEST_EQUAL(d.size(), 0);
+}
+
+namespace {
+
+struct added_torrent
+{
+	sha1_hash info_hash;
+	std::string save_path;
+	error_code error;
+};
+
+std::vector<added_torrent> wait_for_added_torrents(lt::session& ses, int const num)
+{
+	std::vector<added_torrent> ret;
+	time_point const end_time = clock_type::now() + seconds(15);
+	while (int(ret.size()) < num)
+	{
+		time_point const now = clock_type::now();
+		if (now > end_time) break;
+		ses.wait_for_alert(end_time - now);
+		std::vector<alert*> alerts;
+		ses.pop_alerts(&alerts);
+		for (auto const* a : alerts)
+		{
+			auto const* at = alert_cast<add_torrent_alert>(a);
+			if (at == nullptr) continue;
+			ret.push_back({at->params.info_hashes.v1, at->params.save_path, at->error});
+		}
+	}
+	return ret;
+}
+
+sha1_hash numbered_hash(int const i)
+{
+	sha1_hash ret;
+	ret[0] = 1;
+	ret[1] = std::uint8_t(i >> 8);
+	ret[2] = std::uint8_t(i & 0xff);
+	return ret;
+}
+
+} // anonymous namespace
+
+TORRENT_TEST(async_add_torrents)
+{
+	lt::session ses(settings());
+
+	// more than one batch
+	int const num_torrents = 600;
+	std::vector<add_torrent_params> params;
+	for (int i = 0; i < num_torrents; ++i)
+	{
+		add_torrent_params atp;
+		atp.info_hashes.v1 = numbered_hash(i);
+		atp.save_path = ".";
+		params.push_back(std::move(atp));
+	}
+	ses.async_add_torrents(std::move(params));
+
+	std::vector<added_torrent> const added = wait_for_added_torrents(ses, num_torrents);
+	TEST_EQUAL(int(added.size()), num_torrents);
+
+	// the torrents are added in the order they were passed in
+	for (int i = 0; i < int(added.size()); ++i)
+	{
+		TEST_CHECK(!added[std::size_t(i)].error);
+		TEST_CHECK(added[std::size_t(i)].info_hash == numbered_hash(i));
+	}
+	TEST_EQUAL(int(ses.get_torrents().size()), num_torrents);
+}
+
+TORRENT_TEST(async_add_torrents_resume_data)
+{
+	lt::session ses(settings());
+
+	std::vector<std::vector<char>> resume_data;
+
+	add_torrent_params atp;
+	atp.info_hashes.v1 = numbered_hash(0);
+	atp.save_path = "resume_save_path";
+	resume_data.push_back(write_resume_data_buf(atp));
+
+	// this one doesn't have a save path
+	atp.info_hashes.v1 = numbered_hash(1);
+	atp.save_path.clear();
+	resume_data.push_back(write_resume_data_buf(atp));
+
+	std::string const garbage = "d11:not resume";
+	resume_data.emplace_back(garbage.begin(), garbage.end());
+
+	ses.async_add_torrents(std::move(resume_data), "default_save_path");
+
+	std::vector<added_torrent> const added = wait_for_added_torrents(ses, 3);
+	TEST_EQUAL(added.size(), 3);
+	if (added.size() != 3) return;
+
+	TEST_CHECK(!added[0].error);
+	TEST_CHECK(added[0].info_hash == numbered_hash(0));
+	TEST_CHECK(added[0].save_path.find("resume_save_path") != std::string::npos);
+
+	TEST_CHECK(!added[1].error);
+	TEST_CHECK(added[1].info_hash == numbered_hash(1));
+	TEST_CHECK(added[1].save_path.find("default_save_path") != std::string::npos);
+
+	TEST_CHECK(added[2].error);
+	TEST_EQUAL(int(ses.get_torrents().size()), 2);
+}
+
 TORRENT_TEST(load_empty_file)
 {
 	settings_pack p = settings();
@@ -580,3 +814,51 @@ TORRENT_TEST(reopen_network_sockets)
 #endif // TORRENT_DISABLE_ALERT_MSG
 #endif
 
+
+#if TORRENT_HAS_REUSEPORT
+TORRENT_TEST(listen_shards)
+{
+	settings_pack p = settings();
+	p.set_int(settings_pack::alert_mask, alert_category::peer);
+	p.set_str(settings_pack::listen_interfaces, "127.0.0.1:0");
+	p.set_int(settings_pack::listen_shards, 2);
+	// the torrent may still be queued when the connections come in
+	p.set_bool(settings_pack::incoming_starts_queued_torrents, true);
+	lt::session ses(p);
+
+	// incoming connections are rejected if there are no torrents
+	add_torrent_params atp;
+	atp.info_hashes.v1.assign("abababababababababab");
+	atp.save_path = ".";
+	ses.add_torrent(atp);
+
+	int const port = ses.listen_port();
+	TEST_CHECK(port != 0);
+
+	// the kernel spreads the connections over the listen socket and its
+	// shards. Either way, they all end up as incoming connections
+	int const num_connections = 20;
+	lt::io_context ios;
+	std::vector<tcp::socket> socks;
+	for (int i = 0; i < num_connections; ++i)
+	{
+		socks.emplace_back(ios);
+		error_code ec;
+		socks.back().connect(tcp::endpoint(make_address_v4("127.0.0.1")
+			, std::uint16_t(port)), ec);
+		TEST_CHECK(!ec);
+	}
+
+	int incoming = 0;
+	time_point const end_time = clock_type::now() + seconds(10);
+	while (incoming < num_connections && clock_type::now() < end_time)
+	{
+		ses.wait_for_alert(seconds(1));
+		std::vector<alert*> alerts;
+		ses.pop_alerts(&alerts);
+		for (auto a : alerts)
+			if (alert_cast<incoming_connection_alert>(a)) ++incoming;
+	}
+	TEST_EQUAL(incoming, num_connections);
+}
+#endif
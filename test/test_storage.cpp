@@ -57,6 +57,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/random.hpp"
 #include "libtorrent/mmap_disk_io.hpp"
 #include "libtorrent/posix_disk_io.hpp"
+#include "libtorrent/io_uring_disk_io.hpp"
 #include "libtorrent/flags.hpp"
 
 #include <memory>
@@ -870,6 +871,16 @@ TORRENT_TEST(check_files_allocate_posix)
 	test_check_files(zero_prio, lt::posix_disk_io_constructor);
 }
 
+TORRENT_TEST(check_files_sparse_io_uring)
+{
+	test_check_files(sparse | zero_prio, lt::io_uring_disk_io_constructor);
+}
+
+TORRENT_TEST(check_files_oversized_io_uring)
+{
+	test_check_files(sparse | test_oversized, lt::io_uring_disk_io_constructor);
+}
+
 // posix_storage doesn't support pre-allocating files on non-windows
 /*
 TORRENT_TEST(test_pre_allocate_posix)
@@ -1859,7 +1870,278 @@ void none_from_store_buffer(lt::disk_interface* disk_io, lt::storage_holder cons
 	sync(ioc, outstanding);
 }
 
+// issue writes for every block of a few pieces, followed immediately by hash
+// jobs for them, with several disk threads. The hash jobs may run before the
+// writes complete, and must still see the data
+void test_threaded_hash(lt::disk_io_constructor_type constructor)
+{
+	lt::io_context ioc;
+	lt::counters cnt;
+	lt::settings_pack pack;
+	pack.set_int(lt::settings_pack::aio_threads, 4);
+	pack.set_int(lt::settings_pack::hashing_threads, 2);
+
+	std::unique_ptr<lt::disk_interface> disk_io = constructor(ioc, pack, cnt);
+
+	int const piece_size = lt::default_block_size * 4;
+	int const num_pieces = 8;
+	lt::file_storage fs;
+	fs.add_file("test", piece_size * num_pieces);
+	fs.set_num_pieces(num_pieces);
+	fs.set_piece_length(piece_size);
+
+	std::string const save_path = complete("save_path");
+	delete_dirs(combine_path(save_path, "test"));
+
+	lt::aux::vector<lt::download_priority_t, lt::file_index_t> prios;
+	lt::storage_params params(fs, nullptr
+		, save_path
+		, lt::storage_mode_sparse
+		, prios
+		, lt::sha1_hash("01234567890123456789"));
+
+	lt::storage_holder t = disk_io->new_torrent(params, {});
+
+	int outstanding = 0;
+	lt::add_torrent_params atp;
+	disk_io->async_check_files(t, &atp, lt::aux::vector<std::string, lt::file_index_t>{}
+		, [&](lt::status_t, lt::storage_error const&) { --outstanding; });
+	++outstanding;
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	std::vector<char> data(std::size_t(piece_size * num_pieces));
+	aux::random_bytes(data);
+
+	int hashed = 0;
+	for (lt::piece_index_t p(0); p < lt::piece_index_t(num_pieces); ++p)
+	{
+		char const* piece_data = data.data() + static_cast<int>(p) * piece_size;
+		for (int offset = 0; offset < piece_size; offset += lt::default_block_size)
+		{
+			++outstanding;
+			disk_io->async_write(t, {p, offset, lt::default_block_size}
+				, piece_data + offset, {}, write_handler(outstanding));
+		}
+		lt::sha1_hash const expected = lt::hasher(piece_data, piece_size).final();
+		++outstanding;
+		disk_io->async_hash(t, p, {}, lt::disk_interface::v1_hash
+			, [&, expected](lt::piece_index_t, lt::sha1_hash const& h, lt::storage_error const& e)
+			{
+				--outstanding;
+				++hashed;
+				TEST_CHECK(!e.ec);
+				TEST_CHECK(h == expected);
+			});
+	}
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+	TEST_EQUAL(hashed, num_pieces);
+
+	// now hash the pieces again, from disk, on the hashing threads
+	for (lt::piece_index_t p(0); p < lt::piece_index_t(num_pieces); ++p)
+	{
+		char const* piece_data = data.data() + static_cast<int>(p) * piece_size;
+		lt::sha1_hash const expected = lt::hasher(piece_data, piece_size).final();
+		++outstanding;
+		disk_io->async_hash(t, p, {}, lt::disk_interface::v1_hash
+			| lt::disk_interface::sequential_access
+			, [&, expected](lt::piece_index_t, lt::sha1_hash const& h, lt::storage_error const& e)
+			{
+				--outstanding;
+				++hashed;
+				TEST_CHECK(!e.ec);
+				TEST_CHECK(h == expected);
+			});
+	}
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+	TEST_EQUAL(hashed, num_pieces * 2);
+
+	t.reset();
+	disk_io->abort(true);
+}
+
+}
+
+#if TORRENT_HAVE_MMAP
+TORRENT_TEST(mmap_zero_copy_read)
+{
+	lt::io_context ioc;
+	lt::counters cnt;
+	lt::settings_pack pack;
+	pack.set_int(lt::settings_pack::aio_threads, 1);
+
+	std::unique_ptr<lt::disk_interface> disk_io
+		= lt::mmap_disk_io_constructor(ioc, pack, cnt);
+
+	// the files need to be large enough to be memory mapped. One block spans
+	// both files
+	int const piece_size = 0x400000;
+	lt::file_storage fs;
+	fs.add_file("zero_copy/a", piece_size / 2 + lt::default_block_size / 2);
+	fs.add_file("zero_copy/b", piece_size / 2 - lt::default_block_size / 2);
+	fs.set_piece_length(piece_size);
+	fs.set_num_pieces(1);
+
+	std::string const save_path = complete("save_path");
+	delete_dirs(combine_path(save_path, "zero_copy"));
+
+	lt::aux::vector<lt::download_priority_t, lt::file_index_t> prios;
+	lt::storage_params params(fs, nullptr
+		, save_path
+		, lt::storage_mode_sparse
+		, prios
+		, lt::sha1_hash("01234567890123456789"));
+
+	lt::storage_holder t = disk_io->new_torrent(params, {});
+
+	int outstanding = 0;
+	lt::add_torrent_params atp;
+	disk_io->async_check_files(t, &atp, lt::aux::vector<std::string, lt::file_index_t>{}
+		, [&](lt::status_t, lt::storage_error const&) { --outstanding; });
+	++outstanding;
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	std::vector<char> data(static_cast<std::size_t>(piece_size));
+	aux::random_bytes(data);
+
+	std::vector<lt::peer_request> blocks;
+	for (int offset = 0; offset < piece_size; offset += lt::default_block_size)
+	{
+		lt::peer_request const r{lt::piece_index_t(0), offset, lt::default_block_size};
+		blocks.push_back(r);
+		++outstanding;
+		disk_io->async_write(t, r, data.data() + offset, {}, write_handler(outstanding));
+	}
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	std::vector<lt::disk_buffer_holder> views(blocks.size());
+	for (std::size_t i = 0; i < blocks.size(); ++i)
+	{
+		lt::peer_request const r = blocks[i];
+		++outstanding;
+		disk_io->async_read(t, r, [&, r, i](lt::disk_buffer_holder h, lt::storage_error const& ec)
+			{
+				--outstanding;
+				TEST_CHECK(!ec);
+				TEST_CHECK(lt::span<char const>(data.data() + r.start, r.length)
+					== lt::span<char const>(h.data(), h.size()));
+				views[i] = std::move(h);
+			}, lt::disk_interface::zero_copy);
+	}
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	// all blocks but the one spanning the two files are referenced in place
+	TEST_EQUAL(cnt[lt::counters::num_zero_copy_reads], std::int64_t(blocks.size()) - 1);
+
+	// the views keep the mappings alive, even if the storage closes its files
+	++outstanding;
+	disk_io->async_release_files(t, [&] { --outstanding; });
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	for (std::size_t i = 0; i < blocks.size(); ++i)
+	{
+		lt::peer_request const& r = blocks[i];
+		TEST_CHECK(lt::span<char const>(data.data() + r.start, r.length)
+			== lt::span<char const>(views[i].data(), views[i].size()));
+	}
+	views.clear();
+
+	t.reset();
+	disk_io->abort(true);
+}
+#endif
+
+#if TORRENT_HAVE_MMAP || TORRENT_HAVE_MAP_VIEW_OF_FILE
+TORRENT_TEST(mmap_coalesce_piece_writes)
+{
+	lt::io_context ioc;
+	lt::counters cnt;
+	lt::settings_pack pack;
+	pack.set_int(lt::settings_pack::aio_threads, 2);
+	pack.set_bool(lt::settings_pack::coalesce_piece_writes, true);
+
+	std::unique_ptr<lt::disk_interface> disk_io
+		= lt::mmap_disk_io_constructor(ioc, pack, cnt);
+
+	int const piece_size = lt::default_block_size * 8;
+	int const num_pieces = 4;
+	lt::file_storage fs;
+	fs.add_file("coalesce", piece_size * num_pieces);
+	fs.set_num_pieces(num_pieces);
+	fs.set_piece_length(piece_size);
+
+	std::string const save_path = complete("save_path");
+	delete_dirs(combine_path(save_path, "coalesce"));
+
+	lt::aux::vector<lt::download_priority_t, lt::file_index_t> prios;
+	lt::storage_params params(fs, nullptr
+		, save_path
+		, lt::storage_mode_sparse
+		, prios
+		, lt::sha1_hash("01234567890123456789"));
+
+	lt::storage_holder t = disk_io->new_torrent(params, {});
+
+	int outstanding = 0;
+	lt::add_torrent_params atp;
+	disk_io->async_check_files(t, &atp, lt::aux::vector<std::string, lt::file_index_t>{}
+		, [&](lt::status_t, lt::storage_error const&) { --outstanding; });
+	++outstanding;
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	std::vector<char> data(std::size_t(piece_size * num_pieces));
+	aux::random_bytes(data);
+
+	// queue the blocks in reverse order, interleaving the pieces, the way
+	// they may arrive from many peers. The writes to each piece are
+	// performed together, ordered by offset
+	for (int offset = piece_size - lt::default_block_size; offset >= 0
+		; offset -= lt::default_block_size)
+	{
+		for (lt::piece_index_t p(0); p < lt::piece_index_t(num_pieces); ++p)
+		{
+			++outstanding;
+			disk_io->async_write(t, {p, offset, lt::default_block_size}
+				, data.data() + static_cast<int>(p) * piece_size + offset, {}
+				, write_handler(outstanding));
+		}
+	}
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+	TEST_EQUAL(cnt[lt::counters::num_blocks_written], num_pieces * piece_size / lt::default_block_size);
+
+	// all blocks were queued before the disk threads were woken up, so all
+	// but the first block of each piece were written together with it
+	TEST_EQUAL(cnt[lt::counters::num_coalesced_writes]
+		, num_pieces * (piece_size / lt::default_block_size - 1));
+
+	for (lt::piece_index_t p(0); p < lt::piece_index_t(num_pieces); ++p)
+	{
+		char const* piece_data = data.data() + static_cast<int>(p) * piece_size;
+		lt::sha1_hash const expected = lt::hasher(piece_data, piece_size).final();
+		++outstanding;
+		disk_io->async_hash(t, p, {}, lt::disk_interface::v1_hash
+			, [&, expected](lt::piece_index_t, lt::sha1_hash const& h, lt::storage_error const& e)
+			{
+				--outstanding;
+				TEST_CHECK(!e.ec);
+				TEST_CHECK(h == expected);
+			});
+	}
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	t.reset();
+	disk_io->abort(true);
 }
+#endif
 
 #if TORRENT_HAVE_MMAP || TORRENT_HAVE_MAP_VIEW_OF_FILE
 TORRENT_TEST(mmap_unaligned_read_both_store_buffer)
@@ -1871,6 +2153,68 @@ TORRENT_TEST(mmap_unaligned_read_both_store_buffer)
 }
 #endif
 
+#if TORRENT_HAVE_MMAP || TORRENT_HAVE_MAP_VIEW_OF_FILE
+TORRENT_TEST(mmap_threaded_hash)
+{
+	test_threaded_hash(lt::mmap_disk_io_constructor);
+}
+#endif
+
+#if TORRENT_HAVE_MMAP || TORRENT_HAVE_MAP_VIEW_OF_FILE
+TORRENT_TEST(mmap_hash_pieces)
+{
+	// piece 2 spans both files, the others are stored in a single file
+	int const piece_len = 0x8000;
+	file_storage fs;
+	fs.add_file(combine_path("hash_pieces", "a"), piece_len * 2 + piece_len / 2);
+	fs.add_file(combine_path("hash_pieces", "b"), piece_len + piece_len / 2);
+	fs.set_piece_length(piece_len);
+	fs.set_num_pieces(4);
+
+	std::string const test_path = complete("save_path");
+	delete_dirs(combine_path(test_path, "hash_pieces"));
+
+	aux::vector<download_priority_t, file_index_t> priorities;
+	storage_params p{fs, nullptr, test_path, storage_mode_sparse
+		, priorities, sha1_hash{}};
+	aux::file_view_pool fp;
+	aux::session_settings set;
+	// the files are too small to be memory mapped by default
+	set.set_int(settings_pack::mmap_file_size_cutoff, 0);
+	auto s = make_storage<mmap_storage>(p, fp);
+
+	std::vector<char> data(std::size_t(fs.total_size()));
+	aux::random_bytes(data);
+	for (piece_index_t i(0); i < fs.end_piece(); ++i)
+	{
+		storage_error se;
+		write(s, set, {data.data() + static_cast<int>(i) * piece_len, piece_len}
+			, i, 0, aux::open_mode::write, se);
+		TEST_CHECK(!se);
+	}
+
+	std::vector<piece_index_t> const pieces{0_piece, 1_piece, 2_piece, 3_piece};
+	std::vector<sha1_hash> hashes(pieces.size());
+	bitfield hashed;
+	int const ret = s->hash_pieces(set, pieces, hashes, hashed
+		, aux::open_mode::read_only, {});
+	TEST_EQUAL(ret, 3);
+	TEST_EQUAL(hashed.size(), 4);
+	for (int i = 0; i < 4; ++i)
+	{
+		TEST_EQUAL(hashed.get_bit(i), i != 2);
+		if (!hashed.get_bit(i)) continue;
+		TEST_EQUAL(hashes[std::size_t(i)]
+			, hasher(span<char const>(data.data() + i * piece_len, piece_len)).final());
+	}
+}
+#endif
+
+TORRENT_TEST(posix_threaded_hash)
+{
+	test_threaded_hash(lt::posix_disk_io_constructor);
+}
+
 TORRENT_TEST(posix_unaligned_read_both_store_buffer)
 {
 	test_unaligned_read(lt::posix_disk_io_constructor, both_sides_from_store_buffer);
@@ -1878,3 +2222,198 @@ TORRENT_TEST(posix_unaligned_read_both_store_buffer)
 	test_unaligned_read(lt::posix_disk_io_constructor, second_side_from_store_buffer);
 	test_unaligned_read(lt::posix_disk_io_constructor, none_from_store_buffer);
 }
+
+TORRENT_TEST(io_uring_unaligned_read_both_store_buffer)
+{
+	test_unaligned_read(lt::io_uring_disk_io_constructor, both_sides_from_store_buffer);
+	test_unaligned_read(lt::io_uring_disk_io_constructor, first_side_from_store_buffer);
+	test_unaligned_read(lt::io_uring_disk_io_constructor, second_side_from_store_buffer);
+	test_unaligned_read(lt::io_uring_disk_io_constructor, none_from_store_buffer);
+}
+
+namespace {
+
+void test_write_disk_buffer(lt::disk_io_constructor_type constructor)
+{
+	lt::io_context ioc;
+	lt::counters cnt;
+	lt::settings_pack pack;
+
+	std::unique_ptr<lt::disk_interface> disk_io = constructor(ioc, pack, cnt);
+
+	int const piece_size = lt::default_block_size * 2;
+	int const num_pieces = 2;
+	lt::file_storage fs;
+	fs.add_file("direct", piece_size * num_pieces);
+	fs.set_num_pieces(num_pieces);
+	fs.set_piece_length(piece_size);
+
+	std::string const save_path = complete("save_path");
+	delete_dirs(combine_path(save_path, "direct"));
+
+	lt::aux::vector<lt::download_priority_t, lt::file_index_t> prios;
+	lt::storage_params params(fs, nullptr
+		, save_path
+		, lt::storage_mode_sparse
+		, prios
+		, lt::sha1_hash("01234567890123456789"));
+
+	lt::storage_holder t = disk_io->new_torrent(params, {});
+
+	int outstanding = 0;
+	lt::add_torrent_params atp;
+	disk_io->async_check_files(t, &atp, lt::aux::vector<std::string, lt::file_index_t>{}
+		, [&](lt::status_t, lt::storage_error const&) { --outstanding; });
+	++outstanding;
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	std::vector<char> data(std::size_t(piece_size * num_pieces));
+	aux::random_bytes(data);
+
+	// hand over buffers from the disk I/O object, the way a peer receiving
+	// blocks directly into them does
+	for (int offset = 0; offset < piece_size * num_pieces; offset += lt::default_block_size)
+	{
+		bool exceeded = true;
+		lt::disk_buffer_holder buf = disk_io->allocate_disk_buffer(exceeded, {});
+		TEST_CHECK(buf);
+		TEST_CHECK(!exceeded);
+		TEST_CHECK(buf.size() >= lt::default_block_size);
+		std::memcpy(buf.data(), data.data() + offset, std::size_t(lt::default_block_size));
+
+		++outstanding;
+		lt::peer_request const r{lt::piece_index_t(offset / piece_size)
+			, offset % piece_size, lt::default_block_size};
+		disk_io->async_write(t, r, std::move(buf), {}, write_handler(outstanding));
+	}
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	for (int offset = 0; offset < piece_size * num_pieces; offset += lt::default_block_size)
+	{
+		++outstanding;
+		lt::peer_request const r{lt::piece_index_t(offset / piece_size)
+			, offset % piece_size, lt::default_block_size};
+		disk_io->async_read(t, r
+			, [&, offset](lt::disk_buffer_holder h, lt::storage_error const& e)
+			{
+				--outstanding;
+				TEST_CHECK(!e.ec);
+				TEST_CHECK(std::memcmp(h.data(), data.data() + offset
+					, std::size_t(lt::default_block_size)) == 0);
+			});
+	}
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	t.reset();
+	disk_io->abort(true);
+}
+
+} // anonymous namespace
+
+#if TORRENT_HAVE_MMAP || TORRENT_HAVE_MAP_VIEW_OF_FILE
+TORRENT_TEST(mmap_write_disk_buffer)
+{
+	test_write_disk_buffer(lt::mmap_disk_io_constructor);
+}
+#endif
+
+TORRENT_TEST(posix_write_disk_buffer)
+{
+	test_write_disk_buffer(lt::posix_disk_io_constructor);
+}
+
+TORRENT_TEST(io_uring_write_disk_buffer)
+{
+	test_write_disk_buffer(lt::io_uring_disk_io_constructor);
+}
+
+// more files than fit in the file pool are written and read back. Every piece
+// is hashed right after its blocks are posted, which must not run until the
+// writes have completed
+TORRENT_TEST(io_uring_file_pool_and_hash_ordering)
+{
+	lt::io_context ioc;
+	lt::counters cnt;
+	lt::settings_pack pack;
+	pack.set_int(lt::settings_pack::file_pool_size, 1);
+
+	std::unique_ptr<lt::disk_interface> disk_io
+		= lt::io_uring_disk_io_constructor(ioc, pack, cnt);
+
+	int const piece_size = lt::default_block_size * 2;
+	int const num_pieces = 4;
+	lt::file_storage fs;
+	for (int i = 0; i < num_pieces; ++i)
+		fs.add_file(combine_path("pool", "file" + std::to_string(i)), piece_size);
+	fs.set_num_pieces(num_pieces);
+	fs.set_piece_length(piece_size);
+
+	std::string const save_path = complete("save_path");
+	delete_dirs(combine_path(save_path, "pool"));
+
+	lt::aux::vector<lt::download_priority_t, lt::file_index_t> prios;
+	lt::storage_params params(fs, nullptr
+		, save_path
+		, lt::storage_mode_sparse
+		, prios
+		, lt::sha1_hash("01234567890123456789"));
+
+	lt::storage_holder t = disk_io->new_torrent(params, {});
+
+	int outstanding = 0;
+	lt::add_torrent_params atp;
+	disk_io->async_check_files(t, &atp, lt::aux::vector<std::string, lt::file_index_t>{}
+		, [&](lt::status_t, lt::storage_error const&) { --outstanding; });
+	++outstanding;
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	std::vector<char> data(std::size_t(piece_size * num_pieces));
+	aux::random_bytes(data);
+
+	for (lt::piece_index_t p(0); p < lt::piece_index_t(num_pieces); ++p)
+	{
+		char const* piece_data = data.data() + static_cast<int>(p) * piece_size;
+		for (int offset = 0; offset < piece_size; offset += lt::default_block_size)
+		{
+			++outstanding;
+			disk_io->async_write(t, lt::peer_request{p, offset, lt::default_block_size}
+				, piece_data + offset, {}, write_handler(outstanding));
+		}
+
+		lt::sha1_hash const expected = lt::hasher(piece_data, piece_size).final();
+		++outstanding;
+		disk_io->async_hash(t, p, {}, lt::disk_interface::v1_hash
+			, [&, expected](lt::piece_index_t, lt::sha1_hash const& h, lt::storage_error const& e)
+			{
+				--outstanding;
+				TEST_CHECK(!e.ec);
+				TEST_CHECK(h == expected);
+			});
+	}
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	for (int offset = 0; offset < piece_size * num_pieces; offset += lt::default_block_size)
+	{
+		++outstanding;
+		lt::peer_request const r{lt::piece_index_t(offset / piece_size)
+			, offset % piece_size, lt::default_block_size};
+		disk_io->async_read(t, r
+			, [&, offset](lt::disk_buffer_holder h, lt::storage_error const& e)
+			{
+				--outstanding;
+				TEST_CHECK(!e.ec);
+				TEST_CHECK(std::memcmp(h.data(), data.data() + offset
+					, std::size_t(lt::default_block_size)) == 0);
+			});
+	}
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	t.reset();
+	disk_io->abort(true);
+}
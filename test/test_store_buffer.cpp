@@ -34,6 +34,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/store_buffer.hpp"
 #include "libtorrent/disk_interface.hpp" // for default_block_size
 
+#include <thread>
+#include <vector>
+
 using lt::aux::torrent_location;
 using lt::aux::store_buffer;
 
@@ -184,3 +187,47 @@ TORRENT_TEST(store_buffer_get2)
 	check2_miss(sb, loc[7], loc[4]);
 }
 
+
+TORRENT_TEST(store_buffer_threads)
+{
+	store_buffer sb;
+	std::vector<char> bufs(4 * 64);
+	std::vector<std::thread> threads;
+	// the test framework isn't thread safe. Each thread counts its
+	// mismatches, and they're checked once the threads are done
+	std::vector<int> mismatches(4, 0);
+	for (int t = 0; t < 4; ++t)
+	{
+		threads.emplace_back([&sb, &bufs, &mismatches, t] {
+			lt::storage_index_t const st(t);
+			int& failed = mismatches[std::size_t(t)];
+			for (int round = 0; round < 100; ++round)
+			{
+				for (int i = 0; i < 64; ++i)
+					sb.insert({st, lt::piece_index_t(i / 4), (i % 4) * lt::default_block_size}
+						, &bufs[std::size_t(t * 64 + i)]);
+
+				for (int i = 0; i < 63; ++i)
+				{
+					torrent_location const l0(st, lt::piece_index_t(i / 4), (i % 4) * lt::default_block_size);
+					torrent_location const l1(st, lt::piece_index_t((i + 1) / 4), ((i + 1) % 4) * lt::default_block_size);
+					char const* const expected0 = &bufs[std::size_t(t * 64 + i)];
+					char const* const expected1 = &bufs[std::size_t(t * 64 + i + 1)];
+					if (!sb.get(l0, [&](char const* b) { if (b != expected0) ++failed; }))
+						++failed;
+					int const ret = sb.get2(l0, l1, [&](char const* b0, char const* b1) {
+						if (b0 != expected0 || b1 != expected1) ++failed;
+						return 1337;
+					});
+					if (ret != 1337) ++failed;
+				}
+
+				for (int i = 0; i < 64; ++i)
+					sb.erase({st, lt::piece_index_t(i / 4), (i % 4) * lt::default_block_size});
+			}
+		});
+	}
+	for (auto& t : threads) t.join();
+	for (int const m : mismatches) TEST_EQUAL(m, 0);
+	TEST_EQUAL(sb.size(), 0);
+}
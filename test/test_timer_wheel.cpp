@@ -0,0 +1,121 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "test.hpp"
+#include "libtorrent/aux_/timer_wheel.hpp"
+
+#include <utility>
+#include <vector>
+
+using namespace lt;
+
+namespace {
+
+using expired_t = std::vector<std::pair<int, std::int64_t>>;
+
+expired_t advance(aux::timer_wheel<int>& w)
+{
+	expired_t ret;
+	w.advance([&](int const item, std::int64_t const when)
+		{ ret.emplace_back(item, when); });
+	return ret;
+}
+
+}
+
+TORRENT_TEST(schedule)
+{
+	aux::timer_wheel<int> w(8);
+	TEST_EQUAL(w.now(), 0);
+	w.schedule(1, 1);
+	w.schedule(2, 3);
+	w.schedule(3, 3);
+	TEST_EQUAL(w.size(), 3);
+
+	TEST_CHECK((advance(w) == expired_t{{1, 1}}));
+	TEST_EQUAL(w.now(), 1);
+	TEST_CHECK(advance(w).empty());
+	TEST_CHECK((advance(w) == expired_t{{2, 3}, {3, 3}}));
+	TEST_EQUAL(w.size(), 0);
+}
+
+TORRENT_TEST(schedule_in_the_past)
+{
+	aux::timer_wheel<int> w(8);
+	advance(w);
+	advance(w);
+	// items that are already due expire on the next tick
+	w.schedule(1, 0);
+	w.schedule(2, 2);
+	TEST_CHECK((advance(w) == expired_t{{1, 3}, {2, 3}}));
+}
+
+TORRENT_TEST(beyond_one_turn)
+{
+	// items more than one turn of the wheel ahead stay in their slot until
+	// their turn comes up
+	aux::timer_wheel<int> w(4);
+	w.schedule(1, 2);
+	w.schedule(2, 6);
+	w.schedule(3, 10);
+
+	for (int i = 1; i <= 10; ++i)
+	{
+		expired_t const e = advance(w);
+		if (i == 2) TEST_CHECK((e == expired_t{{1, 2}}));
+		else if (i == 6) TEST_CHECK((e == expired_t{{2, 6}}));
+		else if (i == 10) TEST_CHECK((e == expired_t{{3, 10}}));
+		else TEST_CHECK(e.empty());
+	}
+	TEST_EQUAL(w.size(), 0);
+}
+
+TORRENT_TEST(reschedule_from_callback)
+{
+	aux::timer_wheel<int> w(4);
+	w.schedule(1, 1);
+
+	// the callback reschedules the item one turn of the wheel ahead, which
+	// lands in the slot that's being expired
+	std::vector<std::int64_t> ticks;
+	for (int i = 0; i < 9; ++i)
+	{
+		w.advance([&](int const item, std::int64_t const when)
+		{
+			ticks.push_back(when);
+			w.schedule(item, when + 4);
+		});
+	}
+	TEST_CHECK((ticks == std::vector<std::int64_t>{1, 5, 9}));
+	TEST_EQUAL(w.size(), 1);
+}
@@ -53,6 +53,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "settings.hpp"
 #include <tuple>
 #include <iostream>
+#include <future>
+#include <atomic>
+#include <thread>
 
 #include "test.hpp"
 #include "test_utils.hpp"
@@ -496,6 +499,45 @@ TORRENT_TEST(duplicate_is_not_error)
 	// we should only have added the plugin once
 	TEST_EQUAL(called, 1);
 }
+
+namespace {
+struct tick_counter : lt::torrent_plugin
+{
+	explicit tick_counter(std::atomic<int>& t) : m_ticks(t) {}
+	void tick() override { ++m_ticks; }
+	std::atomic<int>& m_ticks;
+};
+}
+
+TORRENT_TEST(idle_torrent_is_not_ticked)
+{
+	lt::settings_pack pack = settings();
+	// with this disabled, there is no inactive state to settle
+	pack.set_bool(settings_pack::dont_count_slow_torrents, false);
+	lt::session ses(pack);
+
+	std::atomic<int> ticks{0};
+	add_torrent_params atp;
+	atp.info_hashes.v1 = sha1_hash("abababababababababab");
+	atp.save_path = ".";
+	atp.flags &= ~torrent_flags::paused;
+	atp.flags &= ~torrent_flags::auto_managed;
+	atp.extensions.push_back([&ticks](torrent_handle const&, client_data_t)
+		{ return std::make_shared<tick_counter>(ticks); });
+	torrent_handle h = ses.add_torrent(std::move(atp));
+
+	// the torrent has no peers and doesn't transfer anything
+	std::this_thread::sleep_for(lt::seconds(2));
+	int const idle_ticks = ticks.load();
+	std::this_thread::sleep_for(lt::seconds(3));
+	TEST_EQUAL(ticks.load(), idle_ticks);
+
+	// traffic wakes it up
+	std::shared_ptr<lt::torrent> t = h.native_handle();
+	post(ses.get_context(), [t] { t->received_bytes(10000, 100); });
+	std::this_thread::sleep_for(lt::seconds(3));
+	TEST_CHECK(ticks.load() > idle_ticks);
+}
 #endif
 
 TORRENT_TEST(torrent_total_size_zero)
@@ -550,6 +592,52 @@ TORRENT_TEST(torrent_status)
 	TEST_EQUAL(static_cast<int>(torrent_status::error_file_exception), -5);
 }
 
+TORRENT_TEST(status_snapshot)
+{
+	lt::settings_pack pack = settings();
+	pack.set_bool(settings_pack::status_snapshots, true);
+	lt::session ses(pack);
+
+	add_torrent_params atp;
+	atp.info_hashes.v1 = sha1_hash("abababababababababab");
+	atp.name = "snapshot_test";
+	atp.save_path = ".";
+	torrent_handle h = ses.add_torrent(atp);
+
+	// the snapshot is published on the next tick
+	std::this_thread::sleep_for(lt::seconds(2));
+
+	// block the network thread. If status_snapshot() needed it, it would
+	// not return
+	std::promise<void> blocked;
+	std::promise<void> release;
+	std::shared_future<void> released = release.get_future().share();
+	post(ses.get_context(), [&blocked, released] {
+		blocked.set_value();
+		released.wait();
+	});
+	blocked.get_future().wait();
+
+	auto st = std::async(std::launch::async, [&h] { return h.status_snapshot(); });
+	bool const returned = st.wait_for(lt::seconds(5)) == std::future_status::ready;
+	release.set_value();
+
+	TEST_CHECK(returned);
+	std::shared_ptr<torrent_status const> const snapshot = st.get();
+	TEST_CHECK(snapshot);
+	if (snapshot)
+	{
+		TEST_EQUAL(snapshot->name, "snapshot_test");
+		TEST_CHECK(snapshot->handle == h);
+	}
+
+	// status() still asks the network thread, so it reflects operations
+	// posted before it
+	h.unset_flags(torrent_flags::auto_managed);
+	h.pause();
+	TEST_CHECK(h.status().flags & torrent_flags::paused);
+}
+
 namespace {
 
 void test_queue(add_torrent_params const& atp)
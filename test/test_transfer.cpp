@@ -82,6 +82,7 @@ using transfer_flags_t = lt::flags::bitfield_flag<std::uint8_t, transfer_tag>;
 constexpr transfer_flags_t delete_files = 2_bit;
 constexpr transfer_flags_t move_storage = 3_bit;
 constexpr transfer_flags_t piece_deadline = 4_bit;
+constexpr transfer_flags_t limit_download = 5_bit;
 
 void test_transfer(int proxy_type, settings_pack const& sett
 	, transfer_flags_t flags = {}
@@ -185,6 +186,16 @@ void test_transfer(int proxy_type, settings_pack const& sett
 
 	ses2.apply_settings(pack);
 
+	if (flags & limit_download)
+	{
+		// the peers connect over loopback, which puts them in the local peer
+		// class. Its limit is distributed in small chunks every tick, which
+		// makes the blocks arrive across multiple reads
+		peer_class_info pci = ses2.get_peer_class(session::local_peer_class_id);
+		pci.download_limit = 80000;
+		ses2.set_peer_class(session::local_peer_class_id, pci);
+	}
+
 	torrent_handle tor1;
 	torrent_handle tor2;
 
@@ -296,6 +307,24 @@ void test_transfer(int proxy_type, settings_pack const& sett
 		TEST_CHECK(tor2.status().is_seeding);
 	}
 
+#if TORRENT_USE_SENDFILE
+	if (sett.get_bool(settings_pack::sendfile_upload))
+	{
+		// ses1 is the seed. The blocks it uploaded were sent straight from
+		// the file
+		auto const cnt = get_counters(ses1);
+		TEST_CHECK(cnt.at("net.sent_sendfile_bytes") > 0);
+	}
+#endif
+
+	if (sett.get_bool(settings_pack::direct_piece_receive))
+	{
+		// ses2 is the downloader. The blocks were received straight into
+		// disk buffers
+		auto const cnt = get_counters(ses2);
+		TEST_CHECK(cnt.at("net.recv_direct_bytes") > 0);
+	}
+
 	// this allows shutting down the sessions in parallel
 	p1 = ses1.abort();
 	p2 = ses2.abort();
@@ -422,6 +451,29 @@ TORRENT_TEST(disable_os_cache)
 }
 
 
+TORRENT_TEST(sendfile_upload)
+{
+	using namespace lt;
+	settings_pack p;
+	p.set_bool(settings_pack::sendfile_upload, true);
+	test_transfer(0, p);
+
+	cleanup();
+}
+
+TORRENT_TEST(direct_piece_receive)
+{
+	using namespace lt;
+	settings_pack p;
+	p.set_bool(settings_pack::direct_piece_receive, true);
+	// with the download rate limited to 80 kB/s, each tick hands out less
+	// than a block worth of quota. Every block is split across reads
+	p.set_int(settings_pack::tick_interval, 100);
+	test_transfer(0, p, limit_download);
+
+	cleanup();
+}
+
 TORRENT_TEST(write_through)
 {
 	using namespace lt;
@@ -0,0 +1,248 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "test.hpp"
+#include "libtorrent/udp_socket.hpp"
+#include "libtorrent/io_context.hpp"
+#include "libtorrent/aux_/array.hpp"
+
+#include <cstring>
+#include <vector>
+
+using namespace lt;
+
+namespace {
+
+void send_packets(udp::endpoint const& target, int const num)
+{
+	io_context ios;
+	udp::socket sender(ios);
+	sender.open(udp::v4());
+	for (int i = 0; i < num; ++i)
+	{
+		char buf[100];
+		std::memset(buf, i, sizeof(buf));
+		sender.send_to(boost::asio::buffer(buf, std::size_t(i + 1)), target);
+	}
+}
+
+}
+
+TORRENT_TEST(read_batch)
+{
+	io_context ios;
+	udp_socket sock(ios, aux::listen_socket_handle{});
+	error_code ec;
+	sock.open(udp::v4(), ec);
+	TEST_CHECK(!ec);
+	sock.bind(udp::endpoint(make_address_v4("127.0.0.1"), 0), ec);
+	TEST_CHECK(!ec);
+
+	int const num_sent = 20;
+	send_packets(sock.local_endpoint(), num_sent);
+
+	aux::array<udp_socket::packet, udp_socket::read_batch_size> pkts;
+	int received = 0;
+	int syscalls = 0;
+	for (int i = 0; i < 10 && received < num_sent; ++i)
+	{
+		int const num = sock.read(pkts, ec);
+		syscalls += sock.read_syscalls();
+		for (int k = 0; k < num; ++k)
+		{
+			auto const& p = pkts[k];
+			TEST_CHECK(!p.error);
+			TEST_EQUAL(p.data.size(), received + 1);
+			for (char const c : p.data)
+				TEST_EQUAL(c, char(received));
+			TEST_EQUAL(p.from.address(), make_address_v4("127.0.0.1"));
+			++received;
+		}
+		if (ec == boost::asio::error::would_block) ec.clear();
+		TEST_CHECK(!ec);
+	}
+	TEST_EQUAL(received, num_sent);
+	TEST_CHECK(syscalls > 0);
+#if TORRENT_USE_RECVMMSG
+	// the packets were all queued on the socket before we started reading,
+	// they should have been received by a single system call. The second
+	// one finds the socket drained
+	TEST_EQUAL(syscalls, 2);
+#endif
+
+	// the socket is drained
+	TEST_EQUAL(sock.read(pkts, ec), 0);
+	TEST_EQUAL(ec, error_code(boost::asio::error::would_block));
+	sock.close();
+}
+
+TORRENT_TEST(read_batch_limit)
+{
+	io_context ios;
+	udp_socket sock(ios, aux::listen_socket_handle{});
+	error_code ec;
+	sock.open(udp::v4(), ec);
+	TEST_CHECK(!ec);
+	sock.bind(udp::endpoint(make_address_v4("127.0.0.1"), 0), ec);
+	TEST_CHECK(!ec);
+
+	send_packets(sock.local_endpoint(), 5);
+
+	// we never return more packets than the array has room for
+	udp_socket::packet pkts[2];
+	TEST_EQUAL(sock.read(pkts, ec), 2);
+	TEST_EQUAL(pkts[0].data.size(), 1);
+	TEST_EQUAL(pkts[1].data.size(), 2);
+	TEST_EQUAL(sock.read(pkts, ec), 2);
+	TEST_EQUAL(pkts[0].data.size(), 3);
+	TEST_EQUAL(pkts[1].data.size(), 4);
+	TEST_EQUAL(sock.read(pkts, ec), 1);
+	TEST_EQUAL(pkts[0].data.size(), 5);
+	sock.close();
+}
+
+namespace {
+
+void open_socket(udp_socket& sock)
+{
+	error_code ec;
+	sock.open(udp::v4(), ec);
+	TEST_CHECK(!ec);
+	sock.bind(udp::endpoint(make_address_v4("127.0.0.1"), 0), ec);
+	TEST_CHECK(!ec);
+}
+
+// returns the sizes of the packets received, in order. The payload of each
+// packet is expected to be filled with its index
+std::vector<int> receive_all(udp_socket& sock)
+{
+	std::vector<int> ret;
+	aux::array<udp_socket::packet, udp_socket::read_batch_size> pkts;
+	error_code ec;
+	for (;;)
+	{
+		int const num = sock.read(pkts, ec);
+		for (int k = 0; k < num; ++k)
+		{
+			auto const& p = pkts[k];
+			for (char const c : p.data)
+				TEST_EQUAL(c, char(ret.size()));
+			ret.push_back(int(p.data.size()));
+		}
+		if (num == 0) break;
+	}
+	return ret;
+}
+
+}
+
+TORRENT_TEST(send_batch)
+{
+	io_context ios;
+	udp_socket sender(ios, aux::listen_socket_handle{});
+	udp_socket receiver1(ios, aux::listen_socket_handle{});
+	udp_socket receiver2(ios, aux::listen_socket_handle{});
+	open_socket(sender);
+	open_socket(receiver1);
+	open_socket(receiver2);
+
+	// runs of equal sized packets to the same endpoint, interleaved with
+	// packets to a different endpoint and of different sizes
+	std::vector<int> const sizes1 = {1000, 1000, 1000, 500, 1000, 200, 200, 200};
+	std::vector<int> const sizes2 = {300, 300, 300, 1200};
+
+	std::vector<char> buf;
+	error_code ec;
+	int idx1 = 0;
+	int idx2 = 0;
+	for (int const s : sizes1)
+	{
+		buf.assign(std::size_t(s), char(idx1++));
+		sender.send(receiver1.local_endpoint(), buf, ec);
+		TEST_CHECK(!ec);
+		if (idx1 % 3 == 0 && idx2 < int(sizes2.size()))
+		{
+			buf.assign(std::size_t(sizes2[std::size_t(idx2)]), char(idx2));
+			++idx2;
+			sender.send(receiver2.local_endpoint(), buf, ec);
+			TEST_CHECK(!ec);
+		}
+	}
+	while (idx2 < int(sizes2.size()))
+	{
+		buf.assign(std::size_t(sizes2[std::size_t(idx2)]), char(idx2));
+		++idx2;
+		sender.send(receiver2.local_endpoint(), buf, ec);
+		TEST_CHECK(!ec);
+	}
+
+#if TORRENT_USE_SENDMMSG
+	TEST_CHECK(sender.has_queued_packets());
+	TEST_EQUAL(sender.send_syscalls(), 0);
+#endif
+	sender.flush(ec);
+	TEST_CHECK(!ec);
+	TEST_CHECK(!sender.has_queued_packets());
+#if TORRENT_USE_SENDMMSG
+	TEST_EQUAL(sender.send_syscalls(), 1);
+#endif
+
+	TEST_CHECK(receive_all(receiver1) == sizes1);
+	TEST_CHECK(receive_all(receiver2) == sizes2);
+}
+
+TORRENT_TEST(send_dont_fragment_preserves_order)
+{
+	io_context ios;
+	udp_socket sender(ios, aux::listen_socket_handle{});
+	udp_socket receiver(ios, aux::listen_socket_handle{});
+	open_socket(sender);
+	open_socket(receiver);
+
+	std::vector<char> buf;
+	error_code ec;
+	buf.assign(100, char(0));
+	sender.send(receiver.local_endpoint(), buf, ec);
+	TEST_CHECK(!ec);
+	buf.assign(100, char(1));
+	sender.send(receiver.local_endpoint(), buf, ec);
+	TEST_CHECK(!ec);
+
+	// packets with the dont_fragment flag are sent immediately, after the
+	// ones already queued
+	buf.assign(200, char(2));
+	sender.send(receiver.local_endpoint(), buf, ec, udp_socket::dont_fragment);
+	TEST_CHECK(!ec);
+	TEST_CHECK(!sender.has_queued_packets());
+
+	TEST_CHECK((receive_all(receiver) == std::vector<int>{100, 100, 200}));
+}
@@ -0,0 +1,139 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+// measures how long it takes to build a merkle tree from its leaves. By
+// default the tree has 2^24 leaves, which corresponds to a 256 GiB file in a
+// v2 torrent. The tree is built hashing one node at a time, the way it used
+// to be done, with merkle_fill_tree() and with merkle_fill_tree_parallel(),
+// with an increasing number of threads.
+
+#include "libtorrent/aux_/merkle.hpp"
+#include "libtorrent/hasher.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using lt::sha256_hash;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+void fill_leaves(std::vector<sha256_hash>& tree, int const num_leafs)
+{
+	int const first_leaf = lt::merkle_first_leaf(num_leafs);
+	for (int i = 0; i < num_leafs; ++i)
+	{
+		std::uint32_t hash[8];
+		std::fill(std::begin(hash), std::end(hash), std::uint32_t(i + 1));
+		tree[std::size_t(first_leaf + i)] = sha256_hash(reinterpret_cast<char const*>(hash));
+	}
+}
+
+// the reference, a hasher256 object per node
+void fill_naive(std::vector<sha256_hash>& tree, int const num_leafs)
+{
+	for (int i = lt::merkle_first_leaf(num_leafs) - 1; i >= 0; --i)
+	{
+		int const child = lt::merkle_get_first_child(i);
+		lt::hasher256 h;
+		h.update(tree[std::size_t(child)]);
+		h.update(tree[std::size_t(child + 1)]);
+		tree[std::size_t(i)] = h.final();
+	}
+}
+
+template <typename Fun>
+void run(char const* name, std::vector<sha256_hash>& tree, int const num_leafs
+	, sha256_hash& root, Fun f)
+{
+	fill_leaves(tree, num_leafs);
+	tree[0].clear();
+	auto const start = clock_type::now();
+	f();
+	auto const duration = clock_type::now() - start;
+	double const seconds = std::chrono::duration<double>(duration).count();
+
+	// all variations must produce the same root
+	if (root.is_all_zeros()) root = tree[0];
+	else if (root != tree[0])
+	{
+		std::cerr << name << ": root mismatch\n";
+		std::exit(1);
+	}
+
+	std::printf("%-24s %8.3f s %10.0f nodes/s\n", name, seconds
+		, double(num_leafs - 1) / seconds);
+}
+
+}
+
+int main(int argc, char const* argv[])
+{
+	int leafs_log = 24;
+	int max_threads = int(std::thread::hardware_concurrency());
+	if (argc > 1) leafs_log = std::atoi(argv[1]);
+	if (argc > 2) max_threads = std::atoi(argv[2]);
+
+	if (leafs_log <= 0 || leafs_log > 28 || max_threads <= 0)
+	{
+		std::cerr << "usage: merkle_benchmark [log2-leaves] [max-threads]\n";
+		return 1;
+	}
+
+	int const num_leafs = 1 << leafs_log;
+	std::vector<sha256_hash> tree(std::size_t(lt::merkle_num_nodes(num_leafs)));
+	sha256_hash root;
+
+	std::printf("leaves: %d (%d MiB tree)\n", num_leafs
+		, int(tree.size() * sizeof(sha256_hash) / 1024 / 1024));
+
+	run("per-node hasher", tree, num_leafs, root
+		, [&]{ fill_naive(tree, num_leafs); });
+	run("merkle_fill_tree", tree, num_leafs, root
+		, [&]{ lt::merkle_fill_tree(tree, num_leafs); });
+
+	for (int threads = 1; threads <= max_threads; threads *= 2)
+	{
+		char name[50];
+		std::snprintf(name, sizeof(name), "parallel (%d threads)", threads);
+		run(name, tree, num_leafs, root
+			, [&]{ lt::merkle_fill_tree_parallel(tree, num_leafs, threads); });
+	}
+	return 0;
+}
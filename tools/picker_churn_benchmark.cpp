@@ -0,0 +1,135 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+// measures the cost of peer churn on the piece picker's availability
+// counters. A number of peers with random bitfields are connected, then
+// peers are repeatedly disconnected and replaced by new ones. Every few
+// connection events a peer picks pieces, which requires the piece list to be
+// up to date.
+
+#include "libtorrent/piece_picker.hpp"
+#include "libtorrent/bitfield.hpp"
+#include "libtorrent/performance_counters.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using lt::piece_index_t;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+lt::typed_bitfield<piece_index_t> random_bitfield(std::mt19937& rng
+	, int const num_pieces)
+{
+	// peers have anything from a few pieces to almost all of them
+	std::uniform_int_distribution<int> fill(1, 99);
+	std::uniform_int_distribution<int> percent(0, 99);
+	int const density = fill(rng);
+	lt::typed_bitfield<piece_index_t> ret(num_pieces);
+	for (auto const i : ret.range())
+		if (percent(rng) < density) ret.set_bit(i);
+	return ret;
+}
+
+}
+
+int main(int argc, char const* argv[])
+{
+	int num_pieces = 100000;
+	int num_peers = 500;
+	int num_events = 20000;
+	int pick_interval = 10;
+	if (argc > 1) num_pieces = std::atoi(argv[1]);
+	if (argc > 2) num_peers = std::atoi(argv[2]);
+	if (argc > 3) num_events = std::atoi(argv[3]);
+	if (argc > 4) pick_interval = std::atoi(argv[4]);
+
+	if (num_pieces <= 0 || num_peers <= 0 || num_events <= 0 || pick_interval <= 0)
+	{
+		std::cerr << "usage: picker_churn_benchmark [pieces] [peers] [events] [pick-interval]\n";
+		return 1;
+	}
+
+	std::mt19937 rng(0x1337);
+	int const piece_size = 0x40000;
+	lt::piece_picker picker(std::int64_t(num_pieces) * piece_size, piece_size);
+
+	// generate all bitfields up-front, to keep it out of the measurement
+	std::vector<lt::typed_bitfield<piece_index_t>> pool;
+	for (int i = 0; i < num_peers * 2; ++i)
+		pool.push_back(random_bitfield(rng, num_pieces));
+
+	std::vector<std::size_t> connected;
+	for (int i = 0; i < num_peers; ++i)
+	{
+		picker.inc_refcount(pool[std::size_t(i)], nullptr);
+		connected.push_back(std::size_t(i));
+	}
+
+	lt::typed_bitfield<piece_index_t> const all(num_pieces, true);
+	std::vector<lt::piece_block> picked;
+	std::vector<piece_index_t> const suggested;
+	lt::counters cnt;
+	std::uniform_int_distribution<std::size_t> peer(0, connected.size() - 1);
+	std::uniform_int_distribution<std::size_t> replacement(0, pool.size() - 1);
+
+	auto const start = clock_type::now();
+	for (int e = 0; e < num_events; ++e)
+	{
+		// one peer disconnects and another one connects
+		std::size_t& slot = connected[peer(rng)];
+		picker.dec_refcount(pool[slot], nullptr);
+		slot = replacement(rng);
+		picker.inc_refcount(pool[slot], nullptr);
+
+		if ((e % pick_interval) == 0)
+		{
+			picked.clear();
+			picker.pick_pieces(all, picked, 16, 0, nullptr
+				, lt::piece_picker::rarest_first, suggested, num_peers, cnt);
+		}
+	}
+	auto const duration = clock_type::now() - start;
+	double const seconds = std::chrono::duration<double>(duration).count();
+
+	std::printf("pieces: %d peers: %d events: %d pick every %d events\n"
+		, num_pieces, num_peers, num_events, pick_interval);
+	std::printf("%8.3f s %10.2f us/event\n", seconds
+		, seconds * 1000000. / num_events);
+	return 0;
+}
@@ -0,0 +1,130 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+// measures the throughput of the store buffer as the number of threads
+// accessing it grows. Each thread simulates a disk thread, inserting and
+// erasing blocks of its own, interleaved with lookups, like the network
+// thread issuing reads.
+
+#include "libtorrent/aux_/store_buffer.hpp"
+#include "libtorrent/disk_interface.hpp" // for default_block_size
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using lt::aux::torrent_location;
+using lt::aux::store_buffer;
+
+namespace {
+
+// the number of blocks each thread keeps in the store buffer at a time
+int const blocks_per_thread = 64;
+
+void worker(store_buffer& sb, int const thread_id, int const rounds
+	, std::atomic<bool>& start, std::atomic<std::int64_t>& ops)
+{
+	std::vector<char> bufs(blocks_per_thread);
+	lt::storage_index_t const st(thread_id % 4);
+	int const first_piece = thread_id * blocks_per_thread / 4;
+	auto location = [&](int const i) {
+		return torrent_location(st, lt::piece_index_t(first_piece + i / 4)
+			, (i % 4) * lt::default_block_size);
+	};
+
+	while (!start) std::this_thread::yield();
+
+	std::int64_t count = 0;
+	std::int64_t hits = 0;
+	for (int r = 0; r < rounds; ++r)
+	{
+		for (int i = 0; i < blocks_per_thread; ++i)
+			sb.insert(location(i), &bufs[std::size_t(i)]);
+
+		for (int i = 0; i < blocks_per_thread - 1; ++i)
+		{
+			hits += sb.get(location(i), [](char const*) {}) ? 1 : 0;
+			hits += sb.get2(location(i), location(i + 1)
+				, [](char const*, char const*) { return 1; });
+		}
+
+		for (int i = 0; i < blocks_per_thread; ++i)
+			sb.erase(location(i));
+
+		count += blocks_per_thread * 2 + (blocks_per_thread - 1) * 2;
+	}
+	if (hits != std::int64_t(rounds) * (blocks_per_thread - 1) * 2) std::abort();
+	ops += count;
+}
+
+}
+
+int main(int argc, char const* argv[])
+{
+	int max_threads = 64;
+	int rounds = 2000;
+	if (argc > 1) max_threads = std::atoi(argv[1]);
+	if (argc > 2) rounds = std::atoi(argv[2]);
+
+	if (max_threads <= 0 || rounds <= 0)
+	{
+		std::cerr << "usage: store_buffer_benchmark [max-threads] [rounds]\n";
+		return 1;
+	}
+
+	std::cout << "threads      ops/s    ns/op\n";
+	for (int num_threads = 1; num_threads <= max_threads; num_threads *= 2)
+	{
+		store_buffer sb;
+		std::atomic<bool> start{false};
+		std::atomic<std::int64_t> ops{0};
+		std::vector<std::thread> threads;
+		for (int i = 0; i < num_threads; ++i)
+			threads.emplace_back(worker, std::ref(sb), i, rounds
+				, std::ref(start), std::ref(ops));
+
+		auto const start_time = std::chrono::steady_clock::now();
+		start = true;
+		for (auto& t : threads) t.join();
+		auto const duration = std::chrono::steady_clock::now() - start_time;
+
+		double const seconds = std::chrono::duration<double>(duration).count();
+		double const ops_per_second = double(ops) / seconds;
+		std::printf("%7d %10.0f %8.1f\n", num_threads, ops_per_second
+			, 1e9 * num_threads / ops_per_second);
+	}
+	return 0;
+}